@@ -0,0 +1,172 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file bounds.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-14
+///
+///\brief Vectorized bounding box reduction over strided point arrays
+
+#ifndef CIRCE_CIRCE_COMMON_BOUNDS_H
+#define CIRCE_CIRCE_COMMON_BOUNDS_H
+
+#include <circe/common/parallel.h>
+#include <circe/common/simd.h>
+#include <hermes/geometry/bbox.h>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace circe {
+
+/// Min/max reductions over points stored in interleaved (AoS) buffers.
+/// Points are read as 3 consecutive f32 values every stride bytes. Large
+/// arrays are split across threads and each block is reduced with SSE
+/// (4-wide loads of x y z + padding) when available.
+class Bounds final {
+public:
+  /// \param points address of the first point (x y z as f32)
+  /// \param count number of points
+  /// \param stride distance in bytes between consecutive points
+  /// \return bounding box of the points (empty box if count is 0)
+  static hermes::bbox3 ofPoints(const void *points, u64 count, u64 stride = 3 * sizeof(f32)) {
+    hermes::bbox3 box;
+    if (!count)
+      return box;
+    const auto *bytes = static_cast<const u8 *>(points);
+    std::vector<std::array<f32, 6>> partial(Parallel::blockCount(count, min_block_size));
+    Parallel::forBlocks(count, [&](u64 begin, u64 end, u32 block) {
+      reduce(bytes, begin, end, count, stride, partial[block].data());
+    }, min_block_size);
+    for (u32 d = 0; d < 3; ++d) {
+      f32 lower = partial[0][d];
+      f32 upper = partial[0][d + 3];
+      for (const auto &p : partial) {
+        lower = std::min(lower, p[d]);
+        upper = std::max(upper, p[d + 3]);
+      }
+      box.lower[d] = lower;
+      box.upper[d] = upper;
+    }
+    return box;
+  }
+
+  /// \param box
+  /// \return surface area of box (0 for empty boxes)
+  static f64 area(const hermes::bbox3 &box) {
+    const f64 dx = box.upper.x - box.lower.x, dy = box.upper.y - box.lower.y, dz = box.upper.z - box.lower.z;
+    if (dx < 0 || dy < 0 || dz < 0)
+      return 0;
+    return 2 * (dx * dy + dx * dz + dy * dz);
+  }
+  /// \param a
+  /// \param b
+  /// \return smallest box containing a and b
+  static hermes::bbox3 merge(const hermes::bbox3 &a, const hermes::bbox3 &b) {
+    hermes::bbox3 r;
+    for (int d = 0; d < 3; ++d) {
+      r.lower[d] = std::min(a.lower[d], b.lower[d]);
+      r.upper[d] = std::max(a.upper[d], b.upper[d]);
+    }
+    return r;
+  }
+  /// Reciprocal of a ray direction component for slab tests. Zero components
+  /// map to a large finite value, so the test never computes 0 * inf.
+  /// \param d
+  /// \return
+  static f32 safeInverse(f32 d) {
+    return std::fabs(d) > 1e-20f ? 1.f / d : std::copysign(1e20f, d);
+  }
+  /// Slab test of a ray against a box
+  /// \param box
+  /// \param origin ray origin (x y z)
+  /// \param inv_dir safeInverse of each ray direction component
+  /// \param dir_is_neg 1 for the components where inv_dir is negative
+  /// \param t_max
+  /// \return true if the ray overlaps box somewhere in [0, t_max]
+  static bool hitsSlabs(const hermes::bbox3 &box, const f32 *origin, const f32 *inv_dir, const int *dir_is_neg,
+                        f32 t_max) {
+    f32 t_min = 0;
+    for (int d = 0; d < 3; ++d) {
+      const f32 t0 = (box[dir_is_neg[d]][d] - origin[d]) * inv_dir[d];
+      const f32 t1 = (box[1 - dir_is_neg[d]][d] - origin[d]) * inv_dir[d];
+      t_min = t0 > t_min ? t0 : t_min;
+      t_max = t1 < t_max ? t1 : t_max;
+      if (t_min > t_max)
+        return false;
+    }
+    return true;
+  }
+
+  static constexpr u64 min_block_size = 1u << 15;
+
+private:
+  /// Reduces points [begin, end) into lower_upper (3 minima followed by 3 maxima)
+  static void reduce(const u8 *bytes, u64 begin, u64 end, u64 count, u64 stride, f32 *lower_upper) {
+    f32 lower[3] = {std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max(),
+                    std::numeric_limits<f32>::max()};
+    f32 upper[3] = {std::numeric_limits<f32>::lowest(), std::numeric_limits<f32>::lowest(),
+                    std::numeric_limits<f32>::lowest()};
+    u64 i = begin;
+#ifdef CIRCE_SSE
+    // points may sit at any offset inside their vertex, so only 12 bytes are
+    // known to be readable after the last one: it is always reduced scalar
+    // (every other point is followed by a whole point)
+    const u64 simd_end = std::min(end, count - 1);
+    auto load = [&](u64 k) { return _mm_loadu_ps(reinterpret_cast<const f32 *>(bytes + k * stride)); };
+    __m128 lo = _mm_set1_ps(std::numeric_limits<f32>::max());
+    __m128 hi = _mm_set1_ps(std::numeric_limits<f32>::lowest());
+    // 4 independent loads per iteration
+    for (; i + 4 <= simd_end; i += 4) {
+      const __m128 a = load(i), b = load(i + 1), c = load(i + 2), d = load(i + 3);
+      lo = _mm_min_ps(lo, _mm_min_ps(_mm_min_ps(a, b), _mm_min_ps(c, d)));
+      hi = _mm_max_ps(hi, _mm_max_ps(_mm_max_ps(a, b), _mm_max_ps(c, d)));
+    }
+    for (; i < simd_end; ++i) {
+      const __m128 a = load(i);
+      lo = _mm_min_ps(lo, a);
+      hi = _mm_max_ps(hi, a);
+    }
+    alignas(16) f32 simd_lower[4], simd_upper[4];
+    _mm_store_ps(simd_lower, lo);
+    _mm_store_ps(simd_upper, hi);
+    for (u32 d = 0; d < 3; ++d) {
+      lower[d] = simd_lower[d];
+      upper[d] = simd_upper[d];
+    }
+#endif
+    for (; i < end; ++i) {
+      const auto *p = reinterpret_cast<const f32 *>(bytes + i * stride);
+      for (u32 d = 0; d < 3; ++d) {
+        lower[d] = std::min(lower[d], p[d]);
+        upper[d] = std::max(upper[d], p[d]);
+      }
+    }
+    for (u32 d = 0; d < 3; ++d) {
+      lower_upper[d] = lower[d];
+      lower_upper[d + 3] = upper[d];
+    }
+  }
+};
+
+}
+
+#endif //CIRCE_CIRCE_COMMON_BOUNDS_H
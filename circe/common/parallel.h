@@ -0,0 +1,169 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file parallel.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-10
+///
+///\brief Fork-join helpers used by the cpu-side geometry stages
+
+#ifndef CIRCE_CIRCE_COMMON_PARALLEL_H
+#define CIRCE_CIRCE_COMMON_PARALLEL_H
+
+#include <hermes/common/defs.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace circe {
+
+/// Static set of fork-join helpers built on top of std::thread.
+/// Work is split into contiguous blocks, one per worker, so callers can keep
+/// per-thread state (accumulators, output buffers) indexed by the block index
+/// and merge them afterwards.
+/// Example:
+///   std::vector<u64> partial(Parallel::blockCount(n));
+///   Parallel::forBlocks(n, [&](u64 begin, u64 end, u32 block) {
+///     for (u64 i = begin; i < end; ++i)
+///       partial[block] += values[i];
+///   });
+///
+/// Loops started from inside a parallel region (a block, an invoke task or a
+/// thread that declared itself a worker with WorkerScope) run serially on the
+/// calling thread, so nested loops never multiply the number of threads.
+class Parallel final {
+public:
+  /// Marks the current thread as a worker while alive: parallel loops
+  /// started from it run serially. Long lived threads that already run in
+  /// parallel with each other (overlapping asset decodes, for example)
+  /// should hold one.
+  class WorkerScope {
+  public:
+    WorkerScope() : previous_(insideWorkerRef()) { insideWorkerRef() = true; }
+    ~WorkerScope() { insideWorkerRef() = previous_; }
+    WorkerScope(const WorkerScope &) = delete;
+    WorkerScope &operator=(const WorkerScope &) = delete;
+
+  private:
+    bool previous_;
+  };
+  /// \return number of threads used by parallel loops
+  static u32 threadCount() {
+    const u32 count = threadCountRef().load(std::memory_order_relaxed);
+    return count ? count : std::max(1u, std::thread::hardware_concurrency());
+  }
+  /// Overrides the number of threads used by parallel loops
+  /// \param thread_count (0 means hardware concurrency)
+  static void setThreadCount(u32 thread_count) {
+    threadCountRef().store(thread_count, std::memory_order_relaxed);
+  }
+  /// \return true if the calling thread runs inside a parallel region
+  static bool insideWorker() { return insideWorkerRef(); }
+  /// \param n number of items
+  /// \param min_block_size minimum number of items per block
+  /// \return number of blocks forBlocks will use for n items (1 inside workers)
+  static u32 blockCount(u64 n, u64 min_block_size = default_block_size) {
+    if (!n)
+      return 0;
+    if (insideWorker())
+      return 1;
+    u64 blocks = std::max<u64>(1, n / std::max<u64>(1, min_block_size));
+    return static_cast<u32>(std::min<u64>(blocks, threadCount()));
+  }
+  /// Splits [0, n) into blockCount(n) contiguous ranges and calls
+  /// f(begin, end, block_index) for each one of them in parallel.
+  /// The calling thread processes the last block.
+  /// \tparam F void(u64, u64, u32)
+  /// \param n number of items
+  /// \param f block function
+  /// \param min_block_size minimum number of items per block
+  template<typename F>
+  static void forBlocks(u64 n, F &&f, u64 min_block_size = default_block_size) {
+    const u32 blocks = blockCount(n, min_block_size);
+    if (blocks <= 1) {
+      if (n)
+        f(0, n, 0);
+      return;
+    }
+    const u64 block_size = (n + blocks - 1) / blocks;
+    std::vector<std::thread> workers;
+    workers.reserve(blocks - 1);
+    for (u32 b = 0; b + 1 < blocks; ++b)
+      workers.emplace_back([&f, b, block_size, n]() {
+        WorkerScope scope;
+        f(b * block_size, std::min(n, (b + 1) * block_size), b);
+      });
+    {
+      WorkerScope scope;
+      f((blocks - 1) * block_size, n, blocks - 1);
+    }
+    for (auto &worker : workers)
+      worker.join();
+  }
+  /// Calls f(i) for each i in [0, n) in parallel
+  /// \tparam F void(u64)
+  /// \param n number of items
+  /// \param f item function
+  /// \param min_block_size minimum number of items per thread
+  template<typename F>
+  static void forEach(u64 n, F &&f, u64 min_block_size = default_block_size) {
+    forBlocks(n, [&f](u64 begin, u64 end, u32) {
+      for (u64 i = begin; i < end; ++i)
+        f(i);
+    }, min_block_size);
+  }
+  /// Runs both functions concurrently and waits for them. Nested invokes
+  /// still spawn threads (callers bound their recursion depth), loops inside
+  /// the tasks run serially.
+  /// \tparam A void()
+  /// \tparam B void()
+  /// \param a first task (runs on a new thread)
+  /// \param b second task (runs on the calling thread)
+  template<typename A, typename B>
+  static void invoke(A &&a, B &&b) {
+    std::thread worker([&a]() {
+      WorkerScope scope;
+      a();
+    });
+    {
+      WorkerScope scope;
+      b();
+    }
+    worker.join();
+  }
+
+  static constexpr u64 default_block_size = 1u << 14;
+
+private:
+  static std::atomic<u32> &threadCountRef() {
+    static std::atomic<u32> thread_count{0};
+    return thread_count;
+  }
+  static bool &insideWorkerRef() {
+    thread_local bool inside_worker{false};
+    return inside_worker;
+  }
+};
+
+}
+
+#endif //CIRCE_CIRCE_COMMON_PARALLEL_H
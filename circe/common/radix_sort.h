@@ -0,0 +1,129 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file radix_sort.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-11
+///
+///\brief Parallel LSD radix sort for 64-bit keys
+
+#ifndef CIRCE_CIRCE_COMMON_RADIX_SORT_H
+#define CIRCE_CIRCE_COMMON_RADIX_SORT_H
+
+#include <circe/common/parallel.h>
+#include <array>
+
+namespace circe {
+
+/// Stable least-significant-digit radix sort of 64-bit keys (8-bit digits).
+/// Each pass builds per-thread digit histograms, computes the scatter offsets
+/// of every (digit, thread) pair and scatters in parallel. Passes in which all
+/// keys share the same digit are skipped, so keys that only use their lower
+/// bits cost fewer passes.
+class RadixSort final {
+public:
+  /// Sorts keys in ascending order
+  /// \param keys
+  static void sort(std::vector<u64> &keys) {
+    std::vector<u8> no_values;
+    sortImpl<false, u8>(keys, no_values);
+  }
+  /// Sorts keys in ascending order, values are permuted along with their keys.
+  /// Values with equal keys keep their relative order.
+  /// \tparam V value type
+  /// \param keys
+  /// \param values (same size of keys)
+  template<typename V>
+  static void sort(std::vector<u64> &keys, std::vector<V> &values) {
+    sortImpl<true, V>(keys, values);
+  }
+
+private:
+  static constexpr u32 digit_bits = 8;
+  static constexpr u32 bucket_count = 1u << digit_bits;
+  static constexpr u32 pass_count = 64 / digit_bits;
+
+  template<bool HasValues, typename V>
+  static void sortImpl(std::vector<u64> &keys, std::vector<V> &values) {
+    const u64 n = keys.size();
+    if (n < 2)
+      return;
+    // find which digits actually vary
+    const u32 blocks = Parallel::blockCount(n);
+    std::vector<u64> block_or(blocks, 0), block_and(blocks, ~0ull);
+    Parallel::forBlocks(n, [&](u64 begin, u64 end, u32 block) {
+      u64 o = 0, a = ~0ull;
+      for (u64 i = begin; i < end; ++i) {
+        o |= keys[i];
+        a &= keys[i];
+      }
+      block_or[block] = o;
+      block_and[block] = a;
+    });
+    u64 varying_bits = 0, common_bits = ~0ull;
+    for (u32 b = 0; b < blocks; ++b) {
+      varying_bits |= block_or[b];
+      common_bits &= block_and[b];
+    }
+    varying_bits &= ~common_bits;
+
+    std::vector<u64> tmp_keys(n);
+    std::vector<V> tmp_values(HasValues ? n : 0);
+    std::vector<std::array<u64, bucket_count>> offsets(blocks);
+    for (u32 pass = 0; pass < pass_count; ++pass) {
+      const u32 shift = pass * digit_bits;
+      if (!((varying_bits >> shift) & (bucket_count - 1)))
+        continue;
+      // histograms
+      Parallel::forBlocks(n, [&](u64 begin, u64 end, u32 block) {
+        auto &histogram = offsets[block];
+        histogram.fill(0);
+        for (u64 i = begin; i < end; ++i)
+          histogram[(keys[i] >> shift) & (bucket_count - 1)]++;
+      });
+      // exclusive scan in (digit, block) order
+      u64 sum = 0;
+      for (u32 digit = 0; digit < bucket_count; ++digit)
+        for (u32 block = 0; block < blocks; ++block) {
+          u64 count = offsets[block][digit];
+          offsets[block][digit] = sum;
+          sum += count;
+        }
+      // scatter
+      Parallel::forBlocks(n, [&](u64 begin, u64 end, u32 block) {
+        auto &offset = offsets[block];
+        for (u64 i = begin; i < end; ++i) {
+          const u64 destination = offset[(keys[i] >> shift) & (bucket_count - 1)]++;
+          tmp_keys[destination] = keys[i];
+          if constexpr (HasValues)
+            tmp_values[destination] = values[i];
+        }
+      });
+      keys.swap(tmp_keys);
+      if constexpr (HasValues)
+        values.swap(tmp_values);
+    }
+  }
+};
+
+}
+
+#endif //CIRCE_CIRCE_COMMON_RADIX_SORT_H
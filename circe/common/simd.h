@@ -0,0 +1,48 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file simd.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-28
+///
+///\brief Compile time SIMD instruction set detection
+
+#ifndef CIRCE_CIRCE_COMMON_SIMD_H
+#define CIRCE_CIRCE_COMMON_SIMD_H
+
+// Defines CIRCE_SSE, CIRCE_SSE2 and CIRCE_AVX for the instruction sets the
+// compiler targets and includes their intrinsics. Kernels pick the widest
+// available path and keep a scalar fallback.
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CIRCE_SSE
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CIRCE_SSE2
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CIRCE_AVX
+#endif
+
+#endif //CIRCE_CIRCE_COMMON_SIMD_H
@@ -0,0 +1,288 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file transform_kernels.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-21
+///
+///\brief Vectorized bulk transforms over strided point and vector arrays
+
+#ifndef CIRCE_CIRCE_COMMON_TRANSFORM_KERNELS_H
+#define CIRCE_CIRCE_COMMON_TRANSFORM_KERNELS_H
+
+#include <circe/common/parallel.h>
+#include <circe/common/simd.h>
+#include <cmath>
+#include <cstring>
+
+
+namespace circe {
+
+/// Bulk kernels that transform 3-component f32 elements stored every stride
+/// bytes (an interleaved attribute) or packed (stride = 12, a separate
+/// attribute array). Large arrays are split across threads. Packed arrays
+/// are processed 8 (AVX) or 4 (SSE) elements at a time after an in-register
+/// transpose to x/y/z lanes; strided arrays are processed one element per
+/// SSE register. A scalar loop handles the rest (and builds without SIMD).
+///
+/// Matrices are row-major: p' = m[0..2][0..2] * p + m[0..2][3].
+class TransformKernels final {
+public:
+  /// Applies an affine transform to points
+  /// \param m 3x4 row-major matrix (the last row of a 4x4 affine matrix is implicit)
+  /// \param points address of the first point (x y z as f32)
+  /// \param count number of points
+  /// \param stride distance in bytes between consecutive points
+  static void transformPoints(const f32 (&m)[3][4], void *points, u64 count, u64 stride = 3 * sizeof(f32)) {
+    run(m, true, false, points, count, stride);
+  }
+  /// Applies a linear transform to vectors
+  /// \note normals must be transformed by the inverse transpose (see normalMatrix)
+  /// \param m 3x3 row-major matrix (stored in the first 3 columns)
+  /// \param vectors address of the first vector (x y z as f32)
+  /// \param count number of vectors
+  /// \param stride distance in bytes between consecutive vectors
+  /// \param normalize_result normalizes the transformed vectors
+  static void transformVectors(const f32 (&m)[3][4], void *vectors, u64 count,
+                               u64 stride = 3 * sizeof(f32), bool normalize_result = false) {
+    run(m, false, normalize_result, vectors, count, stride);
+  }
+  /// Normalizes vectors (zero vectors are kept)
+  /// \param vectors address of the first vector (x y z as f32)
+  /// \param count number of vectors
+  /// \param stride distance in bytes between consecutive vectors
+  static void normalize(void *vectors, u64 count, u64 stride = 3 * sizeof(f32)) {
+    static constexpr f32 identity[3][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+    run(identity, false, true, vectors, count, stride);
+  }
+  /// Computes the inverse transpose of the linear part of m (scaled by
+  /// |det|, which normalization removes)
+  /// \param m 3x4 row-major matrix
+  /// \param normal_matrix **[out]** 3x3 matrix (stored in the first 3 columns)
+  /// \return false if m is singular
+  static bool normalMatrix(const f32 (&m)[3][4], f32 (&normal_matrix)[3][4]) {
+    // the cofactor matrix is det * inverse transpose
+    for (int i = 0; i < 3; ++i) {
+      const int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+      for (int j = 0; j < 3; ++j) {
+        const int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+        normal_matrix[i][j] = m[i1][j1] * m[i2][j2] - m[i1][j2] * m[i2][j1];
+      }
+      normal_matrix[i][3] = 0;
+    }
+    const f32 det = m[0][0] * normal_matrix[0][0] + m[0][1] * normal_matrix[0][1] + m[0][2] * normal_matrix[0][2];
+    if (det == 0)
+      return false;
+    // keep the orientation of mirrored transforms
+    if (det < 0)
+      for (auto &row : normal_matrix)
+        for (auto &v : row)
+          v = -v;
+    return true;
+  }
+
+  static constexpr u64 min_block_size = 1u << 14;
+
+private:
+  static void run(const f32 (&m)[3][4], bool translate, bool normalize_result,
+                  void *elements, u64 count, u64 stride) {
+    if (!count)
+      return;
+    auto *bytes = static_cast<u8 *>(elements);
+    Parallel::forBlocks(count, [&](u64 begin, u64 end, u32) {
+      if (stride == 3 * sizeof(f32))
+        packed(m, translate, normalize_result, reinterpret_cast<f32 *>(bytes), begin, end);
+      else
+        strided(m, translate, normalize_result, bytes, begin, end, stride);
+    }, min_block_size);
+  }
+
+  static void scalar(const f32 (&m)[3][4], bool translate, bool normalize_result, f32 *p) {
+    const f32 x = p[0], y = p[1], z = p[2];
+    for (int d = 0; d < 3; ++d)
+      p[d] = m[d][0] * x + m[d][1] * y + m[d][2] * z + (translate ? m[d][3] : 0.f);
+    if (normalize_result) {
+      const f32 length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+      if (length > 0)
+        for (int d = 0; d < 3; ++d)
+          p[d] /= length;
+    }
+  }
+
+  /// Elements [begin, end) of a packed x y z array
+  static void packed(const f32 (&m)[3][4], bool translate, bool normalize_result, f32 *p, u64 begin, u64 end) {
+    u64 i = begin;
+#ifdef CIRCE_AVX
+    {
+      __m256 r[3][4];
+      for (int d = 0; d < 3; ++d)
+        for (int k = 0; k < 4; ++k)
+          r[d][k] = _mm256_set1_ps(k == 3 && !translate ? 0.f : m[d][k]);
+      for (; i + 8 <= end; i += 8) {
+        f32 *q = p + i * 3;
+        // lane 0 holds elements i..i+3, lane 1 holds i+4..i+7
+        const __m256 a = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(q)), _mm_loadu_ps(q + 12), 1);
+        const __m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(q + 4)), _mm_loadu_ps(q + 16), 1);
+        const __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(q + 8)), _mm_loadu_ps(q + 20), 1);
+        __m256 x, y, z;
+        transpose(a, b, c, x, y, z);
+        __m256 o[3];
+        for (int d = 0; d < 3; ++d)
+          o[d] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[d][0], x), _mm256_mul_ps(r[d][1], y)),
+                               _mm256_add_ps(_mm256_mul_ps(r[d][2], z), r[d][3]));
+        if (normalize_result)
+          normalizeLanes(o[0], o[1], o[2]);
+        __m256 oa, ob, oc;
+        untranspose(o[0], o[1], o[2], oa, ob, oc);
+        _mm_storeu_ps(q, _mm256_castps256_ps128(oa));
+        _mm_storeu_ps(q + 4, _mm256_castps256_ps128(ob));
+        _mm_storeu_ps(q + 8, _mm256_castps256_ps128(oc));
+        _mm_storeu_ps(q + 12, _mm256_extractf128_ps(oa, 1));
+        _mm_storeu_ps(q + 16, _mm256_extractf128_ps(ob, 1));
+        _mm_storeu_ps(q + 20, _mm256_extractf128_ps(oc, 1));
+      }
+    }
+#endif
+#ifdef CIRCE_SSE
+    {
+      __m128 r[3][4];
+      for (int d = 0; d < 3; ++d)
+        for (int k = 0; k < 4; ++k)
+          r[d][k] = _mm_set1_ps(k == 3 && !translate ? 0.f : m[d][k]);
+      for (; i + 4 <= end; i += 4) {
+        f32 *q = p + i * 3;
+        __m128 x, y, z;
+        transpose(_mm_loadu_ps(q), _mm_loadu_ps(q + 4), _mm_loadu_ps(q + 8), x, y, z);
+        __m128 o[3];
+        for (int d = 0; d < 3; ++d)
+          o[d] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[d][0], x), _mm_mul_ps(r[d][1], y)),
+                            _mm_add_ps(_mm_mul_ps(r[d][2], z), r[d][3]));
+        if (normalize_result)
+          normalizeLanes(o[0], o[1], o[2]);
+        __m128 oa, ob, oc;
+        untranspose(o[0], o[1], o[2], oa, ob, oc);
+        _mm_storeu_ps(q, oa);
+        _mm_storeu_ps(q + 4, ob);
+        _mm_storeu_ps(q + 8, oc);
+      }
+    }
+#endif
+    for (; i < end; ++i)
+      scalar(m, translate, normalize_result, p + i * 3);
+  }
+
+  /// Elements [begin, end) stored every stride bytes
+  static void strided(const f32 (&m)[3][4], bool translate, bool normalize_result,
+                      u8 *bytes, u64 begin, u64 end, u64 stride) {
+    u64 i = begin;
+#ifdef CIRCE_SSE
+    // matrix columns, the result of each element is c0 * x + c1 * y + c2 * z + c3
+    const __m128 c0 = _mm_setr_ps(m[0][0], m[1][0], m[2][0], 0);
+    const __m128 c1 = _mm_setr_ps(m[0][1], m[1][1], m[2][1], 0);
+    const __m128 c2 = _mm_setr_ps(m[0][2], m[1][2], m[2][2], 0);
+    const __m128 c3 = translate ? _mm_setr_ps(m[0][3], m[1][3], m[2][3], 0) : _mm_setzero_ps();
+    for (; i < end; ++i) {
+      auto *p = reinterpret_cast<f32 *>(bytes + i * stride);
+      // scalar loads never read past the element
+      __m128 o = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])), _mm_mul_ps(c1, _mm_set1_ps(p[1]))),
+                            _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p[2])), c3));
+      if (normalize_result) {
+        const __m128 squared = _mm_mul_ps(o, o);
+        const __m128 length_squared = _mm_add_ss(_mm_add_ss(squared, _mm_shuffle_ps(squared, squared, 1)),
+                                                 _mm_movehl_ps(squared, squared));
+        const __m128 length = _mm_sqrt_ss(length_squared);
+        if (_mm_cvtss_f32(length) > 0)
+          o = _mm_div_ps(o, _mm_shuffle_ps(length, length, 0));
+      }
+      _mm_storel_pi(reinterpret_cast<__m64 *>(p), o);
+      _mm_store_ss(p + 2, _mm_movehl_ps(o, o));
+    }
+#endif
+    for (; i < end; ++i)
+      scalar(m, translate, normalize_result, reinterpret_cast<f32 *>(bytes + i * stride));
+  }
+
+#ifdef CIRCE_SSE
+  // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3 <-> x0..x3, y0..y3, z0..z3
+  static void transpose(__m128 a, __m128 b, __m128 c, __m128 &x, __m128 &y, __m128 &z) {
+    const __m128 t1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2)); // x2 y2 x3 y3
+    const __m128 t2 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1)); // y0 z0 y1 z1
+    x = _mm_shuffle_ps(a, t1, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(t2, t1, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm_shuffle_ps(t2, c, _MM_SHUFFLE(3, 0, 3, 1));
+  }
+  static void untranspose(__m128 x, __m128 y, __m128 z, __m128 &a, __m128 &b, __m128 &c) {
+    const __m128 x0x1y0y1 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m128 z0z1x1x2 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(2, 1, 1, 0));
+    const __m128 y1y2z1z2 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(2, 1, 2, 1));
+    const __m128 x2x3y2y3 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m128 z2z3x3x3 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 3, 2));
+    const __m128 y2y3z2z3 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 2, 3, 2));
+    a = _mm_shuffle_ps(x0x1y0y1, z0z1x1x2, _MM_SHUFFLE(2, 0, 2, 0));
+    b = _mm_shuffle_ps(y1y2z1z2, x2x3y2y3, _MM_SHUFFLE(2, 0, 2, 0));
+    c = _mm_shuffle_ps(z2z3x3x3, y2y3z2z3, _MM_SHUFFLE(3, 1, 2, 0));
+  }
+  static void normalizeLanes(__m128 &x, __m128 &y, __m128 &z) {
+    const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                                 _mm_mul_ps(z, z)));
+    // zero vectors are divided by 1
+    const __m128 zero = _mm_cmpeq_ps(length, _mm_setzero_ps());
+    const __m128 divisor = _mm_or_ps(_mm_andnot_ps(zero, length), _mm_and_ps(zero, _mm_set1_ps(1.f)));
+    x = _mm_div_ps(x, divisor);
+    y = _mm_div_ps(y, divisor);
+    z = _mm_div_ps(z, divisor);
+  }
+#endif
+#ifdef CIRCE_AVX
+  // same shuffles as the SSE versions, applied to both 128-bit lanes
+  static void transpose(__m256 a, __m256 b, __m256 c, __m256 &x, __m256 &y, __m256 &z) {
+    const __m256 t1 = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+    const __m256 t2 = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+    x = _mm256_shuffle_ps(a, t1, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm256_shuffle_ps(t2, t1, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm256_shuffle_ps(t2, c, _MM_SHUFFLE(3, 0, 3, 1));
+  }
+  static void untranspose(__m256 x, __m256 y, __m256 z, __m256 &a, __m256 &b, __m256 &c) {
+    const __m256 x0x1y0y1 = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 z0z1x1x2 = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(2, 1, 1, 0));
+    const __m256 y1y2z1z2 = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(2, 1, 2, 1));
+    const __m256 x2x3y2y3 = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 z2z3x3x3 = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 3, 2));
+    const __m256 y2y3z2z3 = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 2, 3, 2));
+    a = _mm256_shuffle_ps(x0x1y0y1, z0z1x1x2, _MM_SHUFFLE(2, 0, 2, 0));
+    b = _mm256_shuffle_ps(y1y2z1z2, x2x3y2y3, _MM_SHUFFLE(2, 0, 2, 0));
+    c = _mm256_shuffle_ps(z2z3x3x3, y2y3z2z3, _MM_SHUFFLE(3, 1, 2, 0));
+  }
+  static void normalizeLanes(__m256 &x, __m256 &y, __m256 &z) {
+    const __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)),
+                                                       _mm256_mul_ps(z, z)));
+    const __m256 zero = _mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_EQ_OQ);
+    const __m256 divisor = _mm256_blendv_ps(length, _mm256_set1_ps(1.f), zero);
+    x = _mm256_div_ps(x, divisor);
+    y = _mm256_div_ps(y, divisor);
+    z = _mm256_div_ps(z, divisor);
+  }
+#endif
+};
+
+}
+
+#endif //CIRCE_CIRCE_COMMON_TRANSFORM_KERNELS_H
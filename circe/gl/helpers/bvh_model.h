@@ -25,28 +25,29 @@ public:
     //    circe::glVertex(r.o);
     //    circe::glVertex(r.o + 1000.f * r.d);
     //    glEnd();
-    recDraw(inv(r), bvh->root);
+    recDraw(inv(r), 0);
     return;
     static int k = 0;
     static int t = 0;
     t++;
     if (t > 1000) {
       t = 0;
-      k = (k + 1) % bvh->nodes.size();
+      k = (k + 1) % bvh->nodes().size();
     }
     glLineWidth(1.f);
-    for (size_t i = 0; i < bvh->nodes.size(); i++) {
+    for (size_t i = 0; i < bvh->nodes().size(); i++) {
       // if(i != k) continue;
       glColor4f(0, 0, 1, 0.4);
-      if (bvh->nodes[i].nElements == 1)
+      if (bvh->nodes()[i].isLeaf())
         glColor4f(1, 0, 0, 0.8);
-      draw_bbox(bvh->sceneMesh->transform(bvh->nodes[i].bounds));
+      draw_bbox(bvh->sceneMesh->transform(bvh->nodes()[i].bounds));
     }
   }
 
-  void recDraw(hermes::Ray3 r, BVH::BVHNode *n) const {
-    if (!n)
+  void recDraw(hermes::Ray3 r, size_t node_index) const {
+    if (node_index >= bvh->nodes().size())
       return;
+    const auto *n = &bvh->nodes()[node_index];
     float a, b;
     if (hermes::GeometricQueries::intersect(n->bounds, r, a, b)) {
       // if(!(n->children[0] || n->children[1])) {
@@ -55,8 +56,10 @@ public:
       glColor4f(0, 0, 0, 0.3);
       //}
       // else{
-      recDraw(r, n->children[0]);
-      recDraw(r, n->children[1]);
+      if (!n->isLeaf()) {
+        recDraw(r, node_index + 1);
+        recDraw(r, n->offset);
+      }
       //}
     }
   }
@@ -23,183 +23,81 @@
  */
 
 #include <circe/gl/scene/bvh.h>
+#include <circe/common/parallel.h>
 
-#include <algorithm>
-#include <hermes/structures/bvh.h>
 #include <vector>
 
 namespace circe::gl {
 
-BVH::BVH(SceneMeshObjectSPtr m) {
+namespace {
+
+std::vector<hermes::point3> trianglePositions(const hermes::RawMesh *raw_mesh) {
+  const u64 element_count = raw_mesh->meshDescriptor.count;
+  std::vector<hermes::point3> positions(element_count * 3);
+  Parallel::forEach(element_count, [&](u64 i) {
+    for (u64 c = 0; c < 3; ++c)
+      positions[i * 3 + c] = raw_mesh->positionElement(i, c);
+  });
+  return positions;
+}
+
+std::vector<hermes::point3> localPoints(const hermes::Transform &inv, const hermes::point3 *points, u64 count) {
+  std::vector<hermes::point3> local_points(count);
+  Parallel::forEach(count, [&](u64 i) { local_points[i] = inv(points[i]); });
+  return local_points;
+}
+
+}
+
+BVH::BVH(SceneMeshObjectSPtr m, const BVHBuilder::Options &options, bvh_layout layout) {
   sceneMesh = m;
-  std::vector<BVHElement> buildData;
-  for (size_t i = 0; i < sceneMesh->mesh()->rawMesh()->meshDescriptor.count;
-       i++)
-    buildData.emplace_back(
-        BVHElement(i, sceneMesh->mesh()->rawMesh()->elementBBox(i)));
-  uint32_t totalNodes = 0;
-  orderedElements.reserve(sceneMesh->mesh()->rawMesh()->meshDescriptor.count);
-  root = recursiveBuild(buildData, 0,
-                        sceneMesh->mesh()->rawMesh()->meshDescriptor.count,
-                        &totalNodes, orderedElements);
-  nodes.resize(totalNodes);
-  for (uint32_t i = 0; i < totalNodes; i++)
-    new (&nodes[i]) LinearBVHNode;
-  uint32_t offset = 0;
-  flattenBVHTree(root, &offset);
+  const auto positions = trianglePositions(sceneMesh->mesh()->rawMesh());
+  tree_.build(positions.data(), nullptr, positions.size() / 3, options, layout);
 }
 
-BVH::BVHNode *BVH::recursiveBuild(std::vector<BVHElement> &buildData,
-                                  uint32_t start, uint32_t end,
-                                  uint32_t *totalNodes,
-                                  std::vector<uint32_t> &orderedElements) {
-  (*totalNodes)++;
-  BVHNode *node = new BVHNode();
-  hermes::bbox3 bbox;
-  for (uint32_t i = start; i < end; ++i)
-    bbox = hermes::make_union(bbox, buildData[i].bounds);
-  // compute all bounds
-  uint32_t nElements = end - start;
-  if (nElements == 1) {
-    // create leaf node
-    uint32_t firstElementOffset = orderedElements.size();
-    for (uint32_t i = start; i < end; i++) {
-      uint32_t elementNum = buildData[i].ind;
-      orderedElements.emplace_back(elementNum);
-    }
-    node->initLeaf(firstElementOffset, nElements, bbox);
-  } else {
-    // compute bound of primitives
-    hermes::bbox3 centroidBounds;
-    for (uint32_t i = start; i < end; i++)
-      centroidBounds = hermes::make_union(centroidBounds, buildData[i].centroid);
-    int dim = centroidBounds.maxExtent();
-    // partition primitives
-    uint32_t mid = (start + end) / 2;
-    if (centroidBounds.upper[dim] == centroidBounds.lower[dim]) {
-      node->initInterior(
-          dim,
-          recursiveBuild(buildData, start, mid, totalNodes, orderedElements),
-          recursiveBuild(buildData, mid, end, totalNodes, orderedElements));
-      return node;
-    }
-    // partition into equally sized subsets
-    std::nth_element(&buildData[start], &buildData[mid],
-                     &buildData[end - 1] + 1, Comparepoints(dim));
-    node->initInterior(
-        dim, recursiveBuild(buildData, start, mid, totalNodes, orderedElements),
-        recursiveBuild(buildData, mid, end, totalNodes, orderedElements));
-  }
-  return node;
+TriangleBVH::RefitStatistics BVH::refit(const TriangleBVH::RefitOptions &options) {
+  const auto positions = trianglePositions(sceneMesh->mesh()->rawMesh());
+  return tree_.refit(positions.data(), nullptr, options);
 }
 
-uint32_t BVH::flattenBVHTree(BVHNode *node, uint32_t *offset) {
-  LinearBVHNode *linearNode = &nodes[*offset];
-  linearNode->bounds = node->bounds;
-  uint32_t myOffset = (*offset)++;
-  if (node->nElements > 0) {
-    linearNode->elementsOffset = node->firstElementOffset;
-    linearNode->nElements = node->nElements;
-  } else {
-    linearNode->axis = node->splitAxis;
-    linearNode->nElements = 0;
-    flattenBVHTree(node->children[0], offset);
-    linearNode->secondChildOffset = flattenBVHTree(node->children[1], offset);
-  }
-  return myOffset;
+TriangleBVH::RefitStatistics BVH::refit() {
+  return refit(TriangleBVH::RefitOptions());
 }
 
 int BVH::intersect(const hermes::Ray3 &ray, float *t) {
-  PONOS_UNUSED_VARIABLE(t);
-  if (nodes.empty())
-    return false;
   hermes::Transform inv = hermes::inverse(sceneMesh->transform);
   hermes::Ray3 r = inv(ray);
-  int hit = 0;
-  hermes::vec3 invDir(1.f / r.d.x, 1.f / r.d.y, 1.f / r.d.z);
-  uint32_t dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
-  uint32_t todoOffset = 0, nodeNum = 0;
-  uint32_t todo[64];
-  while (true) {
-    LinearBVHNode *node = &nodes[nodeNum];
-    if (intersect(node->bounds, r, invDir, dirIsNeg)) {
-      if (node->nElements > 0) {
-        // intersect ray with primitives
-        for (uint32_t i = 0; i < node->nElements; i++) {
-          hermes::point3 v0 = sceneMesh->mesh()->rawMesh()->positionElement(
-              orderedElements[node->elementsOffset + i], 0);
-          hermes::point3 v1 = sceneMesh->mesh()->rawMesh()->positionElement(
-              orderedElements[node->elementsOffset + i], 1);
-          hermes::point3 v2 = sceneMesh->mesh()->rawMesh()->positionElement(
-              orderedElements[node->elementsOffset + i], 2);
-          if (hermes::triangle_ray_intersection(v0, v1, v2, r))
-            hit++;
-        }
-        if (todoOffset == 0)
-          break;
-        nodeNum = todo[--todoOffset];
-      } else {
-        if (dirIsNeg[node->axis]) {
-          todo[todoOffset++] = nodeNum + 1;
-          nodeNum = node->secondChildOffset;
-        } else {
-          todo[todoOffset++] = node->secondChildOffset;
-          nodeNum++;
-        }
-      }
-    } else {
-      if (todoOffset == 0)
-        break;
-      nodeNum = todo[--todoOffset];
-    }
-  }
-  return hit;
+  return static_cast<int>(tree_.countHits(r, t));
+}
+
+TriangleBVH::Hit BVH::closestHit(const hermes::Ray3 &ray, f32 max_t) const {
+  return tree_.closestHit(hermes::inverse(sceneMesh->transform)(ray), max_t);
+}
+
+void BVH::closestHits(const hermes::Ray3 *rays, u64 count, TriangleBVH::Hit *hits) const {
+  const hermes::Transform inv = hermes::inverse(sceneMesh->transform);
+  std::vector<hermes::Ray3> local_rays(count);
+  Parallel::forEach(count, [&](u64 i) { local_rays[i] = inv(rays[i]); });
+  tree_.closestHits(local_rays.data(), count, hits);
+}
+
+bool BVH::isInside(const hermes::point3 &p) const {
+  return tree_.isInside(hermes::inverse(sceneMesh->transform)(p));
+}
+
+void BVH::isInside(const hermes::point3 *points, u64 count, u8 *inside,
+                   const TriangleBVH::InsideOptions &options) const {
+  const auto local_points = localPoints(hermes::inverse(sceneMesh->transform), points, count);
+  tree_.isInside(local_points.data(), count, inside, options);
 }
 
-bool BVH::intersect(const hermes::bbox3 &bounds, const hermes::Ray3 &ray,
-                    const hermes::vec3 &invDir,
-                    const uint32_t dirIsNeg[3]) const {
-  float hit1, hit2;
-  return hermes::bbox_ray_intersection(bounds, ray, hit1, hit2);
-  float tmin = (bounds[dirIsNeg[0]].x - ray.o.x) * invDir.x;
-  float tmax = (bounds[1 - dirIsNeg[0]].x - ray.o.x) * invDir.x;
-  float tymin = (bounds[dirIsNeg[1]].y - ray.o.y) * invDir.y;
-  float tymax = (bounds[1 - dirIsNeg[1]].y - ray.o.y) * invDir.y;
-  if ((tmin < tymax) || (tymin > tmax))
-    return false;
-  if (tymin > tmin)
-    tmin = tymin;
-  if (tymax < tmax)
-    tmax = tymax;
-  float tzmin = (bounds[dirIsNeg[2]].z - ray.o.z) * invDir.z;
-  float tzmax = (bounds[1 - dirIsNeg[2]].z - ray.o.z) * invDir.z;
-  if ((tmin < tzmax) || (tzmin > tmax))
-    return false;
-  if (tzmin > tmin)
-    tmin = tzmin;
-  if (tzmax < tmax)
-    tmax = tzmax;
-  return tmax > 0;
+void BVH::isInside(const hermes::point3 *points, u64 count, u8 *inside) const {
+  isInside(points, count, inside, TriangleBVH::InsideOptions());
 }
 
-bool BVH::isInside(const hermes::point3 &p) {
-  hermes::Ray3 r(p, hermes::vec3(1.2, 1.1, 0.1));
-  hermes::Ray3 r2(p, hermes::vec3(0.2, -1.1, 0.1));
-
-  return intersect(r, nullptr) % 2 && intersect(r2, nullptr) % 2;
-
-  int hit = 0, hit2 = 0;
-  for (size_t i = 0; i < sceneMesh->mesh()->rawMesh()->meshDescriptor.count;
-       i++) {
-    hermes::point3 v0 = sceneMesh->mesh()->rawMesh()->positionElement(i, 0);
-    hermes::point3 v1 = sceneMesh->mesh()->rawMesh()->positionElement(i, 1);
-    hermes::point3 v2 = sceneMesh->mesh()->rawMesh()->positionElement(i, 2);
-    if (hermes::triangle_ray_intersection(v0, v1, v2, r))
-      hit++;
-    if (hermes::triangle_ray_intersection(v0, v1, v2, r2))
-      hit2++;
-  }
-  return hit % 2 && hit2 % 2;
+void BVH::windingNumbers(const hermes::point3 *points, u64 count, f32 *winding_numbers, f32 accuracy) const {
+  const auto local_points = localPoints(hermes::inverse(sceneMesh->transform), points, count);
+  tree_.windingNumbers(local_points.data(), count, winding_numbers, accuracy);
 }
 
 } // namespace circe
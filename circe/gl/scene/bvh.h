@@ -2,79 +2,76 @@
 #define CIRCE_SCENE_BVH_H
 
 #include <circe/gl/scene/scene_object.h>
+#include <circe/scene/triangle_bvh.h>
 
 namespace circe::gl {
 
 /* hierarchical structure
  * Bounding Volume Hierarchies.
+ *
+ * Built over the triangles of a scene mesh with the binned SAH builder (see
+ * BVHBuilder and TriangleBVH). Queries take world space rays: they are
+ * brought to the mesh space by the inverse of the object transform, which
+ * keeps the parametric coordinates of hits.
  */
 class BVH {
 public:
   friend class BVHModel;
   /* Constructor.
    * @m **[in]**
+   * @options **[in]** build options (leaf size, bins, costs)
+   * @layout **[in]** nodes traversed by single ray queries
    */
-  BVH(SceneMeshObjectSPtr m);
-  virtual ~BVH() {}
+  explicit BVH(SceneMeshObjectSPtr m, const BVHBuilder::Options &options = {},
+               bvh_layout layout = bvh_layout::binary);
+  virtual ~BVH() = default;
 
   SceneMeshObjectSPtr sceneMesh;
 
+  /// \param ray world space ray
+  /// \param t **[out | optional]** parametric coordinate of the closest hit
+  /// \return number of triangles crossed by the ray
   int intersect(const hermes::Ray3 &ray, float *t = nullptr);
-  bool isInside(const hermes::point3 &p);
+  /// \param ray world space ray
+  /// \param max_t hits are searched in [0, max_t)
+  /// \return triangle index, parametric coordinate and barycentrics of the closest hit
+  [[nodiscard]] TriangleBVH::Hit closestHit(const hermes::Ray3 &ray,
+                                            f32 max_t = std::numeric_limits<f32>::infinity()) const;
+  /// Traces world space rays in packets (see TriangleBVH). Consecutive rays
+  /// should be coherent (tiles of neighbouring probe rays, for example).
+  /// \param rays
+  /// \param count
+  /// \param hits **[out]** count hits
+  void closestHits(const hermes::Ray3 *rays, u64 count, TriangleBVH::Hit *hits) const;
+  /// \param p world space point
+  /// \return true if p is inside the mesh (winding number test, see TriangleBVH)
+  [[nodiscard]] bool isInside(const hermes::point3 &p) const;
+  /// Classifies world space points in parallel. The parity method is faster
+  /// but only reliable for closed meshes.
+  /// \param points
+  /// \param count
+  /// \param inside **[out]** count values, 1 for points inside the mesh
+  /// \param options
+  void isInside(const hermes::point3 *points, u64 count, u8 *inside,
+                const TriangleBVH::InsideOptions &options) const;
+  void isInside(const hermes::point3 *points, u64 count, u8 *inside) const;
+  /// \param points world space points
+  /// \param count
+  /// \param winding_numbers **[out]** count values (1 inside, 0 outside)
+  /// \param accuracy nodes farther than accuracy * node radius are approximated
+  void windingNumbers(const hermes::point3 *points, u64 count, f32 *winding_numbers, f32 accuracy = 2) const;
+  /// Updates the hierarchy after the vertices of the raw mesh moved (same
+  /// triangles); degraded subtrees are rebuilt (see TriangleBVH::refit)
+  /// \param options
+  /// \return refit and rebuild times, sah cost and degradation
+  TriangleBVH::RefitStatistics refit(const TriangleBVH::RefitOptions &options);
+  TriangleBVH::RefitStatistics refit();
+  /// \return build time, node counts and expected traversal cost
+  [[nodiscard]] const BVHBuilder::Statistics &statistics() const { return tree_.statistics(); }
+  [[nodiscard]] const std::vector<BVHBuilder::Node> &nodes() const { return tree_.nodes(); }
 
 private:
-  struct BVHElement {
-    BVHElement(size_t i, const hermes::bbox3 &b) : ind(i), bounds(b) {
-      centroid = b.centroid();
-    }
-    size_t ind;
-    hermes::bbox3 bounds;
-    hermes::point3 centroid;
-  };
-  struct BVHNode {
-    BVHNode() { children[0] = children[1] = nullptr; }
-    void initLeaf(uint32_t first, uint32_t n, const hermes::bbox3 &b) {
-      firstElementOffset = first;
-      nElements = n;
-      bounds = b;
-    }
-    void initInterior(uint32_t axis, BVHNode *c0, BVHNode *c1) {
-      children[0] = c0;
-      children[1] = c1;
-      bounds = hermes::make_union(c0->bounds, c1->bounds);
-      splitAxis = axis;
-      nElements = 0;
-    }
-    hermes::bbox3 bounds;
-    BVHNode *children[2];
-    uint32_t splitAxis, firstElementOffset, nElements;
-  };
-  struct LinearBVHNode {
-    hermes::bbox3 bounds;
-    union {
-      uint32_t elementsOffset;
-      uint32_t secondChildOffset;
-    };
-    uint8_t nElements;
-    uint8_t axis;
-    uint8_t pad[2];
-  };
-  struct Comparepoints {
-    Comparepoints(int d) { dim = d; }
-    int dim;
-    bool operator()(const BVHElement &a, const BVHElement &b) const {
-      return a.centroid[dim] < b.centroid[dim];
-    }
-  };
-  std::vector<uint32_t> orderedElements;
-  std::vector<LinearBVHNode> nodes;
-  BVHNode *root;
-  BVHNode *recursiveBuild(std::vector<BVHElement> &buildData, uint32_t start,
-                          uint32_t end, uint32_t *totalNodes,
-                          std::vector<uint32_t> &orderedElements);
-  uint32_t flattenBVHTree(BVHNode *node, uint32_t *offset);
-  bool intersect(const hermes::bbox3 &bounds, const hermes::Ray3 &ray,
-                 const hermes::vec3 &invDir, const uint32_t dirIsNeg[3]) const;
+  TriangleBVH tree_;
 };
 
 } // namespace circe
@@ -137,6 +137,16 @@ void InstanceSet::draw(const CameraInterface *camera,
   CHECK_GL_ERRORS;
 }
 
+void InstanceSet::setTransforms(const std::vector<hermes::Transform> &transforms,
+                                const std::string &attribute_name) {
+  resize(transforms.size());
+  if (!instance_buffer_view_)
+    return;
+  auto instance_data = instanceData();
+  for (u64 i = 0; i < transforms.size(); ++i)
+    instance_data.at<hermes::mat4>(attribute_name, i) = hermes::transpose(transforms[i].matrix());
+}
+
 InstanceSet::View InstanceSet::instanceData() {
   return InstanceSet::View(*instance_buffer_view_, instance_attributes_, GL_MAP_WRITE_BIT);
 }
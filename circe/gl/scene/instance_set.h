@@ -98,6 +98,12 @@ public:
   /// reserve memory for n instances
   /// \param n number of instances
   void resize(uint n);
+  /// Resizes the set to one instance per transform and writes the transforms
+  /// into the instance buffer (e.g. GltfReader::instanceTransforms)
+  /// \param transforms
+  /// \param attribute_name instance attribute that receives the (transposed) matrices
+  void setTransforms(const std::vector<hermes::Transform> &transforms,
+                     const std::string &attribute_name = "transform_matrix");
   View instanceData();
   void draw(const CameraInterface *camera, hermes::Transform transform) override;
   // *******************************************************************************************************************
@@ -28,6 +28,7 @@
 #include <circe/gl/scene/scene_object.h>
 #include <circe/gl/utils/open_gl.h>
 #include <circe/scene/array.h>
+#include <circe/scene/bvh.h>
 
 #include <memory>
 
@@ -37,7 +38,14 @@ namespace circe::gl {
 /// and intersected.
 /// It is possible to define how these objects are arranged by setting
 /// a **StructureType**. The default organization is a flat array with no
-/// acceleration schemes.
+/// acceleration schemes; circe::BVH builds a bounding volume hierarchy over
+/// the object bounds on init().
+///
+/// render() culls objects against the camera's view frustum using their
+/// worldBounds() (objects without bounds are always drawn). With circe::BVH
+/// the culling walks the hierarchy, otherwise every object is tested.
+/// Culling is on by default; objects whose worldBounds() do not enclose what
+/// they draw must be unbounded or the scene must set frustum_culling = false.
 template<template<typename> class StructureType = circe::Array> class Scene {
 public:
   Scene() {}
@@ -47,12 +55,40 @@ public:
   void add(SceneObject *o) {
     s.add(o);
   }
+  /// Prepares the structure for queries (builds acceleration structures,
+  /// such as circe::BVH). Call after all objects have been added and again
+  /// whenever objects move.
+  void init() {
+    s.init();
+  }
 
+  /// Draws the visible objects inside the camera's view frustum
+  /// \param camera
   void render(CameraInterface *camera) {
-    s.iterate([&](SceneObject *o) {
-      if (o->visible)
-        o->draw(camera, transform);
-    });
+    u64 hidden = 0;
+    auto draw = [&](SceneObject *o) {
+      if (!o->visible) {
+        hidden++;
+        return;
+      }
+      o->draw(camera, transform);
+    };
+    if (frustum_culling)
+      s.iterateVisible(FrustumCuller::fromCamera(*camera, transform), draw, &culling_statistics_);
+    else {
+      culling_statistics_ = {};
+      s.iterate([&](SceneObject *o) {
+        culling_statistics_.visible++;
+        draw(o);
+      });
+    }
+    // hidden objects are not drawn, so they do not count as visible
+    culling_statistics_.visible -= hidden;
+    culling_statistics_.hidden = hidden;
+  }
+  /// \return culled/visible object counts of the last render()
+  [[nodiscard]] const FrustumCuller::Statistics &cullingStatistics() const {
+    return culling_statistics_;
   }
 
   /** \brief intersects ray with objects
@@ -77,9 +113,11 @@ public:
 
   hermes::Transform
       transform; //!< scene transform (applied to all objects on draw)
+  bool frustum_culling{true}; //!< skip objects outside the camera's view (on by default)
 
 private:
   StructureType<SceneObject> s;
+  FrustumCuller::Statistics culling_statistics_;
 };
 
 } // namespace circe
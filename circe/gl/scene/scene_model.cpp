@@ -29,56 +29,44 @@
 
 namespace circe::gl {
 
-SceneModel SceneModel::fromFile(const hermes::Path &path, shape_options options) {
-  auto model = Model::fromFile(path, options);
+SceneModel SceneModel::fromFile(const hermes::Path &path, shape_options options, cpu_residency residency) {
   SceneModel scene_model;
-  scene_model.vb_ = model.data();
-  scene_model.ib_.element_type = OpenGL::PrimitiveToGL(model.primitiveType());
-  scene_model.ib_ = model.indices();
-  scene_model.primitive_count_ = scene_model.ib_.element_count ? scene_model.ib_.element_count :
-                                 OpenGL::primitiveCount(scene_model.ib_.element_type, model.data().size());
-  scene_model.model_ = std::move(model);
-  scene_model.vao_.bind();
-  scene_model.vb_.bind();
-  scene_model.vb_.bindAttributeFormats();
-  scene_model.vao_.unbind();
+  scene_model.quantized_ = testMaskBit(options, shape_options::quantize);
+  scene_model.residency_ = residency;
+  scene_model.model_ = Model::fromFile(path, options);
+  scene_model.uploadModel();
   return std::move(scene_model);
 }
 
 SceneModel::SceneModel() = default;
 
 SceneModel::SceneModel(SceneModel &&other) noexcept {
-  model_ = std::forward<Model>(model_);
+  model_ = std::move(other.model_);
   vao_ = std::move(other.vao_);
   vb_ = std::move(other.vb_);
+  attribute_vbs_ = std::move(other.attribute_vbs_);
   ib_ = std::move(other.ib_);
   primitive_count_ = other.primitive_count_;
+  sub_mesh_first_indices_ = std::move(other.sub_mesh_first_indices_);
+  sub_mesh_index_counts_ = std::move(other.sub_mesh_index_counts_);
+  lod_first_indices_ = std::move(other.lod_first_indices_);
+  lod_index_counts_ = std::move(other.lod_index_counts_);
+  quantized_ = other.quantized_;
+  position_offset_ = other.position_offset_;
+  position_scale_ = other.position_scale_;
+  residency_ = other.residency_;
+  layout_ = std::move(other.layout_);
+  bounds_ = other.bounds_;
 }
 
 SceneModel::SceneModel(const Model &model) {
   model_ = model;
-  vb_ = model.data();
-  ib_.element_type = OpenGL::PrimitiveToGL(model_.primitiveType());
-  ib_ = model.indices();
-  primitive_count_ = ib_.element_count ? ib_.element_count :
-                     OpenGL::primitiveCount(ib_.element_type, vb_.vertexCount());
-  vao_.bind();
-  vb_.bind();
-  vb_.bindAttributeFormats();
-  vao_.unbind();
+  uploadModel();
 }
 
 SceneModel::SceneModel(Model &&model) noexcept {
   model_ = std::forward<Model>(model);
-  vb_ = model_.data();
-  ib_.element_type = OpenGL::PrimitiveToGL(model_.primitiveType());
-  ib_ = model_.indices();
-  primitive_count_ = ib_.element_count ? ib_.element_count :
-                     OpenGL::primitiveCount(ib_.element_type, vb_.vertexCount());
-  vao_.bind();
-  vb_.bind();
-  vb_.bindAttributeFormats();
-  vao_.unbind();
+  uploadModel();
 }
 
 SceneModel::~SceneModel() = default;
@@ -87,37 +75,175 @@ SceneModel &SceneModel::operator=(SceneModel &&other) noexcept {
   model_ = std::move(other.model_);
   vao_ = std::move(other.vao_);
   vb_ = std::move(other.vb_);
+  attribute_vbs_ = std::move(other.attribute_vbs_);
   ib_ = std::move(other.ib_);
   primitive_count_ = other.primitive_count_;
+  sub_mesh_first_indices_ = std::move(other.sub_mesh_first_indices_);
+  sub_mesh_index_counts_ = std::move(other.sub_mesh_index_counts_);
+  lod_first_indices_ = std::move(other.lod_first_indices_);
+  lod_index_counts_ = std::move(other.lod_index_counts_);
+  quantized_ = other.quantized_;
+  position_offset_ = other.position_offset_;
+  position_scale_ = other.position_scale_;
+  residency_ = other.residency_;
+  layout_ = std::move(other.layout_);
+  bounds_ = other.bounds_;
   return *this;
 }
 
 SceneModel &SceneModel::operator=(const Model &model) {
   model_ = model;
-  vb_ = model.data();
-  ib_.element_type = OpenGL::PrimitiveToGL(model.primitiveType());
-  ib_ = model.indices();
-  primitive_count_ = ib_.element_count ? ib_.element_count :
-                     OpenGL::primitiveCount(ib_.element_type, vb_.vertexCount());
-  vao_.bind();
-  vb_.bind();
-  vb_.bindAttributeFormats();
-  vao_.unbind();
+  uploadModel();
   return *this;
 }
 
 SceneModel &SceneModel::operator=(Model &&model) noexcept {
   model_ = std::forward<Model>(model);
-  vb_ = model_.data();
+  uploadModel();
+  return *this;
+}
+
+void SceneModel::uploadModel() {
+  // keep the layout for readbacks
+  layout_ = ModelResidency::layoutOf(model_);
+  layout_.quantized = quantized_;
+  if (quantized_) {
+    auto vertices = VertexQuantizer::quantize(model_);
+    vb_.setVertexData(vertices);
+    position_offset_ = vertices.position_offset;
+    position_scale_ = vertices.position_scale;
+    vertices.data = {};
+    layout_.quantized_vertices = std::move(vertices);
+    attribute_vbs_.clear();
+  } else if (model_.vertexStorage() == vertex_storage::separate) {
+    // one buffer (and binding index) per attribute
+    const auto &fields = model_.vertexDescriptor().fields();
+    attribute_vbs_.resize(fields.size());
+    GLuint location = 0;
+    for (u64 i = 0; i < fields.size(); ++i) {
+      attribute_vbs_[i].setBindingIndex(static_cast<GLuint>(i));
+      attribute_vbs_[i].setAttributeData(fields[i], location, model_.attributeData(i), model_.vertexCount());
+      location += attribute_vbs_[i].attributes.attributes().front().rows();
+    }
+  } else {
+    // raw model views avoid copying externally stored (memory mapped) data
+    vb_.setVertexData(model_.vertexDescriptor(), model_.vertexData(), model_.vertexCount());
+    attribute_vbs_.clear();
+  }
   ib_.element_type = OpenGL::PrimitiveToGL(model_.primitiveType());
-  ib_ = model_.indices();
+  ib_.setIndexData(model_.indexData(), model_.indexCount());
   primitive_count_ = ib_.element_count ? ib_.element_count :
-                     OpenGL::primitiveCount(ib_.element_type, vb_.vertexCount());
+                     OpenGL::primitiveCount(ib_.element_type, vertexCount());
   vao_.bind();
-  vb_.bind();
-  vb_.bindAttributeFormats();
+  bindVertexBuffers();
+  if (attribute_vbs_.empty())
+    vb_.bindAttributeFormats();
+  for (auto &vb : attribute_vbs_)
+    vb.bindAttributeFormats();
   vao_.unbind();
-  return *this;
+  sub_mesh_first_indices_.clear();
+  sub_mesh_index_counts_.clear();
+  for (const auto &sub_mesh : model_.subMeshes()) {
+    sub_mesh_first_indices_.emplace_back(sub_mesh.index_offset);
+    sub_mesh_index_counts_.emplace_back(static_cast<GLsizei>(sub_mesh.index_count));
+  }
+  lod_first_indices_.clear();
+  lod_index_counts_.clear();
+  for (const auto &level : model_.levelsOfDetail()) {
+    lod_first_indices_.emplace_back(level.index_offset);
+    lod_index_counts_.emplace_back(static_cast<GLsizei>(level.index_count));
+  }
+  bounds_ = model_.boundingBox();
+  ModelResidency::release(model_, residency_);
+}
+
+void SceneModel::setResidency(cpu_residency residency) {
+  if (residency_ == residency)
+    return;
+  if (residency == cpu_residency::keep)
+    restoreModel();
+  residency_ = residency;
+  ModelResidency::release(model_, residency_);
+}
+
+Model SceneModel::readback() {
+  std::vector<std::vector<u8>> vertex_buffers;
+  if (!attribute_vbs_.empty()) {
+    for (auto &vb : attribute_vbs_)
+      vertex_buffers.emplace_back(vb.memory() ? vb.memory()->rawData() : std::vector<u8>());
+  } else if (vb_.vertexCount() && vb_.memory())
+    vertex_buffers.emplace_back(vb_.memory()->rawData());
+  std::vector<u8> index_data;
+  if (layout_.index_count && ib_.memory())
+    index_data = ib_.memory()->rawData();
+  return ModelResidency::restore(layout_, vertex_buffers, index_data);
+}
+
+void SceneModel::restoreModel() {
+  if (residency_ == cpu_residency::keep)
+    return;
+  model_ = readback();
+}
+
+u64 SceneModel::cpuMemorySizeInBytes() const {
+  return model_.vertexDataSizeInBytes() + model_.indexCount() * sizeof(i32);
+}
+
+void SceneModel::setQuantization(bool enabled) {
+  if (quantized_ == enabled)
+    return;
+  if (!vertexCount()) {
+    quantized_ = enabled;
+    return;
+  }
+  // re-encoding needs the full host copy
+  restoreModel();
+  quantized_ = enabled;
+  uploadModel();
+}
+
+void SceneModel::updateAttribute(u64 attribute_index) {
+  if (!model_.vertexCount() || attribute_index >= layout_.vertex_descriptor.fields().size()) {
+    hermes::Log::warn("SceneModel: no host data for attribute {} update.", attribute_index);
+    return;
+  }
+  // a released host copy (positions only) does not match the gpu buffers
+  if (residency_ != cpu_residency::keep || !ModelResidency::holdsLayout(model_, layout_)) {
+    hermes::Log::warn("SceneModel: host data does not match the uploaded layout, attribute {} not updated "
+                      "(restoreModel first).", attribute_index);
+    return;
+  }
+  if (attribute_index == model_.positionAttribute())
+    bounds_ = model_.boundingBox();
+  if (!attribute_vbs_.empty() && model_.vertexStorage() == vertex_storage::separate) {
+    attribute_vbs_[attribute_index].setData(model_.attributeData(attribute_index));
+    return;
+  }
+  // interleaved (or quantized) data is uploaded as a whole
+  if (quantized_ || !attribute_vbs_.empty() || model_.vertexStorage() == vertex_storage::separate) {
+    uploadModel();
+    return;
+  }
+  vb_.setData(model_.vertexData());
+}
+
+void SceneModel::bindVertexBuffers() {
+  if (attribute_vbs_.empty())
+    vb_.bind();
+  for (auto &vb : attribute_vbs_)
+    vb.bind();
+}
+
+void SceneModel::setDequantizationUniforms() const {
+  if (!quantized_ || !program.id())
+    return;
+  // glProgramUniform does not depend on the currently bound program
+  GLint location = glGetUniformLocation(program.id(), "position_offset");
+  if (location >= 0)
+    glProgramUniform3fv(program.id(), location, 1, &position_offset_.x);
+  location = glGetUniformLocation(program.id(), "position_scale");
+  if (location >= 0)
+    glProgramUniform3fv(program.id(), location, 1, &position_scale_.x);
 }
 
 void SceneModel::bind() {
@@ -130,19 +256,83 @@ void SceneModel::unbind() {
 
 void SceneModel::bindBuffers() {
   vao_.bind();
-  vb_.bind();
+  bindVertexBuffers();
   ib_.bind();
 }
 
 void SceneModel::draw() {
+  setDequantizationUniforms();
   vao_.bind();
-  vb_.bind();
-  if (ib_.element_count)
+  bindVertexBuffers();
+  if (ib_.element_count && !sub_mesh_first_indices_.empty())
+    ib_.multiDraw(sub_mesh_first_indices_.data(), sub_mesh_index_counts_.data(), sub_mesh_first_indices_.size());
+  else if (ib_.element_count && !lod_first_indices_.empty())
+    // the index buffer also holds coarser levels
+    ib_.multiDraw(lod_first_indices_.data(), lod_index_counts_.data(), 1);
+  else if (ib_.element_count)
     ib_.draw();
   else {
-    glDrawArrays(ib_.element_type, 0, vb_.vertexCount());
+    glDrawArrays(ib_.element_type, 0, vertexCount());
     CHECK_GL_ERRORS
   }
 }
 
+void SceneModel::drawSubMeshes(const std::vector<u64> &sub_mesh_ids) {
+  selected_first_indices_.clear();
+  selected_index_counts_.clear();
+  for (auto id : sub_mesh_ids)
+    if (id < sub_mesh_first_indices_.size()) {
+      selected_first_indices_.emplace_back(sub_mesh_first_indices_[id]);
+      selected_index_counts_.emplace_back(sub_mesh_index_counts_[id]);
+    }
+  if (selected_first_indices_.empty() || !ib_.element_count)
+    return;
+  setDequantizationUniforms();
+  vao_.bind();
+  bindVertexBuffers();
+  ib_.multiDraw(selected_first_indices_.data(), selected_index_counts_.data(), selected_first_indices_.size());
+}
+
+
+u64 SceneModel::selectLevelOfDetail(const CameraInterface &camera, f32 viewport_height) const {
+  const auto &levels = layout_.levels_of_detail;
+  if (levels.size() < 2)
+    return 0;
+  // world space size of the model (the scale factor overestimates rotated
+  // models, which only makes the selection conservative)
+  const auto &bounds = bounds_;
+  const auto world_bounds = transform(bounds);
+  const real_t model_extent = bounds.diagonal().length();
+  const real_t world_extent = world_bounds.diagonal().length();
+  const real_t scale = model_extent > 0 ? world_extent / model_extent : 1;
+  // pixels covered by a unit length at the model's closest point
+  const auto &projection = camera.getProjectionTransform().matrix();
+  real_t pixels_per_unit = std::abs(projection[1][1]) * viewport_height * 0.5f;
+  if (projection[3][3] == 0) {
+    // perspective projection
+    const real_t near = camera.getCameraProjection() ? camera.getCameraProjection()->near : 0.01f;
+    const real_t distance = (camera.getPosition() - world_bounds.centroid()).length() - world_extent * 0.5f;
+    pixels_per_unit /= std::max(distance, near);
+  }
+  for (u64 level = levels.size() - 1; level > 0; --level)
+    if (levels[level].error * scale * pixels_per_unit <= lod_pixel_error)
+      return level;
+  return 0;
+}
+
+void SceneModel::drawLevelOfDetail(u64 level) {
+  if (!level || level >= lod_first_indices_.size() || !ib_.element_count) {
+    draw();
+    return;
+  }
+  setDequantizationUniforms();
+  vao_.bind();
+  bindVertexBuffers();
+  ib_.multiDraw(&lod_first_indices_[level], &lod_index_counts_[level], 1);
+}
+
+void SceneModel::draw(const CameraInterface &camera, f32 viewport_height) {
+  drawLevelOfDetail(selectLevelOfDetail(camera, viewport_height));
+}
+
 }
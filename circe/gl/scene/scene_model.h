@@ -29,9 +29,14 @@
 #define PONOS_CIRCE_CIRCE_GL_SCENE_SCENE_MODEL_H
 
 #include <circe/scene/model.h>
+#include <circe/scene/camera_interface.h>
+#include <circe/scene/model_residency.h>
+#include <circe/scene/vertex_quantizer.h>
 
 namespace circe::gl {
 
+using circe::cpu_residency;
+
 class SceneModel {
 public:
   // ***********************************************************************
@@ -40,8 +45,10 @@ public:
   ///
   /// \param path
   /// \param options
+  /// \param residency host copy kept after upload
   /// \return
-  static SceneModel fromFile(const hermes::Path &path, shape_options options = shape_options::none);
+  static SceneModel fromFile(const hermes::Path &path, shape_options options = shape_options::none,
+                             cpu_residency residency = cpu_residency::keep);
   // ***********************************************************************
   //                           CONSTRUCTORS
   // ***********************************************************************
@@ -59,28 +66,110 @@ public:
   // ***********************************************************************
   //                             METHODS
   // ***********************************************************************
-  inline u64 vertexCount() const { return vb_.vertexCount(); }
+  inline u64 vertexCount() const {
+    return attribute_vbs_.empty() ? vb_.vertexCount() : attribute_vbs_.front().vertexCount();
+  }
   inline u64 elementCount() const { return primitive_count_; }
   VertexBuffer &vertexBuffer() { return vb_; }
+  /// \note only for models with separate vertex storage
+  /// \param attribute_index
+  /// \return buffer bound to binding index attribute_index
+  VertexBuffer &attributeBuffer(u64 attribute_index) { return attribute_vbs_[attribute_index]; }
   const IndexBuffer &indexBuffer() const { return ib_; }
   IndexBuffer &indexBuffer()  { return ib_; }
   const Model &model() const { return model_; }
   void bind();
   void unbind();
   void bindBuffers();
+  /// Uploads a single attribute of model() after it was modified. Models
+  /// with separate vertex storage (see Model::setVertexStorage) get one
+  /// buffer per attribute, so only that attribute array is uploaded;
+  /// interleaved models upload all vertex data.
+  /// \note Needs the full host copy: ignored (with a warning) unless the
+  ///       residency is cpu_residency::keep.
+  /// \param attribute_index
+  void updateAttribute(u64 attribute_index);
+  /// \return mutable model() for attribute updates (see updateAttribute)
+  Model &model() { return model_; }
+  /// Draws the whole model. Models with sub-meshes are drawn with a single
+  /// multi-draw call.
   void draw();
+  /// Draws a subset of sub-meshes with a single multi-draw call
+  /// \param sub_mesh_ids indices into model().subMeshes()
+  void drawSubMeshes(const std::vector<u64> &sub_mesh_ids);
+  /// Picks the coarsest level of detail whose geometric error, projected
+  /// on screen, stays below lod_pixel_error
+  /// \param camera
+  /// \param viewport_height viewport height in pixels
+  /// \return level index (0 if the model has a single level)
+  [[nodiscard]] u64 selectLevelOfDetail(const CameraInterface &camera, f32 viewport_height) const;
+  /// Draws a single level of detail (level 0 is drawn as draw() does)
+  /// \param level
+  void drawLevelOfDetail(u64 level);
+  /// Draws the level of detail selected for camera
+  /// \param camera
+  /// \param viewport_height viewport height in pixels
+  void draw(const CameraInterface &camera, f32 viewport_height);
+  /// Uploads vertex data in compressed formats (see VertexQuantizer). Draw
+  /// calls set the position dequantization uniforms of program
+  /// (vec3 position_offset, vec3 position_scale) when the shader declares them.
+  /// \note The program must decode positions and unit vectors itself with
+  ///       VertexQuantizer::glslDecoder(): a shader reading the quantized
+  ///       normal as a plain vec3 gets (x, y, 0).
+  /// \param enabled
+  void setQuantization(bool enabled);
+  [[nodiscard]] bool isQuantized() const { return quantized_; }
+  /// Sets what model() keeps after uploads. Data dropped from the host copy
+  /// is read back from the gpu buffers whenever it is needed again
+  /// (setQuantization, restoreModel or switching back to keep).
+  /// \param residency
+  void setResidency(cpu_residency residency);
+  [[nodiscard]] cpu_residency residency() const { return residency_; }
+  /// Reads vertex and index data back from the gpu buffers. Quantized vertex
+  /// data is decoded (see VertexQuantizer::dequantize), so positions carry the
+  /// quantization error. Sub-meshes and levels of detail are restored as well.
+  /// \return
+  [[nodiscard]] Model readback();
+  /// Brings back the full host copy (read back from the gpu if it was dropped)
+  void restoreModel();
+  /// \return bytes held by model()
+  [[nodiscard]] u64 cpuMemorySizeInBytes() const;
   // ***********************************************************************
   //                          PUBLIC FIELDS
   // ***********************************************************************
   Program program;
   hermes::Transform transform;
+  f32 lod_pixel_error{1.f}; //!< screen-space error (in pixels) tolerated by level of detail selection
 
 private:
+  /// Uploads model_ data into vertex/index buffers and sets up the vao
+  void uploadModel();
+  void setDequantizationUniforms() const;
+  /// Binds vb_ or the attribute buffers
+  void bindVertexBuffers();
+
   VertexArrayObject vao_;
   VertexBuffer vb_;
+  std::vector<VertexBuffer> attribute_vbs_; //!< separate vertex storage buffers
   IndexBuffer ib_;
   Model model_;
   size_t primitive_count_{0};
+  // sub-mesh draw ranges
+  std::vector<u64> sub_mesh_first_indices_;
+  std::vector<GLsizei> sub_mesh_index_counts_;
+  std::vector<u64> selected_first_indices_;
+  std::vector<GLsizei> selected_index_counts_;
+  // level of detail draw ranges
+  std::vector<u64> lod_first_indices_;
+  std::vector<GLsizei> lod_index_counts_;
+  // vertex quantization
+  bool quantized_{false};
+  hermes::vec3 position_offset_;
+  hermes::vec3 position_scale_{1.f, 1.f, 1.f};
+  // uploaded data description (model_ may not hold it anymore)
+  cpu_residency residency_{cpu_residency::keep};
+  ModelResidency::Layout layout_;
+  hermes::bbox3 bounds_;
 };
 
 }
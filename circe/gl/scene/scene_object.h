@@ -55,6 +55,9 @@ public:
     HERMES_UNUSED_VARIABLE(r);
     return false;
   }
+  /// Bounds used by spatial structures (circe::BVH) and frustum culling
+  /// \return scene space bounds (an empty box for objects without bounds)
+  [[nodiscard]] virtual hermes::bbox3 worldBounds() const { return {}; }
 
   void updateTransform() override {
     transform = this->trackball.tb.getTransform() * transform;
@@ -101,6 +104,11 @@ public:
     mesh_ = createSceneMeshPtr(m);
   }
   virtual ~SceneMeshObject() {}
+  [[nodiscard]] hermes::bbox3 worldBounds() const override {
+    if (!mesh_ || !mesh_->rawMesh())
+      return {};
+    return transform(mesh_->rawMesh()->bbox);
+  }
   void draw(const CameraInterface *camera, hermes::Transform t) override {
     if (!visible)
       return;
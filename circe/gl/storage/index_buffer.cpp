@@ -103,6 +103,19 @@ void IndexBuffer::draw() {
   }
 }
 
+void IndexBuffer::multiDraw(const u64 *first_indices, const GLsizei *index_counts, u64 range_count) {
+  if (!mem_->size() || !range_count)
+    return;
+  // offsets are byte offsets into the bound element buffer
+  const u64 index_size = OpenGL::dataSizeInBytes(data_type);
+  multi_draw_offsets_.resize(range_count);
+  for (u64 i = 0; i < range_count; ++i)
+    multi_draw_offsets_[i] = reinterpret_cast<const void *>(mem_->offset() + first_indices[i] * index_size);
+  mem_->bind();
+  CHECK_GL(glMultiDrawElements(element_type, index_counts, data_type, multi_draw_offsets_.data(),
+                               static_cast<GLsizei>(range_count)));
+}
+
 GLuint IndexBuffer::bufferTarget() const {
   return GL_ELEMENT_ARRAY_BUFFER;
 }
@@ -49,19 +49,21 @@ public:
   [[nodiscard]] u64 dataSizeInBytes() const override;
   /// glDrawElements
   void draw();
-  // ***********************************************************************
-  //                            OPERATORS
-  // ***********************************************************************
-  IndexBuffer &operator=(IndexBuffer &&other) noexcept;
+  /// glMultiDrawElements. Draws several ranges of indices with a single call.
+  /// \param first_indices first index of each range
+  /// \param index_counts number of indices of each range
+  /// \param range_count number of ranges
+  void multiDraw(const u64 *first_indices, const GLsizei *index_counts, u64 range_count);
+  /// Uploads index data (does nothing if count is zero)
   /// \tparam T
   /// \param data
-  /// \return
+  /// \param count number of indices
   template<typename T, typename std::enable_if_t<
       std::is_same_v<i32, T> || std::is_same_v<i16, T> || std::is_same_v<i8, T> ||
           std::is_same_v<u32, T> || std::is_same_v<u16, T> || std::is_same_v<u8, T>> * = nullptr>
-  IndexBuffer &operator=(const std::vector<T> &data) {
-    if(data.empty())
-      return *this;
+  void setIndexData(const T *data, u64 count) {
+    if (!count)
+      return;
     auto data_type_size = sizeof(T);
     switch (data_type_size) {
     case 4: data_type = GL_UNSIGNED_INT;
@@ -70,8 +72,21 @@ public:
       break;
     default:data_type = GL_UNSIGNED_BYTE;
     }
-    element_count = OpenGL::primitiveCount(element_type, data.size());
-    setData(reinterpret_cast<const void *>(data.data()));
+    element_count = OpenGL::primitiveCount(element_type, count);
+    setData(reinterpret_cast<const void *>(data));
+  }
+  // ***********************************************************************
+  //                            OPERATORS
+  // ***********************************************************************
+  IndexBuffer &operator=(IndexBuffer &&other) noexcept;
+  /// \tparam T
+  /// \param data
+  /// \return
+  template<typename T, typename std::enable_if_t<
+      std::is_same_v<i32, T> || std::is_same_v<i16, T> || std::is_same_v<i8, T> ||
+          std::is_same_v<u32, T> || std::is_same_v<u16, T> || std::is_same_v<u8, T>> * = nullptr>
+  IndexBuffer &operator=(const std::vector<T> &data) {
+    setIndexData(data.data(), data.size());
     return *this;
   }
   // ***********************************************************************
@@ -84,6 +99,7 @@ private:
   u64 last_element_count_{0};
   u64 last_element_type_{0};
   u64 index_count_{0};
+  std::vector<const void *> multi_draw_offsets_;
 };
 
 std::ostream &operator<<(std::ostream &os, const IndexBuffer &index_buffer);
@@ -98,25 +98,30 @@ void VertexAttributes::updateOffsets() {
     offsets_.clear();
     return;
   }
-  offsets_.resize(attributes_.size());
+  offsets_.clear();
+  attribute_name_id_map_.clear();
   u64 offset = 0;
-  for (const auto &a : attributes_) {
+  for (u64 i = 0; i < attributes_.size(); ++i) {
+    const auto &a = attributes_[i];
+    attribute_name_id_map_[a.name] = i;
     offsets_.emplace_back(offset);
     offset += a.size * OpenGL::dataSizeInBytes(a.type);
   }
+  stride_ = offset;
 }
 
 void VertexAttributes::bindFormats(GLuint binding_index) const {
   for (size_t i = 0; i < attributes_.size(); ++i) {
     const auto &attribute = attributes_[i];
     auto component_size = attribute.componentSize();
+    auto row_size = component_size * OpenGL::dataSizeInBytes(attribute.type);
     for (size_t j = 0; j < attribute.rows(); ++j) {
       // compute attribute index based on the slot component index
       int attribute_index = attribute.location + j;
-      int offset = offsets_[i] + component_size * j * 4;
+      int offset = offsets_[i] + row_size * j;
       glEnableVertexAttribArray(attribute_index);
       glVertexAttribFormat(attribute_index, component_size,
-                           attribute.type, false, offset);
+                           attribute.type, attribute.normalized, offset);
       glVertexAttribDivisor(attribute_index, attribute.divisor);
       glVertexAttribBinding(attribute_index, binding_index);
     }
@@ -26,6 +26,7 @@
 ///\brief
 
 #include "vertex_buffer.h"
+#include <circe/scene/vertex_quantizer.h>
 
 namespace circe::gl {
 
@@ -47,13 +48,7 @@ VertexBuffer::VertexBuffer(VertexBuffer &&other) noexcept {
 VertexBuffer::~VertexBuffer() = default;
 
 VertexBuffer &VertexBuffer::operator=(const hermes::AoS &aos) {
-  // clear existent data/attributes
-  attributes.clear();
-  // push new attributes
-  for (const auto &field : aos.fields())
-    attributes.push(field.component_count, field.name, OpenGL::dataTypeEnum(field.type));
-  vertex_count_ = aos.size();
-  setData(reinterpret_cast<const void *>(aos.data()));
+  setVertexData(aos.structDescriptor(), aos.data(), aos.size());
   return *this;
 }
 
@@ -71,6 +66,38 @@ VertexBuffer &VertexBuffer::operator=(VertexBuffer &&other) noexcept {
   return *this;
 }
 
+void VertexBuffer::setVertexData(const hermes::StructDescriptor &descriptor, const void *data, u64 vertex_count) {
+  // clear existent data/attributes
+  attributes.clear();
+  // push new attributes
+  for (const auto &field : descriptor.fields())
+    attributes.push(field.component_count, field.name, OpenGL::dataTypeEnum(field.type));
+  vertex_count_ = vertex_count;
+  setData(data);
+}
+
+void VertexBuffer::setVertexData(const QuantizedVertices &vertices) {
+  setVertexData(vertices, vertices.data.data());
+}
+
+void VertexBuffer::setVertexData(const QuantizedVertices &layout, const void *data) {
+  attributes.clear();
+  for (const auto &attribute : layout.attributes)
+    attributes.push(attribute.component_count, attribute.name, OpenGL::dataTypeEnum(attribute.type),
+                    attribute.normalized ? GL_TRUE : GL_FALSE);
+  vertex_count_ = layout.vertex_count;
+  setData(data);
+}
+
+void VertexBuffer::setAttributeData(const hermes::StructDescriptor::Field &field, GLuint location,
+                                    const void *data, u64 vertex_count) {
+  attributes.clear();
+  attributes.push(field.component_count, field.name, OpenGL::dataTypeEnum(field.type), GL_FALSE,
+                  static_cast<int>(location));
+  vertex_count_ = vertex_count;
+  setData(data);
+}
+
 void VertexBuffer::setBindingIndex(GLuint binding_index) {
   binding_index_ = binding_index;
 }
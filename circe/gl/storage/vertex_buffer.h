@@ -33,6 +33,10 @@
 #include <circe/gl/storage/vertex_attributes.h>
 #include <string>
 
+namespace circe {
+struct QuantizedVertices;
+}
+
 namespace circe::gl {
 
 /// A Vertex Buffer Object (VBO) is the common term for a normal Buffer Object when
@@ -65,6 +69,29 @@ public:
   // ***********************************************************************
   //                             METHODS
   // ***********************************************************************
+  /// Sets attributes from descriptor fields and uploads interleaved vertex data
+  /// \param descriptor vertex layout
+  /// \param data vertex_count * descriptor.sizeInBytes() bytes
+  /// \param vertex_count
+  void setVertexData(const hermes::StructDescriptor &descriptor, const void *data, u64 vertex_count);
+  /// Sets attributes from quantized vertex data and uploads it. Snorm
+  /// attributes are declared normalized, so shaders read them as floats.
+  /// \param vertices
+  void setVertexData(const QuantizedVertices &vertices);
+  /// Sets attributes from a vertex layout and uploads vertex data from any
+  /// memory, e.g. a memory mapped glTF buffer (see GltfReader::vertexStream)
+  /// \param layout attributes and vertex count (layout.data is ignored)
+  /// \param data layout.vertex_count * layout.stride bytes
+  void setVertexData(const QuantizedVertices &layout, const void *data);
+  /// Sets a single attribute and uploads its data. Used for models with
+  /// separate vertex storage, where each attribute gets its own buffer and
+  /// binding index (see setBindingIndex).
+  /// \param field attribute description
+  /// \param location shader attribute location
+  /// \param data vertex_count * field.size bytes
+  /// \param vertex_count
+  void setAttributeData(const hermes::StructDescriptor::Field &field, GLuint location,
+                        const void *data, u64 vertex_count);
   /// \param binding_index new binding index value
   void setBindingIndex(GLuint binding_index);
   [[nodiscard]] GLuint bufferTarget() const override;
@@ -28,6 +28,7 @@
 #include <circe/gl/scene/scene_model.h>
 #include <circe/gl/graphics/shader.h>
 #include <circe/scene/shapes.h>
+#include <cstring>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -302,45 +303,54 @@ void Texture::View::apply() const {
     glTexParameterfv(target_, GL_TEXTURE_BORDER_COLOR, border_color_.asArray());
 }
 
-Texture Texture::fromFile(const hermes::Path &path,
-                          circe::texture_options input_options,
-                          circe::texture_options output_options) {
-  // check input options
-  bool input_is_hdr = circe::testMaskBit(input_options, circe::texture_options::hdr);
+Texture::Image Texture::readImage(const hermes::Path &path, circe::texture_options input_options) {
+  Image image;
+  image.hdr = circe::testMaskBit(input_options, circe::texture_options::hdr);
+  int width, height, channel_count;
+  // stb's flip flag is global state, hdr rows are flipped here instead
+  void *data = image.hdr ? static_cast<void *>(stbi_loadf(path.fullName().c_str(), &width, &height, &channel_count, 0))
+                         : static_cast<void *>(stbi_load(path.fullName().c_str(), &width, &height, &channel_count, 0));
+  if (!data) {
+    std::cerr << "Failed to load texture from file " << path << std::endl;
+    return image;
+  }
+  const u64 row_size = static_cast<u64>(width) * channel_count * (image.hdr ? sizeof(f32) : sizeof(u8));
+  image.data.resize(row_size * height);
+  for (int row = 0; row < height; ++row)
+    std::memcpy(image.data.data() + row * row_size,
+                static_cast<const u8 *>(data) + (image.hdr ? height - 1 - row : row) * row_size, row_size);
+  stbi_image_free(data);
+  image.size_in_texels = hermes::size3(width, height, 1);
+  image.channel_count = channel_count;
+  return image;
+}
+
+Texture Texture::fromImage(const Image &image,
+                           circe::texture_options input_options,
+                           circe::texture_options output_options) {
+  if (image.empty())
+    return Texture();
   // check output options
   bool output_is_cubemap = circe::testMaskBit(output_options, circe::texture_options::cubemap);
   // texture object
   Texture texture;
-  // read file
-  int width, height, channel_count;
-  void *data;
-  if (input_is_hdr) {
-    stbi_set_flip_vertically_on_load(true);
-    data = stbi_loadf(path.fullName().c_str(), &width, &height, &channel_count, 0);
-    texture.attributes_.target = GL_TEXTURE_2D;
+  texture.attributes_.target = GL_TEXTURE_2D;
+  texture.attributes_.format = (image.channel_count == 3) ? GL_RGB : GL_RGBA;
+  if (image.hdr) {
     texture.attributes_.internal_format = GL_RGB16F;
-    texture.attributes_.format = (channel_count == 3) ? GL_RGB : GL_RGBA;
     texture.attributes_.type = GL_FLOAT;
   } else {
-    data = stbi_load(path.fullName().c_str(), &width, &height, &channel_count, 0);
-    texture.attributes_.target = GL_TEXTURE_2D;
-    texture.attributes_.format = (channel_count == 3) ? GL_RGB : GL_RGBA;
     texture.attributes_.internal_format = GL_RGB;
     texture.attributes_.type = GL_UNSIGNED_BYTE;
   }
-  if (!data) {
-    std::cerr << "Failed to load texture from file " << path << std::endl;
-    return Texture();
-  }
   // init texture
-  texture.attributes_.size_in_texels = hermes::size3(width, height, 1);
-  texture.setTexels(data);
+  texture.attributes_.size_in_texels = image.size_in_texels;
+  texture.setTexels(image.data.data());
   texture.bind();
 
   circe::gl::Texture::View().apply();
 
   texture.unbind();
-  stbi_image_free(data);
 
   if (output_is_cubemap)
     return convertToCubemap(texture, input_options, {512, 512});
@@ -348,6 +358,12 @@ Texture Texture::fromFile(const hermes::Path &path,
   return texture;
 }
 
+Texture Texture::fromFile(const hermes::Path &path,
+                          circe::texture_options input_options,
+                          circe::texture_options output_options) {
+  return fromImage(readImage(path, input_options), input_options, output_options);
+}
+
 Texture Texture::fromFiles(const std::vector<hermes::Path> &face_paths) {
   Texture texture;
   // resize cube map
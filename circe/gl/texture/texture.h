@@ -109,9 +109,33 @@ public:
     bool using_border_{false};
     circe::Color border_color_;
   };
+  /// Pixels decoded from an image file. Decoding makes no GL calls, so it
+  /// can run on worker threads (see AssetLoader) and leave the upload
+  /// (fromImage) to the GL thread.
+  struct Image {
+    std::vector<u8> data;
+    hermes::size3 size_in_texels;
+    int channel_count{0};
+    bool hdr{false}; //!< data holds f32 texels (rows stored bottom-up)
+    [[nodiscard]] bool empty() const { return data.empty(); }
+  };
   // ***********************************************************************
   //                          STATIC METHODS
   // ***********************************************************************
+  /// Decodes an image file (thread safe, no GL calls)
+  /// \param path
+  /// \param input_options
+  /// \return empty image on failure
+  static Image readImage(const hermes::Path &path,
+                         circe::texture_options input_options = circe::texture_options::none);
+  /// Uploads a decoded image
+  /// \param image
+  /// \param input_options
+  /// \param output_options
+  /// \return Texture object
+  static Texture fromImage(const Image &image,
+                           circe::texture_options input_options = circe::texture_options::none,
+                           circe::texture_options output_options = circe::texture_options::none);
   ///
   /// \param path
   /// \param input_options
@@ -0,0 +1,166 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file asset_loader.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-22
+///
+///\brief
+
+#include <circe/gl/utils/asset_loader.h>
+#include <circe/common/parallel.h>
+#include <circe/scene/shapes.h>
+#include <chrono>
+#include <optional>
+
+namespace circe::gl {
+
+AssetLoader::AssetLoader(u32 worker_count) {
+  if (!worker_count)
+    worker_count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  for (u32 i = 0; i < worker_count; ++i)
+    workers_.emplace_back([this]() { work(); });
+}
+
+AssetLoader::~AssetLoader() {
+  {
+    std::lock_guard<std::mutex> lock(decode_mutex_);
+    stopping_ = true;
+    decode_queue_.clear();
+  }
+  decode_condition_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+AssetHandle<SceneModel> AssetLoader::loadModel(const hermes::Path &path, shape_options options,
+                                               cpu_residency residency) {
+  return load<SceneModel, Model>([path, options](Model &model) {
+    model = Model::fromFile(path, options);
+    if (!model.vertexCount()) {
+      hermes::Log::error("Failed to load model from file {}", path.fullName());
+      return false;
+    }
+    return true;
+  }, [options, residency](Model &&model) {
+    SceneModel scene_model;
+    scene_model.setQuantization(testMaskBit(options, shape_options::quantize));
+    scene_model.setResidency(residency);
+    scene_model = std::move(model);
+    return scene_model;
+  });
+}
+
+AssetHandle<Texture> AssetLoader::loadTexture(const hermes::Path &path,
+                                              circe::texture_options input_options,
+                                              circe::texture_options output_options) {
+  return load<Texture, Texture::Image>([path, input_options](Texture::Image &image) {
+    image = Texture::readImage(path, input_options);
+    return !image.empty();
+  }, [input_options, output_options](Texture::Image &&image) {
+    return Texture::fromImage(image, input_options, output_options);
+  });
+}
+
+u64 AssetLoader::pumpUploads(f64 budget_ms) {
+  const auto start = std::chrono::steady_clock::now();
+  u64 upload_count = 0;
+  while (true) {
+    std::function<void()> upload;
+    {
+      std::lock_guard<std::mutex> lock(upload_mutex_);
+      if (upload_queue_.empty())
+        break;
+      upload = std::move(upload_queue_.front());
+      upload_queue_.pop_front();
+    }
+    upload();
+    upload_count++;
+    if (std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count() >= budget_ms)
+      break;
+  }
+  return upload_count;
+}
+
+void AssetLoader::waitDecoded() {
+  std::unique_lock<std::mutex> lock(decode_mutex_);
+  decoded_condition_.wait(lock, [this]() { return decode_queue_.empty() && !active_decodes_; });
+}
+
+SceneModel &AssetLoader::placeholderModel() {
+  if (!placeholder_model_)
+    placeholder_model_ = std::make_unique<SceneModel>(
+        Shapes::box(hermes::bbox3::unitBox(), shape_options::wireframe));
+  return *placeholder_model_;
+}
+
+Texture &AssetLoader::placeholderTexture() {
+  if (!placeholder_texture_) {
+    Texture::Attributes attributes;
+    attributes.size_in_texels = hermes::size3(1, 1, 1);
+    const u8 white[4] = {255, 255, 255, 255};
+    placeholder_texture_ = std::make_unique<Texture>(attributes, white);
+  }
+  return *placeholder_texture_;
+}
+
+void AssetLoader::enqueueDecode(std::function<void()> &&task) {
+  {
+    std::lock_guard<std::mutex> lock(decode_mutex_);
+    decode_queue_.emplace_back(std::move(task));
+  }
+  decode_condition_.notify_one();
+}
+
+void AssetLoader::enqueueUpload(std::function<void()> &&task) {
+  std::lock_guard<std::mutex> lock(upload_mutex_);
+  upload_queue_.emplace_back(std::move(task));
+}
+
+void AssetLoader::work() {
+  while (true) {
+    std::function<void()> task;
+    bool alone = false;
+    {
+      std::unique_lock<std::mutex> lock(decode_mutex_);
+      decode_condition_.wait(lock, [this]() { return stopping_ || !decode_queue_.empty(); });
+      if (stopping_)
+        return;
+      task = std::move(decode_queue_.front());
+      decode_queue_.pop_front();
+      alone = !active_decodes_ && decode_queue_.empty();
+      active_decodes_++;
+    }
+    // a single decode (one large file) keeps its parallel loops, decodes
+    // running side by side keep theirs serial
+    std::optional<Parallel::WorkerScope> scope;
+    if (!alone)
+      scope.emplace();
+    task();
+    {
+      std::lock_guard<std::mutex> lock(decode_mutex_);
+      active_decodes_--;
+    }
+    decoded_condition_.notify_all();
+  }
+}
+
+}
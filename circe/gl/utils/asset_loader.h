@@ -0,0 +1,194 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file asset_loader.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-22
+///
+///\brief Asynchronous asset loading with budgeted GL uploads
+
+#ifndef CIRCE_CIRCE_GL_UTILS_ASSET_LOADER_H
+#define CIRCE_CIRCE_GL_UTILS_ASSET_LOADER_H
+
+#include <circe/gl/scene/scene_model.h>
+#include <circe/gl/texture/texture.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace circe::gl {
+
+/// State of an asset requested to the AssetLoader
+enum class asset_status {
+  loading = 0,   //!< a worker is reading/decoding the file
+  uploading = 1, //!< decoded, waiting for its GL upload
+  ready = 2,
+  failed = 3
+};
+
+/// Shared reference to an asset loaded by an AssetLoader (copies refer to
+/// the same asset). The status can be queried from any thread, the asset
+/// itself belongs to the GL thread (the one pumping uploads).
+template<typename T>
+class AssetHandle {
+  friend class AssetLoader;
+public:
+  [[nodiscard]] asset_status status() const { return state_ ? state_->status.load() : asset_status::failed; }
+  [[nodiscard]] bool ready() const { return status() == asset_status::ready; }
+  /// \note Like a shared pointer, a const handle still gives access to the
+  ///       (shared) asset
+  /// \return nullptr until the asset is ready
+  T *get() const { return ready() ? state_->asset.get() : nullptr; }
+  /// \param placeholder drawn/used while the asset is not ready
+  /// \return the asset if ready, placeholder otherwise
+  T &getOr(T &placeholder) const {
+    auto *asset = get();
+    return asset ? *asset : placeholder;
+  }
+
+private:
+  struct State {
+    std::atomic<asset_status> status{asset_status::loading};
+    std::unique_ptr<T> asset;
+  };
+  std::shared_ptr<State> state_;
+};
+
+/// Loads assets in two stages:
+///   - files are read and decoded (parsing, image decoding, mesh processing)
+///     by a pool of worker threads;
+///   - GL objects are created by pumpUploads(), on the GL thread, until the
+///     per-frame time budget is used (BaseApp pumps them in prepareFrame).
+/// Example:
+///   auto mesh = loader.loadModel("scene.obj", shape_options::normal);
+///   ...
+///   // render loop
+///   loader.pumpUploads();
+///   mesh.getOr(loader.placeholderModel()).draw();
+/// \note Uploads are not split: a single large model may exceed the budget.
+/// \note A decode that starts while no other decode is active or queued runs
+///       its parallel loops (see Parallel) on all threads, otherwise they run
+///       serially on its worker.
+class AssetLoader {
+public:
+  // ***********************************************************************
+  //                           CONSTRUCTORS
+  // ***********************************************************************
+  /// \param worker_count (0 means hardware concurrency - 1)
+  explicit AssetLoader(u32 worker_count = 0);
+  /// Stops workers. Queued requests are dropped.
+  ~AssetLoader();
+  AssetLoader(const AssetLoader &) = delete;
+  AssetLoader &operator=(const AssetLoader &) = delete;
+  // ***********************************************************************
+  //                             LOADING
+  // ***********************************************************************
+  /// \param path
+  /// \param options
+  /// \param residency host copy kept after upload
+  /// \return
+  AssetHandle<SceneModel> loadModel(const hermes::Path &path, shape_options options = shape_options::none,
+                                    cpu_residency residency = cpu_residency::keep);
+  /// \param path
+  /// \param input_options
+  /// \param output_options
+  /// \return
+  AssetHandle<Texture> loadTexture(const hermes::Path &path,
+                                   circe::texture_options input_options = circe::texture_options::none,
+                                   circe::texture_options output_options = circe::texture_options::none);
+  /// Generic two stage load
+  /// \tparam T asset type
+  /// \tparam D decoded data type
+  /// \param decode runs on a worker thread, returns false on failure
+  /// \param upload runs on the GL thread and builds the asset
+  /// \return
+  template<typename T, typename D>
+  AssetHandle<T> load(std::function<bool(D &)> decode, std::function<T(D &&)> upload) {
+    AssetHandle<T> handle;
+    handle.state_ = std::make_shared<typename AssetHandle<T>::State>();
+    auto state = handle.state_;
+    pending_count_++;
+    enqueueDecode([this, state, decode = std::move(decode), upload = std::move(upload)]() {
+      auto decoded = std::make_shared<D>();
+      if (!decode(*decoded)) {
+        state->status = asset_status::failed;
+        pending_count_--;
+        return;
+      }
+      state->status = asset_status::uploading;
+      enqueueUpload([this, state, decoded, upload]() {
+        state->asset = std::make_unique<T>(upload(std::move(*decoded)));
+        state->status = asset_status::ready;
+        pending_count_--;
+      });
+    });
+    return handle;
+  }
+  // ***********************************************************************
+  //                             UPLOADS
+  // ***********************************************************************
+  /// Runs queued GL uploads on the calling thread until budget_ms is spent
+  /// (at least one upload runs, so loading always progresses)
+  /// \param budget_ms
+  /// \return number of uploads done
+  u64 pumpUploads(f64 budget_ms);
+  /// Uses upload_budget_ms
+  u64 pumpUploads() { return pumpUploads(upload_budget_ms); }
+  /// \return number of assets not ready or failed yet
+  [[nodiscard]] u64 pendingCount() const { return pending_count_; }
+  /// Blocks until every queued file is decoded
+  void waitDecoded();
+  /// Unit wireframe box (created on first use, must be called on the GL
+  /// thread). Its program is set by the caller.
+  SceneModel &placeholderModel();
+  /// 1x1 white texture (created on first use, must be called on the GL thread)
+  Texture &placeholderTexture();
+  // ***********************************************************************
+  //                          PUBLIC FIELDS
+  // ***********************************************************************
+  f64 upload_budget_ms{2.0}; //!< GL upload time per frame (milliseconds)
+
+private:
+  void enqueueDecode(std::function<void()> &&task);
+  void enqueueUpload(std::function<void()> &&task);
+  void work();
+
+  std::vector<std::thread> workers_;
+  std::mutex decode_mutex_;
+  std::condition_variable decode_condition_;
+  std::condition_variable decoded_condition_;
+  std::deque<std::function<void()>> decode_queue_;
+  u64 active_decodes_{0};
+  bool stopping_{false};
+  std::mutex upload_mutex_;
+  std::deque<std::function<void()>> upload_queue_;
+  std::atomic<u64> pending_count_{0};
+  std::unique_ptr<SceneModel> placeholder_model_;
+  std::unique_ptr<Texture> placeholder_texture_;
+};
+
+}
+
+#endif //CIRCE_CIRCE_GL_UTILS_ASSET_LOADER_H
@@ -77,11 +77,19 @@ void BaseApp::prepare() {
 }
 
 void BaseApp::prepareFrame() {
+  if (asset_loader_)
+    asset_loader_->pumpUploads();
   ImGui_ImplOpenGL3_NewFrame();
   ImGui_ImplGlfw_NewFrame();
   ImGui::NewFrame();
 }
 
+AssetLoader &BaseApp::assetLoader() {
+  if (!asset_loader_)
+    asset_loader_ = std::make_unique<AssetLoader>();
+  return *asset_loader_;
+}
+
 void BaseApp::startFrame() {
   // start frame time
   t_start = std::chrono::high_resolution_clock::now();
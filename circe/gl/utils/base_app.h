@@ -29,6 +29,7 @@
 #define CIRCE_UTILS_BASE_APP_H
 
 #include <circe/gl/ui/scene_app.h>
+#include <circe/gl/utils/asset_loader.h>
 #include <chrono>
 
 namespace circe::gl {
@@ -50,6 +51,10 @@ public:
   virtual void render(circe::CameraInterface *camera) = 0;
   virtual void finishFrame();
   int run();
+  /// Asynchronous loader (created on first use). Its GL uploads are pumped
+  /// in prepareFrame, within AssetLoader::upload_budget_ms per frame.
+  /// \return
+  AssetLoader &assetLoader();
 
   ///  Last frame time measured using a high performance timer (if available)
   float frame_timer = 1.0f;
@@ -60,6 +65,7 @@ protected:
   void endFrame();
 
   std::unique_ptr<circe::gl::App> app_;
+  std::unique_ptr<AssetLoader> asset_loader_;
   // Frame counter to display fps
   std::chrono::time_point<std::chrono::high_resolution_clock> t_start;
   uint32_t frame_counter_ = 0;
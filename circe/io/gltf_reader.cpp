@@ -0,0 +1,1014 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file gltf_reader.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-23
+///
+///\brief
+
+#include <circe/io/gltf_reader.h>
+#include <circe/io/mapped_file.h>
+#include <circe/io/text_parsing.h>
+#include <circe/common/parallel.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace circe {
+
+namespace {
+
+// *********************************************************************************************************************
+//                                                                                                               JSON
+// *********************************************************************************************************************
+/// Minimal JSON document (glTF descriptions are small, buffers never go through here)
+struct Json {
+  enum class kind { null_value, boolean, number, string, array, object };
+  kind type{kind::null_value};
+  f64 number{0};
+  bool boolean{false};
+  std::string string;
+  std::vector<std::string> keys; //!< object member names
+  std::vector<Json> items;       //!< array items or object member values
+
+  [[nodiscard]] const Json *find(const char *key) const {
+    if (type != kind::object)
+      return nullptr;
+    for (u64 i = 0; i < keys.size(); ++i)
+      if (keys[i] == key)
+        return &items[i];
+    return nullptr;
+  }
+  [[nodiscard]] i64 integer(const char *key, i64 default_value) const {
+    const auto *value = find(key);
+    return value && value->type == kind::number ? static_cast<i64>(value->number) : default_value;
+  }
+  [[nodiscard]] std::string text(const char *key) const {
+    const auto *value = find(key);
+    return value && value->type == kind::string ? value->string : std::string();
+  }
+  [[nodiscard]] const std::vector<Json> &array(const char *key) const {
+    static const std::vector<Json> empty;
+    const auto *value = find(key);
+    return value && value->type == kind::array ? value->items : empty;
+  }
+};
+
+class JsonParser {
+public:
+  JsonParser(const char *begin, const char *end) : p_(begin), end_(end) {}
+  bool parse(Json &value) {
+    if (!parseValue(value, 0))
+      return false;
+    skipSpaces();
+    return p_ == end_;
+  }
+
+private:
+  static constexpr u32 max_depth = 256;
+
+  void skipSpaces() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+      ++p_;
+  }
+  bool match(const char *word) {
+    const u64 n = std::strlen(word);
+    if (static_cast<u64>(end_ - p_) < n || std::memcmp(p_, word, n) != 0)
+      return false;
+    p_ += n;
+    return true;
+  }
+  bool parseHex(u32 &code) {
+    if (end_ - p_ < 4)
+      return false;
+    code = 0;
+    for (int i = 0; i < 4; ++i, ++p_) {
+      const char c = *p_;
+      code <<= 4;
+      if (c >= '0' && c <= '9') code |= c - '0';
+      else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+      else return false;
+    }
+    return true;
+  }
+  static void appendUtf8(std::string &s, u32 code) {
+    if (code < 0x80)
+      s += static_cast<char>(code);
+    else if (code < 0x800) {
+      s += static_cast<char>(0xc0 | (code >> 6));
+      s += static_cast<char>(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+      s += static_cast<char>(0xe0 | (code >> 12));
+      s += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+      s += static_cast<char>(0x80 | (code & 0x3f));
+    } else {
+      s += static_cast<char>(0xf0 | (code >> 18));
+      s += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+      s += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+      s += static_cast<char>(0x80 | (code & 0x3f));
+    }
+  }
+  bool parseString(std::string &s) {
+    if (p_ >= end_ || *p_ != '"')
+      return false;
+    ++p_;
+    s.clear();
+    while (p_ < end_ && *p_ != '"') {
+      if (*p_ != '\\') {
+        s += *p_++;
+        continue;
+      }
+      if (++p_ >= end_)
+        return false;
+      switch (*p_++) {
+      case '"': s += '"';
+        break;
+      case '\\': s += '\\';
+        break;
+      case '/': s += '/';
+        break;
+      case 'b': s += '\b';
+        break;
+      case 'f': s += '\f';
+        break;
+      case 'n': s += '\n';
+        break;
+      case 'r': s += '\r';
+        break;
+      case 't': s += '\t';
+        break;
+      case 'u': {
+        u32 code = 0;
+        if (!parseHex(code))
+          return false;
+        // surrogate pair
+        if (code >= 0xd800 && code < 0xdc00 && match("\\u")) {
+          u32 low = 0;
+          if (!parseHex(low))
+            return false;
+          code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+        }
+        appendUtf8(s, code);
+        break;
+      }
+      default: return false;
+      }
+    }
+    if (p_ >= end_)
+      return false;
+    ++p_;
+    return true;
+  }
+  bool parseValue(Json &value, u32 depth) {
+    if (depth > max_depth)
+      return false;
+    skipSpaces();
+    if (p_ >= end_)
+      return false;
+    switch (*p_) {
+    case '{': {
+      ++p_;
+      value.type = Json::kind::object;
+      skipSpaces();
+      if (p_ < end_ && *p_ == '}') {
+        ++p_;
+        return true;
+      }
+      while (true) {
+        skipSpaces();
+        value.keys.emplace_back();
+        if (!parseString(value.keys.back()))
+          return false;
+        skipSpaces();
+        if (p_ >= end_ || *p_++ != ':')
+          return false;
+        value.items.emplace_back();
+        if (!parseValue(value.items.back(), depth + 1))
+          return false;
+        skipSpaces();
+        if (p_ < end_ && *p_ == ',') {
+          ++p_;
+          continue;
+        }
+        if (p_ < end_ && *p_ == '}') {
+          ++p_;
+          return true;
+        }
+        return false;
+      }
+    }
+    case '[': {
+      ++p_;
+      value.type = Json::kind::array;
+      skipSpaces();
+      if (p_ < end_ && *p_ == ']') {
+        ++p_;
+        return true;
+      }
+      while (true) {
+        value.items.emplace_back();
+        if (!parseValue(value.items.back(), depth + 1))
+          return false;
+        skipSpaces();
+        if (p_ < end_ && *p_ == ',') {
+          ++p_;
+          continue;
+        }
+        if (p_ < end_ && *p_ == ']') {
+          ++p_;
+          return true;
+        }
+        return false;
+      }
+    }
+    case '"': value.type = Json::kind::string;
+      return parseString(value.string);
+    case 't': value.type = Json::kind::boolean;
+      value.boolean = true;
+      return match("true");
+    case 'f': value.type = Json::kind::boolean;
+      return match("false");
+    case 'n': return match("null");
+    default: value.type = Json::kind::number;
+      return TextParsing::parseDouble(p_, end_, value.number);
+    }
+  }
+
+  const char *p_;
+  const char *end_;
+};
+
+// *********************************************************************************************************************
+//                                                                                                            BUFFERS
+// *********************************************************************************************************************
+constexpr u32 glb_magic = 0x46546C67;      // "glTF"
+constexpr u32 glb_json_chunk = 0x4E4F534A; // "JSON"
+constexpr u32 glb_bin_chunk = 0x004E4942;  // "BIN\0"
+constexpr u64 min_block_size = 1u << 12;
+
+u32 readU32(const char *p) {
+  u32 value = 0;
+  std::memcpy(&value, p, sizeof(u32));
+  return value;
+}
+
+bool decodeBase64(const char *p, const char *end, std::vector<u8> &bytes) {
+  auto digit = [](char c) -> i32 {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+  };
+  bytes.clear();
+  bytes.reserve((end - p) / 4 * 3);
+  u32 accumulator = 0;
+  u32 bits = 0;
+  for (; p < end && *p != '='; ++p) {
+    const i32 d = digit(*p);
+    if (d < 0)
+      return false;
+    accumulator = (accumulator << 6) | static_cast<u32>(d);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      bytes.push_back(static_cast<u8>((accumulator >> bits) & 0xff));
+    }
+  }
+  return true;
+}
+
+std::string decodeUri(const std::string &uri) {
+  std::string s;
+  for (u64 i = 0; i < uri.size(); ++i) {
+    if (uri[i] == '%' && i + 2 < uri.size()) {
+      s += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+      i += 2;
+    } else
+      s += uri[i];
+  }
+  return s;
+}
+
+// *********************************************************************************************************************
+//                                                                                                         CONVERSION
+// *********************************************************************************************************************
+hermes::DataType dataType(gltf_component_type type) {
+  switch (type) {
+  case gltf_component_type::i8: return hermes::DataType::I8;
+  case gltf_component_type::u8: return hermes::DataType::U8;
+  case gltf_component_type::i16: return hermes::DataType::I16;
+  case gltf_component_type::u16: return hermes::DataType::U16;
+  case gltf_component_type::u32: return hermes::DataType::U32;
+  default: return hermes::DataType::F32;
+  }
+}
+
+/// Reads a component as float, normalized integers follow the glTF rules
+f32 componentValue(const u8 *p, gltf_component_type type, bool normalized) {
+  switch (type) {
+  case gltf_component_type::i8: {
+    i8 v;
+    std::memcpy(&v, p, sizeof(v));
+    return normalized ? std::max(v / 127.f, -1.f) : v;
+  }
+  case gltf_component_type::u8: return normalized ? *p / 255.f : *p;
+  case gltf_component_type::i16: {
+    i16 v;
+    std::memcpy(&v, p, sizeof(v));
+    return normalized ? std::max(v / 32767.f, -1.f) : v;
+  }
+  case gltf_component_type::u16: {
+    u16 v;
+    std::memcpy(&v, p, sizeof(v));
+    return normalized ? v / 65535.f : v;
+  }
+  case gltf_component_type::u32: {
+    u32 v;
+    std::memcpy(&v, p, sizeof(v));
+    return static_cast<f32>(v);
+  }
+  default: {
+    f32 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  }
+}
+
+u32 indexValue(const u8 *p, gltf_component_type type) {
+  switch (type) {
+  case gltf_component_type::u8: return *p;
+  case gltf_component_type::u16: {
+    u16 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  default: {
+    u32 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  }
+}
+
+/// Maps glTF modes to the primitive type produced by readMesh
+bool primitiveType(u32 mode, hermes::GeometricPrimitiveType &type) {
+  switch (mode) {
+  case 0: type = hermes::GeometricPrimitiveType::POINTS;
+    return true;
+  case 1:
+  case 2:
+  case 3: type = hermes::GeometricPrimitiveType::LINES;
+    return true;
+  case 4:
+  case 5:
+  case 6: type = hermes::GeometricPrimitiveType::TRIANGLES;
+    return true;
+  default: return false;
+  }
+}
+
+/// Converts strips, loops and fans into lists
+void expandIndices(u32 mode, std::vector<u32> &indices) {
+  std::vector<u32> list;
+  const u64 n = indices.size();
+  switch (mode) {
+  case 2: // line loop
+  case 3: // line strip
+    for (u64 i = 0; i + 1 < n; ++i) {
+      list.push_back(indices[i]);
+      list.push_back(indices[i + 1]);
+    }
+    if (mode == 2 && n > 2) {
+      list.push_back(indices[n - 1]);
+      list.push_back(indices[0]);
+    }
+    break;
+  case 5: // triangle strip
+    for (u64 i = 0; i + 2 < n; ++i) {
+      const bool odd = i & 1;
+      list.push_back(indices[i]);
+      list.push_back(indices[i + (odd ? 2 : 1)]);
+      list.push_back(indices[i + (odd ? 1 : 2)]);
+    }
+    break;
+  case 6: // triangle fan
+    for (u64 i = 1; i + 1 < n; ++i) {
+      list.push_back(indices[0]);
+      list.push_back(indices[i]);
+      list.push_back(indices[i + 1]);
+    }
+    break;
+  default: return;
+  }
+  indices = std::move(list);
+}
+
+/// \param m column-major 4x4
+hermes::Transform toTransform(const f32 *m) {
+  hermes::mat4 matrix;
+  for (int r = 0; r < 4; ++r)
+    for (int c = 0; c < 4; ++c)
+      matrix[r][c] = m[c * 4 + r];
+  return hermes::Transform(matrix);
+}
+
+/// c = a * b (column-major)
+void multiply(const f32 *a, const f32 *b, f32 *c) {
+  for (int col = 0; col < 4; ++col)
+    for (int row = 0; row < 4; ++row) {
+      f32 sum = 0;
+      for (int k = 0; k < 4; ++k)
+        sum += a[k * 4 + row] * b[col * 4 + k];
+      c[col * 4 + row] = sum;
+    }
+}
+
+/// Local transform from translation, rotation (x y z w quaternion) and scale
+void composeTransform(const f32 *t, const f32 *q, const f32 *s, f32 *m) {
+  const f32 x = q[0], y = q[1], z = q[2], w = q[3];
+  const f32 r[9] = {
+      1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w),
+      2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+      2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y)};
+  for (int col = 0; col < 3; ++col) {
+    for (int row = 0; row < 3; ++row)
+      m[col * 4 + row] = r[col * 3 + row] * s[col];
+    m[col * 4 + 3] = 0;
+  }
+  m[12] = t[0];
+  m[13] = t[1];
+  m[14] = t[2];
+  m[15] = 1;
+}
+
+void readFloats(const Json &json, const char *key, f32 *values, u64 n) {
+  const auto &items = json.array(key);
+  for (u64 i = 0; i < n && i < items.size(); ++i)
+    values[i] = static_cast<f32>(items[i].number);
+}
+
+}
+
+// *********************************************************************************************************************
+//                                                                                                         GltfReader
+// *********************************************************************************************************************
+u64 GltfReader::Accessor::elementSize() const {
+  return componentSize(component_type) * component_count;
+}
+
+GltfReader::GltfReader() = default;
+
+GltfReader::GltfReader(const hermes::Path &path) {
+  open(path);
+}
+
+GltfReader::~GltfReader() = default;
+
+u64 GltfReader::componentSize(gltf_component_type type) {
+  switch (type) {
+  case gltf_component_type::i8:
+  case gltf_component_type::u8: return 1;
+  case gltf_component_type::i16:
+  case gltf_component_type::u16: return 2;
+  default: return 4;
+  }
+}
+
+std::string GltfReader::attributeName(const std::string &semantic) {
+  if (semantic == "POSITION") return "position";
+  if (semantic == "NORMAL") return "normal";
+  if (semantic == "TANGENT") return "tangent";
+  if (semantic == "TEXCOORD_0") return "uvs";
+  if (semantic.rfind("TEXCOORD_", 0) == 0) return "uvs_" + semantic.substr(9);
+  if (semantic == "COLOR_0") return "color";
+  std::string name = semantic;
+  std::transform(name.begin(), name.end(), name.begin(), [](char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+  });
+  return name;
+}
+
+bool GltfReader::open(const hermes::Path &path) {
+  good_ = false;
+  path_ = path.fullName();
+  buffers_.clear();
+  buffer_views_.clear();
+  accessors_.clear();
+  meshes_.clear();
+  nodes_.clear();
+  scenes_.clear();
+  default_scene_ = -1;
+
+  auto file = std::make_shared<MappedFile>();
+  if (!file->open(path) || !file->size()) {
+    hermes::Log::error("GltfReader: could not open {}.", path_);
+    return false;
+  }
+  const char *data = file->data();
+  const u64 size = file->size();
+  if (size >= 12 && readU32(data) == glb_magic) {
+    // binary container: header, JSON chunk and an optional BIN chunk
+    if (readU32(data + 4) != 2 || readU32(data + 8) > size) {
+      hermes::Log::error("GltfReader: unsupported glb header in {}.", path_);
+      return false;
+    }
+    const u64 length = readU32(data + 8);
+    const char *json = nullptr;
+    u64 json_size = 0;
+    Buffer glb_buffer;
+    for (u64 offset = 12; offset + 8 <= length;) {
+      const u64 chunk_size = readU32(data + offset);
+      const u32 chunk_type = readU32(data + offset + 4);
+      if (chunk_size > length - offset - 8) {
+        hermes::Log::error("GltfReader: truncated chunk in {}.", path_);
+        return false;
+      }
+      if (chunk_type == glb_json_chunk && !json) {
+        json = data + offset + 8;
+        json_size = chunk_size;
+      } else if (chunk_type == glb_bin_chunk && !glb_buffer.data) {
+        glb_buffer.data = reinterpret_cast<const u8 *>(data + offset + 8);
+        glb_buffer.size = chunk_size;
+        glb_buffer.owner = file;
+      }
+      offset += 8 + ((chunk_size + 3) & ~u64(3));
+    }
+    if (!json) {
+      hermes::Log::error("GltfReader: missing JSON chunk in {}.", path_);
+      return false;
+    }
+    good_ = readJson(json, json_size, glb_buffer);
+  } else
+    good_ = readJson(data, size, Buffer());
+  return good_;
+}
+
+bool GltfReader::readJson(const char *json, u64 size, const Buffer &glb_buffer) {
+  Json document;
+  if (!JsonParser(json, json + size).parse(document) || document.type != Json::kind::object) {
+    hermes::Log::error("GltfReader: malformed JSON in {}.", path_);
+    return false;
+  }
+  // buffers
+  const std::string &full_path = path_;
+  const auto separator = full_path.find_last_of("/\\");
+  const std::string directory = separator == std::string::npos ? "" : full_path.substr(0, separator + 1);
+  for (const auto &item : document.array("buffers")) {
+    Buffer buffer;
+    const u64 byte_length = item.integer("byteLength", 0);
+    const std::string uri = item.text("uri");
+    if (uri.empty()) {
+      if (buffers_.empty() && glb_buffer.data)
+        buffer = glb_buffer;
+    } else if (uri.rfind("data:", 0) == 0) {
+      const auto comma = uri.find(',');
+      auto bytes = std::make_shared<std::vector<u8>>();
+      if (comma == std::string::npos || uri.find(";base64") > comma ||
+          !decodeBase64(uri.data() + comma + 1, uri.data() + uri.size(), *bytes)) {
+        hermes::Log::error("GltfReader: unsupported data uri in {}.", path_);
+        return false;
+      }
+      buffer.data = bytes->data();
+      buffer.size = bytes->size();
+      buffer.owner = bytes;
+    } else {
+      auto file = std::make_shared<MappedFile>();
+      if (!file->open(hermes::Path(directory + decodeUri(uri)))) {
+        hermes::Log::error("GltfReader: could not open buffer {} of {}.", uri, path_);
+        return false;
+      }
+      buffer.data = reinterpret_cast<const u8 *>(file->data());
+      buffer.size = file->size();
+      buffer.owner = file;
+    }
+    if (buffer.size < byte_length) {
+      hermes::Log::error("GltfReader: buffer {} is smaller than declared in {}.", buffers_.size(), path_);
+      return false;
+    }
+    buffers_.emplace_back(std::move(buffer));
+  }
+  // buffer views
+  for (const auto &item : document.array("bufferViews")) {
+    BufferView view;
+    view.buffer = item.integer("buffer", 0);
+    view.byte_offset = item.integer("byteOffset", 0);
+    view.byte_length = item.integer("byteLength", 0);
+    view.byte_stride = item.integer("byteStride", 0);
+    if (view.buffer >= buffers_.size() || view.byte_offset > buffers_[view.buffer].size ||
+        view.byte_length > buffers_[view.buffer].size - view.byte_offset) {
+      hermes::Log::error("GltfReader: buffer view {} out of bounds in {}.", buffer_views_.size(), path_);
+      return false;
+    }
+    buffer_views_.emplace_back(view);
+  }
+  // accessors
+  for (const auto &item : document.array("accessors")) {
+    Accessor accessor;
+    accessor.buffer_view = item.integer("bufferView", -1);
+    accessor.byte_offset = item.integer("byteOffset", 0);
+    accessor.component_type = static_cast<gltf_component_type>(item.integer("componentType", 5126));
+    accessor.count = item.integer("count", 0);
+    const auto *normalized = item.find("normalized");
+    accessor.normalized = normalized && normalized->boolean;
+    accessor.sparse = item.find("sparse") != nullptr;
+    const std::string type = item.text("type");
+    if (type == "SCALAR") accessor.component_count = 1;
+    else if (type == "VEC2") accessor.component_count = 2;
+    else if (type == "VEC3") accessor.component_count = 3;
+    else if (type == "VEC4" || type == "MAT2") accessor.component_count = 4;
+    else if (type == "MAT3") accessor.component_count = 9;
+    else if (type == "MAT4") accessor.component_count = 16;
+    if (accessor.buffer_view >= static_cast<i64>(buffer_views_.size())) {
+      hermes::Log::error("GltfReader: accessor {} references a missing buffer view in {}.", accessors_.size(), path_);
+      return false;
+    }
+    accessors_.emplace_back(accessor);
+  }
+  // meshes
+  for (const auto &item : document.array("meshes")) {
+    Mesh mesh;
+    mesh.name = item.text("name");
+    for (const auto &primitive_item : item.array("primitives")) {
+      Primitive primitive;
+      primitive.indices = primitive_item.integer("indices", -1);
+      primitive.mode = primitive_item.integer("mode", 4);
+      primitive.material = primitive_item.integer("material", -1);
+      if (const auto *attributes = primitive_item.find("attributes"))
+        for (u64 i = 0; i < attributes->keys.size(); ++i) {
+          const auto accessor = static_cast<u64>(attributes->items[i].number);
+          if (accessor >= accessors_.size()) {
+            hermes::Log::error("GltfReader: primitive references a missing accessor in {}.", path_);
+            return false;
+          }
+          primitive.attributes.emplace_back(attributes->keys[i], accessor);
+        }
+      if (primitive.indices >= static_cast<i64>(accessors_.size())) {
+        hermes::Log::error("GltfReader: primitive references a missing accessor in {}.", path_);
+        return false;
+      }
+      mesh.primitives.emplace_back(std::move(primitive));
+    }
+    meshes_.emplace_back(std::move(mesh));
+  }
+  // nodes
+  for (const auto &item : document.array("nodes")) {
+    Node node;
+    node.name = item.text("name");
+    node.mesh = item.integer("mesh", -1);
+    if (node.mesh >= static_cast<i64>(meshes_.size()))
+      node.mesh = -1;
+    for (const auto &child : item.array("children"))
+      node.children.emplace_back(static_cast<u64>(child.number));
+    if (item.find("matrix"))
+      readFloats(item, "matrix", node.matrix, 16);
+    else {
+      f32 t[3] = {0, 0, 0}, r[4] = {0, 0, 0, 1}, s[3] = {1, 1, 1};
+      readFloats(item, "translation", t, 3);
+      readFloats(item, "rotation", r, 4);
+      readFloats(item, "scale", s, 3);
+      composeTransform(t, r, s, node.matrix);
+    }
+    nodes_.emplace_back(std::move(node));
+  }
+  for (auto &node : nodes_)
+    node.children.erase(std::remove_if(node.children.begin(), node.children.end(),
+                                       [&](u64 child) { return child >= nodes_.size(); }),
+                        node.children.end());
+  // scenes
+  for (const auto &item : document.array("scenes")) {
+    scenes_.emplace_back();
+    for (const auto &node : item.array("nodes"))
+      if (static_cast<u64>(node.number) < nodes_.size())
+        scenes_.back().emplace_back(static_cast<u64>(node.number));
+  }
+  default_scene_ = document.integer("scene", scenes_.empty() ? -1 : 0);
+  if (default_scene_ >= static_cast<i64>(scenes_.size()))
+    default_scene_ = -1;
+  return true;
+}
+
+bool GltfReader::accessorData(u64 accessor_index, const u8 *&data, u64 &stride) const {
+  const auto &accessor = accessors_[accessor_index];
+  data = nullptr;
+  stride = accessor.elementSize();
+  if (accessor.buffer_view < 0)
+    return true;
+  const auto &view = buffer_views_[accessor.buffer_view];
+  if (view.byte_stride)
+    stride = view.byte_stride;
+  if (accessor.count &&
+      (accessor.byte_offset > view.byte_length ||
+          (accessor.count - 1) * stride + accessor.elementSize() > view.byte_length - accessor.byte_offset))
+    return false;
+  data = buffers_[view.buffer].data + view.byte_offset + accessor.byte_offset;
+  return true;
+}
+
+bool GltfReader::interleavedLayout(const Primitive &primitive, std::vector<u64> &order, VertexStream &stream) const {
+  if (primitive.attributes.empty())
+    return false;
+  const auto &first = accessors_[primitive.attributes[0].second];
+  order.resize(primitive.attributes.size());
+  for (u64 i = 0; i < order.size(); ++i) {
+    const auto &accessor = accessors_[primitive.attributes[i].second];
+    if (accessor.buffer_view < 0 || accessor.sparse || accessor.buffer_view != first.buffer_view ||
+        accessor.count != first.count)
+      return false;
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](u64 a, u64 b) {
+    return accessors_[primitive.attributes[a].second].byte_offset <
+        accessors_[primitive.attributes[b].second].byte_offset;
+  });
+  // attributes must be packed one after the other, with no padding
+  const auto &base = accessors_[primitive.attributes[order[0]].second];
+  u64 offset = base.byte_offset;
+  for (auto i : order) {
+    const auto &accessor = accessors_[primitive.attributes[i].second];
+    if (accessor.byte_offset != offset)
+      return false;
+    offset += accessor.elementSize();
+  }
+  const u64 vertex_size = offset - base.byte_offset;
+  if (!accessorData(primitive.attributes[order[0]].second, stream.data, stream.layout.stride) ||
+      stream.layout.stride != vertex_size)
+    return false;
+  // the last vertex must fit in the view as a whole
+  const auto &view = buffer_views_[first.buffer_view];
+  if (first.count && base.byte_offset + first.count * vertex_size > view.byte_length)
+    return false;
+  stream.layout.vertex_count = first.count;
+  stream.owner = buffers_[view.buffer].owner;
+  return true;
+}
+
+bool GltfReader::vertexStream(u64 mesh, u64 primitive, VertexStream &stream) const {
+  stream = VertexStream();
+  if (mesh >= meshes_.size() || primitive >= meshes_[mesh].primitives.size())
+    return false;
+  const auto &p = meshes_[mesh].primitives[primitive];
+  std::vector<u64> order;
+  if (!interleavedLayout(p, order, stream))
+    return false;
+  u64 offset = 0;
+  for (auto i : order) {
+    const auto &accessor = accessors_[p.attributes[i].second];
+    QuantizedVertices::Attribute attribute;
+    attribute.name = attributeName(p.attributes[i].first);
+    attribute.component_count = accessor.component_count;
+    attribute.type = dataType(accessor.component_type);
+    attribute.normalized = accessor.normalized;
+    attribute.offset = offset;
+    offset += accessor.elementSize();
+    stream.layout.attributes.emplace_back(attribute);
+  }
+  return true;
+}
+
+Model GltfReader::readMesh(u64 mesh_index) const {
+  Model model;
+  if (mesh_index >= meshes_.size() || meshes_[mesh_index].primitives.empty())
+    return model;
+  const auto &mesh = meshes_[mesh_index];
+  const auto &first = mesh.primitives[0];
+  hermes::GeometricPrimitiveType primitive_type{};
+  if (!primitiveType(first.mode, primitive_type) || first.attributes.empty()) {
+    hermes::Log::error("GltfReader: unsupported primitive in mesh {} of {}.", mesh_index, path_);
+    return model;
+  }
+  auto pushField = [](hermes::AoS &aos, const std::string &name, u32 component_count) {
+    switch (component_count) {
+    case 1: aos.pushField<f32>(name);
+      break;
+    case 2: aos.pushField<hermes::point2>(name);
+      break;
+    case 3:
+      if (name == "position")
+        aos.pushField<hermes::point3>(name);
+      else
+        aos.pushField<hermes::vec3>(name);
+      break;
+    default: aos.pushField<hermes::vec4>(name);
+    }
+  };
+
+  // zero-copy: a single primitive with interleaved float attributes and 32-bit indices
+  if (first.mode == 0 || first.mode == 1 || first.mode == 4) {
+    std::vector<u64> order;
+    VertexStream stream;
+    const u8 *indices = nullptr;
+    u64 index_stride = 0;
+    bool zero_copy = mesh.primitives.size() == 1 && first.indices >= 0 &&
+        interleavedLayout(first, order, stream) &&
+        accessors_[first.indices].component_type == gltf_component_type::u32 &&
+        !accessors_[first.indices].sparse &&
+        accessorData(first.indices, indices, index_stride) && indices && index_stride == sizeof(u32) &&
+        reinterpret_cast<uintptr_t>(indices) % alignof(i32) == 0;
+    for (u64 i = 0; zero_copy && i < order.size(); ++i) {
+      const auto &accessor = accessors_[first.attributes[order[i]].second];
+      zero_copy = accessor.component_type == gltf_component_type::f32 && accessor.component_count <= 4;
+    }
+    // indices are used in place, so they are checked here (the gather path
+    // reports out of range indices)
+    if (zero_copy) {
+      const u64 index_count = accessors_[first.indices].count;
+      const auto *file_indices = reinterpret_cast<const u32 *>(indices);
+      std::vector<u32> block_max(Parallel::blockCount(index_count, min_block_size), 0);
+      Parallel::forBlocks(index_count, [&](u64 begin, u64 end, u32 block) {
+        u32 max_index = 0;
+        for (u64 i = begin; i < end; ++i)
+          max_index = std::max(max_index, file_indices[i]);
+        block_max[block] = max_index;
+      }, min_block_size);
+      for (auto max_index : block_max)
+        zero_copy = zero_copy && max_index < stream.layout.vertex_count;
+    }
+    if (zero_copy) {
+      hermes::AoS aos;
+      for (auto i : order)
+        pushField(aos, attributeName(first.attributes[i].first),
+                  accessors_[first.attributes[i].second].component_count);
+      model.setExternalData(aos.structDescriptor(), stream.data, stream.layout.vertex_count,
+                            reinterpret_cast<const i32 *>(indices), accessors_[first.indices].count,
+                            stream.owner);
+      model.setPrimitiveType(primitive_type);
+      return model;
+    }
+  }
+
+  // gather all primitives into a single vertex/index block
+  hermes::AoS aos;
+  for (const auto &attribute : first.attributes)
+    pushField(aos, attributeName(attribute.first), std::min(accessors_[attribute.second].component_count, 4u));
+  const auto &fields = aos.structDescriptor().fields();
+  std::vector<const Primitive *> primitives;
+  u64 vertex_count = 0;
+  for (const auto &primitive : mesh.primitives) {
+    hermes::GeometricPrimitiveType type{};
+    if (primitive.attributes.empty() || !primitiveType(primitive.mode, type) || type != primitive_type) {
+      hermes::Log::warn("GltfReader: skipping primitive with a different mode in mesh {} of {}.",
+                        mesh_index, path_);
+      continue;
+    }
+    primitives.emplace_back(&primitive);
+    vertex_count += accessors_[primitive.attributes[0].second].count;
+  }
+  aos.resize(vertex_count);
+  u8 *vertices = aos.data();
+  const u64 vertex_size = aos.stride();
+  std::vector<i32> indices;
+  std::vector<Model::SubMesh> sub_meshes;
+  u64 base_vertex = 0;
+  for (const auto *primitive : primitives) {
+    const u64 count = accessors_[primitive->attributes[0].second].count;
+    // attributes
+    for (u64 f = 0; f < fields.size(); ++f) {
+      const std::string &semantic = first.attributes[f].first;
+      auto it = std::find_if(primitive->attributes.begin(), primitive->attributes.end(),
+                             [&](const auto &attribute) { return attribute.first == semantic; });
+      if (it == primitive->attributes.end())
+        continue;
+      const auto &accessor = accessors_[it->second];
+      const u8 *source = nullptr;
+      u64 source_stride = 0;
+      if (accessor.sparse)
+        hermes::Log::warn("GltfReader: sparse accessor {} read without substitutions.", it->second);
+      if (accessor.count < count || !accessorData(it->second, source, source_stride)) {
+        hermes::Log::error("GltfReader: accessor {} out of bounds in {}.", it->second, path_);
+        return Model();
+      }
+      if (!source)
+        continue;
+      const u32 component_count = std::min(accessor.component_count, fields[f].component_count);
+      const u64 component_size = componentSize(accessor.component_type);
+      u8 *destination = vertices + base_vertex * vertex_size + fields[f].offset;
+      Parallel::forBlocks(count, [&](u64 begin, u64 end, u32) {
+        for (u64 v = begin; v < end; ++v) {
+          auto *d = reinterpret_cast<f32 *>(destination + v * vertex_size);
+          const u8 *s = source + v * source_stride;
+          for (u32 c = 0; c < component_count; ++c)
+            d[c] = componentValue(s + c * component_size, accessor.component_type, accessor.normalized);
+        }
+      }, min_block_size);
+    }
+    // indices
+    std::vector<u32> primitive_indices;
+    if (primitive->indices >= 0) {
+      const auto &accessor = accessors_[primitive->indices];
+      const u8 *source = nullptr;
+      u64 source_stride = 0;
+      if (!accessorData(primitive->indices, source, source_stride) || !source) {
+        hermes::Log::error("GltfReader: index accessor {} out of bounds in {}.", primitive->indices, path_);
+        return Model();
+      }
+      primitive_indices.resize(accessor.count);
+      for (u64 i = 0; i < accessor.count; ++i)
+        primitive_indices[i] = indexValue(source + i * source_stride, accessor.component_type);
+    } else {
+      primitive_indices.resize(count);
+      for (u64 i = 0; i < count; ++i)
+        primitive_indices[i] = static_cast<u32>(i);
+    }
+    expandIndices(primitive->mode, primitive_indices);
+    Model::SubMesh sub_mesh;
+    sub_mesh.name = mesh.name;
+    sub_mesh.index_offset = indices.size();
+    sub_mesh.index_count = primitive_indices.size();
+    sub_mesh.material_id = static_cast<i32>(primitive->material);
+    for (auto index : primitive_indices) {
+      if (index >= count) {
+        hermes::Log::error("GltfReader: vertex index {} out of bounds in {}.", index, path_);
+        return Model();
+      }
+      indices.emplace_back(static_cast<i32>(base_vertex + index));
+    }
+    sub_meshes.emplace_back(sub_mesh);
+    base_vertex += count;
+  }
+  model = std::move(aos);
+  model.setIndices(std::move(indices));
+  model.setPrimitiveType(primitive_type);
+  if (sub_meshes.size() > 1)
+    model.setSubMeshes(std::move(sub_meshes));
+  return model;
+}
+
+std::vector<GltfReader::Instance> GltfReader::instances(i64 scene) const {
+  std::vector<Instance> result;
+  std::vector<u64> roots;
+  if (scene < 0)
+    scene = default_scene_;
+  if (scene >= 0 && scene < static_cast<i64>(scenes_.size()))
+    roots = scenes_[scene];
+  else {
+    // no scene: every node that is nobody's child is a root
+    std::vector<bool> is_child(nodes_.size(), false);
+    for (const auto &node : nodes_)
+      for (auto child : node.children)
+        is_child[child] = true;
+    for (u64 i = 0; i < nodes_.size(); ++i)
+      if (!is_child[i])
+        roots.emplace_back(i);
+  }
+  struct Item {
+    u64 node;
+    f32 world[16];
+    u64 depth;
+  };
+  std::vector<Item> stack;
+  for (auto root : roots) {
+    Item item{root, {}, 0};
+    std::memcpy(item.world, nodes_[root].matrix, sizeof(item.world));
+    stack.emplace_back(item);
+  }
+  std::reverse(stack.begin(), stack.end());
+  while (!stack.empty()) {
+    Item item = stack.back();
+    stack.pop_back();
+    const auto &node = nodes_[item.node];
+    if (node.mesh >= 0)
+      result.push_back({item.node, static_cast<u64>(node.mesh), toTransform(item.world)});
+    // a valid hierarchy is a forest, deeper paths can only come from cycles
+    if (item.depth >= nodes_.size())
+      continue;
+    for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+      Item child{*it, {}, item.depth + 1};
+      multiply(item.world, nodes_[*it].matrix, child.world);
+      stack.emplace_back(child);
+    }
+  }
+  return result;
+}
+
+std::vector<hermes::Transform> GltfReader::instanceTransforms(u64 mesh, i64 scene) const {
+  std::vector<hermes::Transform> transforms;
+  for (const auto &instance : instances(scene))
+    if (instance.mesh == mesh)
+      transforms.emplace_back(instance.transform);
+  return transforms;
+}
+
+}
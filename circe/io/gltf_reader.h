@@ -0,0 +1,211 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file gltf_reader.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-23
+///
+///\brief glTF 2.0 (.gltf / .glb) reader
+
+#ifndef CIRCE_CIRCE_IO_GLTF_READER_H
+#define CIRCE_CIRCE_IO_GLTF_READER_H
+
+#include <circe/scene/model.h>
+#include <circe/scene/vertex_quantizer.h>
+#include <hermes/common/file_system.h>
+#include <hermes/geometry/transform.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace circe {
+
+/// Component types of glTF accessors (values match the GL enums)
+enum class gltf_component_type {
+  i8 = 5120,
+  u8 = 5121,
+  i16 = 5122,
+  u16 = 5123,
+  u32 = 5125,
+  f32 = 5126
+};
+
+/// Reader for glTF 2.0 assets, both .gltf (JSON + external or embedded
+/// buffers) and binary .glb files.
+///
+/// Binary data is never parsed: .glb files and external .bin buffers are
+/// memory mapped and accessors are read in place. Primitives whose attributes
+/// share a single interleaved buffer view (or a single tightly packed
+/// attribute) are exposed without copies:
+///   - readMesh() returns a model referencing the mapping (see
+///     Model::setExternalData) when all attributes are floats and indices are
+///     32-bit, so SceneModel uploads go straight from the file to DeviceMemory;
+///   - vertexStream() describes the raw vertex data of any interleaved
+///     primitive, including normalized integer attributes, which can be
+///     handed directly to VertexBuffer::setVertexData.
+/// Other layouts are gathered into a new model, where integer attributes are
+/// converted to floats (normalized ones following the glTF rules).
+///
+/// Node hierarchies are flattened by instances(), which gives the world
+/// transform of every node that references a mesh (ready for InstanceSet).
+///
+/// Example:
+///   GltfReader reader(path);
+///   SceneModel model = reader.readMesh(0);
+///   instance_set.setTransforms(reader.instanceTransforms(0));
+class GltfReader final {
+public:
+  struct Buffer {
+    const u8 *data{nullptr};
+    u64 size{0};
+    std::shared_ptr<const void> owner; //!< keeps data alive (mapping or decoded bytes)
+  };
+  struct BufferView {
+    u64 buffer{0};
+    u64 byte_offset{0};
+    u64 byte_length{0};
+    u64 byte_stride{0}; //!< 0 means tightly packed elements
+  };
+  struct Accessor {
+    i64 buffer_view{-1}; //!< -1 means all elements are zero
+    u64 byte_offset{0};
+    gltf_component_type component_type{gltf_component_type::f32};
+    u32 component_count{1};
+    bool normalized{false};
+    u64 count{0};
+    bool sparse{false}; //!< sparse substitutions are not supported
+    /// \return size of a single element in bytes
+    [[nodiscard]] u64 elementSize() const;
+  };
+  struct Primitive {
+    /// (glTF attribute semantic, accessor index) pairs
+    std::vector<std::pair<std::string, u64>> attributes;
+    i64 indices{-1};
+    u32 mode{4}; //!< 0 points, 1 lines, 4 triangles (GL enums)
+    i64 material{-1};
+  };
+  struct Mesh {
+    std::string name;
+    std::vector<Primitive> primitives;
+  };
+  struct Node {
+    std::string name;
+    i64 mesh{-1};
+    std::vector<u64> children;
+    f32 matrix[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}; //!< local transform (column-major)
+  };
+  /// A mesh placed in the scene by a node
+  struct Instance {
+    u64 node{0};
+    u64 mesh{0};
+    hermes::Transform transform; //!< world transform
+  };
+  /// Interleaved vertex data of a primitive, read in place
+  struct VertexStream {
+    QuantizedVertices layout; //!< raw attributes in memory order, stride and vertex count (no data)
+    const u8 *data{nullptr};
+    std::shared_ptr<const void> owner;
+  };
+  // ***********************************************************************
+  //                           CONSTRUCTORS
+  // ***********************************************************************
+  GltfReader();
+  /// \param path .gltf or .glb file
+  explicit GltfReader(const hermes::Path &path);
+  ~GltfReader();
+  GltfReader(const GltfReader &) = delete;
+  GltfReader &operator=(const GltfReader &) = delete;
+  // ***********************************************************************
+  //                             METHODS
+  // ***********************************************************************
+  /// Reads the asset description and maps its buffers
+  /// \param path .gltf or .glb file
+  /// \return true if success
+  bool open(const hermes::Path &path);
+  /// \return true if an asset is open
+  [[nodiscard]] bool good() const { return good_; }
+  [[nodiscard]] const std::vector<Buffer> &buffers() const { return buffers_; }
+  [[nodiscard]] const std::vector<BufferView> &bufferViews() const { return buffer_views_; }
+  [[nodiscard]] const std::vector<Accessor> &accessors() const { return accessors_; }
+  [[nodiscard]] const std::vector<Mesh> &meshes() const { return meshes_; }
+  [[nodiscard]] const std::vector<Node> &nodes() const { return nodes_; }
+  /// \return root nodes of each scene
+  [[nodiscard]] const std::vector<std::vector<u64>> &scenes() const { return scenes_; }
+  /// \return scene index (-1 if the asset does not define one)
+  [[nodiscard]] i64 defaultScene() const { return default_scene_; }
+  /// Gives the address of the first element of an accessor
+  /// \param accessor accessor index
+  /// \param data **[out]** nullptr if the accessor has no buffer view
+  /// \param stride **[out]** distance between consecutive elements
+  /// \return false if the accessor range lies outside its buffer
+  bool accessorData(u64 accessor, const u8 *&data, u64 &stride) const;
+  /// Builds a model with all primitives of a mesh. Primitives become
+  /// sub-meshes of a single vertex/index block.
+  /// \param mesh mesh index
+  /// \return empty model on failure
+  [[nodiscard]] Model readMesh(u64 mesh) const;
+  /// Describes the vertex data of a primitive without copying it
+  /// \param mesh mesh index
+  /// \param primitive primitive index
+  /// \param stream **[out]**
+  /// \return false if the primitive attributes are not interleaved in a single buffer view
+  bool vertexStream(u64 mesh, u64 primitive, VertexStream &stream) const;
+  /// Flattens the node hierarchy of a scene
+  /// \param scene scene index (-1 for the default scene, or all root nodes if there is none)
+  /// \return one instance per node that references a mesh
+  [[nodiscard]] std::vector<Instance> instances(i64 scene = -1) const;
+  /// \param mesh mesh index
+  /// \param scene scene index (see instances)
+  /// \return world transforms of all instances of mesh
+  [[nodiscard]] std::vector<hermes::Transform> instanceTransforms(u64 mesh, i64 scene = -1) const;
+  /// Maps glTF attribute semantics to circe attribute names (POSITION ->
+  /// position, NORMAL -> normal, TANGENT -> tangent, TEXCOORD_0 -> uvs,
+  /// TEXCOORD_n -> uvs_n, COLOR_0 -> color). Other semantics are lowercased.
+  /// \param semantic
+  /// \return
+  static std::string attributeName(const std::string &semantic);
+  /// \param type
+  /// \return size in bytes
+  static u64 componentSize(gltf_component_type type);
+
+private:
+  bool readJson(const char *json, u64 size, const Buffer &glb_buffer);
+  /// Checks that primitive attributes are interleaved in a single buffer view
+  /// \param primitive
+  /// \param order **[out]** attribute indices sorted by offset
+  /// \param stream **[out]** data, stride and vertex count
+  bool interleavedLayout(const Primitive &primitive, std::vector<u64> &order, VertexStream &stream) const;
+
+  bool good_{false};
+  std::string path_;
+  std::vector<Buffer> buffers_;
+  std::vector<BufferView> buffer_views_;
+  std::vector<Accessor> accessors_;
+  std::vector<Mesh> meshes_;
+  std::vector<Node> nodes_;
+  std::vector<std::vector<u64>> scenes_;
+  i64 default_scene_{-1};
+};
+
+}
+
+#endif //CIRCE_CIRCE_IO_GLTF_READER_H
@@ -26,32 +26,25 @@
 ///\brief
 
 #include "io.h"
+#include <circe/common/parallel.h>
+#include <circe/scene/mesh_optimizer.h>
+#include <circe/scene/tangent_space.h>
+#include <circe/scene/vertex_welder.h>
+#include <optional>
 
 //#define TINYOBJLOADER_IMPLEMENTATION // define this in only *one* .cc
 #include <tiny_obj_loader.h>
 
-/// A unique vertex data is comprised with each of its component indices
-struct ObjIndexKey {
-  int vertex_index{0};
-  int normal_index{0};
-  int uv_index{0};
-  bool operator==(const ObjIndexKey &other) const {
-    return vertex_index == other.vertex_index &&
-        normal_index == other.normal_index &&
-        uv_index == other.uv_index;
-  }
-};
-
-struct ObjIndexKeyHash : public std::unary_function<ObjIndexKey, int> {
-  int operator()(const ObjIndexKey &k) const {
-    return k.vertex_index ^ k.normal_index ^ k.uv_index;
-  }
-};
-
 namespace circe {
 
-Model io::readOBJ(const hermes::Path &path, shape_options options, u32 mesh_id) {
-  Model model;
+bool io::readOBJ(const hermes::Path &path, ObjData &data, obj_parsing_engine engine) {
+  if (engine == obj_parsing_engine::native) {
+    if (!ObjParser::parse(path, data)) {
+      hermes::Log::error("Failed to load obj file {}.", path.fullName());
+      return false;
+    }
+    return true;
+  }
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
@@ -59,110 +52,231 @@ Model io::readOBJ(const hermes::Path &path, shape_options options, u32 mesh_id)
   std::string err;
   if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.fullName().c_str())) {
     hermes::Log::error("Failed to load obj file {} : {}.", path.fullName(), err);
-    return model;
+    return false;
   }
   if (!warn.empty())
     hermes::Log::warn("Load obj: {}", warn);
+  data = ObjData();
+  data.positions = std::move(attrib.vertices);
+  data.normals = std::move(attrib.normals);
+  data.uvs = std::move(attrib.texcoords);
+  data.colors = std::move(attrib.colors);
+  for (const auto &material : materials)
+    data.materials.emplace_back(material.name);
+  for (const auto &shape : shapes) {
+    data.shapes.push_back({shape.name, data.indices.size(), shape.mesh.indices.size()});
+    u64 corner = data.indices.size();
+    for (const auto &idx : shape.mesh.indices)
+      data.indices.push_back({idx.vertex_index, idx.normal_index, idx.texcoord_index});
+    if (materials.empty())
+      continue;
+    // material ids are given per face
+    for (u64 face = 0; face < shape.mesh.num_face_vertices.size(); ++face) {
+      const i32 material_id = face < shape.mesh.material_ids.size() ? shape.mesh.material_ids[face] : -1;
+      if (data.material_ranges.empty() || data.material_ranges.back().material_id != material_id)
+        data.material_ranges.push_back({corner, 0, material_id});
+      data.material_ranges.back().index_count += shape.mesh.num_face_vertices[face];
+      corner += shape.mesh.num_face_vertices[face];
+    }
+  }
+  return true;
+}
 
+Model io::readOBJ(const hermes::Path &path, shape_options options, u32 mesh_id, obj_parsing_engine engine) {
+  ObjData data;
+  if (!readOBJ(path, data, engine))
+    return Model();
+  return fromOBJData(data, options, mesh_id);
+}
+
+Model io::fromOBJData(const ObjData &data, shape_options options, u32 mesh_id) {
+  Model model;
   u64 position_id{0}, normal_id{0}, color_id{0}, uv_id{0};
-  if (!attrib.vertices.empty())
+  if (!data.positions.empty())
     position_id = model.pushAttribute<hermes::point3>("position");
-  if (!attrib.normals.empty() || testMaskBit(options, shape_options::normal))
+  if (!data.normals.empty() || testMaskBit(options, shape_options::normal))
     normal_id = model.pushAttribute<hermes::vec3>("normal");
-  if (!attrib.colors.empty())
+  if (!data.colors.empty())
     color_id = model.pushAttribute<hermes::vec3>("color");
-  if (!attrib.texcoords.empty())
+  if (!data.uvs.empty())
     uv_id = model.pushAttribute<hermes::point2>("uv");
+  // tangent frames need uv coordinates
+  u64 tangent_id{0}, bitangent_id{0};
+  if ((options & shape_options::tangent_space) == shape_options::tangent_space)
+    options = options | shape_options::tangent | shape_options::bitangent;
+  if (!data.uvs.empty() && testMaskBit(options, shape_options::tangent))
+    tangent_id = model.pushAttribute<hermes::vec3>("tangents");
+  if (!data.uvs.empty() && testMaskBit(options, shape_options::bitangent))
+    bitangent_id = model.pushAttribute<hermes::vec3>("bitangents");
 
-  if (mesh_id >= shapes.size()) {
+  if (mesh_id != all_shapes && mesh_id >= data.shapes.size()) {
     hermes::Log::error("readOBJ: Shape not found!");
     return model;
   }
-
-  std::vector<f32> vertex_data;
-  std::vector<i32> index_data;
-  /// We need to map indices, because the same vertex can have different
-  /// indices for each of its elements
-  std::unordered_map<const ObjIndexKey, i32, ObjIndexKeyHash> index_map;
+  if (data.shapes.empty())
+    return model;
 
   /// build vertex indices
-  auto &shape = shapes[mesh_id];
-  u64 index_offset = 0;
-  u64 vertex_count = 0;
-  // loop over faces
-  for (auto fv : shape.mesh.num_face_vertices) {
-    // loop over vertices in the face
-    for (u64 v = 0; v < fv; ++v) {
-      auto idx = shape.mesh.indices[index_offset + v];
-      ObjIndexKey key{
-          idx.vertex_index,
-          idx.normal_index,
-          idx.texcoord_index
-      };
-      auto it = index_map.find(key);
-      if (it == index_map.end()) {
-        index_map[key] = vertex_count;
-        index_data.emplace_back(vertex_count++);
-      } else
-        index_data.emplace_back(it->second);
+  // shapes are contiguous ranges of corners
+  u64 first_corner = 0, index_count = 0;
+  if (mesh_id == all_shapes) {
+    first_corner = data.shapes.front().index_offset;
+    index_count = data.shapes.back().index_offset + data.shapes.back().index_count - first_corner;
+  } else {
+    first_corner = data.shapes[mesh_id].index_offset;
+    index_count = data.shapes[mesh_id].index_count;
+  }
+  const ObjIndex *shape_indices = data.indices.data() + first_corner;
+  const u64 position_count = data.positions.size() / 3;
+  const u64 normal_count = data.normals.size() / 3;
+  const u64 uv_count = data.uvs.size() / 2;
+  // normal and uv indices are optional (-1)
+  auto outOfBounds = [](i32 index, u64 count, bool optional) {
+    if (optional && index == -1)
+      return false;
+    return index < 0 || static_cast<u64>(index) >= count;
+  };
+  for (u64 i = 0; i < index_count; ++i) {
+    if (outOfBounds(shape_indices[i].vertex_index, position_count, false)) {
+      hermes::Log::error("readOBJ: vertex index {} out of bounds.", shape_indices[i].vertex_index);
+      return model;
+    }
+    if (outOfBounds(shape_indices[i].normal_index, normal_count, true)) {
+      hermes::Log::error("readOBJ: normal index {} out of bounds.", shape_indices[i].normal_index);
+      return model;
+    }
+    if (outOfBounds(shape_indices[i].uv_index, uv_count, true)) {
+      hermes::Log::error("readOBJ: uv index {} out of bounds.", shape_indices[i].uv_index);
+      return model;
     }
-    index_offset += fv;
   }
+  /// We need to map indices, because the same vertex can have different
+  /// indices for each of its elements
+  std::vector<i32> index_data;
+  std::vector<u64> unique_corners;
+  VertexWelder::weld(shape_indices, index_count, index_data, unique_corners);
+  std::vector<ObjIndex> unique_keys(unique_corners.size());
+  Parallel::forEach(unique_corners.size(), [&](u64 i) {
+    unique_keys[i] = shape_indices[unique_corners[i]];
+  });
   /// decompress vertex data
-  model.resize(vertex_count);
-  for (const auto &vertex : index_map) {
-    const auto &idx = vertex.first;
+  model.resize(unique_keys.size());
+  // views are taken once, the loop body only writes through them
+  std::optional<hermes::AoSFieldView<hermes::point3>> positions;
+  std::optional<hermes::AoSFieldView<hermes::vec3>> normals, colors;
+  std::optional<hermes::AoSFieldView<hermes::point2>> uvs;
+  if (!data.positions.empty())
+    positions.emplace(model.attributeAccessor<hermes::point3>(position_id));
+  if (!data.normals.empty())
+    normals.emplace(model.attributeAccessor<hermes::vec3>(normal_id));
+  if (!data.colors.empty())
+    colors.emplace(model.attributeAccessor<hermes::vec3>(color_id));
+  if (!data.uvs.empty())
+    uvs.emplace(model.attributeAccessor<hermes::point2>(uv_id));
+  Parallel::forEach(unique_keys.size(), [&](u64 vertex_index) {
+    const auto &idx = unique_keys[vertex_index];
     // add new vertex
-    if (!attrib.vertices.empty())
-      model.attributeValue<hermes::point3>(position_id, vertex.second) = {
-          attrib.vertices[3 * idx.vertex_index + 0],
-          attrib.vertices[3 * idx.vertex_index + 1],
-          attrib.vertices[3 * idx.vertex_index + 2]};
-    if (!attrib.normals.empty())
-      model.attributeValue<hermes::vec3>(normal_id, vertex.second) = {
-          attrib.normals[3 * idx.normal_index + 0],
-          attrib.normals[3 * idx.normal_index + 1],
-          attrib.normals[3 * idx.normal_index + 2]};
-    if (!attrib.colors.empty())
-      model.attributeValue<hermes::vec3>(color_id, vertex.second) = {
-          attrib.colors[3 * idx.vertex_index + 0],
-          attrib.colors[3 * idx.vertex_index + 1],
-          attrib.colors[3 * idx.vertex_index + 2]};
-    if (!attrib.texcoords.empty())
-      model.attributeValue<hermes::vec2>(uv_id, vertex.second) = {
-          attrib.texcoords[2 * idx.uv_index + 0],
-          attrib.texcoords[2 * idx.uv_index + 1]};
-  }
-  // check if we need to generate normals
-  if (!attrib.normals.empty() && normal_id) {
-    std::vector<u8> face_count(attrib.vertices.size() / 3, 0);
-    std::vector<hermes::vec3> normals(attrib.vertices.size() / 3, hermes::vec3());
-    index_offset = 0;
-    for (auto fv : shape.mesh.num_face_vertices) {
-      // loop over vertices in the face
-      hermes::vec3 face_vertices[3];
-      for (u64 v = 0; v < 3; ++v) {
-        auto idx = shape.mesh.indices[index_offset + v];
-        face_vertices[v] = {attrib.vertices[3 * idx.vertex_index + 0],
-                            attrib.vertices[3 * idx.vertex_index + 1],
-                            attrib.vertices[3 * idx.vertex_index + 2]};
-      }
-      auto normal = hermes::cross(face_vertices[1] - face_vertices[0],
-                                 face_vertices[2] - face_vertices[1]);
-      for (u64 v = 0; v < fv; ++v) {
-        auto idx = shape.mesh.indices[index_offset + v];
-        normals[idx.vertex_index] = normal;
-        face_count[idx.vertex_index]++;
+    if (positions)
+      (*positions)[vertex_index] = {
+          data.positions[3 * idx.vertex_index + 0],
+          data.positions[3 * idx.vertex_index + 1],
+          data.positions[3 * idx.vertex_index + 2]};
+    if (normals && idx.normal_index >= 0)
+      (*normals)[vertex_index] = {
+          data.normals[3 * idx.normal_index + 0],
+          data.normals[3 * idx.normal_index + 1],
+          data.normals[3 * idx.normal_index + 2]};
+    if (colors)
+      (*colors)[vertex_index] = {
+          data.colors[3 * idx.vertex_index + 0],
+          data.colors[3 * idx.vertex_index + 1],
+          data.colors[3 * idx.vertex_index + 2]};
+    if (uvs && idx.uv_index >= 0)
+      (*uvs)[vertex_index] = {
+          data.uvs[2 * idx.uv_index + 0],
+          data.uvs[2 * idx.uv_index + 1]};
+  });
+  model.setIndices(std::move(index_data));
+  // generate missing normals (and requested tangent frames)
+  shape_options tangent_space_options = shape_options::none;
+  if (data.normals.empty() && normal_id)
+    tangent_space_options = tangent_space_options | shape_options::normal;
+  if (tangent_id)
+    tangent_space_options = tangent_space_options | shape_options::tangent;
+  if (bitangent_id)
+    tangent_space_options = tangent_space_options | shape_options::bitangent;
+  TangentSpace::generate(model, tangent_space_options);
+  if (mesh_id == all_shapes) {
+    // intersect shapes with material ranges
+    std::vector<Model::SubMesh> sub_meshes;
+    u64 range = 0;
+    for (const auto &shape : data.shapes) {
+      u64 begin = shape.index_offset;
+      const u64 end = shape.index_offset + shape.index_count;
+      while (begin < end) {
+        while (range < data.material_ranges.size() &&
+            data.material_ranges[range].index_offset + data.material_ranges[range].index_count <= begin)
+          range++;
+        i32 material_id = -1;
+        u64 sub_mesh_end = end;
+        if (range < data.material_ranges.size() && data.material_ranges[range].index_offset <= begin) {
+          material_id = data.material_ranges[range].material_id;
+          sub_mesh_end = std::min(end, data.material_ranges[range].index_offset +
+              data.material_ranges[range].index_count);
+        } else if (range < data.material_ranges.size())
+          sub_mesh_end = std::min(end, data.material_ranges[range].index_offset);
+        sub_meshes.push_back({shape.name, begin - first_corner, sub_mesh_end - begin, material_id});
+        begin = sub_mesh_end;
       }
-      index_offset += fv;
     }
-    // store normals
-    for (const auto &vertex : index_map)
-      model.attributeValue<hermes::vec3>(normal_id, vertex.second) =
-          hermes::normalize(normals[vertex.first.vertex_index]);// / (f32) face_count[vertex.second]);
+    model.setSubMeshes(std::move(sub_meshes));
   }
-  model.setIndices(std::move(index_data));
+  if (testMaskBit(options, shape_options::optimize)) {
+    auto report = MeshOptimizer::optimize(model);
+    hermes::Log::info("readOBJ: optimized mesh ACMR {} -> {}, ATVR {} -> {}",
+                      report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr);
+  }
+  return model;
+}
+
+Model io::readPLY(const hermes::Path &path, u64 chunk_size) {
+  Model model;
+  PlyReader reader(path);
+  if (!reader.good())
+    return model;
+  for (const auto &attribute : reader.vertexAttributes()) {
+    if (attribute.name == "position")
+      model.pushAttribute<hermes::point3>(attribute.name);
+    else if (attribute.component_count == 3)
+      model.pushAttribute<hermes::vec3>(attribute.name);
+    else
+      model.pushAttribute<f32>(attribute.name);
+  }
+  model.setPrimitiveType(hermes::GeometricPrimitiveType::POINTS);
+  if (model.vertexDescriptor().sizeInBytes() != reader.vertexComponentCount() * sizeof(f32)) {
+    hermes::Log::error("readPLY: unexpected vertex layout.");
+    return Model();
+  }
+  model.resize(reader.vertexCount());
+  if (!reader.vertexCount())
+    return model;
+  // position is the first attribute, converted records match the model layout
+  auto *vertices = reinterpret_cast<f32 *>(&model.attributeValue<hermes::point3>(0, 0));
+  if (!reader.readVertices(vertices, chunk_size))
+    return Model();
+  // no index buffer (4 bytes per point), points are drawn non-indexed
   return model;
 }
 
+Model io::readGLTF(const hermes::Path &path, u32 mesh_id) {
+  GltfReader reader(path);
+  if (!reader.good())
+    return Model();
+  if (mesh_id >= reader.meshes().size()) {
+    hermes::Log::error("readGLTF: mesh not found!");
+    return Model();
+  }
+  return reader.readMesh(mesh_id);
+}
+
 }
@@ -31,18 +31,61 @@
 
 #include <circe/scene/model.h>
 #include <circe/scene/shapes.h>
+#include <circe/io/obj_parser.h>
+#include <circe/io/ply_reader.h>
+#include <circe/io/gltf_reader.h>
 #include <hermes/common/file_system.h>
 
 namespace circe {
 
+/// Parsing engines available for OBJ files
+enum class obj_parsing_engine {
+  native, //!< memory mapped, multi-threaded ObjParser
+  tinyobj //!< single-threaded tinyobjloader (reference implementation)
+};
+
 class io {
 public:
+  /// mesh_id value that merges all shapes of an OBJ file into a single model.
+  /// Shapes share one vertex/index block and are recorded as sub-meshes
+  /// (split further where materials change).
+  static constexpr u32 all_shapes = ~0u;
   ///
   /// \param path
   /// \param options
-  /// \param mesh_id
+  /// \param mesh_id shape index or all_shapes
+  /// \param engine parser used to read the file
   /// \return
-  static Model readOBJ(const hermes::Path &path, shape_options options = shape_options::none, u32 mesh_id = 0);
+  static Model readOBJ(const hermes::Path &path, shape_options options = shape_options::none, u32 mesh_id = 0,
+                       obj_parsing_engine engine = obj_parsing_engine::native);
+  /// Reads raw OBJ contents
+  /// \param path
+  /// \param data **[out]**
+  /// \param engine parser used to read the file
+  /// \return true if success
+  static bool readOBJ(const hermes::Path &path, ObjData &data,
+                      obj_parsing_engine engine = obj_parsing_engine::native);
+  /// Builds a model from a shape of parsed OBJ contents
+  /// \param data
+  /// \param options
+  /// \param mesh_id shape index or all_shapes
+  /// \return
+  static Model fromOBJData(const ObjData &data, shape_options options = shape_options::none, u32 mesh_id = 0);
+  /// Reads the vertices of a PLY file (ascii or binary) as a point cloud.
+  /// Vertices are streamed in chunks straight into the model storage, see
+  /// PlyReader for the attribute layout. Use PlyReader directly to stream
+  /// into caller buffers.
+  /// \param path
+  /// \param chunk_size number of vertices converted at a time
+  /// \return model with POINTS primitive and no indices (empty on failure)
+  static Model readPLY(const hermes::Path &path, u64 chunk_size = PlyReader::default_chunk_size);
+  /// Reads a mesh of a glTF 2.0 file (.gltf or .glb). Interleaved float
+  /// vertex data of mapped buffers is referenced in place, see GltfReader
+  /// for the node hierarchy and raw vertex streams.
+  /// \param path
+  /// \param mesh_id mesh index
+  /// \return model with all primitives of the mesh (empty on failure)
+  static Model readGLTF(const hermes::Path &path, u32 mesh_id = 0);
 };
 
 }
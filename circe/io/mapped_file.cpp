@@ -0,0 +1,162 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file mapped_file.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-10
+///
+///\brief
+
+#include <circe/io/mapped_file.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace circe {
+
+MappedFile::MappedFile() = default;
+
+MappedFile::MappedFile(const hermes::Path &path) {
+  open(path);
+}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+  *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this == &other)
+    return *this;
+  close();
+  data_ = other.data_;
+  size_ = other.size_;
+  is_open_ = other.is_open_;
+#ifdef _WIN32
+  file_handle_ = other.file_handle_;
+  mapping_handle_ = other.mapping_handle_;
+  other.file_handle_ = nullptr;
+  other.mapping_handle_ = nullptr;
+#else
+  fd_ = other.fd_;
+  other.fd_ = -1;
+#endif
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.is_open_ = false;
+  return *this;
+}
+
+bool MappedFile::open(const hermes::Path &path) {
+  close();
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.fullName().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    hermes::Log::error("MappedFile: could not open {}.", path.fullName());
+    return false;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    hermes::Log::error("MappedFile: could not stat {}.", path.fullName());
+    return false;
+  }
+  file_handle_ = file;
+  size_ = static_cast<u64>(file_size.QuadPart);
+  is_open_ = true;
+  if (!size_)
+    return true;
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    hermes::Log::error("MappedFile: could not map {}.", path.fullName());
+    close();
+    return false;
+  }
+  mapping_handle_ = mapping;
+  data_ = reinterpret_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+  fd_ = ::open(path.fullName().c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    hermes::Log::error("MappedFile: could not open {}.", path.fullName());
+    return false;
+  }
+  struct stat file_stat{};
+  if (fstat(fd_, &file_stat) != 0) {
+    hermes::Log::error("MappedFile: could not stat {}.", path.fullName());
+    close();
+    return false;
+  }
+  size_ = static_cast<u64>(file_stat.st_size);
+  is_open_ = true;
+  if (!size_)
+    return true;
+  void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (mapped != MAP_FAILED)
+    data_ = reinterpret_cast<const char *>(mapped);
+#endif
+  if (!data_) {
+    hermes::Log::error("MappedFile: could not map {}.", path.fullName());
+    close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+  if (data_)
+    UnmapViewOfFile(data_);
+  if (mapping_handle_)
+    CloseHandle(reinterpret_cast<HANDLE>(mapping_handle_));
+  if (file_handle_)
+    CloseHandle(reinterpret_cast<HANDLE>(file_handle_));
+  mapping_handle_ = nullptr;
+  file_handle_ = nullptr;
+#else
+  if (data_)
+    munmap(const_cast<char *>(data_), size_);
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  is_open_ = false;
+}
+
+void MappedFile::adviseSequential() const {
+#ifndef _WIN32
+  if (data_)
+    madvise(const_cast<char *>(data_), size_, MADV_SEQUENTIAL);
+#endif
+}
+
+}
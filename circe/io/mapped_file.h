@@ -0,0 +1,86 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file mapped_file.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-10
+///
+///\brief Read-only memory mapped files
+
+#ifndef CIRCE_CIRCE_IO_MAPPED_FILE_H
+#define CIRCE_CIRCE_IO_MAPPED_FILE_H
+
+#include <hermes/common/file_system.h>
+
+namespace circe {
+
+/// Maps a whole file into the process address space (read-only).
+/// Pages are loaded lazily by the OS, so huge files can be traversed without
+/// reading them into memory first.
+///
+/// Notes:
+/// - This class uses RAII. The mapping is released on destruction.
+class MappedFile final {
+public:
+  // ***********************************************************************
+  //                           CONSTRUCTORS
+  // ***********************************************************************
+  MappedFile();
+  /// \param path file path
+  explicit MappedFile(const hermes::Path &path);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+  // ***********************************************************************
+  //                             METHODS
+  // ***********************************************************************
+  /// Maps file contents (any previous mapping is released)
+  /// \param path file path
+  /// \return true if success
+  bool open(const hermes::Path &path);
+  /// Releases mapping
+  void close();
+  /// \return true if a file is currently mapped
+  [[nodiscard]] bool good() const { return data_ != nullptr || (is_open_ && size_ == 0); }
+  /// \return pointer to the first byte of the file
+  [[nodiscard]] const char *data() const { return data_; }
+  /// \return file size in bytes
+  [[nodiscard]] u64 size() const { return size_; }
+  /// Hints the OS that the file will be read sequentially
+  void adviseSequential() const;
+
+private:
+  const char *data_{nullptr};
+  u64 size_{0};
+  bool is_open_{false};
+#ifdef _WIN32
+  void *file_handle_{nullptr};
+  void *mapping_handle_{nullptr};
+#else
+  int fd_{-1};
+#endif
+};
+
+}
+
+#endif //CIRCE_CIRCE_IO_MAPPED_FILE_H
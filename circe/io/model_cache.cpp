@@ -0,0 +1,467 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file model_cache.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-12
+///
+///\brief
+
+#include <circe/io/model_cache.h>
+#include <circe/io/mapped_file.h>
+#include <circe/common/parallel.h>
+#include <circe/scene/vertex_welder.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+namespace circe {
+
+namespace {
+
+constexpr char file_magic[8] = {'C', 'I', 'R', 'C', 'E', 'M', 'D', 'L'};
+constexpr u32 byte_order_mark = 0x01020304;
+constexpr u64 block_alignment = 64;
+
+struct FileHeader {
+  char magic[8];
+  u32 version;
+  u32 byte_order;
+  u32 primitive_type;
+  u32 field_count;
+  u64 vertex_count;
+  u64 vertex_size;
+  u64 index_count;
+  u64 descriptor_offset;
+  u64 vertex_offset;
+  u64 index_offset;
+  u64 file_size;
+  // source key (zero for containers written with ModelCache::write)
+  u64 source_size;
+  i64 source_mtime;
+  u64 source_hash;
+  u64 source_options;
+  u64 source_path_size;
+  u64 sub_mesh_count;
+  u64 level_of_detail_count;
+};
+
+/// Followed by name_size bytes, padded to 8 bytes
+struct FieldRecord {
+  u32 type;
+  u32 component_count;
+  u64 size;
+  u64 offset;
+  u64 name_size;
+};
+
+/// Followed by name_size bytes, padded to 8 bytes
+struct SubMeshRecord {
+  u64 index_offset;
+  u64 index_count;
+  i64 material_id;
+  u64 name_size;
+};
+
+struct LevelOfDetailRecord {
+  u64 index_offset;
+  u64 index_count;
+  f64 error;
+};
+
+/// Index ranges stored in the container
+struct IndexRanges {
+  std::vector<Model::SubMesh> sub_meshes;
+  std::vector<Model::LevelOfDetail> levels_of_detail;
+};
+
+struct SourceKey {
+  u64 size{0};
+  i64 mtime{0};
+  u64 hash{0};
+  u64 options{0};
+  std::string path;
+};
+
+u64 alignUp(u64 value, u64 alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+/// \return canonical form of path (path itself if it can not be resolved)
+std::string canonicalPath(const hermes::Path &path) {
+  std::error_code error;
+  auto canonical_path = std::filesystem::weakly_canonical(std::filesystem::path(path.fullName()), error);
+  return error ? path.fullName() : canonical_path.string();
+}
+
+bool sourceKey(const hermes::Path &source, shape_options options, SourceKey &key) {
+  std::error_code error;
+  std::filesystem::path source_path(source.fullName());
+  key.size = std::filesystem::file_size(source_path, error);
+  if (error)
+    return false;
+  key.mtime = static_cast<i64>(std::filesystem::last_write_time(source_path, error).time_since_epoch().count());
+  if (error)
+    return false;
+  key.path = canonicalPath(source);
+  key.options = static_cast<u64>(options);
+  return true;
+}
+
+/// Appends a field to descriptor, returns false if the layout is not supported
+bool pushField(hermes::StructDescriptor &descriptor, const std::string &name,
+               hermes::DataType type, u32 component_count) {
+#define ADD_FIELD(D, C, T) \
+  if(type == D && component_count == C) { \
+    descriptor.pushField<T>(name);         \
+    return true;                           \
+  }
+  ADD_FIELD(hermes::DataType::F32, 1, f32)
+  ADD_FIELD(hermes::DataType::F32, 2, hermes::vec2f)
+  ADD_FIELD(hermes::DataType::F32, 3, hermes::vec3f)
+  ADD_FIELD(hermes::DataType::I32, 1, i32)
+  ADD_FIELD(hermes::DataType::U32, 1, u32)
+#undef ADD_FIELD
+  return false;
+}
+
+/// Checks if descriptor can be rebuilt from its fields
+bool supportedDescriptor(const hermes::StructDescriptor &descriptor) {
+  hermes::StructDescriptor rebuilt;
+  for (const auto &field : descriptor.fields())
+    if (!pushField(rebuilt, field.name, field.type, field.component_count))
+      return false;
+  if (rebuilt.sizeInBytes() != descriptor.sizeInBytes())
+    return false;
+  for (u64 i = 0; i < descriptor.fields().size(); ++i)
+    if (rebuilt.fields()[i].offset != descriptor.fields()[i].offset)
+      return false;
+  return true;
+}
+
+bool writeFile(const hermes::Path &path, const Model &model, const SourceKey &key) {
+  const auto &descriptor = model.vertexDescriptor();
+  if (!supportedDescriptor(descriptor)) {
+    hermes::Log::warn("ModelCache: unsupported vertex layout, {} not written.", path.fullName());
+    return false;
+  }
+  FileHeader header{};
+  std::memcpy(header.magic, file_magic, sizeof(file_magic));
+  header.version = ModelCache::version;
+  header.byte_order = byte_order_mark;
+  header.primitive_type = static_cast<u32>(model.primitiveType());
+  header.field_count = descriptor.fields().size();
+  header.vertex_count = model.vertexCount();
+  header.vertex_size = descriptor.sizeInBytes();
+  header.index_count = model.indexCount();
+  header.descriptor_offset = sizeof(FileHeader);
+  u64 offset = header.descriptor_offset;
+  for (const auto &field : descriptor.fields())
+    offset += sizeof(FieldRecord) + alignUp(field.name.size(), 8);
+  for (const auto &sub_mesh : model.subMeshes())
+    offset += sizeof(SubMeshRecord) + alignUp(sub_mesh.name.size(), 8);
+  offset += model.levelsOfDetail().size() * sizeof(LevelOfDetailRecord);
+  offset += alignUp(key.path.size(), 8);
+  header.vertex_offset = alignUp(offset, block_alignment);
+  header.index_offset = alignUp(header.vertex_offset + header.vertex_count * header.vertex_size, block_alignment);
+  header.file_size = header.index_offset + header.index_count * sizeof(i32);
+  header.source_size = key.size;
+  header.source_mtime = key.mtime;
+  header.source_hash = key.hash;
+  header.source_options = key.options;
+  header.source_path_size = key.path.size();
+  header.sub_mesh_count = model.subMeshes().size();
+  header.level_of_detail_count = model.levelsOfDetail().size();
+
+  // write into a temporary file first, so readers never see partial files
+  const std::string tmp_path = path.fullName() + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!file.good()) {
+      hermes::Log::warn("ModelCache: could not create {}.", tmp_path);
+      return false;
+    }
+    const char zeros[block_alignment] = {};
+    auto pad = [&](u64 target) {
+      u64 position = static_cast<u64>(file.tellp());
+      if (target > position)
+        file.write(zeros, target - position);
+    };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(FileHeader));
+    for (const auto &field : descriptor.fields()) {
+      FieldRecord record{static_cast<u32>(field.type), static_cast<u32>(field.component_count),
+                         field.size, field.offset, field.name.size()};
+      file.write(reinterpret_cast<const char *>(&record), sizeof(FieldRecord));
+      file.write(field.name.data(), field.name.size());
+      pad(alignUp(static_cast<u64>(file.tellp()), 8));
+    }
+    for (const auto &sub_mesh : model.subMeshes()) {
+      SubMeshRecord record{sub_mesh.index_offset, sub_mesh.index_count, sub_mesh.material_id, sub_mesh.name.size()};
+      file.write(reinterpret_cast<const char *>(&record), sizeof(SubMeshRecord));
+      file.write(sub_mesh.name.data(), sub_mesh.name.size());
+      pad(alignUp(static_cast<u64>(file.tellp()), 8));
+    }
+    for (const auto &level : model.levelsOfDetail()) {
+      LevelOfDetailRecord record{level.index_offset, level.index_count, level.error};
+      file.write(reinterpret_cast<const char *>(&record), sizeof(LevelOfDetailRecord));
+    }
+    file.write(key.path.data(), key.path.size());
+    pad(header.vertex_offset);
+    if (model.vertexData())
+      file.write(reinterpret_cast<const char *>(model.vertexData()), header.vertex_count * header.vertex_size);
+    else {
+      // separate attribute arrays are interleaved into the vertex block
+      std::vector<u8> vertex_block(header.vertex_count * header.vertex_size);
+      model.copyVertexData(vertex_block.data());
+      file.write(reinterpret_cast<const char *>(vertex_block.data()), vertex_block.size());
+    }
+    pad(header.index_offset);
+    file.write(reinterpret_cast<const char *>(model.indexData()), header.index_count * sizeof(i32));
+    if (!file.good()) {
+      hermes::Log::warn("ModelCache: failed to write {}.", tmp_path);
+      file.close();
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(tmp_path, path.fullName(), error);
+  if (error) {
+    hermes::Log::warn("ModelCache: could not move {} to {}.", tmp_path, path.fullName());
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+/// Validates the mapped container and rebuilds its vertex descriptor
+bool parseFile(const MappedFile &file, FileHeader &header, hermes::StructDescriptor &descriptor,
+               IndexRanges &ranges, std::string &source_path) {
+  if (file.size() < sizeof(FileHeader))
+    return false;
+  std::memcpy(&header, file.data(), sizeof(FileHeader));
+  if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+      header.version != ModelCache::version ||
+      header.byte_order != byte_order_mark ||
+      header.file_size != file.size() ||
+      header.primitive_type > static_cast<u32>(hermes::GeometricPrimitiveType::CUSTOM))
+    return false;
+  // records are read at offset, which may be past the end of the file
+  // (corrupt offsets, name padding), so sizes are compared with what is left
+  u64 offset = header.descriptor_offset;
+  auto fits = [&](u64 size) { return offset <= file.size() && size <= file.size() - offset; };
+  // field records
+  for (u32 i = 0; i < header.field_count; ++i) {
+    if (!fits(sizeof(FieldRecord)))
+      return false;
+    FieldRecord record{};
+    std::memcpy(&record, file.data() + offset, sizeof(FieldRecord));
+    offset += sizeof(FieldRecord);
+    if (!fits(record.name_size))
+      return false;
+    std::string name(file.data() + offset, record.name_size);
+    offset += alignUp(record.name_size, 8);
+    if (!pushField(descriptor, name, static_cast<hermes::DataType>(record.type), record.component_count) ||
+        descriptor.fields().back().offset != record.offset || descriptor.fields().back().size != record.size)
+      return false;
+  }
+  if (descriptor.sizeInBytes() != header.vertex_size)
+    return false;
+  // sub-mesh records
+  for (u64 i = 0; i < header.sub_mesh_count; ++i) {
+    if (!fits(sizeof(SubMeshRecord)))
+      return false;
+    SubMeshRecord record{};
+    std::memcpy(&record, file.data() + offset, sizeof(SubMeshRecord));
+    offset += sizeof(SubMeshRecord);
+    if (!fits(record.name_size) || record.index_offset > header.index_count ||
+        record.index_count > header.index_count - record.index_offset)
+      return false;
+    ranges.sub_meshes.push_back({std::string(file.data() + offset, record.name_size),
+                          record.index_offset, record.index_count, static_cast<i32>(record.material_id)});
+    offset += alignUp(record.name_size, 8);
+  }
+  // level of detail records
+  for (u64 i = 0; i < header.level_of_detail_count; ++i) {
+    if (!fits(sizeof(LevelOfDetailRecord)))
+      return false;
+    LevelOfDetailRecord record{};
+    std::memcpy(&record, file.data() + offset, sizeof(LevelOfDetailRecord));
+    offset += sizeof(LevelOfDetailRecord);
+    if (record.index_offset > header.index_count || record.index_count > header.index_count - record.index_offset)
+      return false;
+    ranges.levels_of_detail.push_back({record.index_offset, record.index_count, static_cast<f32>(record.error)});
+  }
+  if (!fits(header.source_path_size))
+    return false;
+  source_path.assign(file.data() + offset, header.source_path_size);
+  // data blocks
+  if (header.vertex_offset % block_alignment || header.index_offset % sizeof(i32) ||
+      header.vertex_offset > file.size() || header.index_offset > file.size())
+    return false;
+  if (header.vertex_size && header.vertex_count > (file.size() - header.vertex_offset) / header.vertex_size)
+    return false;
+  if (header.index_count > (file.size() - header.index_offset) / sizeof(i32))
+    return false;
+  return true;
+}
+
+Model modelFromMapping(const std::shared_ptr<MappedFile> &file, const FileHeader &header,
+                       const hermes::StructDescriptor &descriptor, IndexRanges &ranges) {
+  Model model;
+  model.setExternalData(descriptor,
+                        file->data() + header.vertex_offset, header.vertex_count,
+                        header.index_count ? reinterpret_cast<const i32 *>(file->data() + header.index_offset)
+                                           : nullptr,
+                        header.index_count, file);
+  model.setPrimitiveType(static_cast<hermes::GeometricPrimitiveType>(header.primitive_type));
+  model.setSubMeshes(std::move(ranges.sub_meshes));
+  model.setLevelsOfDetail(std::move(ranges.levels_of_detail));
+  return model;
+}
+
+std::atomic<bool> &sidecarEnabledRef() {
+  static std::atomic<bool> enabled{false};
+  return enabled;
+}
+
+std::mutex &cacheDirectoryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::string &cacheDirectoryRef() {
+  static std::string directory;
+  return directory;
+}
+
+}
+
+bool ModelCache::write(const hermes::Path &path, const Model &model) {
+  return writeFile(path, model, SourceKey());
+}
+
+Model ModelCache::read(const hermes::Path &path) {
+  auto file = std::make_shared<MappedFile>();
+  if (!file->open(path))
+    return Model();
+  FileHeader header{};
+  hermes::StructDescriptor descriptor;
+  IndexRanges ranges;
+  std::string source_path;
+  if (!parseFile(*file, header, descriptor, ranges, source_path)) {
+    hermes::Log::error("ModelCache: invalid model file {}.", path.fullName());
+    return Model();
+  }
+  return modelFromMapping(file, header, descriptor, ranges);
+}
+
+Model ModelCache::load(const hermes::Path &source, shape_options options, const Loader &loader) {
+  SourceKey key;
+  if (!sidecarEnabled() || !sourceKey(source, options, key))
+    return loader(source, options);
+  const hermes::Path cache_path = sidecarPath(source);
+  std::error_code error;
+  if (std::filesystem::exists(cache_path.fullName(), error)) {
+    auto file = std::make_shared<MappedFile>();
+    FileHeader header{};
+    hermes::StructDescriptor descriptor;
+    IndexRanges ranges;
+    std::string source_path;
+    if (file->open(cache_path) && parseFile(*file, header, descriptor, ranges, source_path) &&
+        header.source_size == key.size && header.source_options == key.options && source_path == key.path) {
+      if (header.source_mtime == key.mtime)
+        return modelFromMapping(file, header, descriptor, ranges);
+      // the source was touched, check if its contents are still the same
+      key.hash = contentHash(source);
+      if (key.hash && key.hash == header.source_hash) {
+        // the mapped file is never written: a fresh copy with the new key
+        // replaces it (the mapping keeps reading the old one)
+        Model model = modelFromMapping(file, header, descriptor, ranges);
+        writeFile(cache_path, model, key);
+        return model;
+      }
+    }
+  }
+  // cache miss
+  Model model = loader(source, options);
+  if (!model.vertexCount())
+    return model;
+  if (!key.hash)
+    key.hash = contentHash(source);
+  const std::string directory = cacheDirectory();
+  if (!directory.empty())
+    std::filesystem::create_directories(directory, error);
+  writeFile(cache_path, model, key);
+  return model;
+}
+
+hermes::Path ModelCache::sidecarPath(const hermes::Path &source) {
+  const std::string directory = cacheDirectory();
+  if (directory.empty())
+    return hermes::Path(source.fullName() + "." + extension);
+  // sources with the same name in different directories get different files
+  const std::string key_path = canonicalPath(source);
+  char hash[17];
+  std::snprintf(hash, sizeof(hash), "%016llx",
+                static_cast<unsigned long long>(VertexWelder::hash(key_path.data(), key_path.size())));
+  const auto file_name = std::filesystem::path(source.fullName()).filename().string() + "-" + hash + "." + extension;
+  return hermes::Path((std::filesystem::path(directory) / file_name).string());
+}
+
+u64 ModelCache::contentHash(const hermes::Path &path) {
+  MappedFile file;
+  if (!file.open(path))
+    return 0;
+  file.adviseSequential();
+  constexpr u64 block_size = 1u << 22;
+  const u64 block_count = (file.size() + block_size - 1) / block_size;
+  std::vector<u64> block_hashes(block_count + 1, file.size());
+  Parallel::forEach(block_count, [&](u64 block) {
+    const u64 begin = block * block_size;
+    block_hashes[block] = VertexWelder::hash(file.data() + begin, std::min(block_size, file.size() - begin));
+  }, 1);
+  // 0 is reserved for failures
+  return std::max<u64>(1, VertexWelder::hash(block_hashes.data(), block_hashes.size() * sizeof(u64)));
+}
+
+void ModelCache::setSidecarEnabled(bool enabled) {
+  sidecarEnabledRef() = enabled;
+}
+
+bool ModelCache::sidecarEnabled() {
+  return sidecarEnabledRef();
+}
+
+void ModelCache::setCacheDirectory(const hermes::Path &directory) {
+  std::lock_guard<std::mutex> lock(cacheDirectoryMutex());
+  cacheDirectoryRef() = directory.fullName();
+}
+
+std::string ModelCache::cacheDirectory() {
+  std::lock_guard<std::mutex> lock(cacheDirectoryMutex());
+  return cacheDirectoryRef();
+}
+
+}
@@ -0,0 +1,105 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file model_cache.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-12
+///
+///\brief Binary model container and sidecar cache
+
+#ifndef CIRCE_CIRCE_IO_MODEL_CACHE_H
+#define CIRCE_CIRCE_IO_MODEL_CACHE_H
+
+#include <circe/scene/model.h>
+#include <functional>
+#include <string>
+
+namespace circe {
+
+/// Versioned binary container for circe::Model.
+/// The file stores the vertex struct descriptor, the interleaved vertex block,
+/// the indices, the sub-meshes and the primitive type. Vertex and index blocks are 64-byte
+/// aligned, so read() maps the file and lets the model reference them in place.
+///
+/// Layout:
+///   header | field records | sub-mesh records | lod records | source path | vertex block | index block
+///
+/// Sidecar caches (see load) are opt-in (see setSidecarEnabled). They live
+/// in the cache directory (<directory>/<source name>-<path hash>.cmodel) or,
+/// if no directory is set, next to their source files (<source>.cmodel).
+/// They are keyed by source path, size, modification time, load options and
+/// a content hash of the source. Mapped files are never written: stale
+/// caches are replaced by new files.
+///
+/// Notes:
+/// - Files are written in native byte order; files with different byte order
+///   or version are rejected.
+/// - Only attribute layouts that Model can rebuild are supported (f32 scalars,
+///   2 and 3 component f32 vectors, i32/u32 scalars).
+class ModelCache final {
+public:
+  /// Builds a model from a source file
+  using Loader = std::function<Model(const hermes::Path &, shape_options)>;
+  /// Writes model into a binary container
+  /// \param path output file
+  /// \param model
+  /// \return true if success
+  static bool write(const hermes::Path &path, const Model &model);
+  /// Maps a binary container. The returned model references the mapped
+  /// file (no vertex/index data is copied).
+  /// \param path
+  /// \return empty model on failure
+  static Model read(const hermes::Path &path);
+  /// Loads source through its sidecar cache. On a cache miss (missing or
+  /// stale sidecar) loader is used and a new sidecar is written.
+  /// A sidecar with the same source size, but different modification time, is
+  /// validated by the source content hash.
+  /// \param source source file path
+  /// \param options options passed to loader (part of the cache key)
+  /// \param loader
+  /// \return
+  static Model load(const hermes::Path &source, shape_options options, const Loader &loader);
+  /// \param source
+  /// \return sidecar cache path of source (depends on cacheDirectory())
+  static hermes::Path sidecarPath(const hermes::Path &source);
+  /// Computes a 64-bit hash of the file contents (in parallel)
+  /// \param path
+  /// \return 0 if file could not be read
+  static u64 contentHash(const hermes::Path &path);
+  /// Enables/disables sidecar caches (disabled by default). When disabled,
+  /// load() just calls the loader.
+  /// \param enabled
+  static void setSidecarEnabled(bool enabled);
+  /// \return
+  static bool sidecarEnabled();
+  /// Sets where sidecar caches are written (created on demand)
+  /// \param directory empty path puts caches next to their sources
+  static void setCacheDirectory(const hermes::Path &directory);
+  /// \return sidecar cache directory (empty if caches live next to sources)
+  static std::string cacheDirectory();
+
+  static constexpr u32 version = 3;
+  static constexpr const char *extension = "cmodel";
+};
+
+}
+
+#endif //CIRCE_CIRCE_IO_MODEL_CACHE_H
@@ -0,0 +1,284 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file obj_parser.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-10
+///
+///\brief
+
+#include <circe/io/obj_parser.h>
+#include <circe/io/mapped_file.h>
+#include <circe/io/text_parsing.h>
+#include <circe/common/parallel.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace circe {
+
+namespace {
+
+/// Statements that split faces into shapes
+struct ObjEvent {
+  u64 corner{0};        //!< first corner after the statement
+  bool material{false}; //!< usemtl (true) or o/g (false)
+  std::string name;
+};
+
+/// Parsing output of a range of lines
+struct ObjChunk {
+  std::vector<f32> positions;
+  std::vector<f32> normals;
+  std::vector<f32> uvs;
+  std::vector<f32> colors;
+  std::vector<ObjIndex> indices;
+  /// index components that still hold chunk-relative values (corner * 3 + component)
+  std::vector<u64> relative_slots;
+  /// o/g and usemtl statements in file order
+  std::vector<ObjEvent> events;
+  bool has_colors{false};
+};
+
+/// Converts a raw obj index into a 0-based index
+/// \param raw index as written in the file (1-based or negative)
+/// \param element_count number of elements parsed so far in the chunk
+/// \param relative **[out]** set if the result is chunk-relative
+/// \return -1 if raw is invalid
+i32 resolveIndex(i64 raw, u64 element_count, bool &relative) {
+  relative = false;
+  if (raw > 0)
+    // huge indices stay out of bounds instead of wrapping around
+    return static_cast<i32>(std::min<i64>(raw - 1, std::numeric_limits<i32>::max()));
+  if (raw < 0) {
+    relative = true;
+    return static_cast<i32>(std::max<i64>(static_cast<i64>(element_count) + raw, std::numeric_limits<i32>::min()));
+  }
+  return -1;
+}
+
+void parseChunk(const char *begin, const char *end, ObjChunk &chunk) {
+  struct Corner {
+    ObjIndex index;
+    u8 relative_mask{0};
+  };
+  std::vector<Corner> polygon;
+  const char *p = begin;
+  while (p < end) {
+    const char *eol = TextParsing::lineEnd(p, end);
+    TextParsing::skipBlanks(p, eol);
+    if (p + 1 < eol) {
+      const char c0 = p[0];
+      const char c1 = p[1];
+      if (c0 == 'v' && TextParsing::isBlank(c1)) {
+        // v x y z [w | r g b]
+        p += 2;
+        f32 values[6] = {0, 0, 0, 1, 1, 1};
+        u32 count = TextParsing::parseFloats(p, eol, values, 6);
+        if (count == 6 && !chunk.has_colors) {
+          // first colored vertex, previous vertices get the default color
+          chunk.has_colors = true;
+          chunk.colors.resize(chunk.positions.size(), 1.f);
+        }
+        chunk.positions.insert(chunk.positions.end(), values, values + 3);
+        if (chunk.has_colors) {
+          if (count != 6)
+            values[3] = values[4] = values[5] = 1.f;
+          chunk.colors.insert(chunk.colors.end(), values + 3, values + 6);
+        }
+      } else if (c0 == 'v' && c1 == 'n') {
+        p += 2;
+        f32 values[3] = {0, 0, 0};
+        TextParsing::parseFloats(p, eol, values, 3);
+        chunk.normals.insert(chunk.normals.end(), values, values + 3);
+      } else if (c0 == 'v' && c1 == 't') {
+        p += 2;
+        f32 values[2] = {0, 0};
+        TextParsing::parseFloats(p, eol, values, 2);
+        chunk.uvs.insert(chunk.uvs.end(), values, values + 2);
+      } else if (c0 == 'f' && TextParsing::isBlank(c1)) {
+        // f v[/vt][/vn] ...
+        p += 2;
+        polygon.clear();
+        const u64 vertex_count = chunk.positions.size() / 3;
+        const u64 normal_count = chunk.normals.size() / 3;
+        const u64 uv_count = chunk.uvs.size() / 2;
+        while (true) {
+          TextParsing::skipBlanks(p, eol);
+          i64 raw = 0;
+          if (p >= eol || !TextParsing::parseInt(p, eol, raw))
+            break;
+          Corner corner;
+          bool relative = false;
+          corner.index.vertex_index = resolveIndex(raw, vertex_count, relative);
+          corner.relative_mask |= relative ? 1 : 0;
+          if (p < eol && *p == '/') {
+            ++p;
+            if (p < eol && *p != '/' && TextParsing::parseInt(p, eol, raw)) {
+              corner.index.uv_index = resolveIndex(raw, uv_count, relative);
+              corner.relative_mask |= relative ? 4 : 0;
+            }
+            if (p < eol && *p == '/') {
+              ++p;
+              if (TextParsing::parseInt(p, eol, raw)) {
+                corner.index.normal_index = resolveIndex(raw, normal_count, relative);
+                corner.relative_mask |= relative ? 2 : 0;
+              }
+            }
+          }
+          // skip anything left in this corner token
+          while (p < eol && !TextParsing::isBlank(*p))
+            ++p;
+          polygon.emplace_back(corner);
+        }
+        // triangulate as a fan
+        for (u64 i = 1; i + 1 < polygon.size(); ++i)
+          for (u64 k : {static_cast<u64>(0), i, i + 1}) {
+            const u64 slot = chunk.indices.size() * 3;
+            for (u32 component = 0; component < 3; ++component)
+              if (polygon[k].relative_mask & (1u << component))
+                chunk.relative_slots.emplace_back(slot + component);
+            chunk.indices.emplace_back(polygon[k].index);
+          }
+      } else if (((c0 == 'o' || c0 == 'g') && TextParsing::isBlank(c1)) ||
+          (eol - p > 7 && std::memcmp(p, "usemtl", 6) == 0 && TextParsing::isBlank(p[6]))) {
+        const bool material = c0 == 'u';
+        p += material ? 7 : 2;
+        TextParsing::skipBlanks(p, eol);
+        const char *name_end = eol;
+        while (name_end > p && TextParsing::isBlank(*(name_end - 1)))
+          --name_end;
+        chunk.events.push_back({chunk.indices.size(), material, std::string(p, name_end)});
+      }
+    }
+    p = eol + 1;
+  }
+}
+
+}
+
+bool ObjParser::parse(const hermes::Path &path, ObjData &data) {
+  MappedFile file(path);
+  if (!file.good())
+    return false;
+  file.adviseSequential();
+  return parse(file.data(), file.size(), data);
+}
+
+bool ObjParser::parse(const char *text, u64 size, ObjData &data) {
+  data = ObjData();
+  if (!text || !size)
+    return true;
+  const char *end = text + size;
+  // split text into line aligned chunks
+  const u32 chunk_count = std::max<u32>(1, std::min<u64>(size / min_chunk_size, Parallel::threadCount()));
+  std::vector<const char *> bounds = {text};
+  for (u32 i = 1; i < chunk_count; ++i) {
+    const char *split = std::max(text + size / chunk_count * i, bounds.back());
+    split = TextParsing::lineEnd(split, end);
+    bounds.emplace_back(split < end ? split + 1 : end);
+  }
+  bounds.emplace_back(end);
+  // parse chunks
+  std::vector<ObjChunk> chunks(chunk_count);
+  Parallel::forEach(chunk_count, [&](u64 i) {
+    parseChunk(bounds[i], bounds[i + 1], chunks[i]);
+  }, 1);
+  // compute where each chunk goes in the final arrays
+  struct Offsets {
+    u64 positions{0};
+    u64 normals{0};
+    u64 uvs{0};
+    u64 indices{0};
+  };
+  std::vector<Offsets> offsets(chunk_count + 1);
+  bool has_colors = false;
+  for (u32 i = 0; i < chunk_count; ++i) {
+    offsets[i + 1].positions = offsets[i].positions + chunks[i].positions.size();
+    offsets[i + 1].normals = offsets[i].normals + chunks[i].normals.size();
+    offsets[i + 1].uvs = offsets[i].uvs + chunks[i].uvs.size();
+    offsets[i + 1].indices = offsets[i].indices + chunks[i].indices.size();
+    has_colors |= chunks[i].has_colors;
+  }
+  data.positions.resize(offsets[chunk_count].positions);
+  data.normals.resize(offsets[chunk_count].normals);
+  data.uvs.resize(offsets[chunk_count].uvs);
+  data.indices.resize(offsets[chunk_count].indices);
+  if (has_colors)
+    data.colors.resize(data.positions.size());
+  // shapes and material ranges (must be computed before chunks are released)
+  std::string shape_name;
+  u64 shape_start = 0;
+  i32 material_id = -1;
+  u64 material_start = 0;
+  std::unordered_map<std::string, i32> material_ids;
+  for (u32 i = 0; i < chunk_count; ++i)
+    for (const auto &event : chunks[i].events) {
+      u64 event_start = offsets[i].indices + event.corner;
+      if (!event.material) {
+        if (event_start > shape_start)
+          data.shapes.push_back({shape_name, shape_start, event_start - shape_start});
+        shape_name = event.name;
+        shape_start = event_start;
+        continue;
+      }
+      if (event_start > material_start)
+        data.material_ranges.push_back({material_start, event_start - material_start, material_id});
+      auto it = material_ids.find(event.name);
+      if (it == material_ids.end()) {
+        it = material_ids.emplace(event.name, static_cast<i32>(data.materials.size())).first;
+        data.materials.emplace_back(event.name);
+      }
+      material_id = it->second;
+      material_start = event_start;
+    }
+  if (data.indices.size() > shape_start)
+    data.shapes.push_back({shape_name, shape_start, data.indices.size() - shape_start});
+  if (!data.materials.empty() && data.indices.size() > material_start)
+    data.material_ranges.push_back({material_start, data.indices.size() - material_start, material_id});
+  // merge chunks
+  Parallel::forEach(chunk_count, [&](u64 i) {
+    auto &chunk = chunks[i];
+    const auto &offset = offsets[i];
+    std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + offset.positions);
+    std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + offset.normals);
+    std::copy(chunk.uvs.begin(), chunk.uvs.end(), data.uvs.begin() + offset.uvs);
+    if (chunk.has_colors)
+      std::copy(chunk.colors.begin(), chunk.colors.end(), data.colors.begin() + offset.positions);
+    else if (has_colors)
+      std::fill_n(data.colors.begin() + offset.positions, chunk.positions.size(), 1.f);
+    std::copy(chunk.indices.begin(), chunk.indices.end(), data.indices.begin() + offset.indices);
+    // relative indices can now be made absolute
+    const i32 bases[3] = {static_cast<i32>(offset.positions / 3),
+                          static_cast<i32>(offset.normals / 3),
+                          static_cast<i32>(offset.uvs / 2)};
+    for (u64 slot : chunk.relative_slots) {
+      auto &index = data.indices[offset.indices + slot / 3];
+      i32 *components[3] = {&index.vertex_index, &index.normal_index, &index.uv_index};
+      *components[slot % 3] += bases[slot % 3];
+    }
+    chunk = ObjChunk();
+  }, 1);
+  return true;
+}
+
+}
@@ -0,0 +1,95 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file obj_parser.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-10
+///
+///\brief Multi-threaded Wavefront OBJ parser
+
+#ifndef CIRCE_CIRCE_IO_OBJ_PARSER_H
+#define CIRCE_CIRCE_IO_OBJ_PARSER_H
+
+#include <hermes/common/file_system.h>
+#include <string>
+#include <vector>
+
+namespace circe {
+
+/// A face corner of an OBJ file. Each corner references its components
+/// independently (-1 means the component is absent).
+struct ObjIndex {
+  i32 vertex_index{-1};
+  i32 normal_index{-1};
+  i32 uv_index{-1};
+};
+
+/// Raw contents of an OBJ file. Attributes are stored exactly as they appear
+/// in the file and faces are triangulated (3 corners per triangle).
+struct ObjData {
+  /// A shape is a named range of triangle corners (o/g statements)
+  struct Shape {
+    std::string name;
+    u64 index_offset{0}; //!< first corner in indices
+    u64 index_count{0};  //!< number of corners
+  };
+  /// A range of triangle corners that use the same material (usemtl statements)
+  struct MaterialRange {
+    u64 index_offset{0}; //!< first corner in indices
+    u64 index_count{0};  //!< number of corners
+    i32 material_id{-1}; //!< index in materials (-1 if no material is in use)
+  };
+  std::vector<f32> positions; //!< x y z per vertex
+  std::vector<f32> normals;   //!< x y z per normal
+  std::vector<f32> uvs;       //!< u v per texture coordinate
+  std::vector<f32> colors;    //!< r g b per vertex (empty if the file has no vertex colors)
+  std::vector<ObjIndex> indices; //!< triangle corners of all shapes
+  std::vector<Shape> shapes;
+  std::vector<MaterialRange> material_ranges; //!< empty if the file has no usemtl statements
+  std::vector<std::string> materials;         //!< material names (in order of first use)
+};
+
+/// Native OBJ parser.
+/// The file is memory mapped and split into line-aligned chunks that are
+/// parsed concurrently. Per-chunk results are then merged in file order, so
+/// the output is identical to a sequential parse.
+/// Supported statements: v (with optional vertex colors), vn, vt, f, o, g and
+/// usemtl (material libraries are not read).
+/// Polygonal faces are triangulated as fans. Negative (relative) indices are
+/// resolved after the merge.
+class ObjParser final {
+public:
+  /// \param path obj file path
+  /// \param data **[out]** receives file contents
+  /// \return true if success
+  static bool parse(const hermes::Path &path, ObjData &data);
+  /// \param text obj file contents
+  /// \param size text size in bytes
+  /// \param data **[out]** receives file contents
+  /// \return true if success
+  static bool parse(const char *text, u64 size, ObjData &data);
+
+  static constexpr u64 min_chunk_size = 1u << 20; //!< chunks smaller than this are not split
+};
+
+}
+
+#endif //CIRCE_CIRCE_IO_OBJ_PARSER_H
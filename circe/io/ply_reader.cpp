@@ -0,0 +1,533 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file ply_reader.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-13
+///
+///\brief
+
+#include <circe/io/ply_reader.h>
+#include <circe/io/text_parsing.h>
+#include <circe/common/parallel.h>
+#include <atomic>
+#include <cstring>
+#include <sstream>
+
+namespace circe {
+
+namespace {
+
+u64 typeSize(ply_type type) {
+  switch (type) {
+  case ply_type::i8:
+  case ply_type::u8: return 1;
+  case ply_type::i16:
+  case ply_type::u16: return 2;
+  case ply_type::i32:
+  case ply_type::u32:
+  case ply_type::f32: return 4;
+  case ply_type::f64: return 8;
+  default: return 0;
+  }
+}
+
+ply_type typeFromName(const std::string &name) {
+  if (name == "char" || name == "int8") return ply_type::i8;
+  if (name == "uchar" || name == "uint8") return ply_type::u8;
+  if (name == "short" || name == "int16") return ply_type::i16;
+  if (name == "ushort" || name == "uint16") return ply_type::u16;
+  if (name == "int" || name == "int32") return ply_type::i32;
+  if (name == "uint" || name == "uint32") return ply_type::u32;
+  if (name == "float" || name == "float32") return ply_type::f32;
+  if (name == "double" || name == "float64") return ply_type::f64;
+  return ply_type::none;
+}
+
+bool hostIsLittleEndian() {
+  const u16 value = 1;
+  u8 first_byte = 0;
+  std::memcpy(&first_byte, &value, 1);
+  return first_byte == 1;
+}
+
+template<typename T>
+T loadSwapped(const char *p, bool swap) {
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, p, sizeof(T));
+  if (swap)
+    for (u64 i = 0; i < sizeof(T) / 2; ++i)
+      std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+f64 loadValue(const char *p, ply_type type, bool swap) {
+  switch (type) {
+  case ply_type::i8: return static_cast<f64>(static_cast<i8>(*p));
+  case ply_type::u8: return static_cast<f64>(static_cast<u8>(*p));
+  case ply_type::i16: return static_cast<f64>(loadSwapped<i16>(p, swap));
+  case ply_type::u16: return static_cast<f64>(loadSwapped<u16>(p, swap));
+  case ply_type::i32: return static_cast<f64>(loadSwapped<i32>(p, swap));
+  case ply_type::u32: return static_cast<f64>(loadSwapped<u32>(p, swap));
+  case ply_type::f32: return static_cast<f64>(loadSwapped<f32>(p, swap));
+  case ply_type::f64: return loadSwapped<f64>(p, swap);
+  default: return 0;
+  }
+}
+
+}
+
+/// Sequential window over a stream. Only the unconsumed part of the file that
+/// was requested through fill() is kept in memory.
+class PlyReader::Input {
+public:
+  explicit Input(std::ifstream &file) : file_(file) {}
+  /// Makes at least n bytes available (unless the stream ends first)
+  /// \return true if n bytes are available
+  bool fill(u64 n) {
+    if (available() >= n)
+      return true;
+    // move remaining bytes to the front
+    if (begin_) {
+      std::memmove(buffer_.data(), buffer_.data() + begin_, available());
+      end_ -= begin_;
+      begin_ = 0;
+    }
+    if (buffer_.size() < n)
+      buffer_.resize(n);
+    if (!eof_) {
+      file_.read(buffer_.data() + end_, static_cast<std::streamsize>(buffer_.size() - end_));
+      end_ += static_cast<u64>(file_.gcount());
+      eof_ = !file_.good();
+    }
+    return available() >= n;
+  }
+  [[nodiscard]] const char *data() const { return buffer_.data() + begin_; }
+  [[nodiscard]] u64 available() const { return end_ - begin_; }
+  [[nodiscard]] bool eof() const { return eof_; }
+  void consume(u64 n) { begin_ += std::min(n, available()); }
+  /// Finds the next non-blank line, reading more data when needed
+  /// \param offset scan position relative to data(), moved past the line
+  /// \param line_begin receives the line start relative to data()
+  /// \param line_end receives the line end relative to data()
+  /// \return false if there are no more lines
+  bool nextLine(u64 &offset, u64 &line_begin, u64 &line_end) {
+    while (true) {
+      const char *base = data();
+      const u64 size = available();
+      const void *eol = offset < size ? std::memchr(base + offset, '\n', size - offset) : nullptr;
+      if (!eol && !eof_) {
+        fill(size + line_block_size);
+        continue;
+      }
+      if (offset >= size)
+        return false;
+      line_begin = offset;
+      line_end = eol ? static_cast<u64>(static_cast<const char *>(eol) - base) : size;
+      offset = eol ? line_end + 1 : size;
+      const char *p = base + line_begin;
+      TextParsing::skipBlanks(p, base + line_end);
+      if (p != base + line_end)
+        return true;
+    }
+  }
+
+  static constexpr u64 line_block_size = 1u << 16;
+
+private:
+  std::ifstream &file_;
+  std::vector<char> buffer_;
+  u64 begin_{0};
+  u64 end_{0};
+  bool eof_{false};
+};
+
+PlyReader::PlyReader() = default;
+
+PlyReader::PlyReader(const hermes::Path &path) {
+  open(path);
+}
+
+PlyReader::~PlyReader() = default;
+
+bool PlyReader::open(const hermes::Path &path) {
+  good_ = false;
+  elements_.clear();
+  vertex_attributes_.clear();
+  vertex_components_.clear();
+  path_ = path.fullName();
+  if (file_.is_open())
+    file_.close();
+  file_.clear();
+  file_.open(path_, std::ios::binary);
+  if (!file_.good()) {
+    hermes::Log::error("PlyReader: could not open {}.", path_);
+    return false;
+  }
+  good_ = readHeader();
+  return good_;
+}
+
+bool PlyReader::readHeader() {
+  std::string line;
+  auto nextLine = [&]() -> bool {
+    if (!std::getline(file_, line))
+      return false;
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    return true;
+  };
+  if (!nextLine() || line != "ply") {
+    hermes::Log::error("PlyReader: {} is not a ply file.", path_);
+    return false;
+  }
+  bool has_format = false;
+  while (true) {
+    if (!nextLine()) {
+      hermes::Log::error("PlyReader: unexpected end of header in {}.", path_);
+      return false;
+    }
+    std::istringstream tokens(line);
+    std::string keyword;
+    tokens >> keyword;
+    if (keyword == "end_header")
+      break;
+    if (keyword == "format") {
+      std::string format;
+      tokens >> format;
+      if (format == "ascii")
+        format_ = ply_format::ascii;
+      else if (format == "binary_little_endian")
+        format_ = ply_format::binary_little_endian;
+      else if (format == "binary_big_endian")
+        format_ = ply_format::binary_big_endian;
+      else {
+        hermes::Log::error("PlyReader: unknown format {} in {}.", format, path_);
+        return false;
+      }
+      has_format = true;
+    } else if (keyword == "element") {
+      Element element;
+      tokens >> element.name >> element.count;
+      elements_.emplace_back(element);
+    } else if (keyword == "property") {
+      if (elements_.empty()) {
+        hermes::Log::error("PlyReader: property without element in {}.", path_);
+        return false;
+      }
+      Property property;
+      std::string type;
+      tokens >> type;
+      if (type == "list") {
+        std::string count_type, item_type;
+        tokens >> count_type >> item_type;
+        property.count_type = typeFromName(count_type);
+        property.type = typeFromName(item_type);
+        if (property.count_type == ply_type::none || property.count_type == ply_type::f32 ||
+            property.count_type == ply_type::f64) {
+          hermes::Log::error("PlyReader: invalid list size type {} in {}.", count_type, path_);
+          return false;
+        }
+      } else
+        property.type = typeFromName(type);
+      tokens >> property.name;
+      if (property.type == ply_type::none) {
+        hermes::Log::error("PlyReader: unknown property type in '{}' ({}).", line, path_);
+        return false;
+      }
+      elements_.back().properties.emplace_back(property);
+    }
+    // comment, obj_info and unknown keywords are ignored
+  }
+  if (!has_format) {
+    hermes::Log::error("PlyReader: missing format in {}.", path_);
+    return false;
+  }
+  data_offset_ = static_cast<u64>(file_.tellg());
+  // vertex layout
+  vertex_element_ = elements_.size();
+  for (u64 i = 0; i < elements_.size(); ++i)
+    if (elements_[i].name == "vertex") {
+      vertex_element_ = i;
+      break;
+    }
+  if (vertex_element_ == elements_.size())
+    return true;
+  const auto &properties = elements_[vertex_element_].properties;
+  std::vector<bool> used(properties.size(), false);
+  auto find = [&](const char *name) -> u64 {
+    for (u64 i = 0; i < properties.size(); ++i)
+      if (properties[i].name == name && properties[i].count_type == ply_type::none)
+        return i;
+    return properties.size();
+  };
+  auto pushAttribute = [&](const char *attribute_name, std::initializer_list<const char *> names,
+                           bool normalize) -> bool {
+    std::vector<u64> ids;
+    for (auto name : names) {
+      ids.emplace_back(find(name));
+      if (ids.back() == properties.size())
+        return false;
+    }
+    vertex_attributes_.push_back({attribute_name, static_cast<u32>(ids.size())});
+    for (auto id : ids) {
+      f32 scale = 1;
+      if (normalize && properties[id].type == ply_type::u8)
+        scale = 1.f / 255.f;
+      else if (normalize && properties[id].type == ply_type::u16)
+        scale = 1.f / 65535.f;
+      vertex_components_.push_back({id, scale});
+      used[id] = true;
+    }
+    return true;
+  };
+  if (!pushAttribute("position", {"x", "y", "z"}, false)) {
+    hermes::Log::error("PlyReader: vertex element without x y z properties in {}.", path_);
+    return false;
+  }
+  pushAttribute("normal", {"nx", "ny", "nz"}, false);
+  pushAttribute("color", {"red", "green", "blue"}, true);
+  for (u64 i = 0; i < properties.size(); ++i)
+    if (!used[i] && properties[i].count_type == ply_type::none) {
+      vertex_attributes_.push_back({properties[i].name, 1});
+      vertex_components_.push_back({i, 1});
+    }
+  return true;
+}
+
+u64 PlyReader::vertexCount() const {
+  return vertex_element_ < elements_.size() ? elements_[vertex_element_].count : 0;
+}
+
+bool PlyReader::readVertices(f32 *destination, u64 chunk_size) {
+  const u64 component_count = vertexComponentCount();
+  return readVertices([&](const f32 *vertices, u64 first_vertex, u64 vertex_count) {
+    std::memcpy(destination + first_vertex * component_count, vertices,
+                vertex_count * component_count * sizeof(f32));
+    return true;
+  }, chunk_size);
+}
+
+bool PlyReader::readVertices(const ChunkCallback &callback, u64 chunk_size) {
+  if (!good_)
+    return false;
+  if (vertex_element_ >= elements_.size())
+    return true;
+  chunk_size = std::max<u64>(1, chunk_size);
+  file_.clear();
+  file_.seekg(static_cast<std::streamoff>(data_offset_));
+  Input input(file_);
+  // elements are stored in header order, skip the ones before vertices
+  for (u64 i = 0; i < vertex_element_; ++i)
+    if (!skipElement(input, elements_[i])) {
+      hermes::Log::error("PlyReader: unexpected end of data in {}.", path_);
+      return false;
+    }
+  const auto &element = elements_[vertex_element_];
+  if (format_ == ply_format::ascii)
+    return readAsciiVertices(input, element, callback, chunk_size);
+  return readBinaryVertices(input, element, callback, chunk_size);
+}
+
+bool PlyReader::skipElement(Input &input, const Element &element) {
+  if (format_ == ply_format::ascii) {
+    u64 offset = 0, line_begin = 0, line_end = 0;
+    for (u64 i = 0; i < element.count; ++i) {
+      if (!input.nextLine(offset, line_begin, line_end))
+        return false;
+      input.consume(offset);
+      offset = 0;
+    }
+    return true;
+  }
+  const bool swap = (format_ == ply_format::binary_little_endian) != hostIsLittleEndian();
+  u64 record_size = 0;
+  bool has_lists = false;
+  for (const auto &property : element.properties) {
+    record_size += typeSize(property.type);
+    has_lists |= property.count_type != ply_type::none;
+  }
+  if (!has_lists) {
+    u64 remaining = element.count * record_size;
+    while (remaining) {
+      const u64 n = std::min<u64>(remaining, 1u << 20);
+      if (!input.fill(n))
+        return false;
+      input.consume(n);
+      remaining -= n;
+    }
+    return true;
+  }
+  for (u64 i = 0; i < element.count; ++i)
+    for (const auto &property : element.properties) {
+      u64 size = typeSize(property.type);
+      if (property.count_type != ply_type::none) {
+        const u64 count_size = typeSize(property.count_type);
+        if (!input.fill(count_size))
+          return false;
+        size *= static_cast<u64>(loadValue(input.data(), property.count_type, swap));
+        input.consume(count_size);
+      }
+      if (!input.fill(size))
+        return false;
+      input.consume(size);
+    }
+  return true;
+}
+
+bool PlyReader::readBinaryVertices(Input &input, const Element &element,
+                                   const ChunkCallback &callback, u64 chunk_size) {
+  const bool swap = (format_ == ply_format::binary_little_endian) != hostIsLittleEndian();
+  const u64 component_count = vertex_components_.size();
+  // byte offset of each property inside a record (valid for records without lists)
+  std::vector<u64> offsets(element.properties.size(), 0);
+  u64 record_size = 0;
+  bool has_lists = false;
+  for (u64 i = 0; i < element.properties.size(); ++i) {
+    offsets[i] = record_size;
+    record_size += typeSize(element.properties[i].type);
+    has_lists |= element.properties[i].count_type != ply_type::none;
+  }
+  std::vector<f32> vertices(chunk_size * component_count);
+  for (u64 first = 0; first < element.count; first += chunk_size) {
+    const u64 count = std::min(chunk_size, element.count - first);
+    if (!has_lists) {
+      if (!input.fill(count * record_size)) {
+        hermes::Log::error("PlyReader: unexpected end of data in {}.", path_);
+        return false;
+      }
+      const char *records = input.data();
+      Parallel::forBlocks(count, [&](u64 begin, u64 end, u64) {
+        for (u64 v = begin; v < end; ++v) {
+          const char *record = records + v * record_size;
+          f32 *vertex = vertices.data() + v * component_count;
+          for (u64 c = 0; c < component_count; ++c) {
+            const auto &component = vertex_components_[c];
+            vertex[c] = static_cast<f32>(loadValue(record + offsets[component.property],
+                                                   element.properties[component.property].type,
+                                                   swap)) * component.scale;
+          }
+        }
+      }, 4096);
+      input.consume(count * record_size);
+    } else {
+      // records have variable size, walk them sequentially
+      std::vector<f64> values(element.properties.size(), 0);
+      for (u64 v = 0; v < count; ++v) {
+        for (u64 p = 0; p < element.properties.size(); ++p) {
+          const auto &property = element.properties[p];
+          u64 size = typeSize(property.type);
+          if (property.count_type != ply_type::none) {
+            const u64 count_size = typeSize(property.count_type);
+            if (!input.fill(count_size)) {
+              hermes::Log::error("PlyReader: unexpected end of data in {}.", path_);
+              return false;
+            }
+            size *= static_cast<u64>(loadValue(input.data(), property.count_type, swap));
+            input.consume(count_size);
+          }
+          if (!input.fill(size)) {
+            hermes::Log::error("PlyReader: unexpected end of data in {}.", path_);
+            return false;
+          }
+          if (property.count_type == ply_type::none)
+            values[p] = loadValue(input.data(), property.type, swap);
+          input.consume(size);
+        }
+        f32 *vertex = vertices.data() + v * component_count;
+        for (u64 c = 0; c < component_count; ++c)
+          vertex[c] = static_cast<f32>(values[vertex_components_[c].property]) * vertex_components_[c].scale;
+      }
+    }
+    if (!callback(vertices.data(), first, count))
+      return true;
+  }
+  return true;
+}
+
+bool PlyReader::readAsciiVertices(Input &input, const Element &element,
+                                  const ChunkCallback &callback, u64 chunk_size) {
+  const u64 component_count = vertex_components_.size();
+  std::vector<f32> vertices(chunk_size * component_count);
+  std::vector<std::pair<u64, u64>> lines;
+  lines.reserve(chunk_size);
+  for (u64 first = 0; first < element.count; first += chunk_size) {
+    const u64 count = std::min(chunk_size, element.count - first);
+    // gather the lines of this chunk (offsets stay valid while the buffer grows)
+    lines.clear();
+    u64 offset = 0, line_begin = 0, line_end = 0;
+    while (lines.size() < count && input.nextLine(offset, line_begin, line_end))
+      lines.emplace_back(line_begin, line_end);
+    if (lines.size() < count) {
+      hermes::Log::error("PlyReader: unexpected end of data in {}.", path_);
+      return false;
+    }
+    // parse lines in parallel
+    const char *text = input.data();
+    std::atomic<bool> malformed{false};
+    Parallel::forBlocks(count, [&](u64 begin, u64 end, u64) {
+      std::vector<f64> values(element.properties.size(), 0);
+      for (u64 v = begin; v < end; ++v) {
+        const char *p = text + lines[v].first;
+        const char *line_end = text + lines[v].second;
+        for (u64 i = 0; i < element.properties.size(); ++i) {
+          if (element.properties[i].count_type != ply_type::none) {
+            i64 n = 0;
+            TextParsing::skipBlanks(p, line_end);
+            if (!TextParsing::parseInt(p, line_end, n) || n < 0) {
+              malformed = true;
+              return;
+            }
+            for (i64 k = 0; k < n; ++k) {
+              f64 ignored;
+              TextParsing::skipBlanks(p, line_end);
+              if (!TextParsing::parseDouble(p, line_end, ignored)) {
+                malformed = true;
+                return;
+              }
+            }
+            continue;
+          }
+          TextParsing::skipBlanks(p, line_end);
+          if (!TextParsing::parseDouble(p, line_end, values[i])) {
+            malformed = true;
+            return;
+          }
+        }
+        f32 *vertex = vertices.data() + v * component_count;
+        for (u64 c = 0; c < component_count; ++c)
+          vertex[c] = static_cast<f32>(values[vertex_components_[c].property]) * vertex_components_[c].scale;
+      }
+    }, 1024);
+    if (malformed) {
+      hermes::Log::error("PlyReader: malformed vertex data in {}.", path_);
+      return false;
+    }
+    input.consume(offset);
+    if (!callback(vertices.data(), first, count))
+      return true;
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,153 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file ply_reader.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-13
+///
+///\brief Streaming PLY reader
+
+#ifndef CIRCE_CIRCE_IO_PLY_READER_H
+#define CIRCE_CIRCE_IO_PLY_READER_H
+
+#include <hermes/common/file_system.h>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace circe {
+
+/// Storage formats of PLY files
+enum class ply_format {
+  ascii,
+  binary_little_endian,
+  binary_big_endian
+};
+
+/// Scalar types of PLY properties
+enum class ply_type {
+  none, i8, u8, i16, u16, i32, u32, f32, f64
+};
+
+/// Streaming reader for PLY files (ascii, binary little and big endian).
+/// The header is read on open. Vertices are then streamed from the file in
+/// fixed-size chunks and converted into interleaved f32 records, so memory
+/// usage does not depend on the file size.
+///
+/// Converted vertices contain the position (x y z), followed by the normal
+/// (nx ny nz) and the color (red green blue, normalized to [0,1] for integer
+/// types) when present, followed by one component for each remaining scalar
+/// vertex property (e.g. intensity), in file order. List properties of the
+/// vertex element are skipped.
+///
+/// Example:
+///   PlyReader reader(path);
+///   reader.readVertices([&](const f32 *vertices, u64 first, u64 count) {
+///     // vertices holds count * reader.vertexComponentCount() values
+///     return true;
+///   });
+class PlyReader final {
+public:
+  /// Receives converted vertices [first_vertex, first_vertex + vertex_count).
+  /// Returning false stops the stream.
+  using ChunkCallback = std::function<bool(const f32 *vertices, u64 first_vertex, u64 vertex_count)>;
+  struct Property {
+    std::string name;
+    ply_type type{ply_type::none};       //!< value type (item type for lists)
+    ply_type count_type{ply_type::none}; //!< list size type (none for scalar properties)
+  };
+  struct Element {
+    std::string name;
+    u64 count{0};
+    std::vector<Property> properties;
+  };
+  /// Attribute of converted vertices
+  struct Attribute {
+    std::string name;
+    u32 component_count{1};
+  };
+  // ***********************************************************************
+  //                           CONSTRUCTORS
+  // ***********************************************************************
+  PlyReader();
+  /// \param path ply file
+  explicit PlyReader(const hermes::Path &path);
+  ~PlyReader();
+  PlyReader(const PlyReader &) = delete;
+  PlyReader &operator=(const PlyReader &) = delete;
+  // ***********************************************************************
+  //                             METHODS
+  // ***********************************************************************
+  /// Opens file and reads its header
+  /// \param path
+  /// \return true if success
+  bool open(const hermes::Path &path);
+  /// \return true if a file with a valid header is open
+  [[nodiscard]] bool good() const { return good_; }
+  [[nodiscard]] ply_format format() const { return format_; }
+  [[nodiscard]] const std::vector<Element> &elements() const { return elements_; }
+  /// \return number of vertices in the file
+  [[nodiscard]] u64 vertexCount() const;
+  /// \return layout of converted vertices
+  [[nodiscard]] const std::vector<Attribute> &vertexAttributes() const { return vertex_attributes_; }
+  /// \return number of f32 values per converted vertex
+  [[nodiscard]] u32 vertexComponentCount() const { return static_cast<u32>(vertex_components_.size()); }
+  /// Streams all vertices of the file through callback
+  /// \param callback
+  /// \param chunk_size maximum number of vertices per callback call
+  /// \return false on read errors or malformed data
+  bool readVertices(const ChunkCallback &callback, u64 chunk_size = default_chunk_size);
+  /// Reads all vertices into a caller provided buffer
+  /// \param destination vertexCount() * vertexComponentCount() values
+  /// \param chunk_size number of vertices converted at a time
+  /// \return false on read errors or malformed data
+  bool readVertices(f32 *destination, u64 chunk_size = default_chunk_size);
+
+  static constexpr u64 default_chunk_size = 1u << 16;
+
+private:
+  /// Source of a converted vertex component
+  struct Component {
+    u64 property{0}; //!< index in the vertex element properties
+    f32 scale{1};
+  };
+  /// Buffered window over the data section of the file
+  class Input;
+  bool readHeader();
+  bool skipElement(Input &input, const Element &element);
+  bool readBinaryVertices(Input &input, const Element &element, const ChunkCallback &callback, u64 chunk_size);
+  bool readAsciiVertices(Input &input, const Element &element, const ChunkCallback &callback, u64 chunk_size);
+
+  std::ifstream file_;
+  std::string path_;
+  bool good_{false};
+  ply_format format_{ply_format::ascii};
+  std::vector<Element> elements_;
+  u64 data_offset_{0};
+  u64 vertex_element_{0};
+  std::vector<Attribute> vertex_attributes_;
+  std::vector<Component> vertex_components_;
+};
+
+}
+
+#endif //CIRCE_CIRCE_IO_PLY_READER_H
@@ -0,0 +1,151 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file text_parsing.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-13
+///
+///\brief Locale independent number parsing helpers for text file readers
+
+#ifndef CIRCE_CIRCE_IO_TEXT_PARSING_H
+#define CIRCE_CIRCE_IO_TEXT_PARSING_H
+
+#include <hermes/common/defs.h>
+#include <cmath>
+#include <cstring>
+
+namespace circe {
+
+/// Parsing helpers shared by text based readers (OBJ, ASCII PLY).
+/// All functions work on [p, end) ranges, do not allocate and do not depend on
+/// the current locale. Functions that read a token advance p past it on success.
+class TextParsing final {
+public:
+  static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+  static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+  }
+  static void skipBlanks(const char *&p, const char *end) {
+    while (p < end && isBlank(*p))
+      ++p;
+  }
+  /// \return position of the next '\n' (or end)
+  static const char *lineEnd(const char *p, const char *end) {
+    auto *eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    return eol ? eol : end;
+  }
+  /// Parses a decimal floating point number
+  /// \param p **[in/out]** current position, advanced past the number on success
+  /// \param end line end
+  /// \param value **[out]**
+  /// \return false if no number could be read at p
+  static bool parseDouble(const char *&p, const char *end, f64 &value) {
+    static const f64 powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+'))
+      negative = *s++ == '-';
+    u64 mantissa = 0;
+    i32 exponent = 0;
+    i32 significant_digits = 0;
+    bool has_digits = false;
+    for (; s < end && isDigit(*s); ++s, has_digits = true) {
+      if (significant_digits < 19) {
+        mantissa = mantissa * 10 + (*s - '0');
+        significant_digits += mantissa != 0;
+      } else
+        exponent++;
+    }
+    if (s < end && *s == '.')
+      for (++s; s < end && isDigit(*s); ++s, has_digits = true)
+        if (significant_digits < 19) {
+          mantissa = mantissa * 10 + (*s - '0');
+          significant_digits += mantissa != 0;
+          exponent--;
+        }
+    if (!has_digits)
+      return false;
+    if (s < end && (*s == 'e' || *s == 'E')) {
+      const char *e = s + 1;
+      bool negative_exponent = false;
+      if (e < end && (*e == '-' || *e == '+'))
+        negative_exponent = *e++ == '-';
+      if (e < end && isDigit(*e)) {
+        i32 exponent_value = 0;
+        for (; e < end && isDigit(*e); ++e)
+          if (exponent_value < 10000)
+            exponent_value = exponent_value * 10 + (*e - '0');
+        exponent += negative_exponent ? -exponent_value : exponent_value;
+        s = e;
+      }
+    }
+    auto v = static_cast<f64>(mantissa);
+    if (mantissa) {
+      if (exponent < 0)
+        v = exponent >= -22 ? v / powers_of_ten[-exponent] : v * std::pow(10.0, exponent);
+      else if (exponent > 0)
+        v = exponent <= 22 ? v * powers_of_ten[exponent] : v * std::pow(10.0, exponent);
+    }
+    value = negative ? -v : v;
+    p = s;
+    return true;
+  }
+  /// \copydoc parseDouble
+  static bool parseFloat(const char *&p, const char *end, f32 &value) {
+    f64 v = 0;
+    if (!parseDouble(p, end, v))
+      return false;
+    value = static_cast<f32>(v);
+    return true;
+  }
+  static bool parseInt(const char *&p, const char *end, i64 &value) {
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+'))
+      negative = *s++ == '-';
+    if (s >= end || !isDigit(*s))
+      return false;
+    i64 v = 0;
+    for (; s < end && isDigit(*s); ++s)
+      v = v * 10 + (*s - '0');
+    value = negative ? -v : v;
+    p = s;
+    return true;
+  }
+  /// Reads up to n floats separated by blanks
+  /// \return number of floats read
+  static u32 parseFloats(const char *&p, const char *end, f32 *values, u32 n) {
+    u32 count = 0;
+    for (; count < n; ++count) {
+      skipBlanks(p, end);
+      if (!parseFloat(p, end, values[count]))
+        break;
+    }
+    return count;
+  }
+};
+
+}
+
+#endif //CIRCE_CIRCE_IO_TEXT_PARSING_H
@@ -0,0 +1,65 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file attribute_semantics.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-28
+///
+///\brief
+
+#include <circe/scene/attribute_semantics.h>
+
+#include <algorithm>
+
+namespace circe {
+
+attribute_semantic AttributeSemantics::fromName(const std::string &attribute_name) {
+  std::string name = attribute_name;
+  std::transform(name.begin(), name.end(), name.begin(), [](char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+  });
+  auto contains = [&](const char *word) { return name.find(word) != std::string::npos; };
+  // bitangents first, "bitangent" contains "tangent" and "binormal" contains "normal"
+  if (contains("bitangent") || contains("binormal"))
+    return attribute_semantic::bitangent;
+  if (contains("tangent"))
+    return attribute_semantic::tangent;
+  if (contains("normal") || name == "n")
+    return attribute_semantic::normal;
+  if (contains("position") || name == "pos" || name == "p")
+    return attribute_semantic::position;
+  if (contains("texcoord") || name.rfind("uv", 0) == 0 || name == "st")
+    return attribute_semantic::texcoord;
+  if (contains("color") || contains("colour") || name == "cd")
+    return attribute_semantic::color;
+  return attribute_semantic::other;
+}
+
+bool AttributeSemantics::isDirection(attribute_semantic semantic) {
+  return semantic == attribute_semantic::normal || semantic == attribute_semantic::tangent ||
+      semantic == attribute_semantic::bitangent;
+}
+
+bool AttributeSemantics::isDirection(const std::string &attribute_name) {
+  return isDirection(fromName(attribute_name));
+}
+
+}
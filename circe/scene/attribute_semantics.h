@@ -0,0 +1,68 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file attribute_semantics.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-28
+///
+///\brief Vertex attribute roles derived from attribute names
+
+#ifndef CIRCE_CIRCE_SCENE_ATTRIBUTE_SEMANTICS_H
+#define CIRCE_CIRCE_SCENE_ATTRIBUTE_SEMANTICS_H
+
+#include <string>
+
+namespace circe {
+
+/// Role of a vertex attribute
+enum class attribute_semantic {
+  position,  //!< "position", "pos", "P"
+  normal,    //!< "normal", "normals", "N"
+  tangent,   //!< "tangent", "tangents"
+  bitangent, //!< "bitangent", "bitangents", "binormal"
+  texcoord,  //!< "uv", "uvs", "uvw", "texcoord", "st"
+  color,     //!< "color", "colour", "Cd"
+  other
+};
+
+/// Classifies vertex attributes by name, so every module that treats
+/// attributes differently (transforms, quantization, ...) agrees on which
+/// attribute is what.
+///
+/// Names are compared case insensitively; long names match as substrings
+/// ("normal_0", "vertexNormal"), short aliases ("N", "P", "Cd", "st") only as
+/// whole names.
+class AttributeSemantics final {
+public:
+  /// \param attribute_name
+  /// \return semantic of the attribute, attribute_semantic::other if unknown
+  static attribute_semantic fromName(const std::string &attribute_name);
+  /// \param semantic
+  /// \return true for unit vectors (normals, tangents and bitangents)
+  static bool isDirection(attribute_semantic semantic);
+  /// \param attribute_name
+  /// \return true if the attribute holds unit vectors
+  static bool isDirection(const std::string &attribute_name);
+};
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_ATTRIBUTE_SEMANTICS_H
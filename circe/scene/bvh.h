@@ -28,4 +28,208 @@
 #ifndef CIRCE_CIRCE_SCENE_BVH_H
 #define CIRCE_CIRCE_SCENE_BVH_H
 
+#include <circe/common/bounds.h>
+#include <circe/scene/bvh_builder.h>
+#include <circe/scene/spatial_structure_interface.h>
+#include <hermes/geometry/ray.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace circe {
+
+/// Object level bounding volume hierarchy. Drop-in replacement for
+/// circe::Array as the StructureType of a Scene: ray queries visit only the
+/// objects whose bounds are pierced by the ray, closest first pruned, and
+/// frustum culling rejects or accepts whole subtrees at once.
+///
+/// ObjectType must provide
+///   hermes::bbox3 worldBounds() const;           // scene space bounds
+///   bool intersect(const hermes::Ray3 &r, float *t);
+/// Objects with invalid (empty) bounds are kept out of the hierarchy and
+/// always tested. The hierarchy is built by init(), after all add calls;
+/// objects added later are tested linearly until the next init(). Moving
+/// objects requires calling init() again.
+///
+/// Example:
+///   Scene<circe::BVH> scene;
+///   for (auto &o : objects)
+///     scene.add(o.get());
+///   scene.init();
+///   auto *picked = scene.intersect(ray);
+template<typename ObjectType>
+class BVH : public SpatialStructureInterface<ObjectType> {
+public:
+  BVH() = default;
+  /// \param options builder options
+  explicit BVH(const BVHBuilder::Options &options) : options_(options) {}
+  ~BVH() override = default;
+  /* @inherit */
+  void add(ObjectType *o) override { objects_.emplace_back(o); }
+  /* @inherit */
+  void iterate(std::function<void(const ObjectType *o)> f) const override {
+    for (const auto e : objects_)
+      f(e);
+  }
+  /* @inherit */
+  void iterate(std::function<void(ObjectType *o)> f) override {
+    for (auto e : objects_)
+      f(e);
+  }
+  /// Builds the hierarchy over the current world bounds of all objects
+  void init() override {
+    std::vector<hermes::bbox3> bounds;
+    std::vector<ObjectType *> bounded;
+    bounds.reserve(objects_.size());
+    bounded.reserve(objects_.size());
+    unbounded_.clear();
+    for (auto o : objects_) {
+      auto b = o->worldBounds();
+      if (hasBounds(b)) {
+        bounds.emplace_back(b);
+        bounded.emplace_back(o);
+      } else
+        unbounded_.emplace_back(o);
+    }
+    std::vector<u32> elements;
+    statistics_ = BVHBuilder::build(bounds.data(), bounds.size(), options_, nodes_, elements);
+    leaf_objects_.resize(elements.size());
+    for (u64 i = 0; i < elements.size(); ++i)
+      leaf_objects_[i] = bounded[elements[i]];
+    built_count_ = objects_.size();
+  }
+  /* @inherit */
+  ObjectType *intersect(const hermes::Ray3 &r, float *t = nullptr) const override {
+    ObjectType *ret = nullptr;
+    float mint = INFINITY;
+    auto test = [&](ObjectType *o) {
+      float cur_t = INFINITY;
+      if (o->intersect(r, &cur_t) && cur_t < mint) {
+        mint = cur_t;
+        ret = o;
+      }
+    };
+    for (auto o : unbounded_)
+      test(o);
+    for (u64 i = built_count_; i < objects_.size(); ++i)
+      test(objects_[i]);
+    if (!nodes_.empty()) {
+      const f32 origin[3] = {r.o.x, r.o.y, r.o.z};
+      const f32 inv_dir[3] = {Bounds::safeInverse(r.d.x), Bounds::safeInverse(r.d.y), Bounds::safeInverse(r.d.z)};
+      const int dir_is_neg[3] = {inv_dir[0] < 0, inv_dir[1] < 0, inv_dir[2] < 0};
+      // pending nodes never outnumber the tree depth
+      u32 todo_buffer[64];
+      std::vector<u32> todo_storage;
+      u32 *todo = todo_buffer;
+      if (statistics_.max_depth >= 64) {
+        todo_storage.resize(statistics_.max_depth + 1);
+        todo = todo_storage.data();
+      }
+      u32 todo_count = 0;
+      u32 node_index = 0;
+      while (true) {
+        const auto &node = nodes_[node_index];
+        if (Bounds::hitsSlabs(node.bounds, origin, inv_dir, dir_is_neg, mint)) {
+          if (node.isLeaf()) {
+            for (u32 i = 0; i < node.count; ++i)
+              test(leaf_objects_[node.offset + i]);
+            if (!todo_count)
+              break;
+            node_index = todo[--todo_count];
+          } else {
+            // visit the near child first
+            if (dir_is_neg[node.axis]) {
+              todo[todo_count++] = node_index + 1;
+              node_index = node.offset;
+            } else {
+              todo[todo_count++] = node.offset;
+              node_index = node_index + 1;
+            }
+          }
+        } else {
+          if (!todo_count)
+            break;
+          node_index = todo[--todo_count];
+        }
+      }
+    }
+    if (t != nullptr)
+      *t = mint;
+    return ret;
+  }
+  /// Visits the hierarchy top-down. Subtrees outside the frustum are skipped,
+  /// subtrees completely inside are accepted without testing their objects.
+  /* @inherit */
+  void iterateVisible(const FrustumCuller &culler, std::function<void(ObjectType *o)> f,
+                      FrustumCuller::Statistics *statistics = nullptr) override {
+    FrustumCuller::Statistics counts;
+    auto visit = [&](ObjectType *o, u8 plane_mask) {
+      if (plane_mask) {
+        auto bounds = o->worldBounds();
+        if (!hasBounds(bounds))
+          counts.unbounded++;
+        else {
+          counts.box_tests++;
+          if (culler.classify(bounds, plane_mask) == frustum_test::outside)
+            return;
+        }
+      }
+      counts.visible++;
+      f(o);
+    };
+    for (auto o : unbounded_)
+      visit(o, FrustumCuller::all_planes);
+    for (u64 i = built_count_; i < objects_.size(); ++i)
+      visit(objects_[i], FrustumCuller::all_planes);
+    if (!nodes_.empty()) {
+      struct Pending {
+        u32 node;
+        u8 plane_mask;
+      };
+      Pending todo_buffer[64];
+      std::vector<Pending> todo_storage;
+      Pending *todo = todo_buffer;
+      if (statistics_.max_depth >= 64) {
+        todo_storage.resize(statistics_.max_depth + 1);
+        todo = todo_storage.data();
+      }
+      u32 todo_count = 0;
+      todo[todo_count++] = {0, FrustumCuller::all_planes};
+      while (todo_count) {
+        auto pending = todo[--todo_count];
+        const auto &node = nodes_[pending.node];
+        if (pending.plane_mask) {
+          counts.box_tests++;
+          if (culler.classify(node.bounds, pending.plane_mask) == frustum_test::outside)
+            continue;
+        }
+        if (node.isLeaf()) {
+          for (u32 i = 0; i < node.count; ++i)
+            visit(leaf_objects_[node.offset + i], pending.plane_mask);
+        } else {
+          todo[todo_count++] = {node.offset, pending.plane_mask};
+          todo[todo_count++] = {pending.node + 1, pending.plane_mask};
+        }
+      }
+    }
+    counts.culled = objects_.size() - counts.visible;
+    if (statistics)
+      *statistics = counts;
+  }
+  /// \return statistics of the last init()
+  [[nodiscard]] const BVHBuilder::Statistics &statistics() const { return statistics_; }
+
+private:
+  BVHBuilder::Options options_;
+  BVHBuilder::Statistics statistics_;
+  std::vector<ObjectType *> objects_;      //!< insertion order
+  std::vector<ObjectType *> leaf_objects_; //!< objects referenced by the leaves
+  std::vector<ObjectType *> unbounded_;
+  std::vector<BVHBuilder::Node> nodes_;
+  u64 built_count_{0};
+};
+
+} // namespace circe
+
 #endif //CIRCE_CIRCE_SCENE_BVH_H
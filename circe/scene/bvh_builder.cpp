@@ -0,0 +1,422 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file bvh_builder.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-24
+///
+///\brief
+
+#include <circe/scene/bvh_builder.h>
+#include <circe/common/bounds.h>
+#include <circe/common/parallel.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace circe {
+
+namespace {
+
+struct Box {
+  f32 lo[3]{std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max()};
+  f32 hi[3]{std::numeric_limits<f32>::lowest(), std::numeric_limits<f32>::lowest(),
+            std::numeric_limits<f32>::lowest()};
+
+  void grow(const Box &b) {
+    for (int d = 0; d < 3; ++d) {
+      lo[d] = std::min(lo[d], b.lo[d]);
+      hi[d] = std::max(hi[d], b.hi[d]);
+    }
+  }
+  void grow(const f32 *p) {
+    for (int d = 0; d < 3; ++d) {
+      lo[d] = std::min(lo[d], p[d]);
+      hi[d] = std::max(hi[d], p[d]);
+    }
+  }
+  [[nodiscard]] f32 area() const {
+    const f32 x = hi[0] - lo[0], y = hi[1] - lo[1], z = hi[2] - lo[2];
+    if (x < 0 || y < 0 || z < 0)
+      return 0;
+    return 2 * (x * y + y * z + z * x);
+  }
+  [[nodiscard]] hermes::bbox3 bbox() const {
+    return hermes::bbox3(hermes::point3(lo[0], lo[1], lo[2]), hermes::point3(hi[0], hi[1], hi[2]));
+  }
+};
+
+/// Element reference moved around during partitioning
+struct Reference {
+  Box box;
+  f32 centroid[3];
+  u32 index;
+};
+
+/// Arena node (flattened after the build)
+struct BuildNode {
+  Box box;
+  u32 first{0}; //!< first element (leaves) or first child (interior nodes, the second child follows it)
+  u32 count{0}; //!< 0 for interior nodes
+  u8 axis{0};
+};
+
+/// Chunked node storage. Chunks are only created when nodes are allocated
+/// from them, and nodes never move, so tasks can allocate concurrently.
+class NodeArena {
+public:
+  explicit NodeArena(u64 capacity) : chunks_((capacity + chunk_size - 1) / chunk_size), flags_(chunks_.size()) {}
+  u32 allocate(u32 n) {
+    const u32 first = next_.fetch_add(n);
+    for (u32 c = first >> chunk_shift; c <= (first + n - 1) >> chunk_shift; ++c)
+      std::call_once(flags_[c], [&]() { chunks_[c] = std::make_unique<BuildNode[]>(chunk_size); });
+    return first;
+  }
+  BuildNode &operator[](u32 i) { return chunks_[i >> chunk_shift][i & (chunk_size - 1)]; }
+  const BuildNode &operator[](u32 i) const { return chunks_[i >> chunk_shift][i & (chunk_size - 1)]; }
+  [[nodiscard]] u32 size() const { return next_; }
+
+private:
+  static constexpr u32 chunk_shift = 14;
+  static constexpr u32 chunk_size = 1u << chunk_shift;
+  std::vector<std::unique_ptr<BuildNode[]>> chunks_;
+  std::vector<std::once_flag> flags_;
+  std::atomic<u32> next_{0};
+};
+
+struct Bin {
+  Box box;
+  u32 count{0};
+};
+
+struct Task {
+  u32 node;
+  u64 begin, end;
+  u32 depth;
+  Box centroid_box; //!< bounds of the element centroids
+};
+
+class Builder {
+public:
+  Builder(std::vector<Reference> &references, const BVHBuilder::Options &options)
+      : references_(references), options_(options), arena_(2 * references.size() - 1) {
+    options_.max_leaf_size = std::clamp<u32>(options_.max_leaf_size, 1, BVHBuilder::max_leaf_size_limit);
+    options_.bin_count = std::clamp<u32>(options_.bin_count, 2, BVHBuilder::max_bin_count);
+    // subtrees are spawned as tasks until there are about two per thread
+    while ((1u << spawn_depth_) < 2 * Parallel::threadCount())
+      spawn_depth_++;
+  }
+
+  void build() {
+    const u32 root = allocate(1);
+    const u64 count = references_.size();
+    std::vector<Box> boxes(2 * Parallel::blockCount(count));
+    Parallel::forBlocks(count, [&](u64 begin, u64 end, u32 block) {
+      for (u64 i = begin; i < end; ++i) {
+        boxes[2 * block].grow(references_[i].box);
+        boxes[2 * block + 1].grow(references_[i].centroid);
+      }
+    });
+    Task task{root, 0, count, 0, {}};
+    for (u64 b = 0; b < boxes.size(); b += 2) {
+      arena_[root].box.grow(boxes[b]);
+      task.centroid_box.grow(boxes[b + 1]);
+    }
+    build(task);
+  }
+
+  const NodeArena &arena() const { return arena_; }
+
+private:
+  u32 allocate(u32 n) { return arena_.allocate(n); }
+
+  void build(Task root) {
+    std::vector<Task> stack{root};
+    while (!stack.empty()) {
+      Task task = stack.back();
+      stack.pop_back();
+      Task children[2];
+      if (!split(task, children))
+        continue;
+      if (task.end - task.begin >= options_.parallel_size && task.depth < spawn_depth_)
+        Parallel::invoke([&, task = children[0]]() { build(task); },
+                         [&, task = children[1]]() { build(task); });
+      else {
+        stack.emplace_back(children[1]);
+        stack.emplace_back(children[0]);
+      }
+    }
+  }
+
+  void makeLeaf(const Task &task) {
+    auto &node = arena_[task.node];
+    node.first = static_cast<u32>(task.begin);
+    node.count = static_cast<u32>(task.end - task.begin);
+  }
+
+  /// Accumulates element bounds into 3 x bin_count bins
+  void binElements(u64 begin, u64 end, u32 bin_count, const Box &centroid_box, const f32 *scale, Bin *bins) const {
+    for (u64 i = begin; i < end; ++i) {
+      const auto &reference = references_[i];
+      for (int d = 0; d < 3; ++d) {
+        if (scale[d] <= 0)
+          continue;
+        const auto b = std::min(bin_count - 1,
+                                static_cast<u32>((reference.centroid[d] - centroid_box.lo[d]) * scale[d]));
+        bins[d * bin_count + b].box.grow(reference.box);
+        bins[d * bin_count + b].count++;
+      }
+    }
+  }
+
+  /// Splits a node (or turns it into a leaf)
+  /// \return false if the node became a leaf
+  bool split(const Task &task, Task *children) {
+    const u64 count = task.end - task.begin;
+    auto &node = arena_[task.node];
+    if (count <= 1) {
+      makeLeaf(task);
+      return false;
+    }
+    const Box &centroid_box = task.centroid_box;
+    // small nodes do not need more bins than elements
+    const u32 bin_count = static_cast<u32>(std::min<u64>(options_.bin_count, std::max<u64>(count, 2)));
+    f32 scale[3];
+    for (int d = 0; d < 3; ++d) {
+      const f32 extent = centroid_box.hi[d] - centroid_box.lo[d];
+      scale[d] = extent > 0 ? bin_count * (1 - 1e-5f) / extent : 0;
+    }
+    u64 best_left_count = 0;
+    u32 best_bin = 0;
+    int best_axis = -1;
+    f32 best_cost = std::numeric_limits<f32>::max();
+    Box best_boxes[2];
+    if (scale[0] > 0 || scale[1] > 0 || scale[2] > 0) {
+      // per thread scratch memory, so small nodes only reset the bins they use
+      thread_local std::vector<Bin> bins;
+      thread_local std::vector<Box> right_boxes;
+      thread_local std::vector<u64> right_counts;
+      bins.assign(3 * bin_count, Bin());
+      right_boxes.resize(bin_count);
+      right_counts.resize(bin_count);
+      if (count >= options_.parallel_size) {
+        // large nodes are binned in parallel into per block bins
+        const u64 min_block = std::max<u64>(1, options_.parallel_size / 2);
+        const u32 blocks = Parallel::blockCount(count, min_block);
+        std::vector<Bin> block_bins(blocks * 3 * bin_count);
+        Parallel::forBlocks(count, [&](u64 begin, u64 end, u32 block) {
+          binElements(task.begin + begin, task.begin + end, bin_count, centroid_box, scale, &block_bins[block * 3 * bin_count]);
+        }, min_block);
+        for (u32 block = 0; block < blocks; ++block)
+          for (u32 b = 0; b < 3 * bin_count; ++b) {
+            bins[b].box.grow(block_bins[block * 3 * bin_count + b].box);
+            bins[b].count += block_bins[block * 3 * bin_count + b].count;
+          }
+      } else
+        binElements(task.begin, task.end, bin_count, centroid_box, scale, bins.data());
+      // sweep the bins of each axis
+      const f32 node_area = std::max(node.box.area(), std::numeric_limits<f32>::min());
+      for (int d = 0; d < 3; ++d) {
+        if (scale[d] <= 0)
+          continue;
+        const Bin *axis_bins = &bins[d * bin_count];
+        Box right;
+        u64 right_count = 0;
+        for (u32 b = bin_count - 1; b > 0; --b) {
+          right.grow(axis_bins[b].box);
+          right_count += axis_bins[b].count;
+          right_boxes[b] = right;
+          right_counts[b] = right_count;
+        }
+        Box left;
+        u64 left_count = 0;
+        for (u32 b = 0; b + 1 < bin_count; ++b) {
+          left.grow(axis_bins[b].box);
+          left_count += axis_bins[b].count;
+          if (!left_count || !right_counts[b + 1])
+            continue;
+          const f32 cost = options_.traversal_cost + options_.intersection_cost *
+              (left.area() * left_count + right_boxes[b + 1].area() * right_counts[b + 1]) / node_area;
+          if (cost < best_cost) {
+            best_cost = cost;
+            best_axis = d;
+            best_bin = b;
+            best_left_count = left_count;
+            best_boxes[0] = left;
+            best_boxes[1] = right_boxes[b + 1];
+          }
+        }
+      }
+    }
+    const f32 leaf_cost = options_.intersection_cost * count;
+    if (count <= options_.max_leaf_size && (best_axis < 0 || leaf_cost <= best_cost)) {
+      makeLeaf(task);
+      return false;
+    }
+    Box centroid_boxes[2];
+    u64 middle = task.begin + count / 2;
+    if (best_axis >= 0) {
+      // partition elements by bin, child centroid bounds are computed on the way
+      const int d = best_axis;
+      auto is_left = [&](const Reference &reference) {
+        return std::min(bin_count - 1, static_cast<u32>((reference.centroid[d] - centroid_box.lo[d]) * scale[d]))
+            <= best_bin;
+      };
+      u64 i = task.begin, j = task.end;
+      while (i < j) {
+        if (is_left(references_[i]))
+          centroid_boxes[0].grow(references_[i++].centroid);
+        else {
+          std::swap(references_[i], references_[--j]);
+          centroid_boxes[1].grow(references_[j].centroid);
+        }
+      }
+      middle = i;
+      node.axis = static_cast<u8>(d);
+    } else
+      // all centroids coincide: any split is as good as another
+      node.axis = 0;
+    if (best_axis < 0 || middle != task.begin + best_left_count || middle == task.begin || middle == task.end) {
+      if (middle == task.begin || middle == task.end)
+        middle = task.begin + count / 2;
+      // recompute child bounds (median fallback)
+      for (int c = 0; c < 2; ++c)
+        best_boxes[c] = centroid_boxes[c] = Box();
+      for (u64 k = task.begin; k < task.end; ++k) {
+        const int c = k < middle ? 0 : 1;
+        best_boxes[c].grow(references_[k].box);
+        centroid_boxes[c].grow(references_[k].centroid);
+      }
+    }
+    const u32 first_child = allocate(2);
+    node.first = first_child;
+    arena_[first_child].box = best_boxes[0];
+    arena_[first_child + 1].box = best_boxes[1];
+    children[0] = {first_child, task.begin, middle, task.depth + 1, centroid_boxes[0]};
+    children[1] = {first_child + 1, middle, task.end, task.depth + 1, centroid_boxes[1]};
+    return true;
+  }
+
+  std::vector<Reference> &references_;
+  BVHBuilder::Options options_;
+  NodeArena arena_;
+  u32 spawn_depth_{0};
+};
+
+}
+
+BVHBuilder::Statistics BVHBuilder::build(const hermes::bbox3 *bounds, u64 count, const Options &options,
+                                         std::vector<Node> &nodes, std::vector<u32> &elements) {
+  const auto start = std::chrono::steady_clock::now();
+  nodes.clear();
+  elements.clear();
+  if (!count)
+    return {};
+  std::vector<Reference> references(count);
+  Parallel::forEach(count, [&](u64 i) {
+    auto &reference = references[i];
+    reference.box.lo[0] = bounds[i].lower.x;
+    reference.box.lo[1] = bounds[i].lower.y;
+    reference.box.lo[2] = bounds[i].lower.z;
+    reference.box.hi[0] = bounds[i].upper.x;
+    reference.box.hi[1] = bounds[i].upper.y;
+    reference.box.hi[2] = bounds[i].upper.z;
+    for (int d = 0; d < 3; ++d)
+      reference.centroid[d] = 0.5f * (reference.box.lo[d] + reference.box.hi[d]);
+    reference.index = static_cast<u32>(i);
+  });
+  Builder builder(references, options);
+  builder.build();
+  // flatten into depth-first order
+  const auto &arena = builder.arena();
+  nodes.resize(arena.size());
+  struct Item {
+    u32 build_node;
+    u32 parent; //!< flattened parent whose second child this is (or ~0)
+  };
+  std::vector<Item> stack{{0, ~0u}};
+  u32 next = 0;
+  while (!stack.empty()) {
+    const Item item = stack.back();
+    stack.pop_back();
+    const u32 index = next++;
+    if (item.parent != ~0u)
+      nodes[item.parent].offset = index;
+    const auto &build_node = arena[item.build_node];
+    auto &node = nodes[index];
+    node.bounds = build_node.box.bbox();
+    node.axis = build_node.axis;
+    if (build_node.count) {
+      node.offset = build_node.first;
+      node.count = static_cast<u16>(build_node.count);
+    } else {
+      node.count = 0;
+      stack.push_back({build_node.first + 1, index});
+      stack.push_back({build_node.first, ~0u});
+    }
+  }
+  elements.resize(count);
+  Parallel::forEach(count, [&](u64 i) { elements[i] = references[i].index; });
+  auto statistics = BVHBuilder::statistics(nodes, options);
+  statistics.build_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return statistics;
+}
+
+f64 BVHBuilder::sahCost(const std::vector<Node> &nodes, const Options &options) {
+  if (nodes.empty())
+    return 0;
+  const f64 root_area = std::max<f64>(Bounds::area(nodes[0].bounds), std::numeric_limits<f32>::min());
+  f64 cost = 0;
+  for (const auto &node : nodes)
+    cost += Bounds::area(node.bounds) / root_area *
+        (node.isLeaf() ? options.intersection_cost * node.count : options.traversal_cost);
+  return cost;
+}
+
+BVHBuilder::Statistics BVHBuilder::statistics(const std::vector<Node> &nodes, const Options &options) {
+  Statistics statistics;
+  if (nodes.empty())
+    return statistics;
+  statistics.node_count = nodes.size();
+  u64 element_count = 0;
+  std::vector<std::pair<u32, u32>> stack{{0, 1}};
+  while (!stack.empty()) {
+    const auto [index, depth] = stack.back();
+    stack.pop_back();
+    statistics.max_depth = std::max(statistics.max_depth, depth);
+    const auto &node = nodes[index];
+    if (node.isLeaf()) {
+      statistics.leaf_count++;
+      element_count += node.count;
+      continue;
+    }
+    stack.emplace_back(node.offset, depth + 1);
+    stack.emplace_back(index + 1, depth + 1);
+  }
+  statistics.average_leaf_size = statistics.leaf_count ? static_cast<f32>(element_count) / statistics.leaf_count : 0;
+  statistics.sah_cost = sahCost(nodes, options);
+  return statistics;
+}
+
+}
@@ -0,0 +1,105 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file bvh_builder.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-24
+///
+///\brief Binned SAH bounding volume hierarchy builder
+
+#ifndef CIRCE_CIRCE_SCENE_BVH_BUILDER_H
+#define CIRCE_CIRCE_SCENE_BVH_BUILDER_H
+
+#include <hermes/geometry/bbox.h>
+#include <vector>
+
+namespace circe {
+
+/// Builds bounding volume hierarchies over element bounds with the binned
+/// surface area heuristic (Wald 2007). At each node the element centroids are
+/// binned along the three axes and the split plane with the lowest expected
+/// traversal cost is chosen; a node becomes a leaf when that is cheaper than
+/// any split and it holds at most max_leaf_size elements.
+///
+/// Build nodes are taken from a preallocated arena (a binary tree over n
+/// elements has at most 2n - 1 nodes), so no per node allocations happen.
+/// Large nodes are binned in parallel and their subtrees are built as
+/// parallel tasks; the result is flattened into depth-first order.
+///
+/// Example:
+///   std::vector<BVHBuilder::Node> nodes;
+///   std::vector<u32> elements;
+///   auto statistics = BVHBuilder::build(bounds.data(), bounds.size(), {}, nodes, elements);
+class BVHBuilder final {
+public:
+  struct Options {
+    u32 max_leaf_size{4};       //!< elements per leaf (at most max_leaf_size_limit)
+    u32 bin_count{16};          //!< SAH bins per axis (at most max_bin_count)
+    f32 traversal_cost{1.f};    //!< cost of visiting an interior node
+    f32 intersection_cost{1.f}; //!< cost of testing an element
+    u64 parallel_size{1u << 15}; //!< nodes with at least this many elements are built in parallel
+  };
+  /// Flattened node (depth-first order: the first child of an interior node
+  /// follows it, the second child is at offset)
+  struct Node {
+    hermes::bbox3 bounds;
+    u32 offset{0}; //!< first element (leaves) or second child index (interior nodes)
+    u16 count{0};  //!< number of elements (0 for interior nodes)
+    u8 axis{0};    //!< split axis of interior nodes
+    u8 pad{0};
+    [[nodiscard]] bool isLeaf() const { return count > 0; }
+  };
+  struct Statistics {
+    u64 node_count{0};
+    u64 leaf_count{0};
+    u32 max_depth{0};
+    f32 average_leaf_size{0};
+    f64 sah_cost{0}; //!< expected cost of a random ray traversal (see sahCost)
+    f64 build_ms{0};
+  };
+  /// Builds a hierarchy over element bounds
+  /// \param bounds element bounds
+  /// \param count number of elements
+  /// \param options
+  /// \param nodes **[out]** flattened nodes (nodes[0] is the root, empty if count is 0)
+  /// \param elements **[out]** element indices referenced by the leaves
+  /// \return
+  static Statistics build(const hermes::bbox3 *bounds, u64 count, const Options &options,
+                          std::vector<Node> &nodes, std::vector<u32> &elements);
+  /// Expected cost of traversing the hierarchy with a random ray: node
+  /// costs weighted by the probability of hitting them (surface area
+  /// relative to the root).
+  /// \param nodes
+  /// \param options costs
+  /// \return
+  static f64 sahCost(const std::vector<Node> &nodes, const Options &options);
+  /// \param nodes
+  /// \param options costs used for the sah cost
+  /// \return node, leaf, depth and cost figures of a hierarchy (no build time)
+  static Statistics statistics(const std::vector<Node> &nodes, const Options &options);
+
+  static constexpr u32 max_leaf_size_limit = 0xffff;
+  static constexpr u32 max_bin_count = 64;
+};
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_BVH_BUILDER_H
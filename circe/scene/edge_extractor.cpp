@@ -0,0 +1,85 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file edge_extractor.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-19
+///
+///\brief
+
+#include <circe/scene/edge_extractor.h>
+#include <circe/common/radix_sort.h>
+
+namespace circe {
+
+std::vector<i32> EdgeExtractor::extract(const i32 *indices, u64 element_count, u32 element_size,
+                                        std::vector<u32> *face_edges) {
+  std::vector<i32> edges;
+  const u64 corner_count = element_count * element_size;
+  if (!corner_count || element_size < 2)
+    return edges;
+  // one key per element edge
+  std::vector<u64> keys(corner_count);
+  std::vector<u32> corners(face_edges ? corner_count : 0);
+  Parallel::forEach(element_count, [&](u64 e) {
+    const i32 *element = indices + e * element_size;
+    for (u32 k = 0; k < element_size; ++k) {
+      keys[e * element_size + k] = edgeKey(static_cast<u32>(element[k]),
+                                           static_cast<u32>(element[(k + 1) % element_size]));
+      if (face_edges)
+        corners[e * element_size + k] = static_cast<u32>(e * element_size + k);
+    }
+  });
+  if (face_edges)
+    RadixSort::sort(keys, corners);
+  else
+    RadixSort::sort(keys);
+  // count unique keys per block
+  const u32 blocks = Parallel::blockCount(corner_count);
+  std::vector<u64> block_offsets(blocks + 1, 0);
+  Parallel::forBlocks(corner_count, [&](u64 begin, u64 end, u32 block) {
+    u64 count = 0;
+    for (u64 i = begin; i < end; ++i)
+      count += !i || keys[i] != keys[i - 1];
+    block_offsets[block + 1] = count;
+  });
+  for (u32 b = 0; b < blocks; ++b)
+    block_offsets[b + 1] += block_offsets[b];
+  // write unique edges (and the edge id of each corner)
+  edges.resize(block_offsets[blocks] * 2);
+  if (face_edges)
+    face_edges->resize(corner_count);
+  Parallel::forBlocks(corner_count, [&](u64 begin, u64 end, u32 block) {
+    u64 edge_id = block_offsets[block];
+    for (u64 i = begin; i < end; ++i) {
+      if (!i || keys[i] != keys[i - 1]) {
+        edges[edge_id * 2 + 0] = static_cast<i32>(keys[i] >> 32);
+        edges[edge_id * 2 + 1] = static_cast<i32>(keys[i] & 0xffffffffu);
+        edge_id++;
+      }
+      if (face_edges)
+        (*face_edges)[corners[i]] = static_cast<u32>(edge_id - 1);
+    }
+  });
+  return edges;
+}
+
+}
@@ -0,0 +1,63 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file edge_extractor.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-19
+///
+///\brief Unique edge extraction from element index buffers
+
+#ifndef CIRCE_CIRCE_SCENE_EDGE_EXTRACTOR_H
+#define CIRCE_CIRCE_SCENE_EDGE_EXTRACTOR_H
+
+#include <hermes/common/defs.h>
+#include <vector>
+
+namespace circe {
+
+/// Extracts the unique edges of polygon index buffers (triangles, quads, ...).
+/// Every element edge is packed into a 64-bit key (min vertex in the upper
+/// 32 bits, max vertex in the lower 32 bits), keys are radix sorted in
+/// parallel and duplicates are removed with a parallel scan. Edges come out
+/// sorted by (min, max) vertex and edge ids are their position in the output.
+/// Vertex indices must fit in 32 bits and the number of element corners must
+/// be below 2^32.
+class EdgeExtractor final {
+public:
+  /// \param a
+  /// \param b
+  /// \return key of the undirected edge (a, b)
+  static u64 edgeKey(u32 a, u32 b) {
+    return a < b ? (static_cast<u64>(a) << 32) | b : (static_cast<u64>(b) << 32) | a;
+  }
+  /// \param indices element list (element_size indices per element)
+  /// \param element_count
+  /// \param element_size number of vertices per element (3 for triangles, 4 for quads)
+  /// \param face_edges **[out | optional]** element_count * element_size edge ids, the
+  ///        k-th id of an element is the edge between its k-th and (k+1)-th vertices
+  /// \return edge vertex pairs (2 indices per edge, smaller vertex first)
+  static std::vector<i32> extract(const i32 *indices, u64 element_count, u32 element_size,
+                                  std::vector<u32> *face_edges = nullptr);
+};
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_EDGE_EXTRACTOR_H
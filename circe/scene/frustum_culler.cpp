@@ -0,0 +1,99 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file frustum_culler.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-27
+///
+///\brief
+
+#include <circe/scene/frustum_culler.h>
+
+#include <cmath>
+
+namespace circe {
+
+FrustumCuller FrustumCuller::fromCamera(const CameraInterface &camera,
+                                        const hermes::Transform &model) {
+  return FrustumCuller(camera.getProjectionTransform() * camera.getViewTransform()
+                           * camera.getModelTransform() * model);
+}
+
+FrustumCuller::FrustumCuller() {
+  // 0 >= -1 holds everywhere
+  for (auto &plane : planes_)
+    plane[3] = 1;
+}
+
+FrustumCuller::FrustumCuller(const hermes::Transform &clip_transform)
+    : FrustumCuller(clip_transform.matrix()) {}
+
+FrustumCuller::FrustumCuller(const hermes::Matrix4x4<real_t> &clip_matrix) {
+  // Gribb & Hartmann: a point is inside if -w <= x, y, z <= w in clip space,
+  // each inequality is a plane given by a combination of the matrix rows.
+  // Using -w <= z also covers [0, w] depth ranges (the near plane is then
+  // slightly conservative).
+  for (u32 i = 0; i < 6; ++i) {
+    const u32 row = i / 2;
+    const real_t sign = (i % 2) ? -1 : 1;
+    for (u32 j = 0; j < 4; ++j)
+      planes_[i][j] = clip_matrix[3][j] + sign * clip_matrix[row][j];
+    const real_t length = std::sqrt(planes_[i][0] * planes_[i][0] + planes_[i][1] * planes_[i][1]
+                                        + planes_[i][2] * planes_[i][2]);
+    if (length > 0)
+      for (auto &c : planes_[i])
+        c /= length;
+  }
+}
+
+frustum_test FrustumCuller::classify(const hermes::bbox3 &bounds, u8 &plane_mask) const {
+  const real_t center[3] = {(bounds.lower.x + bounds.upper.x) * 0.5f,
+                            (bounds.lower.y + bounds.upper.y) * 0.5f,
+                            (bounds.lower.z + bounds.upper.z) * 0.5f};
+  const real_t extent[3] = {(bounds.upper.x - bounds.lower.x) * 0.5f,
+                            (bounds.upper.y - bounds.lower.y) * 0.5f,
+                            (bounds.upper.z - bounds.lower.z) * 0.5f};
+  for (u32 i = 0; i < 6; ++i) {
+    if (!(plane_mask & (1u << i)))
+      continue;
+    const real_t *p = planes_[i];
+    // signed distance of the center and projected radius of the box
+    const real_t distance = p[0] * center[0] + p[1] * center[1] + p[2] * center[2] + p[3];
+    const real_t radius = std::fabs(p[0]) * extent[0] + std::fabs(p[1]) * extent[1]
+        + std::fabs(p[2]) * extent[2];
+    if (distance + radius < 0)
+      return frustum_test::outside;
+    if (distance - radius >= 0)
+      plane_mask &= ~(1u << i);
+  }
+  return plane_mask ? frustum_test::intersecting : frustum_test::inside;
+}
+
+frustum_test FrustumCuller::classify(const hermes::bbox3 &bounds) const {
+  u8 plane_mask = all_planes;
+  return classify(bounds, plane_mask);
+}
+
+bool FrustumCuller::isVisible(const hermes::bbox3 &bounds) const {
+  return classify(bounds) != frustum_test::outside;
+}
+
+} // namespace circe
@@ -0,0 +1,107 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file frustum_culler.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-27
+///
+///\brief View frustum tests for object culling
+
+#ifndef CIRCE_CIRCE_SCENE_FRUSTUM_CULLER_H
+#define CIRCE_CIRCE_SCENE_FRUSTUM_CULLER_H
+
+#include <circe/scene/camera_interface.h>
+#include <hermes/geometry/bbox.h>
+
+namespace circe {
+
+/// Result of testing a box against the view frustum
+enum class frustum_test {
+  outside,      //!< box is completely outside (cull)
+  intersecting, //!< box crosses at least one plane
+  inside        //!< box is completely inside
+};
+
+/// Tests world space bounds against the six planes of a view frustum.
+/// Planes are extracted from a clip transform (projection * view * model),
+/// so any projection the camera uses is supported.
+///
+/// Hierarchical tests pass a plane mask along: planes a parent box is
+/// completely inside of are removed from the mask and never tested again for
+/// its children. A box tested with an empty mask is inside without any work.
+///
+/// Example:
+///   auto culler = FrustumCuller::fromCamera(camera);
+///   if (culler.isVisible(object.worldBounds()))
+///     object.draw(...);
+class FrustumCuller final {
+public:
+  static constexpr u8 all_planes = 0x3f;
+  /// Object counts of a culling pass
+  struct Statistics {
+    u64 visible{0};   //!< objects inside or crossing the frustum (includes unbounded)
+    u64 culled{0};    //!< objects completely outside the frustum
+    u64 unbounded{0}; //!< objects without bounds, never culled
+    u64 box_tests{0}; //!< boxes (objects and hierarchy nodes) tested against planes
+    u64 hidden{0};    //!< objects inside the frustum skipped by the caller (not in visible)
+  };
+  /// \param camera
+  /// \param model transform applied to objects before the camera's (the scene transform)
+  /// \return culler of the camera's view frustum
+  static FrustumCuller fromCamera(const CameraInterface &camera,
+                                  const hermes::Transform &model = hermes::Transform());
+  /// Frustum that accepts every box
+  FrustumCuller();
+  /// \param clip_transform world to clip space transform (projection * view)
+  explicit FrustumCuller(const hermes::Transform &clip_transform);
+  /// \param clip_matrix world to clip space matrix, applied to column vectors
+  explicit FrustumCuller(const hermes::Matrix4x4<real_t> &clip_matrix);
+  /// \param bounds world space box
+  /// \param plane_mask **[in/out]** planes to test; planes that contain the
+  ///                   whole box are removed
+  /// \return box classification
+  [[nodiscard]] frustum_test classify(const hermes::bbox3 &bounds, u8 &plane_mask) const;
+  /// \param bounds world space box
+  /// \return box classification against all planes
+  [[nodiscard]] frustum_test classify(const hermes::bbox3 &bounds) const;
+  /// \param bounds world space box
+  /// \return false if the box is completely outside
+  [[nodiscard]] bool isVisible(const hermes::bbox3 &bounds) const;
+  /// Plane i is (a, b, c, d), with a * x + b * y + c * z + d >= 0 inside.
+  /// Order: left, right, bottom, top, near, far.
+  /// \param i plane index
+  /// \return normalized plane coefficients
+  [[nodiscard]] const real_t *plane(u32 i) const { return planes_[i]; }
+
+private:
+  real_t planes_[6][4]{};
+};
+
+/// \param bounds
+/// \return true if bounds hold at least a point (default bboxes are empty)
+inline bool hasBounds(const hermes::bbox3 &bounds) {
+  return bounds.lower.x <= bounds.upper.x && bounds.lower.y <= bounds.upper.y
+      && bounds.lower.z <= bounds.upper.z;
+}
+
+} // namespace circe
+
+#endif //CIRCE_CIRCE_SCENE_FRUSTUM_CULLER_H
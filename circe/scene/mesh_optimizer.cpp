@@ -0,0 +1,356 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file mesh_optimizer.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-15
+///
+///\brief
+
+#include <circe/scene/mesh_optimizer.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace circe {
+
+namespace {
+
+/// FIFO post-transform cache simulated with insertion timestamps
+class FifoCache {
+public:
+  FifoCache(u64 vertex_count, u32 cache_size) : timestamps_(vertex_count, 0), cache_size_(cache_size),
+                                                time_(cache_size + 1) {}
+  /// \return true if v was not in the cache (v is then inserted)
+  bool access(i32 v) {
+    if (time_ - timestamps_[v] <= cache_size_)
+      return false;
+    timestamps_[v] = time_++;
+    return true;
+  }
+  /// Invalidates all entries
+  void flush() { time_ += cache_size_ + 1; }
+
+private:
+  std::vector<u64> timestamps_;
+  u64 cache_size_;
+  u64 time_;
+};
+
+/// \return position of vertex v in a triangle list
+const f32 *position(const u8 *positions, u64 stride, i32 v) {
+  return reinterpret_cast<const f32 *>(positions + static_cast<u64>(v) * stride);
+}
+
+}
+
+MeshOptimizer::VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const i32 *indices, u64 index_count,
+                                                                       u64 vertex_count, u32 cache_size) {
+  VertexCacheStatistics statistics;
+  if (index_count < 3)
+    return statistics;
+  FifoCache cache(vertex_count, cache_size);
+  std::vector<bool> referenced(vertex_count, false);
+  u64 referenced_count = 0;
+  for (u64 i = 0; i < index_count; ++i) {
+    statistics.vertices_transformed += cache.access(indices[i]);
+    if (!referenced[indices[i]]) {
+      referenced[indices[i]] = true;
+      referenced_count++;
+    }
+  }
+  statistics.acmr = static_cast<f32>(statistics.vertices_transformed) / static_cast<f32>(index_count / 3);
+  statistics.atvr = static_cast<f32>(statistics.vertices_transformed) / static_cast<f32>(referenced_count);
+  return statistics;
+}
+
+void MeshOptimizer::optimizeVertexCache(i32 *indices, u64 index_count, u64 vertex_count, u32 cache_size,
+                                        std::vector<u64> *clusters) {
+  const u64 triangle_count = index_count / 3;
+  if (clusters)
+    clusters->assign(1, 0);
+  if (triangle_count < 2)
+    return;
+  // vertex -> triangles adjacency
+  std::vector<u64> adjacency_offsets(vertex_count + 1, 0);
+  for (u64 i = 0; i < triangle_count * 3; ++i)
+    adjacency_offsets[indices[i] + 1]++;
+  for (u64 v = 0; v < vertex_count; ++v)
+    adjacency_offsets[v + 1] += adjacency_offsets[v];
+  std::vector<u64> adjacency(adjacency_offsets.back());
+  {
+    std::vector<u64> cursor(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (u64 i = 0; i < triangle_count * 3; ++i)
+      adjacency[cursor[indices[i]]++] = i / 3;
+  }
+  // live triangle count of each vertex
+  std::vector<u32> live(vertex_count, 0);
+  for (u64 v = 0; v < vertex_count; ++v)
+    live[v] = static_cast<u32>(adjacency_offsets[v + 1] - adjacency_offsets[v]);
+  std::vector<u64> timestamps(vertex_count, 0);
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<i32> dead_end_stack;
+  std::vector<i32> candidates;
+  std::vector<u64> order;
+  order.reserve(triangle_count);
+  u64 time = cache_size + 1;
+  u64 cursor = 0;
+  // first vertex in input order that still has live triangles
+  auto skipDeadEnd = [&]() -> i32 {
+    while (!dead_end_stack.empty()) {
+      const i32 d = dead_end_stack.back();
+      dead_end_stack.pop_back();
+      if (live[d] > 0)
+        return d;
+    }
+    for (; cursor < vertex_count; ++cursor)
+      if (live[cursor] > 0)
+        return static_cast<i32>(cursor);
+    return -1;
+  };
+  i32 fanning_vertex = skipDeadEnd();
+  while (fanning_vertex >= 0) {
+    candidates.clear();
+    // emit all live triangles around the fanning vertex
+    for (u64 a = adjacency_offsets[fanning_vertex]; a < adjacency_offsets[fanning_vertex + 1]; ++a) {
+      const u64 t = adjacency[a];
+      if (emitted[t])
+        continue;
+      for (u32 k = 0; k < 3; ++k) {
+        const i32 v = indices[t * 3 + k];
+        dead_end_stack.emplace_back(v);
+        candidates.emplace_back(v);
+        live[v]--;
+        if (time - timestamps[v] > cache_size)
+          timestamps[v] = time++;
+      }
+      emitted[t] = true;
+      order.emplace_back(t);
+    }
+    // next fanning vertex: the oldest candidate that stays in cache while its
+    // remaining triangles are emitted
+    i32 best = -1;
+    u64 best_priority = 0;
+    bool found = false;
+    for (auto v : candidates) {
+      if (!live[v])
+        continue;
+      u64 priority = 0;
+      if (time - timestamps[v] + 2 * live[v] <= cache_size)
+        priority = time - timestamps[v];
+      if (!found || priority > best_priority) {
+        best = v;
+        best_priority = priority;
+        found = true;
+      }
+    }
+    if (!found) {
+      best = skipDeadEnd();
+      // non-local jump starts a new cluster
+      if (clusters && best >= 0 && order.size() < triangle_count)
+        clusters->emplace_back(order.size());
+    }
+    fanning_vertex = best;
+  }
+  std::vector<i32> reordered(triangle_count * 3);
+  for (u64 i = 0; i < order.size(); ++i)
+    std::memcpy(&reordered[i * 3], &indices[order[i] * 3], 3 * sizeof(i32));
+  std::memcpy(indices, reordered.data(), reordered.size() * sizeof(i32));
+}
+
+void MeshOptimizer::optimizeOverdraw(i32 *indices, u64 index_count, const u8 *positions, u64 stride,
+                                     const std::vector<u64> &clusters, u32 cache_size, f32 threshold) {
+  const u64 triangle_count = index_count / 3;
+  if (triangle_count < 2 || clusters.empty())
+    return;
+  u64 vertex_count = 0;
+  for (u64 i = 0; i < triangle_count * 3; ++i)
+    vertex_count = std::max(vertex_count, static_cast<u64>(indices[i]) + 1);
+  // split hard clusters into soft clusters whenever the running ACMR gets
+  // close enough to the ACMR of the whole cluster
+  std::vector<u64> soft_clusters;
+  FifoCache cache(vertex_count, cache_size);
+  for (u64 c = 0; c < clusters.size(); ++c) {
+    const u64 begin = clusters[c];
+    const u64 end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+    cache.flush();
+    u64 misses = 0;
+    for (u64 t = begin; t < end; ++t)
+      for (u32 k = 0; k < 3; ++k)
+        misses += cache.access(indices[t * 3 + k]);
+    const f32 cluster_acmr = static_cast<f32>(misses) / static_cast<f32>(end - begin);
+    cache.flush();
+    soft_clusters.emplace_back(begin);
+    u64 soft_begin = begin;
+    misses = 0;
+    for (u64 t = begin; t < end; ++t) {
+      for (u32 k = 0; k < 3; ++k)
+        misses += cache.access(indices[t * 3 + k]);
+      if (t + 1 < end &&
+          static_cast<f32>(misses) / static_cast<f32>(t + 1 - soft_begin) <= threshold * cluster_acmr) {
+        soft_clusters.emplace_back(t + 1);
+        soft_begin = t + 1;
+        misses = 0;
+        cache.flush();
+      }
+    }
+  }
+  // area weighted centroid and normal of each cluster
+  const u64 cluster_count = soft_clusters.size();
+  std::vector<f32> centroids(cluster_count * 3, 0), normals(cluster_count * 3, 0), areas(cluster_count, 0);
+  f32 mesh_centroid[3] = {0, 0, 0};
+  f32 mesh_area = 0;
+  for (u64 c = 0; c < cluster_count; ++c) {
+    const u64 begin = soft_clusters[c];
+    const u64 end = c + 1 < cluster_count ? soft_clusters[c + 1] : triangle_count;
+    for (u64 t = begin; t < end; ++t) {
+      const f32 *a = position(positions, stride, indices[t * 3 + 0]);
+      const f32 *b = position(positions, stride, indices[t * 3 + 1]);
+      const f32 *p = position(positions, stride, indices[t * 3 + 2]);
+      const f32 e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+      const f32 e1[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+      const f32 n[3] = {e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0]};
+      const f32 area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for (u32 d = 0; d < 3; ++d) {
+        centroids[c * 3 + d] += area * (a[d] + b[d] + p[d]) / 3.f;
+        normals[c * 3 + d] += n[d];
+      }
+      areas[c] += area;
+    }
+    for (u32 d = 0; d < 3; ++d)
+      mesh_centroid[d] += centroids[c * 3 + d];
+    mesh_area += areas[c];
+    if (areas[c] > 0)
+      for (u32 d = 0; d < 3; ++d)
+        centroids[c * 3 + d] /= areas[c];
+  }
+  if (mesh_area > 0)
+    for (f32 &d : mesh_centroid)
+      d /= mesh_area;
+  // clusters that face away from the mesh center are likely to occlude others
+  std::vector<f32> sort_keys(cluster_count, 0);
+  for (u64 c = 0; c < cluster_count; ++c) {
+    const f32 *n = &normals[c * 3];
+    const f32 length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length > 0)
+      for (u32 d = 0; d < 3; ++d)
+        sort_keys[c] += (centroids[c * 3 + d] - mesh_centroid[d]) * n[d] / length;
+  }
+  std::vector<u64> cluster_order(cluster_count);
+  std::iota(cluster_order.begin(), cluster_order.end(), 0);
+  std::stable_sort(cluster_order.begin(), cluster_order.end(),
+                   [&](u64 a, u64 b) { return sort_keys[a] > sort_keys[b]; });
+  std::vector<i32> reordered;
+  reordered.reserve(triangle_count * 3);
+  for (auto c : cluster_order) {
+    const u64 begin = soft_clusters[c];
+    const u64 end = c + 1 < cluster_count ? soft_clusters[c + 1] : triangle_count;
+    reordered.insert(reordered.end(), indices + begin * 3, indices + end * 3);
+  }
+  std::memcpy(indices, reordered.data(), reordered.size() * sizeof(i32));
+}
+
+void MeshOptimizer::optimizeVertexFetch(u8 *vertices, u64 vertex_count, u64 stride, i32 *indices,
+                                        u64 index_count) {
+  std::vector<i32> remap(vertex_count, -1);
+  i32 next = 0;
+  for (u64 i = 0; i < index_count; ++i) {
+    if (remap[indices[i]] < 0)
+      remap[indices[i]] = next++;
+    indices[i] = remap[indices[i]];
+  }
+  for (u64 v = 0; v < vertex_count; ++v)
+    if (remap[v] < 0)
+      remap[v] = next++;
+  // follow the permutation cycles, each swap puts one vertex in place
+  for (u64 v = 0; v < vertex_count; ++v)
+    while (remap[v] != static_cast<i32>(v)) {
+      const i32 target = remap[v];
+      std::swap_ranges(vertices + v * stride, vertices + (v + 1) * stride, vertices + target * stride);
+      std::swap(remap[v], remap[target]);
+    }
+}
+
+MeshOptimizer::Report MeshOptimizer::optimize(Model &model, u32 cache_size) {
+  Report report;
+  report.before = analyzeVertexCache(model.indexData(), model.indexCount(), model.vertexCount(), cache_size);
+  report.after = report.before;
+  const u64 position_id = model.positionAttribute();
+  if (model.primitiveType() != hermes::GeometricPrimitiveType::TRIANGLES || model.indexCount() < 6 ||
+      position_id >= model.vertexDescriptor().fields().size())
+    return report;
+  // vertices and indices are reordered in place, so external or separate
+  // data is made owned first
+  u8 *vertices = model.mutableVertexData();
+  i32 *indices = model.mutableIndexData();
+  const u64 index_count = model.indexCount();
+  const u64 stride = model.vertexDescriptor().sizeInBytes();
+  // positionAttribute() only returns 3 float fields
+  const u8 *positions = vertices + model.vertexDescriptor().fields()[position_id].offset;
+  // triangles are only reordered inside sub-meshes
+  const auto &levels = model.levelsOfDetail();
+  std::vector<std::pair<u64, u64>> ranges;
+  for (const auto &sub_mesh : model.subMeshes())
+    ranges.emplace_back(sub_mesh.index_offset, sub_mesh.index_count);
+  if (ranges.empty())
+    ranges.emplace_back(0, levels.empty() ? index_count : levels.front().index_count);
+  for (u64 level = 1; level < levels.size(); ++level)
+    ranges.emplace_back(levels[level].index_offset, levels[level].index_count);
+  // ranges are optimized with local vertex numbering, so the cost of each
+  // range does not depend on the size of the model
+  std::vector<i32> local_ids(model.vertexCount(), -1);
+  std::vector<i32> global_ids;
+  std::vector<i32> local_indices;
+  std::vector<f32> local_positions;
+  std::vector<u64> clusters;
+  for (const auto &range : ranges) {
+    const u64 count = range.second - range.second % 3;
+    if (count < 6)
+      continue;
+    i32 *range_indices = indices + range.first;
+    global_ids.clear();
+    local_indices.resize(count);
+    for (u64 i = 0; i < count; ++i) {
+      i32 &local = local_ids[range_indices[i]];
+      if (local < 0) {
+        local = static_cast<i32>(global_ids.size());
+        global_ids.emplace_back(range_indices[i]);
+      }
+      local_indices[i] = local;
+    }
+    local_positions.resize(global_ids.size() * 3);
+    for (u64 v = 0; v < global_ids.size(); ++v)
+      std::memcpy(&local_positions[v * 3], positions + global_ids[v] * stride, 3 * sizeof(f32));
+    optimizeVertexCache(local_indices.data(), count, global_ids.size(), cache_size, &clusters);
+    optimizeOverdraw(local_indices.data(), count, reinterpret_cast<const u8 *>(local_positions.data()),
+                     3 * sizeof(f32), clusters, cache_size);
+    for (u64 i = 0; i < count; ++i)
+      range_indices[i] = global_ids[local_indices[i]];
+    for (auto v : global_ids)
+      local_ids[v] = -1;
+  }
+  optimizeVertexFetch(vertices, model.vertexCount(), stride, indices, index_count);
+  report.after = analyzeVertexCache(model.indexData(), model.indexCount(), model.vertexCount(), cache_size);
+  return report;
+}
+
+}
@@ -0,0 +1,110 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file mesh_optimizer.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-15
+///
+///\brief Triangle and vertex reordering for GPU friendly index buffers
+
+#ifndef CIRCE_CIRCE_SCENE_MESH_OPTIMIZER_H
+#define CIRCE_CIRCE_SCENE_MESH_OPTIMIZER_H
+
+#include <circe/scene/model.h>
+#include <vector>
+
+namespace circe {
+
+/// Reorders triangle meshes for the GPU. The full pass (optimize) runs:
+///   1. vertex cache optimization: Tipsify (Sander et al. 2007) fans
+///      triangles around cached vertices and records where it had to jump
+///      (hard cluster boundaries);
+///   2. overdraw optimization: clusters are split where their cache
+///      efficiency is already within a threshold of the whole cluster, and
+///      sorted so that outward facing clusters are drawn first;
+///   3. vertex fetch optimization: vertices are renumbered (and moved) in
+///      the order of their first use by the index buffer.
+/// Cache efficiency is measured by simulating a FIFO post-transform cache:
+///   - ACMR: transformed vertices per triangle (0.5 is optimal for large grids)
+///   - ATVR: transformed vertices per referenced vertex (1 is optimal)
+class MeshOptimizer final {
+public:
+  struct VertexCacheStatistics {
+    u64 vertices_transformed{0};
+    f32 acmr{0}; //!< average cache miss ratio
+    f32 atvr{0}; //!< average transformed vertex ratio
+  };
+  /// Vertex cache statistics of a model before and after optimize()
+  struct Report {
+    VertexCacheStatistics before;
+    VertexCacheStatistics after;
+  };
+  /// Simulates a FIFO vertex cache
+  /// \param indices triangle list
+  /// \param index_count
+  /// \param vertex_count
+  /// \param cache_size number of cache entries
+  /// \return
+  static VertexCacheStatistics analyzeVertexCache(const i32 *indices, u64 index_count, u64 vertex_count,
+                                                  u32 cache_size = default_cache_size);
+  /// Reorders triangles (in place) for vertex cache locality
+  /// \param indices **[in/out]** triangle list
+  /// \param index_count
+  /// \param vertex_count
+  /// \param cache_size number of cache entries
+  /// \param clusters **[out | optional]** receives the first triangle of each hard cluster
+  static void optimizeVertexCache(i32 *indices, u64 index_count, u64 vertex_count,
+                                  u32 cache_size = default_cache_size,
+                                  std::vector<u64> *clusters = nullptr);
+  /// Reorders clusters of triangles (in place) to reduce overdraw, keeping
+  /// the cache efficiency of each cluster within threshold
+  /// \param indices **[in/out]** triangle list (output of optimizeVertexCache)
+  /// \param index_count
+  /// \param positions address of the first vertex position (x y z as f32)
+  /// \param stride distance in bytes between consecutive positions
+  /// \param clusters first triangle of each hard cluster (output of optimizeVertexCache)
+  /// \param cache_size number of cache entries
+  /// \param threshold maximum ACMR degradation allowed when splitting clusters
+  static void optimizeOverdraw(i32 *indices, u64 index_count, const u8 *positions, u64 stride,
+                               const std::vector<u64> &clusters, u32 cache_size = default_cache_size,
+                               f32 threshold = default_overdraw_threshold);
+  /// Moves vertices (in place) into the order of their first use. Vertices
+  /// that are not referenced are kept after the referenced ones.
+  /// \param vertices **[in/out]** interleaved vertex data
+  /// \param vertex_count
+  /// \param stride vertex size in bytes
+  /// \param indices **[in/out]** triangle list
+  /// \param index_count
+  static void optimizeVertexFetch(u8 *vertices, u64 vertex_count, u64 stride, i32 *indices, u64 index_count);
+  /// Runs all stages over a triangle model. Sub-meshes and levels of detail
+  /// are optimized independently, so their index ranges stay valid.
+  /// \param model **[in/out]**
+  /// \param cache_size number of cache entries
+  /// \return vertex cache statistics before and after the optimization
+  static Report optimize(Model &model, u32 cache_size = default_cache_size);
+
+  static constexpr u32 default_cache_size = 16;
+  static constexpr f32 default_overdraw_threshold = 1.05f;
+};
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_MESH_OPTIMIZER_H
@@ -0,0 +1,460 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file mesh_simplifier.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-16
+///
+///\brief
+
+#include <circe/scene/mesh_simplifier.h>
+#include <circe/scene/mesh_optimizer.h>
+#include <circe/scene/vertex_welder.h>
+#include <circe/common/parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace circe {
+
+namespace {
+
+/// Symmetric 4x4 matrix of the sum of squared distances to a set of planes,
+/// scaled by the total plane weight
+struct Quadric {
+  f64 a2{0}, b2{0}, c2{0}, d2{0}, ab{0}, ac{0}, ad{0}, bc{0}, bd{0}, cd{0};
+  f64 weight{0};
+
+  /// Plane ax + by + cz + d = 0 with unit normal
+  static Quadric fromPlane(f64 a, f64 b, f64 c, f64 d, f64 weight) {
+    Quadric q;
+    q.a2 = a * a * weight;
+    q.b2 = b * b * weight;
+    q.c2 = c * c * weight;
+    q.d2 = d * d * weight;
+    q.ab = a * b * weight;
+    q.ac = a * c * weight;
+    q.ad = a * d * weight;
+    q.bc = b * c * weight;
+    q.bd = b * d * weight;
+    q.cd = c * d * weight;
+    q.weight = weight;
+    return q;
+  }
+  Quadric &operator+=(const Quadric &q) {
+    a2 += q.a2;
+    b2 += q.b2;
+    c2 += q.c2;
+    d2 += q.d2;
+    ab += q.ab;
+    ac += q.ac;
+    ad += q.ad;
+    bc += q.bc;
+    bd += q.bd;
+    cd += q.cd;
+    weight += q.weight;
+    return *this;
+  }
+  /// \return weighted sum of squared distances from p to the planes
+  [[nodiscard]] f64 evaluate(const f32 *p) const {
+    const f64 x = p[0], y = p[1], z = p[2];
+    return a2 * x * x + b2 * y * y + c2 * z * z + d2 +
+        2 * (ab * x * y + ac * x * z + ad * x + bc * y * z + bd * y + cd * z);
+  }
+};
+
+enum class vertex_kind : u8 {
+  interior,
+  border, //!< on a boundary edge, moves only along boundary edges
+  seam,   //!< split by an attribute seam, moves only along the seam
+  locked  //!< never moves (seam junctions, seams meeting the boundary)
+};
+
+struct PositionKey {
+  f32 x, y, z;
+};
+
+/// Collapse of every vertex at position from onto vertices at position to
+struct Collapse {
+  i32 from;
+  i32 to;
+  f64 cost;
+};
+
+void triangleNormal(const f32 *a, const f32 *b, const f32 *c, f64 *n) {
+  const f64 e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+  const f64 e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+  n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+  n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+  n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+/// Simplification state. Quadrics are kept between calls to simplify, so
+/// successive calls produce a chain of levels whose errors are measured
+/// against the initial mesh.
+/// Vertices at the same position (wedges, split by normal/uv seams) share
+/// topology and quadrics and are collapsed together: each wedge moves onto
+/// the wedge of the target position it shares an edge with, so triangles
+/// keep the attributes of their side of the seam.
+class QuadricSimplifier {
+public:
+  QuadricSimplifier(const i32 *indices, u64 index_count, const u8 *positions, u64 stride, u64 vertex_count)
+      : indices_(indices, indices + index_count - index_count % 3), positions_(positions), stride_(stride),
+        vertex_count_(vertex_count), remap_(vertex_count) {
+    buildWedges();
+    buildAdjacency();
+    computeQuadrics();
+  }
+  /// Collapses edges until the mesh has at most target_index_count indices or
+  /// the next collapse would exceed max_error
+  /// \return current error
+  f32 simplify(u64 target_index_count, f32 max_error) {
+    const f64 max_cost = static_cast<f64>(max_error) * static_cast<f64>(max_error);
+    while (indices_.size() > target_index_count) {
+      if (!collapseEdges(indices_.size() / 3 - target_index_count / 3, max_cost))
+        break;
+      buildAdjacency();
+    }
+    return static_cast<f32>(std::sqrt(error_));
+  }
+  [[nodiscard]] const std::vector<i32> &indices() const { return indices_; }
+
+private:
+  /// \param p position id
+  [[nodiscard]] const f32 *position(i32 p) const {
+    return reinterpret_cast<const f32 *>(positions_ + static_cast<u64>(wedges_[wedge_offsets_[p]]) * stride_);
+  }
+  /// Groups vertices by position
+  void buildWedges() {
+    std::vector<PositionKey> keys(vertex_count_);
+    Parallel::forEach(vertex_count_, [&](u64 v) {
+      const f32 *p = reinterpret_cast<const f32 *>(positions_ + v * stride_);
+      keys[v] = {p[0], p[1], p[2]};
+    });
+    std::vector<u64> unique_positions;
+    VertexWelder::weld(keys.data(), vertex_count_, position_ids_, unique_positions);
+    position_count_ = unique_positions.size();
+    wedge_offsets_.assign(position_count_ + 1, 0);
+    for (auto p : position_ids_)
+      wedge_offsets_[p + 1]++;
+    for (u64 p = 0; p < position_count_; ++p)
+      wedge_offsets_[p + 1] += wedge_offsets_[p];
+    wedges_.resize(vertex_count_);
+    cursor_.assign(wedge_offsets_.begin(), wedge_offsets_.end() - 1);
+    for (u64 v = 0; v < vertex_count_; ++v)
+      wedges_[cursor_[position_ids_[v]]++] = static_cast<i32>(v);
+    kinds_.assign(position_count_, vertex_kind::interior);
+    quadrics_.assign(position_count_, Quadric());
+    pass_locked_.resize(position_count_);
+  }
+  /// position -> triangles, and the vertices still referenced
+  void buildAdjacency() {
+    adjacency_offsets_.assign(position_count_ + 1, 0);
+    for (auto v : indices_)
+      adjacency_offsets_[position_ids_[v] + 1]++;
+    for (u64 p = 0; p < position_count_; ++p)
+      adjacency_offsets_[p + 1] += adjacency_offsets_[p];
+    adjacency_.resize(indices_.size());
+    cursor_.assign(adjacency_offsets_.begin(), adjacency_offsets_.end() - 1);
+    for (u64 i = 0; i < indices_.size(); ++i)
+      adjacency_[cursor_[position_ids_[indices_[i]]]++] = i / 3;
+    referenced_.assign(vertex_count_, false);
+    for (auto v : indices_)
+      referenced_[v] = true;
+  }
+  /// \return true if no triangle has the opposite edge b -> a (vertices, or
+  ///         positions if by_position)
+  [[nodiscard]] bool isBorderEdge(i32 a, i32 b, bool by_position) const {
+    const i32 pa = position_ids_[a], pb = position_ids_[b];
+    for (u64 k = adjacency_offsets_[pa]; k < adjacency_offsets_[pa + 1]; ++k) {
+      const i32 *t = &indices_[adjacency_[k] * 3];
+      for (u32 e = 0; e < 3; ++e) {
+        const i32 u = t[e], w = t[(e + 1) % 3];
+        if (by_position ? position_ids_[u] == pb && position_ids_[w] == pa : u == b && w == a)
+          return false;
+      }
+    }
+    return true;
+  }
+  /// Plane quadrics (area weighted) and boundary/seam constraint quadrics
+  void computeQuadrics() {
+    for (u64 i = 0; i < indices_.size(); i += 3) {
+      const i32 *t = &indices_[i];
+      const i32 pt[3] = {position_ids_[t[0]], position_ids_[t[1]], position_ids_[t[2]]};
+      f64 n[3];
+      triangleNormal(position(pt[0]), position(pt[1]), position(pt[2]), n);
+      const f64 length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      if (length <= 0)
+        continue;
+      for (auto &c : n)
+        c /= length;
+      const f32 *p = position(pt[0]);
+      const auto plane = Quadric::fromPlane(n[0], n[1], n[2], -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]),
+                                            length * 0.5);
+      for (u32 k = 0; k < 3; ++k)
+        quadrics_[pt[k]] += plane;
+      for (u32 k = 0; k < 3; ++k) {
+        const i32 a = t[k], b = t[(k + 1) % 3];
+        const bool border = isBorderEdge(a, b, true);
+        if (!border && !isBorderEdge(a, b, false))
+          continue;
+        const i32 pa = pt[k], pb = pt[(k + 1) % 3];
+        const vertex_kind kind = border ? vertex_kind::border : vertex_kind::seam;
+        for (auto v : {pa, pb})
+          if (kinds_[v] == vertex_kind::interior)
+            kinds_[v] = kind;
+          else if (kinds_[v] != kind)
+            kinds_[v] = vertex_kind::locked;
+        // heavy weight keeps boundaries and seams in place
+        const f32 *a_position = position(pa), *b_position = position(pb);
+        const f64 e[3] = {b_position[0] - a_position[0], b_position[1] - a_position[1],
+                          b_position[2] - a_position[2]};
+        f64 bn[3] = {e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0]};
+        const f64 bn_length = std::sqrt(bn[0] * bn[0] + bn[1] * bn[1] + bn[2] * bn[2]);
+        if (bn_length <= 0)
+          continue;
+        for (auto &c : bn)
+          c /= bn_length;
+        const f64 edge_length2 = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+        const auto constraint = Quadric::fromPlane(bn[0], bn[1], bn[2],
+                                                   -(bn[0] * a_position[0] + bn[1] * a_position[1] +
+                                                       bn[2] * a_position[2]), edge_length2 * 10);
+        quadrics_[pa] += constraint;
+        quadrics_[pb] += constraint;
+      }
+    }
+    // seam junctions (more than 2 wedges) would bend the other seams
+    for (u64 p = 0; p < position_count_; ++p) {
+      u64 wedge_count = 0;
+      for (u64 w = wedge_offsets_[p]; w < wedge_offsets_[p + 1]; ++w)
+        wedge_count += referenced_[wedges_[w]];
+      if (wedge_count > 2 || (wedge_count > 1 && kinds_[p] == vertex_kind::border))
+        kinds_[p] = vertex_kind::locked;
+    }
+  }
+  /// Finds, for each referenced wedge of from, the wedge of to it shares an
+  /// edge with (wedge_targets_)
+  /// \return false if a wedge has no (or more than one) candidate
+  bool mapWedges(i32 from, i32 to) {
+    wedge_targets_.clear();
+    for (u64 w = wedge_offsets_[from]; w < wedge_offsets_[from + 1]; ++w)
+      if (referenced_[wedges_[w]])
+        wedge_targets_.push_back({wedges_[w], -1});
+    for (u64 a = adjacency_offsets_[from]; a < adjacency_offsets_[from + 1]; ++a) {
+      const i32 *t = &indices_[adjacency_[a] * 3];
+      for (u32 k = 0; k < 3; ++k) {
+        if (position_ids_[t[k]] != from)
+          continue;
+        for (u32 j = 0; j < 3; ++j) {
+          if (position_ids_[t[j]] != to)
+            continue;
+          for (auto &target : wedge_targets_)
+            if (target.first == t[k]) {
+              if (target.second >= 0 && target.second != t[j])
+                return false;
+              target.second = t[j];
+            }
+        }
+      }
+    }
+    for (const auto &target : wedge_targets_)
+      if (target.second < 0)
+        return false;
+    return true;
+  }
+  /// One pass of independent collapses, cheapest first
+  /// \return false if no edge could be collapsed
+  bool collapseEdges(u64 triangles_to_remove, f64 max_cost) {
+    // candidate collapses along every edge (both directions)
+    collapses_.clear();
+    for (u64 i = 0; i < indices_.size(); i += 3)
+      for (u32 k = 0; k < 3; ++k) {
+        const i32 a = indices_[i + k], b = indices_[i + (k + 1) % 3];
+        const i32 pa = position_ids_[a], pb = position_ids_[b];
+        // interior edges appear twice, keep the one with pa < pb
+        const bool border_edge = isBorderEdge(a, b, true);
+        if (!border_edge && pa > pb)
+          continue;
+        const bool seam_edge = !border_edge && isBorderEdge(a, b, false);
+        for (u32 direction = 0; direction < 2; ++direction) {
+          const i32 from = direction ? pb : pa;
+          const i32 to = direction ? pa : pb;
+          const vertex_kind kind = kinds_[from];
+          if (kind == vertex_kind::locked ||
+              (kind == vertex_kind::border && (kinds_[to] == vertex_kind::interior || !border_edge)) ||
+              (kind == vertex_kind::seam && (kinds_[to] == vertex_kind::interior || !seam_edge)))
+            continue;
+          collapses_.push_back({from, to, 0});
+        }
+      }
+    Parallel::forEach(collapses_.size(), [&](u64 c) {
+      auto q = quadrics_[collapses_[c].from];
+      q += quadrics_[collapses_[c].to];
+      collapses_[c].cost = q.weight > 0 ? std::max(0.0, q.evaluate(position(collapses_[c].to)) / q.weight) : 0;
+    });
+    std::sort(collapses_.begin(), collapses_.end(), [](const Collapse &a, const Collapse &b) {
+      return a.cost < b.cost || (a.cost == b.cost && (a.from < b.from || (a.from == b.from && a.to < b.to)));
+    });
+    // greedily apply independent collapses
+    std::fill(pass_locked_.begin(), pass_locked_.end(), false);
+    std::iota(remap_.begin(), remap_.end(), 0);
+    u64 removed = 0;
+    u64 applied = 0;
+    for (const auto &collapse : collapses_) {
+      if (collapse.cost > max_cost || removed >= triangles_to_remove)
+        break;
+      if (pass_locked_[collapse.from] || pass_locked_[collapse.to])
+        continue;
+      // reject collapses that flip triangles
+      bool flips = false;
+      u64 collapsed_triangles = 0;
+      for (u64 a = adjacency_offsets_[collapse.from]; a < adjacency_offsets_[collapse.from + 1] && !flips; ++a) {
+        const i32 *t = &indices_[adjacency_[a] * 3];
+        const i32 pt[3] = {position_ids_[t[0]], position_ids_[t[1]], position_ids_[t[2]]};
+        if (pt[0] == collapse.to || pt[1] == collapse.to || pt[2] == collapse.to) {
+          collapsed_triangles++;
+          continue;
+        }
+        const f32 *p[3], *q[3];
+        for (u32 k = 0; k < 3; ++k) {
+          p[k] = position(pt[k]);
+          q[k] = pt[k] == collapse.from ? position(collapse.to) : p[k];
+        }
+        f64 before[3], after[3];
+        triangleNormal(p[0], p[1], p[2], before);
+        triangleNormal(q[0], q[1], q[2], after);
+        const f64 dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        const f64 after_length2 = after[0] * after[0] + after[1] * after[1] + after[2] * after[2];
+        flips = dot <= 0 || after_length2 <= 0;
+      }
+      if (flips || !collapsed_triangles || !mapWedges(collapse.from, collapse.to))
+        continue;
+      for (const auto &target : wedge_targets_)
+        remap_[target.first] = target.second;
+      quadrics_[collapse.to] += quadrics_[collapse.from];
+      // the one-ring of the removed position changes, lock it for this pass
+      for (u64 a = adjacency_offsets_[collapse.from]; a < adjacency_offsets_[collapse.from + 1]; ++a)
+        for (u32 k = 0; k < 3; ++k)
+          pass_locked_[position_ids_[indices_[adjacency_[a] * 3 + k]]] = true;
+      error_ = std::max(error_, collapse.cost);
+      removed += collapsed_triangles;
+      applied++;
+    }
+    if (!applied)
+      return false;
+    // apply remap and drop degenerate triangles (wedges of a position
+    // collapse together, so degenerate triangles may use different wedges)
+    u64 written = 0;
+    for (u64 i = 0; i < indices_.size(); i += 3) {
+      const i32 a = remap_[indices_[i]], b = remap_[indices_[i + 1]], c = remap_[indices_[i + 2]];
+      const i32 pa = position_ids_[a], pb = position_ids_[b], pc = position_ids_[c];
+      if (pa == pb || pb == pc || pa == pc)
+        continue;
+      indices_[written++] = a;
+      indices_[written++] = b;
+      indices_[written++] = c;
+    }
+    indices_.resize(written);
+    return true;
+  }
+
+  std::vector<i32> indices_;
+  const u8 *positions_;
+  u64 stride_;
+  u64 vertex_count_;
+  // vertices grouped by position
+  std::vector<i32> position_ids_;
+  u64 position_count_{0};
+  std::vector<u64> wedge_offsets_;
+  std::vector<i32> wedges_;
+  // per position
+  std::vector<vertex_kind> kinds_;
+  std::vector<Quadric> quadrics_;
+  std::vector<u64> adjacency_offsets_;
+  std::vector<u64> adjacency_;
+  std::vector<bool> pass_locked_;
+  // per vertex
+  std::vector<bool> referenced_;
+  std::vector<i32> remap_;
+  std::vector<u64> cursor_;
+  std::vector<Collapse> collapses_;
+  std::vector<std::pair<i32, i32>> wedge_targets_;
+  f64 error_{0};
+};
+
+}
+
+u64 MeshSimplifier::simplify(const i32 *indices, u64 index_count, const u8 *positions, u64 stride,
+                             u64 vertex_count, u64 target_index_count, f32 max_error,
+                             std::vector<i32> &destination, f32 *result_error) {
+  if (result_error)
+    *result_error = 0;
+  if (index_count <= target_index_count || !vertex_count) {
+    destination.assign(indices, indices + index_count - index_count % 3);
+    return destination.size();
+  }
+  QuadricSimplifier simplifier(indices, index_count, positions, stride, vertex_count);
+  const f32 error = simplifier.simplify(target_index_count, max_error);
+  if (result_error)
+    *result_error = error;
+  destination = simplifier.indices();
+  return destination.size();
+}
+
+u64 MeshSimplifier::generateLevelsOfDetail(Model &model, u32 max_levels, f32 reduction, f32 max_error) {
+  const u64 position_id = model.positionAttribute();
+  if (model.primitiveType() != hermes::GeometricPrimitiveType::TRIANGLES ||
+      position_id >= model.vertexDescriptor().fields().size() || !model.indexCount())
+    return 0;
+  // level 0 is the original index range
+  u64 base_index_count = model.indexCount();
+  if (!model.levelsOfDetail().empty())
+    base_index_count = model.levelsOfDetail().front().index_count;
+  std::vector<i32> indices(model.indexData(), model.indexData() + base_index_count);
+  std::vector<Model::LevelOfDetail> levels = {{0, base_index_count, 0.f}};
+  u64 stride = 0;
+  const u8 *positions = model.attributeElements(position_id, stride);
+  // each level continues the simplification of the previous one, errors are
+  // measured against level 0
+  QuadricSimplifier simplifier(indices.data(), base_index_count, positions, stride, model.vertexCount());
+  std::vector<i32> level_indices;
+  u64 target = base_index_count;
+  while (levels.size() < max_levels) {
+    target = static_cast<u64>(static_cast<f64>(target) * reduction);
+    target -= target % 3;
+    if (target < 3)
+      break;
+    const f32 error = simplifier.simplify(target, max_error);
+    const auto &previous = levels.back();
+    if (simplifier.indices().empty() || simplifier.indices().size() >= previous.index_count * 0.95)
+      break;
+    level_indices = simplifier.indices();
+    MeshOptimizer::optimizeVertexCache(level_indices.data(), level_indices.size(), model.vertexCount());
+    levels.push_back({indices.size(), level_indices.size(), error});
+    indices.insert(indices.end(), level_indices.begin(), level_indices.end());
+    target = level_indices.size();
+  }
+  model.setIndices(std::move(indices));
+  model.setLevelsOfDetail(std::move(levels));
+  return model.levelsOfDetail().size();
+}
+
+}
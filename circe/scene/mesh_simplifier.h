@@ -0,0 +1,84 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file mesh_simplifier.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-16
+///
+///\brief Quadric error metric simplification and LOD chain generation
+
+#ifndef CIRCE_CIRCE_SCENE_MESH_SIMPLIFIER_H
+#define CIRCE_CIRCE_SCENE_MESH_SIMPLIFIER_H
+
+#include <circe/scene/model.h>
+#include <limits>
+#include <vector>
+
+namespace circe {
+
+/// Simplifies triangle lists by collapsing edges in order of their quadric
+/// error (Garland and Heckbert 1997). Vertices are always collapsed onto one
+/// of their neighbours, so simplified index lists reference the original
+/// vertices and can share the vertex buffer of the full resolution mesh.
+///
+/// Notes:
+/// - Boundary edges are preserved by constraint quadrics and boundary
+///   vertices only slide along the boundary.
+/// - Vertices split by attribute seams (several vertices at the same
+///   position, e.g. split normals or uvs) are collapsed together: each one
+///   moves onto the vertex of its side of the seam, so seams do not crack
+///   and triangles keep their attributes. Seam vertices only slide along
+///   the seam, and seam junctions (more than 2 vertices at a position) or
+///   seams meeting the boundary are kept in place.
+/// - Errors are given in model units: the square root of the area weighted
+///   mean squared distance to the planes merged into a vertex.
+class MeshSimplifier final {
+public:
+  /// Simplifies a triangle list
+  /// \param indices triangle list
+  /// \param index_count
+  /// \param positions address of the first vertex position (x y z as f32)
+  /// \param stride distance in bytes between consecutive positions
+  /// \param vertex_count
+  /// \param target_index_count simplification stops when the result has at most this many indices
+  /// \param max_error simplification stops before exceeding this error (model units)
+  /// \param destination **[out]** simplified triangle list
+  /// \param result_error **[out | optional]** error of the simplified mesh
+  /// \return number of indices in destination
+  static u64 simplify(const i32 *indices, u64 index_count, const u8 *positions, u64 stride, u64 vertex_count,
+                      u64 target_index_count, f32 max_error, std::vector<i32> &destination,
+                      f32 *result_error = nullptr);
+  /// Appends a chain of simplified levels to the index data of a triangle
+  /// model. Level 0 is the original index range, each following level
+  /// targets reduction times the indices of the previous one. The chain
+  /// stops early when a level can not be reduced any further.
+  /// \param model **[in/out]**
+  /// \param max_levels maximum number of levels (including level 0)
+  /// \param reduction target index ratio between consecutive levels
+  /// \param max_error maximum error of the coarsest level (model units)
+  /// \return number of levels
+  static u64 generateLevelsOfDetail(Model &model, u32 max_levels = 4, f32 reduction = 0.5f,
+                                    f32 max_error = std::numeric_limits<f32>::max());
+};
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_MESH_SIMPLIFIER_H
@@ -27,12 +27,28 @@
 
 #include "model.h"
 #include <circe/io/io.h>
+#include <circe/io/model_cache.h>
+#include <circe/common/bounds.h>
+#include <circe/common/parallel.h>
+#include <circe/common/transform_kernels.h>
+#include <circe/scene/attribute_semantics.h>
+#include <cstring>
 
 namespace circe {
 
 Model Model::fromFile(const hermes::Path &path, shape_options options) {
+  if (path.extension() == ModelCache::extension)
+    return ModelCache::read(path);
   if (path.extension() == "obj")
-    return std::move(io::readOBJ(path, options | shape_options::unique_positions));
+    return ModelCache::load(path, options, [](const hermes::Path &source, shape_options source_options) {
+      return io::readOBJ(source, source_options | shape_options::unique_positions);
+    });
+  if (path.extension() == "ply")
+    return ModelCache::load(path, options, [](const hermes::Path &source, shape_options) {
+      return io::readPLY(source);
+    });
+  if (path.extension() == "gltf" || path.extension() == "glb")
+    return io::readGLTF(path);
   return std::move(Model());
 }
 
@@ -41,7 +57,16 @@ Model::Model() = default;
 Model::Model(Model &&other) noexcept {
   indices_ = std::move(other.indices_);
   data_ = std::move(other.data_);
+  external_ = std::move(other.external_);
+  other.external_ = {};
+  storage_ = other.storage_;
+  attribute_arrays_ = std::move(other.attribute_arrays_);
+  attribute_vertex_count_ = other.attribute_vertex_count_;
+  sub_meshes_ = std::move(other.sub_meshes_);
+  levels_of_detail_ = std::move(other.levels_of_detail_);
   element_type_ = other.element_type_;
+  bounding_box_ = other.bounding_box_;
+  bounding_box_valid_ = other.bounding_box_valid_;
 }
 
 Model::~Model() = default;
@@ -49,28 +74,51 @@ Model::~Model() = default;
 Model &Model::operator=(Model &&other) noexcept {
   indices_ = std::move(other.indices_);
   data_ = std::move(other.data_);
+  external_ = std::move(other.external_);
+  other.external_ = {};
+  storage_ = other.storage_;
+  attribute_arrays_ = std::move(other.attribute_arrays_);
+  attribute_vertex_count_ = other.attribute_vertex_count_;
+  sub_meshes_ = std::move(other.sub_meshes_);
+  levels_of_detail_ = std::move(other.levels_of_detail_);
   element_type_ = other.element_type_;
+  bounding_box_ = other.bounding_box_;
+  bounding_box_valid_ = other.bounding_box_valid_;
   return *this;
 }
 
 Model &Model::operator=(const Model &other) {
+  // external data is shared, not copied
   indices_ = other.indices_;
   data_ = other.data_;
+  external_ = other.external_;
+  storage_ = other.storage_;
+  attribute_arrays_ = other.attribute_arrays_;
+  attribute_vertex_count_ = other.attribute_vertex_count_;
+  sub_meshes_ = other.sub_meshes_;
+  levels_of_detail_ = other.levels_of_detail_;
   element_type_ = other.element_type_;
+  bounding_box_ = other.bounding_box_;
+  bounding_box_valid_ = other.bounding_box_valid_;
   return *this;
 }
 
 Model &Model::operator=(hermes::AoS &&data) {
+  materialize();
   data_ = std::forward<hermes::AoS>(data);
+  invalidateBoundingBox();
   return *this;
 }
 
 Model &Model::operator=(const hermes::AoS &data) {
+  materialize();
   data_ = data;
+  invalidateBoundingBox();
   return *this;
 }
 
 Model &Model::operator=(const std::vector<i32> &indices) {
+  materialize();
   indices_ = indices;
   return *this;
 }
@@ -82,11 +130,179 @@ Model &Model::operator=(const std::vector<f32> &vertex_data) {
 }
 
 void Model::resize(u64 new_size) {
+  materialize();
   data_.resize(new_size);
+  invalidateBoundingBox();
 }
 
 void Model::setIndices(std::vector<i32> &&indices) {
-  indices_ = indices;
+  materialize();
+  indices_ = std::move(indices);
+}
+
+void Model::setExternalData(const hermes::StructDescriptor &descriptor,
+                            const void *vertices, u64 vertex_count,
+                            const i32 *indices, u64 index_count,
+                            std::shared_ptr<const void> owner) {
+  data_ = hermes::AoS();
+  data_.setStructDescriptor(descriptor);
+  indices_.clear();
+  storage_ = vertex_storage::interleaved;
+  attribute_arrays_.clear();
+  attribute_vertex_count_ = 0;
+  external_.vertices = reinterpret_cast<const u8 *>(vertices);
+  external_.vertex_count = vertex_count;
+  external_.indices = indices;
+  external_.index_count = index_count;
+  external_.owner = std::move(owner);
+  invalidateBoundingBox();
+}
+
+void Model::materialize() {
+  if (storage_ == vertex_storage::separate) {
+    // interleave attribute arrays back into data_
+    hermes::AoS interleaved;
+    interleaved.setStructDescriptor(data_.structDescriptor());
+    interleaved.resize(attribute_vertex_count_);
+    copyVertexData(interleaved.data());
+    data_ = std::move(interleaved);
+    attribute_arrays_.clear();
+    attribute_vertex_count_ = 0;
+    storage_ = vertex_storage::interleaved;
+    return;
+  }
+  if (!external_.owner)
+    return;
+  data_.resize(external_.vertex_count);
+  if (external_.vertex_count)
+    std::memcpy(data_.data(), external_.vertices, external_.vertex_count * data_.structDescriptor().sizeInBytes());
+  indices_.assign(external_.indices, external_.indices + external_.index_count);
+  external_ = {};
+}
+
+const u8 *Model::vertexData() const {
+  if (storage_ == vertex_storage::separate)
+    return nullptr;
+  return external_.owner ? external_.vertices : data_.data();
+}
+
+void Model::copyVertexData(u8 *destination) const {
+  const auto &fields = data_.structDescriptor().fields();
+  const u64 stride = data_.structDescriptor().sizeInBytes();
+  if (storage_ != vertex_storage::separate) {
+    if (vertexCount())
+      std::memcpy(destination, vertexData(), vertexCount() * stride);
+    return;
+  }
+  Parallel::forBlocks(attribute_vertex_count_, [&](u64 begin, u64 end, u32) {
+    for (u64 f = 0; f < fields.size(); ++f) {
+      const u8 *source = attribute_arrays_[f].data();
+      const u64 size = fields[f].size;
+      for (u64 v = begin; v < end; ++v)
+        std::memcpy(destination + v * stride + fields[f].offset, source + v * size, size);
+    }
+  });
+}
+
+const u8 *Model::attributeElements(u64 attribute_index, u64 &stride) const {
+  const auto &fields = data_.structDescriptor().fields();
+  if (attribute_index >= fields.size() || !vertexCount())
+    return nullptr;
+  if (storage_ == vertex_storage::separate) {
+    stride = fields[attribute_index].size;
+    return attribute_arrays_[attribute_index].data();
+  }
+  stride = data_.structDescriptor().sizeInBytes();
+  return vertexData() + fields[attribute_index].offset;
+}
+
+u64 Model::attributeIndex(const std::string &attribute_name) const {
+  const auto &fields = data_.structDescriptor().fields();
+  for (u64 i = 0; i < fields.size(); ++i)
+    if (fields[i].name == attribute_name)
+      return i;
+  return fields.size();
+}
+
+u64 Model::vertexCount() const {
+  if (storage_ == vertex_storage::separate)
+    return attribute_vertex_count_;
+  return external_.owner ? external_.vertex_count : data_.size();
+}
+
+u64 Model::vertexDataSizeInBytes() const {
+  return vertexCount() * data_.structDescriptor().sizeInBytes();
+}
+
+const i32 *Model::indexData() const {
+  return external_.owner ? external_.indices : indices_.data();
+}
+
+u64 Model::indexCount() const {
+  return external_.owner ? external_.index_count : indices_.size();
+}
+
+u8 *Model::mutableVertexData() {
+  materialize();
+  invalidateBoundingBox();
+  return data_.data();
+}
+
+i32 *Model::mutableIndexData() {
+  materialize();
+  return indices_.data();
+}
+
+void Model::setVertexStorage(vertex_storage storage) {
+  if (storage == storage_)
+    return;
+  if (storage == vertex_storage::interleaved) {
+    materialize();
+    return;
+  }
+  materialize();
+  const auto descriptor = data_.structDescriptor();
+  const auto &fields = descriptor.fields();
+  const u64 stride = descriptor.sizeInBytes();
+  const u64 vertex_count = data_.size();
+  attribute_arrays_.resize(fields.size());
+  for (u64 f = 0; f < fields.size(); ++f)
+    attribute_arrays_[f].resize(vertex_count * fields[f].size);
+  const u8 *data = data_.data();
+  Parallel::forBlocks(vertex_count, [&](u64 begin, u64 end, u32) {
+    for (u64 f = 0; f < fields.size(); ++f) {
+      u8 *destination = attribute_arrays_[f].data();
+      const u64 size = fields[f].size;
+      for (u64 v = begin; v < end; ++v)
+        std::memcpy(destination + v * size, data + v * stride + fields[f].offset, size);
+    }
+  });
+  // data_ keeps only the layout
+  data_ = hermes::AoS();
+  data_.setStructDescriptor(descriptor);
+  attribute_vertex_count_ = vertex_count;
+  storage_ = vertex_storage::separate;
+}
+
+const u8 *Model::attributeData(u64 attribute_index) const {
+  if (storage_ != vertex_storage::separate || attribute_index >= attribute_arrays_.size())
+    return nullptr;
+  return attribute_arrays_[attribute_index].data();
+}
+
+u8 *Model::attributeData(u64 attribute_index) {
+  if (storage_ != vertex_storage::separate || attribute_index >= attribute_arrays_.size())
+    return nullptr;
+  invalidateBoundingBox();
+  return attribute_arrays_[attribute_index].data();
+}
+
+void Model::setSubMeshes(std::vector<SubMesh> &&sub_meshes) {
+  sub_meshes_ = std::move(sub_meshes);
+}
+
+void Model::setLevelsOfDetail(std::vector<LevelOfDetail> &&levels) {
+  levels_of_detail_ = std::move(levels);
 }
 
 void Model::setPrimitiveType(hermes::GeometricPrimitiveType primitive_type) {
@@ -110,25 +326,149 @@ std::ostream &operator<<(std::ostream &o, const Model &model) {
     return "ERR";
 #undef ES
   };
-  o << "Model:\n" << model.data_;
+  if (model.isMaterialized())
+    o << "Model:\n" << model.data_;
+  else
+    o << "Model: " << model.vertexCount() << " vertices (external or separate storage)\n";
   o << "Model primitive type " << ESTR(model.element_type_) << std::endl;
   o << "Model Indices(" << model.elementCount() << " primitives):\n";
-  for (auto i : model.indices_)
-    o << i << " ";
+  for (u64 i = 0; i < model.indexCount(); ++i)
+    o << model.indexData()[i] << " ";
   o << std::endl;
   return o;
 }
+u64 Model::positionAttribute() const {
+  const auto &fields = data_.structDescriptor().fields();
+  auto isPoint3 = [&](u64 i) {
+    return fields[i].type == hermes::DataType::F32 && fields[i].component_count == 3;
+  };
+  // 2D positions (Shapes::box(bbox2), ...) are not mistaken for any other field
+  for (u64 i = 0; i < fields.size(); ++i)
+    if (fields[i].name == "position")
+      return isPoint3(i) ? i : fields.size();
+  for (u64 i = 0; i < fields.size(); ++i)
+    if (isPoint3(i))
+      return i;
+  return fields.size();
+}
+
 hermes::bbox3 Model::boundingBox() const {
-  return hermes::bbox3();
+  std::lock_guard<std::mutex> lock(bounding_box_mutex_);
+  if (bounding_box_valid_)
+    return bounding_box_;
+  const u64 position_id = positionAttribute();
+  bounding_box_ = hermes::bbox3();
+  if (position_id < data_.structDescriptor().fields().size()) {
+    const auto &field = data_.structDescriptor().fields()[position_id];
+    if (storage_ == vertex_storage::separate)
+      bounding_box_ = Bounds::ofPoints(attributeData(position_id), vertexCount(), field.size);
+    else
+      bounding_box_ = Bounds::ofPoints(vertexData() + field.offset, vertexCount(),
+                                       data_.structDescriptor().sizeInBytes());
+  }
+  bounding_box_valid_ = true;
+  return bounding_box_;
 }
 
 void Model::fitToBox(const hermes::bbox3 &box) {
-  HERMES_NOT_IMPLEMENTED
-  HERMES_UNUSED_VARIABLE(box)
+  const auto bounds = boundingBox();
+  const u64 position_id = positionAttribute();
+  if (!vertexCount() || position_id >= data_.structDescriptor().fields().size())
+    return;
+  // uniform scale that fits the largest extent ratio
+  real_t scale = hermes::Numbers::greatest<real_t>();
+  for (int d = 0; d < 3; ++d)
+    if (bounds.size(d) > 0)
+      scale = std::min(scale, box.size(d) / bounds.size(d));
+  if (scale == hermes::Numbers::greatest<real_t>())
+    scale = 1;
+  const auto source_center = bounds.centroid();
+  const auto target_center = box.centroid();
+  if (storage_ == vertex_storage::separate) {
+    auto *positions = attributeArray<hermes::point3>(position_id);
+    Parallel::forEach(vertexCount(), [&](u64 i) {
+      positions[i] = target_center + (positions[i] - source_center) * scale;
+    });
+    return;
+  }
+  auto positions = attributeAccessor<hermes::point3>(position_id);
+  Parallel::forEach(vertexCount(), [&](u64 i) {
+    positions[i] = target_center + (positions[i] - source_center) * scale;
+  });
+}
+
+void Model::transform(const hermes::Transform &transform) {
+  if (!vertexCount())
+    return;
+  const bool separate = storage_ == vertex_storage::separate;
+  if (!separate)
+    materialize();
+  const auto &fields = data_.structDescriptor().fields();
+  const u64 stride = separate ? 3 * sizeof(f32) : data_.structDescriptor().sizeInBytes();
+  auto elements = [&](u64 attribute_index) -> u8 * {
+    return separate ? attribute_arrays_[attribute_index].data() : data_.data() + fields[attribute_index].offset;
+  };
+  const auto &matrix = transform.matrix();
+  f32 m[3][4];
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 4; ++j)
+      m[i][j] = matrix[i][j];
+  f32 normal_matrix[3][4];
+  const bool invertible = TransformKernels::normalMatrix(m, normal_matrix);
+  if (!invertible)
+    hermes::Log::warn("Model transform is singular, normals are left unchanged.");
+  const bool projective = matrix[3][0] != 0 || matrix[3][1] != 0 || matrix[3][2] != 0 || matrix[3][3] != 1;
+  const u64 position_id = positionAttribute();
+  for (u64 i = 0; i < fields.size(); ++i) {
+    if (fields[i].type != hermes::DataType::F32 || fields[i].component_count != 3)
+      continue;
+    if (i == position_id) {
+      if (!projective) {
+        TransformKernels::transformPoints(m, elements(i), vertexCount(), stride);
+        continue;
+      }
+      // the homogeneous divide is not vectorized
+      u8 *positions = elements(i);
+      Parallel::forEach(vertexCount(), [&](u64 v) {
+        hermes::point3 p;
+        std::memcpy(&p, positions + v * stride, sizeof(p));
+        p = transform(p);
+        std::memcpy(positions + v * stride, &p, sizeof(p));
+      });
+      continue;
+    }
+    const auto semantic = AttributeSemantics::fromName(fields[i].name);
+    if (semantic == attribute_semantic::normal) {
+      if (invertible)
+        TransformKernels::transformVectors(normal_matrix, elements(i), vertexCount(), stride, true);
+    } else if (AttributeSemantics::isDirection(semantic))
+      TransformKernels::transformVectors(m, elements(i), vertexCount(), stride, true);
+  }
+  invalidateBoundingBox();
+  boundingBox();
+}
+
+void Model::normalizeAttribute(u64 attribute_index) {
+  const auto &fields = data_.structDescriptor().fields();
+  if (attribute_index >= fields.size() || fields[attribute_index].type != hermes::DataType::F32 ||
+      fields[attribute_index].component_count != 3) {
+    hermes::Log::warn("Only 3-component f32 attributes can be normalized.");
+    return;
+  }
+  if (storage_ == vertex_storage::separate) {
+    TransformKernels::normalize(attribute_arrays_[attribute_index].data(), vertexCount());
+    return;
+  }
+  materialize();
+  TransformKernels::normalize(data_.data() + fields[attribute_index].offset, vertexCount(),
+                              data_.structDescriptor().sizeInBytes());
 }
 
 u64 Model::elementCount() const {
-  size_t index_count = indices_.empty() ? data_.size() : indices_.size();
+  size_t index_count = indexCount() ? indexCount() : vertexCount();
+  // only the full resolution level counts
+  if (!levels_of_detail_.empty())
+    index_count = levels_of_detail_.front().index_count;
   switch (element_type_) {
   case hermes::GeometricPrimitiveType::TRIANGLES: return index_count / 3;
   case hermes::GeometricPrimitiveType::LINES: return index_count / 2;
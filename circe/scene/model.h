@@ -35,12 +35,65 @@
 #include <circe/gl/storage/index_buffer.h>
 #include <circe/gl/graphics/shader.h>
 #include <circe/scene/shape_options.h>
+#include <memory>
+#include <mutex>
 
 namespace circe {
 
+/// Vertex data layout of a Model
+enum class vertex_storage {
+  interleaved = 0, //!< a single array of structures (default)
+  separate = 1     //!< one contiguous array per attribute (structure of arrays)
+};
+
+/// Read-only strided view of a vertex attribute. Works over every vertex
+/// storage of a Model (owned, external or separate) without copying.
+template<typename T> class ConstAttributeView {
+public:
+  ConstAttributeView() = default;
+  /// \param data address of the first element
+  /// \param stride distance in bytes between consecutive elements
+  /// \param size number of elements
+  ConstAttributeView(const u8 *data, u64 stride, u64 size) : data_(data), stride_(stride), size_(size) {}
+  const T &operator[](u64 i) const { return *reinterpret_cast<const T *>(data_ + i * stride_); }
+  [[nodiscard]] u64 size() const { return size_; }
+
+private:
+  const u8 *data_{nullptr};
+  u64 stride_{0};
+  u64 size_{0};
+};
+
 /// Stores mesh data in interleaved fashion
+///
+/// Notes:
+/// - Vertex and index data may live in external memory (e.g. a memory mapped
+///   model cache file, see setExternalData). External data is read in place
+///   through the raw accessors (vertexData, indexData, ...) and the const
+///   attribute accessors. Non-const accessors and modifiers copy it into the
+///   model first (see materialize()).
+/// - With separate vertex storage (see setVertexStorage) each attribute is a
+///   contiguous array (attributeData, attributeArray), so attributes can be
+///   updated and uploaded independently. Non-const methods that need
+///   interleaved data switch the model back to interleaved storage.
+/// - Const methods never change the storage: data() and indices() require
+///   owned interleaved data (call materialize() first), vertexData() is
+///   nullptr for separate storage.
 class Model {
 public:
+  /// A range of indices (e.g. a part of an assembly) drawn with one material
+  struct SubMesh {
+    std::string name;
+    u64 index_offset{0}; //!< first index
+    u64 index_count{0};  //!< number of indices
+    i32 material_id{-1}; //!< -1 means no material
+  };
+  /// A simplified version of the mesh stored as a range of the shared index data
+  struct LevelOfDetail {
+    u64 index_offset{0}; //!< first index
+    u64 index_count{0};  //!< number of indices
+    f32 error{0};        //!< geometric deviation from level 0 (in model units)
+  };
   // ***********************************************************************
   //                          STATIC METHODS
   // ***********************************************************************
@@ -66,40 +119,196 @@ public:
   // ***********************************************************************
   template<typename T>
   hermes::AoSFieldView<T> attributeAccessor(const std::string &attribute_name) {
+    materialize();
+    invalidateBoundingBox();
     return data_.field<T>(attribute_name);
   }
   template<typename T>
   hermes::AoSFieldView<T> attributeAccessor(u64 attribute_index) {
+    materialize();
+    invalidateBoundingBox();
     return data_.field<T>(attribute_index);
   }
+  /// \tparam T attribute type (must match the field size)
+  /// \param attribute_name
+  /// \return view over the attribute in its current storage (no copies)
   template<typename T>
-  hermes::ConstAoSFieldView<T> attributeAccessor(const std::string &attribute_name) const {
-    return data_.field<T>(attribute_name);
+  ConstAttributeView<T> attributeAccessor(const std::string &attribute_name) const {
+    return attributeAccessor<T>(attributeIndex(attribute_name));
   }
   template<typename T>
-  hermes::ConstAoSFieldView<T> attributeAccessor(u64 attribute_index) const {
-    return data_.field<T>(attribute_index);
+  ConstAttributeView<T> attributeAccessor(u64 attribute_index) const {
+    HERMES_ASSERT(attribute_index < vertexDescriptor().fields().size());
+    HERMES_ASSERT(vertexDescriptor().fields()[attribute_index].size == sizeof(T));
+    u64 stride = 0;
+    const u8 *elements = attributeElements(attribute_index, stride);
+    return ConstAttributeView<T>(elements, stride, vertexCount());
   }
   template<typename T>
-  T &attributeValue(u64 attribute_index, u64 vertex_index) { return data_.valueAt<T>(attribute_index, vertex_index); }
+  T &attributeValue(u64 attribute_index, u64 vertex_index) {
+    materialize();
+    invalidateBoundingBox();
+    return data_.valueAt<T>(attribute_index, vertex_index);
+  }
   template<typename T>
   u64 pushAttribute(const std::string &attribute_name) {
+    materialize();
     return data_.pushField<T>(attribute_name);
   }
-  const hermes::AoS &data() const { return data_; }
-  const std::vector<i32> &indices() const { return indices_; }
+  /// \note requires owned interleaved data (see materialize())
+  const hermes::AoS &data() const {
+    HERMES_ASSERT(isMaterialized());
+    return data_;
+  }
+  /// \note requires owned data (see materialize())
+  const std::vector<i32> &indices() const {
+    HERMES_ASSERT(!hasExternalData());
+    return indices_;
+  }
+  /// Copies external vertex/index data into the model and interleaves
+  /// separate attribute arrays. Non-const accessors and modifiers call it,
+  /// const readers of data() and indices() must call it beforehand.
+  void materialize();
+  /// \return true if data is owned by the model and interleaved
+  [[nodiscard]] bool isMaterialized() const {
+    return !hasExternalData() && storage_ == vertex_storage::interleaved;
+  }
   hermes::GeometricPrimitiveType primitiveType() const { return element_type_; }
   void resize(u64 new_size);
   void setIndices(std::vector<i32> &&indices);
   void setPrimitiveType(hermes::GeometricPrimitiveType primitive_type);
   u64 elementCount() const;
+  /// Makes the model reference vertex and index data stored elsewhere,
+  /// without copying it.
+  /// \param descriptor vertex layout
+  /// \param vertices interleaved vertex data (vertex_count * descriptor.sizeInBytes() bytes)
+  /// \param vertex_count
+  /// \param indices
+  /// \param index_count
+  /// \param owner keeps the external memory alive while the model references it
+  void setExternalData(const hermes::StructDescriptor &descriptor,
+                       const void *vertices, u64 vertex_count,
+                       const i32 *indices, u64 index_count,
+                       std::shared_ptr<const void> owner);
+  /// \return true while vertex and index data live in external memory
+  bool hasExternalData() const { return external_.owner != nullptr; }
+  // raw access (never copies external data)
+  const hermes::StructDescriptor &vertexDescriptor() const { return data_.structDescriptor(); }
+  /// \return interleaved vertex data, nullptr with separate vertex storage
+  const u8 *vertexData() const;
+  /// Writes interleaved vertex data (vertexDataSizeInBytes() bytes) for any
+  /// vertex storage
+  /// \param destination
+  void copyVertexData(u8 *destination) const;
+  /// \param attribute_index
+  /// \param stride **[out]** distance in bytes between consecutive elements
+  /// \return address of the first element of the attribute in its current
+  ///         storage (nullptr if there is no such attribute or no data)
+  const u8 *attributeElements(u64 attribute_index, u64 &stride) const;
+  /// \param attribute_name
+  /// \return attribute index, number of attributes if not found
+  [[nodiscard]] u64 attributeIndex(const std::string &attribute_name) const;
+  u64 vertexCount() const;
+  u64 vertexDataSizeInBytes() const;
+  const i32 *indexData() const;
+  u64 indexCount() const;
+  /// Interleaved vertex data for in place edits (see materialize())
+  /// \note invalidates the bounding box
+  /// \return vertexDataSizeInBytes() bytes
+  u8 *mutableVertexData();
+  /// Index data for in place edits (see materialize())
+  /// \return indexCount() indices
+  i32 *mutableIndexData();
+  /// Sub-meshes partition the index range of models that merge several
+  /// meshes into a single vertex/index block. Empty for single meshes.
+  /// \param sub_meshes
+  void setSubMeshes(std::vector<SubMesh> &&sub_meshes);
+  const std::vector<SubMesh> &subMeshes() const { return sub_meshes_; }
+  /// Levels of detail share the vertex data and own consecutive index
+  /// ranges. Level 0 is the full resolution mesh (the range sub-meshes refer
+  /// to) and errors grow with the level. Empty if there is a single level.
+  /// \param levels
+  void setLevelsOfDetail(std::vector<LevelOfDetail> &&levels);
+  const std::vector<LevelOfDetail> &levelsOfDetail() const { return levels_of_detail_; }
 
+  /// Bounds of the position attribute (see positionAttribute()). The result
+  /// is cached until vertex data is modified through the model (accessors,
+  /// assignments, resize, ...).
+  /// \return empty box if the model has no positions
   hermes::bbox3 boundingBox() const;
+  /// Translates and uniformly scales positions so the model is centered
+  /// in box and touches its closest faces (aspect ratio is kept).
+  /// \param box
   void fitToBox(const hermes::bbox3 &box = hermes::bbox3::unitBox());
+  /// Positions are always 3 x f32, so callers (bounds, fitToBox, mesh
+  /// optimization, ...) can read them as hermes::point3
+  /// \return index of the position attribute ("position", or the first
+  ///         3-component f32 attribute), number of attributes if there is
+  ///         none or if "position" has another type
+  u64 positionAttribute() const;
+  /// Must be called after vertex positions are written through memory
+  /// obtained outside the model accessors
+  void invalidateBoundingBox() { bounding_box_valid_ = false; }
+  /// Bakes a transform into vertex data: positions get the full transform,
+  /// normals the inverse transpose and tangents/bitangents the linear part
+  /// (direction attributes are renormalized). Attribute roles come from
+  /// AttributeSemantics. Runs TransformKernels over
+  /// either vertex storage and recomputes the bounding box.
+  /// \param transform
+  void transform(const hermes::Transform &transform);
+  /// Normalizes a 3-component f32 attribute in place
+  /// \param attribute_index
+  void normalizeAttribute(u64 attribute_index);
+  // ***********************************************************************
+  //                        SEPARATE ATTRIBUTES
+  // ***********************************************************************
+  /// Converts vertex data between interleaved and separate attribute arrays
+  /// \param storage
+  void setVertexStorage(vertex_storage storage);
+  [[nodiscard]] vertex_storage vertexStorage() const { return storage_; }
+  /// Contiguous data of a single attribute (vertexCount() * field size bytes)
+  /// \note nullptr unless the model uses separate vertex storage
+  /// \param attribute_index
+  /// \return
+  [[nodiscard]] const u8 *attributeData(u64 attribute_index) const;
+  /// \note invalidates the bounding box
+  /// \param attribute_index
+  /// \return
+  u8 *attributeData(u64 attribute_index);
+  /// \tparam T attribute type (must match the field size)
+  /// \param attribute_index
+  /// \return
+  template<typename T>
+  T *attributeArray(u64 attribute_index) {
+    return reinterpret_cast<T *>(attributeData(attribute_index));
+  }
+  template<typename T>
+  const T *attributeArray(u64 attribute_index) const {
+    return reinterpret_cast<const T *>(attributeData(attribute_index));
+  }
 
 protected:
+  struct ExternalData {
+    const u8 *vertices{nullptr};
+    u64 vertex_count{0};
+    const i32 *indices{nullptr};
+    u64 index_count{0};
+    std::shared_ptr<const void> owner;
+  };
   hermes::AoS data_;
   std::vector<i32> indices_;
+  // external data is copied by materialize()
+  ExternalData external_;
+  // separate vertex storage (data_ keeps only the descriptor)
+  vertex_storage storage_{vertex_storage::interleaved};
+  std::vector<std::vector<u8>> attribute_arrays_;
+  u64 attribute_vertex_count_{0};
+  std::vector<SubMesh> sub_meshes_;
+  std::vector<LevelOfDetail> levels_of_detail_;
+  // boundingBox() cache, concurrent const calls are serialized
+  mutable std::mutex bounding_box_mutex_;
+  mutable hermes::bbox3 bounding_box_;
+  mutable bool bounding_box_valid_{false};
   hermes::GeometricPrimitiveType element_type_{hermes::GeometricPrimitiveType::TRIANGLES};
 };
 
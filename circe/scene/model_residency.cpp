@@ -0,0 +1,150 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file model_residency.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-28
+///
+///\brief
+
+#include <circe/scene/model_residency.h>
+#include <circe/common/parallel.h>
+#include <algorithm>
+#include <cstring>
+
+namespace circe {
+
+ModelResidency::Layout ModelResidency::layoutOf(const Model &model) {
+  Layout layout;
+  layout.vertex_descriptor = model.vertexDescriptor();
+  layout.storage = model.vertexStorage();
+  layout.primitive_type = model.primitiveType();
+  layout.vertex_count = model.vertexCount();
+  layout.index_count = model.indexCount();
+  layout.sub_meshes = model.subMeshes();
+  layout.levels_of_detail = model.levelsOfDetail();
+  return layout;
+}
+
+bool ModelResidency::release(Model &model, cpu_residency residency) {
+  if (residency == cpu_residency::keep || !model.vertexCount())
+    return true;
+  if (residency == cpu_residency::release) {
+    model = Model();
+    return true;
+  }
+  const Model &source_model = model;
+  const auto &fields = source_model.vertexDescriptor().fields();
+  const u64 position_id = source_model.positionAttribute();
+  if (position_id >= fields.size() || fields[position_id].type != hermes::DataType::F32 ||
+      fields[position_id].component_count != 3) {
+    hermes::Log::warn("ModelResidency: keeping all vertex data, positions are not stored as 3 floats.");
+    return false;
+  }
+  hermes::AoS positions;
+  positions.pushField<hermes::point3>("position");
+  positions.resize(source_model.vertexCount());
+  // raw reads do not copy externally stored (memory mapped) data
+  const bool separate = source_model.vertexStorage() == vertex_storage::separate;
+  const u8 *source = separate ? source_model.attributeData(position_id) :
+                     source_model.vertexData() + fields[position_id].offset;
+  const u64 stride = separate ? sizeof(hermes::point3) : source_model.vertexDescriptor().sizeInBytes();
+  u8 *destination = positions.data();
+  Parallel::forBlocks(source_model.vertexCount(), [&](u64 begin, u64 end, u32) {
+    for (u64 i = begin; i < end; ++i)
+      std::memcpy(destination + i * sizeof(hermes::point3), source + i * stride, sizeof(hermes::point3));
+  });
+  Model positions_model;
+  positions_model = std::move(positions);
+  positions_model.setIndices(std::vector<i32>(source_model.indexData(),
+                                              source_model.indexData() + source_model.indexCount()));
+  positions_model.setPrimitiveType(source_model.primitiveType());
+  positions_model.setSubMeshes(std::vector<Model::SubMesh>(source_model.subMeshes()));
+  positions_model.setLevelsOfDetail(std::vector<Model::LevelOfDetail>(source_model.levelsOfDetail()));
+  model = std::move(positions_model);
+  return true;
+}
+
+bool ModelResidency::holdsLayout(const Model &model, const Layout &layout) {
+  if (model.vertexCount() != layout.vertex_count)
+    return false;
+  const auto &fields = model.vertexDescriptor().fields();
+  const auto &layout_fields = layout.vertex_descriptor.fields();
+  if (fields.size() != layout_fields.size() ||
+      model.vertexDescriptor().sizeInBytes() != layout.vertex_descriptor.sizeInBytes())
+    return false;
+  for (u64 i = 0; i < fields.size(); ++i)
+    if (fields[i].name != layout_fields[i].name || fields[i].type != layout_fields[i].type ||
+        fields[i].component_count != layout_fields[i].component_count || fields[i].offset != layout_fields[i].offset)
+      return false;
+  return true;
+}
+
+Model ModelResidency::restore(const Layout &layout, const std::vector<std::vector<u8>> &vertex_buffers,
+                              const std::vector<u8> &index_data) {
+  Model model;
+  if (!layout.vertex_count || vertex_buffers.empty())
+    return model;
+  if (layout.quantized) {
+    auto vertices = layout.quantized_vertices;
+    vertices.data = vertex_buffers.front();
+    vertices.data.resize(vertices.vertex_count * vertices.stride, 0);
+    model = VertexQuantizer::dequantize(vertices);
+  } else if (layout.storage == vertex_storage::separate) {
+    // gather attribute buffers
+    hermes::AoS aos;
+    aos.setStructDescriptor(layout.vertex_descriptor);
+    aos.resize(layout.vertex_count);
+    const auto &fields = layout.vertex_descriptor.fields();
+    for (u64 i = 0; i < fields.size() && i < vertex_buffers.size(); ++i) {
+      const auto &attribute_data = vertex_buffers[i];
+      const u64 count = std::min<u64>(aos.size(), attribute_data.size() / fields[i].size);
+      u8 *destination = aos.data() + fields[i].offset;
+      for (u64 v = 0; v < count; ++v)
+        std::memcpy(destination + v * aos.stride(), attribute_data.data() + v * fields[i].size, fields[i].size);
+    }
+    model = std::move(aos);
+  } else {
+    const auto &vertex_data = vertex_buffers.front();
+    if (vertex_data.empty())
+      return model;
+    hermes::AoS aos;
+    aos.setStructDescriptor(layout.vertex_descriptor);
+    aos.resize(layout.vertex_count);
+    std::memcpy(aos.data(), vertex_data.data(), std::min<u64>(vertex_data.size(), aos.memorySizeInBytes()));
+    model = std::move(aos);
+  }
+  if (layout.index_count && !index_data.empty()) {
+    std::vector<i32> indices(layout.index_count);
+    std::memcpy(indices.data(), index_data.data(),
+                std::min<u64>(index_data.size(), layout.index_count * sizeof(i32)));
+    model.setIndices(std::move(indices));
+  }
+  model.setPrimitiveType(layout.primitive_type);
+  model.setSubMeshes(std::vector<Model::SubMesh>(layout.sub_meshes));
+  model.setLevelsOfDetail(std::vector<Model::LevelOfDetail>(layout.levels_of_detail));
+  // last, setIndices interleaves vertex data
+  if (!layout.quantized)
+    model.setVertexStorage(layout.storage);
+  return model;
+}
+
+}
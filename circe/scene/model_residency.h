@@ -0,0 +1,89 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file model_residency.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-28
+///
+///\brief Host copies of models whose data lives in gpu buffers
+
+#ifndef CIRCE_CIRCE_SCENE_MODEL_RESIDENCY_H
+#define CIRCE_CIRCE_SCENE_MODEL_RESIDENCY_H
+
+#include <circe/scene/model.h>
+#include <circe/scene/vertex_quantizer.h>
+
+namespace circe {
+
+/// Host copy kept by a model after its data is uploaded to the gpu
+enum class cpu_residency {
+  keep = 0,           //!< model() holds all vertex and index data
+  positions_only = 1, //!< model() holds positions and indices only (picking, bounds)
+  release = 2         //!< model() is emptied, data lives only in gpu buffers
+};
+
+/// Drops host model data that is also stored in gpu buffers and rebuilds
+/// host models from raw buffer contents. Buffers are read by the caller, so
+/// nothing here depends on a GL context.
+class ModelResidency final {
+public:
+  /// Description of uploaded vertex and index data (holds no data)
+  struct Layout {
+    hermes::StructDescriptor vertex_descriptor;
+    vertex_storage storage{vertex_storage::interleaved};
+    bool quantized{false};
+    QuantizedVertices quantized_vertices; //!< attributes only, no data
+    hermes::GeometricPrimitiveType primitive_type{hermes::GeometricPrimitiveType::TRIANGLES};
+    u64 vertex_count{0};
+    u64 index_count{0};
+    std::vector<Model::SubMesh> sub_meshes;
+    std::vector<Model::LevelOfDetail> levels_of_detail;
+  };
+  /// \param model
+  /// \return layout of model data (quantized fields are left to the caller)
+  static Layout layoutOf(const Model &model);
+  /// Keeps in model only the data residency asks for
+  /// \param model
+  /// \param residency
+  /// \return false if model was kept whole (positions are not stored as 3 floats)
+  static bool release(Model &model, cpu_residency residency);
+  /// Checks if model still holds every uploaded attribute with the uploaded
+  /// layout, so its data can be uploaded again over the gpu buffers (it does
+  /// not after a release, or after attributes are pushed)
+  /// \param model
+  /// \param layout
+  /// \return
+  static bool holdsLayout(const Model &model, const Layout &layout);
+  /// Rebuilds a host model from raw buffer contents. Quantized vertex data is
+  /// decoded (see VertexQuantizer::dequantize).
+  /// \param layout
+  /// \param vertex_buffers one buffer per attribute for separate storage (empty
+  ///                       buffers leave their attribute zeroed), a single
+  ///                       buffer otherwise
+  /// \param index_data raw i32 indices
+  /// \return an empty model if there is no vertex data
+  static Model restore(const Layout &layout, const std::vector<std::vector<u8>> &vertex_buffers,
+                       const std::vector<u8> &index_data);
+};
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_MODEL_RESIDENCY_H
@@ -45,7 +45,9 @@ enum class shape_options {
   wireframe = 0x80, //!< only edges
   vertices = 0x100, //!< only vertices
   flip_normals = 0x200, //!< flip normals to point inwards (uv coordinates may change as well)
-  flip_faces = 0x400 //!< reverse face vertex order
+  flip_faces = 0x400, //!< reverse face vertex order
+  optimize = 0x800, //!< reorder triangles and vertices for vertex cache, overdraw and vertex fetch
+  quantize = 0x1000 //!< upload vertex attributes in compressed formats (see VertexQuantizer)
 };
 CIRCE_ENABLE_BITMASK_OPERATORS(shape_options);
 }
@@ -27,6 +27,17 @@
 
 #include <circe/scene/shapes.h>
 #include <circe/scene/model.h>
+#include <circe/scene/edge_extractor.h>
+#include <circe/scene/mesh_optimizer.h>
+#include <circe/scene/tangent_space.h>
+#include <circe/common/parallel.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 
 using namespace hermes;
 
@@ -104,8 +115,10 @@ Model Shapes::convert(const Model &model, shape_options options, const std::vect
   const bool wireframe = testMaskBit(options, shape_options::wireframe);
   const bool unique_positions = testMaskBit(options, shape_options::unique_positions);
   const bool only_vertices = testMaskBit(options, shape_options::vertices);
-  // TODO the following options are not handled!
+  if ((options & shape_options::tangent_space) == shape_options::tangent_space)
+    options = options | shape_options::tangent | shape_options::bitangent;
   const bool generate_normals = testMaskBit(options, shape_options::normal);
+  // TODO uv generation is not handled!
   const bool generate_uvs = testMaskBit(options, shape_options::uv);
   const bool generate_tangents = testMaskBit(options, shape_options::tangent);
   const bool generate_bitangents = testMaskBit(options, shape_options::bitangent);
@@ -114,10 +127,10 @@ Model Shapes::convert(const Model &model, shape_options options, const std::vect
   // attribute description
   StructDescriptor descriptor;
   if (attr_filter.empty())
-    descriptor = model.data().structDescriptor();
+    descriptor = model.vertexDescriptor();
   else {
     // filter attributes
-    const auto &fields = model.data().fields();
+    const auto &fields = model.vertexDescriptor().fields();
     for (const auto &field_id : attr_filter) {
 #define ADD_FIELD(D, C, T) \
       if(fields[field_id].type == D && fields[field_id].component_count == C) \
@@ -128,15 +141,33 @@ Model Shapes::convert(const Model &model, shape_options options, const std::vect
 #undef ADD_FIELD
     }
   }
+  // generated attributes are appended after the copied ones
+  const u64 copied_field_count = descriptor.fields().size();
+  const bool generate_tangent_space = !wireframe && !only_vertices &&
+      model.primitiveType() == GeometricPrimitiveType::TRIANGLES;
+  auto hasField = [&](const std::vector<std::string> &names) {
+    for (const auto &field : descriptor.fields())
+      if (std::find(names.begin(), names.end(), field.name) != names.end())
+        return true;
+    return false;
+  };
+  if (generate_tangent_space) {
+    if (generate_normals && !hasField({"normal", "normals"}))
+      descriptor.pushField<vec3f>("normal");
+    if (generate_tangents && !hasField({"tangents", "tangent"}))
+      descriptor.pushField<vec3f>("tangents");
+    if (generate_bitangents && !hasField({"bitangents", "bitangent"}))
+      descriptor.pushField<vec3f>("bitangents");
+  }
 
   auto primitive_type = model.primitiveType();
   // Lets check if there will be any change in some mesh count
   size_t converted_model_element_count = model.elementCount();
-  size_t converted_model_vertex_count = model.data().size();
+  size_t converted_model_vertex_count = model.vertexCount();
   // For now, only wireframe options is able to change element count.
   // Only if the input model is not a wireframe.
   // The new element count will be given by edges count
-  std::set<std::pair<u64, u64>> edges;
+  std::vector<i32> edges;
   if (wireframe && model.primitiveType() != GeometricPrimitiveType::LINES &&
       model.primitiveType() != GeometricPrimitiveType::POINTS &&
       model.primitiveType() != GeometricPrimitiveType::LINE_LOOP &&
@@ -150,23 +181,15 @@ Model Shapes::convert(const Model &model, shape_options options, const std::vect
       break;
     default:Log::warn("GeometricPrimitiveType not implemented in circe::Shapes::convert");
     }
-    const auto &model_indices = model.indices();
     u64 element_count = model.elementCount();
-    HERMES_ASSERT(element_count * element_size <= model_indices.size());
-    for (u64 e = 0; e < element_count; ++e)
-      for (u32 k = 0; k < element_size; ++k) {
-        u64 a = std::min(model_indices[e * element_size + k],
-                         model_indices[e * element_size + (k + 1) % element_size]);
-        u64 b = std::max(model_indices[e * element_size + k],
-                         model_indices[e * element_size + (k + 1) % element_size]);
-        edges.insert(std::make_pair(a, b));
-      }
+    HERMES_ASSERT(element_count * element_size <= model.indexCount());
+    edges = EdgeExtractor::extract(model.indexData(), element_count, element_size);
     primitive_type = GeometricPrimitiveType::LINES;
   }
   // In the case of vertex count, the unique_positions options will create
   // new vertices
   if (unique_positions)
-    converted_model_vertex_count = edges.empty() ? model.indices().size() : edges.size() * 2;
+    converted_model_vertex_count = edges.empty() ? model.indexCount() : edges.size();
 
   AoS aos;
   aos.setStructDescriptor(descriptor);
@@ -176,22 +199,19 @@ Model Shapes::convert(const Model &model, shape_options options, const std::vect
   // First, lets create indices
   std::vector<i32> indices;
   if (edges.empty() && !unique_positions)
-    indices = model.indices();
+    indices.assign(model.indexData(), model.indexData() + model.indexCount());
   else if (!edges.empty())
-    for (auto e : edges) {
-      indices.emplace_back(e.first);
-      indices.emplace_back(e.second);
-    }
+    indices = std::move(edges);
   // now we copy field data
   // unique positions will get an empty indices vector
   if (indices.empty()) {
-    const auto &model_indices = model.indices();
-    for (size_t i = 0; i < model_indices.size(); ++i) {
+    const i32 *model_indices = model.indexData();
+    for (size_t i = 0; i < model.indexCount(); ++i) {
       u64 f = 0;
-      for (size_t j = 0; j < fields.size(); ++j) {
+      for (size_t j = 0; j < copied_field_count; ++j) {
 #define CPY_FIELD(D, C, T) \
       if(fields[j].type == D && fields[j].component_count == C) {               \
-        const auto& field = model.data().field<T>(fields[j].name);              \
+        const auto field = model.attributeAccessor<T>(fields[j].name);         \
           aos.valueAt<T>(f, i) = field[model_indices[i]];                       \
           }
         CPY_FIELD(DataType::F32, 1, f32)
@@ -203,10 +223,10 @@ Model Shapes::convert(const Model &model, shape_options options, const std::vect
     }
   } else {
     u64 f = 0;
-    for (size_t field_id = 0; field_id < fields.size(); ++field_id) {
+    for (size_t field_id = 0; field_id < copied_field_count; ++field_id) {
 #define CPY_FIELD(D, C, T) \
       if(fields[field_id].type == D && fields[field_id].component_count == C) { \
-        const auto& field = model.data().field<T>(fields[field_id].name);       \
+        const auto field = model.attributeAccessor<T>(fields[field_id].name);  \
         for(u64 i : indices)                                                    \
           aos.valueAt<T>(f, i) = field[i];                                      \
           }
@@ -222,126 +242,330 @@ Model Shapes::convert(const Model &model, shape_options options, const std::vect
   converted_model = aos;
   converted_model = indices;
   converted_model.setPrimitiveType(primitive_type);
+  if (generate_tangent_space)
+    TangentSpace::generate(converted_model, options & (shape_options::normal | shape_options::tangent |
+        shape_options::bitangent));
+  if (testMaskBit(options, shape_options::optimize))
+    MeshOptimizer::optimize(converted_model);
   return std::move(converted_model);
 }
 
-Model Shapes::icosphere(const point3 &center, real_t radius, u32 divisions, shape_options options) {
-  const bool generate_wireframe = testMaskBit(options, shape_options::wireframe);
-  const bool only_vertices = testMaskBit(options, shape_options::vertices);
-  const bool generate_normals = testMaskBit(options, shape_options::normal);
-  const bool generate_uvs = testMaskBit(options, shape_options::uv);
-  const bool generate_tangents = testMaskBit(options, shape_options::tangent);
-  const bool generate_bitangents = testMaskBit(options, shape_options::bitangent);
-  const bool flip_normals = testMaskBit(options, shape_options::flip_normals);
-  const bool flip_faces = testMaskBit(options, shape_options::flip_faces);
-  const bool unique_positions = testMaskBit(options, shape_options::unique_positions);
+namespace {
 
-  AoS aos;
-  aos.pushField<point3>("position");
-  u64 struct_size = 3;
-  if (generate_normals) {
-    aos.pushField<vec3>("normal");
-    struct_size += 3;
+/// Writes interleaved vertex attributes into caller provided memory
+struct VertexSpan {
+  template<typename T>
+  void write(u64 vertex_index, u64 offset, const T &value) const {
+    std::memcpy(data + vertex_index * stride + offset, &value, sizeof(T));
   }
-  if (generate_uvs) {
-    aos.pushField<point2>("uv");
-    struct_size += 2;
+  u8 *data{nullptr};
+  u64 stride{0};
+};
+
+/// Offsets of optional f32 attributes, following the generators field order.
+/// Computed from options only, so writers never build descriptors.
+struct FieldOffsets {
+  /// \param sizes byte size of each optional attribute (0 if absent)
+  explicit FieldOffsets(std::initializer_list<u64> sizes, u64 position_size = sizeof(f32) * 3) {
+    stride = position_size;
+    u64 i = 0;
+    for (auto size : sizes) {
+      offsets[i++] = size ? stride : 0;
+      stride += size;
+    }
   }
-  // starting sphere
-  float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
-  std::vector<real_t> vertex_data(12 * struct_size);
-#define STORE_POSITION(INDEX, X, Y, Z) \
-  *(vertex_data.data() + struct_size * (INDEX) + 0) = X; \
-  *(vertex_data.data() + struct_size * (INDEX) + 1) = Y; \
-  *(vertex_data.data() + struct_size * (INDEX) + 2) = Z;
-#define ADD_FACE(A, B, C) \
-            index_data.emplace_back(A);              \
-            index_data.emplace_back(B);              \
-            index_data.emplace_back(C);
-  STORE_POSITION(0, -1, t, 0);
-  STORE_POSITION(1, 1, t, 0);
-  STORE_POSITION(2, -1, -t, 0);
-  STORE_POSITION(3, 1, -t, 0);
-  STORE_POSITION(4, 0, -1, t);
-  STORE_POSITION(5, 0, 1, t);
-  STORE_POSITION(6, 0, -1, -t);
-  STORE_POSITION(7, 0, 1, -t);
-  STORE_POSITION(8, t, 0, -1);
-  STORE_POSITION(9, t, 0, 1);
-  STORE_POSITION(10, -t, 0, -1);
-  STORE_POSITION(11, -t, 0, 1);
-  std::vector<i32> index_data = {0, 11, 5,/**/ 0, 5, 1,/**/0, 1, 7,/**/0, 7, 10,/**/0, 10, 11,/**/
-                                 1, 5, 9,/**/  5, 11, 4,/**/11, 10, 2,/**/10, 7, 6,/**/7, 1, 8,/**/
-                                 3, 9, 4,/**/3, 4, 2,/**/3, 2, 6,/**/3, 6, 8,/**/3, 8, 9,/**/
-                                 4, 9, 5,/**/2, 4, 11,/**/6, 2, 10,/**/8, 6, 7,/**/9, 8, 1};
-  // refine mesh
-  std::map<std::pair<u32, u32>, u64> indices_cache;
-  std::function<u64(u32, u32)> midPoint = [&](u32 a, u32 b) -> u64 {
-    std::pair<u32, u32> key(std::min(a, b), std::max(a, b));
-    u64 n = vertex_data.size() / struct_size;
-    if (indices_cache.find(key) != indices_cache.end())
-      return indices_cache[key];
-    const point3 &pa = *reinterpret_cast<point3 *>(vertex_data.data() + struct_size * a);
-    const point3 &pb = *reinterpret_cast<point3 *>(vertex_data.data() + struct_size * b);
-    auto pm = pa + (pb - pa) * 0.5f;
-    vertex_data.resize(vertex_data.size() + struct_size);
-    STORE_POSITION(n, pm.x, pm.y, pm.z);
-    return n;
+  u64 offsets[6]{};
+  u64 stride{0};
+};
+
+/// Shared topology of the base icosahedron used by the tessellation
+struct Icosahedron {
+  Icosahedron() {
+    for (auto &row : edge_ids)
+      row.fill(-1);
+    corner_owners.fill(-1);
+    u32 edge_count = 0;
+    for (u32 f = 0; f < 20; ++f)
+      for (u32 k = 0; k < 3; ++k) {
+        const u32 a = faces[f][k];
+        const u32 b = faces[f][(k + 1) % 3];
+        if (corner_owners[a] < 0)
+          corner_owners[a] = static_cast<i32>(f);
+        if (edge_ids[a][b] < 0) {
+          edge_ids[a][b] = edge_ids[b][a] = static_cast<i32>(edge_count);
+          edge_owners[edge_count++] = f;
+        }
+      }
+  }
+  static const Icosahedron &get() {
+    static const Icosahedron icosahedron;
+    return icosahedron;
+  }
+  static constexpr u32 faces[20][3] = {{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+                                       {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+                                       {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+                                       {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}};
+  std::array<std::array<i32, 12>, 12> edge_ids{};
+  std::array<i32, 12> corner_owners{};
+  std::array<u32, 30> edge_owners{};
+};
+
+constexpr u32 Icosahedron::faces[20][3];
+
+AoS allocate(const Shapes::Layout &layout) {
+  AoS aos;
+  aos.setStructDescriptor(layout.vertex_descriptor);
+  aos.resize(layout.vertex_count);
+  return aos;
+}
+
+/// \return interleaved vertex data of the model (position is the first attribute)
+void *vertexMemory(Model &model) {
+  return model.vertexCount() ? &model.attributeValue<point3>(0, 0) : nullptr;
+}
+
+enum shape_key : u32 {
+  shape_key_icosphere = 0,
+  shape_key_plane = 1
+};
+
+/// Process-wide store of unit shape tessellations, keyed by
+/// (shape, divisions, options). Entries are immutable once built, callers
+/// copy them and apply their own placement (center, radius, ...).
+class TessellationCache {
+public:
+  struct Entry {
+    std::vector<u8> vertices;
+    std::vector<i32> indices;
   };
-  for (u32 i = 0; i < divisions; i++) {
-    u64 n = index_data.size() / 3;
-    for (u64 j = 0; j < n; j++) {
-      i32 v0 = index_data[j * 3 + 0];
-      i32 v1 = index_data[j * 3 + 1];
-      i32 v2 = index_data[j * 3 + 2];
-      u64 a = midPoint(v0, v1);
-      u64 b = midPoint(v1, v2);
-      u64 c = midPoint(v2, v0);
-      ADD_FACE(v0, a, c);
-      ADD_FACE(v1, b, a);
-      ADD_FACE(v2, c, b);
-      ADD_FACE(a, c, b);
+  using Key = std::tuple<u32, u32, u32, u32>;
+  /// \tparam F void(Entry&)
+  /// \param key
+  /// \param build called (outside the lock) when the key is not cached yet
+  /// \return
+  template<typename F>
+  static std::shared_ptr<const Entry> get(const Key &key, F &&build) {
+    auto &cache = instance();
+    {
+      std::lock_guard<std::mutex> lock(cache.mutex_);
+      auto it = cache.entries_.find(key);
+      if (it != cache.entries_.end())
+        return it->second;
     }
+    auto entry = std::make_shared<Entry>();
+    build(*entry);
+    // concurrent builds of the same key keep the first entry
+    std::lock_guard<std::mutex> lock(cache.mutex_);
+    return cache.entries_.emplace(key, std::move(entry)).first->second;
   }
-  // finish data
-  u64 vertex_count = vertex_data.size() / struct_size;
-  for (u64 i = 0; i < vertex_count; ++i) {
-    // project vertex to unit sphere
-    (*reinterpret_cast<vec3 *>(vertex_data.data() + struct_size * i)).normalize();
-    // compute normal
-    if (generate_normals)
-      (*reinterpret_cast<vec3 *>(vertex_data.data() + struct_size * i + 3)) =
-          (*reinterpret_cast<vec3 *>(vertex_data.data() + struct_size * i));
-    // compute uv
-    if (generate_uvs) {
-      (*reinterpret_cast<point2 *>(vertex_data.data() + struct_size * i + 6)).x = std::atan2(
-          (*reinterpret_cast<vec3 *>(vertex_data.data() + struct_size * i)).y,
-          (*reinterpret_cast<vec3 *>(vertex_data.data() + struct_size * i)).x);
-      (*reinterpret_cast<point2 *>(vertex_data.data() + struct_size * i + 6)).y = std::acos(
-          (*reinterpret_cast<vec3 *>(vertex_data.data() + struct_size * i)).z);
-    }
-    // translate and scale
-    vertex_data[i * struct_size + 0] =
-        (*reinterpret_cast<point3 *>(vertex_data.data() + struct_size * i)).x * radius + center.x;
-    vertex_data[i * struct_size + 1] =
-        (*reinterpret_cast<point3 *>(vertex_data.data() + struct_size * i)).y * radius + center.y;
-    vertex_data[i * struct_size + 2] =
-        (*reinterpret_cast<point3 *>(vertex_data.data() + struct_size * i)).z * radius + center.z;
+  /// Copies an entry into caller memory and transforms each vertex in parallel
+  /// \tparam F void(u8* vertex)
+  /// \param entry
+  /// \param stride vertex size in bytes
+  /// \param vertices **[out]**
+  /// \param indices **[out]**
+  /// \param transform
+  template<typename F>
+  static void copy(const Entry &entry, u64 stride, void *vertices, i32 *indices, F &&transform) {
+    if (!entry.indices.empty())
+      std::memcpy(indices, entry.indices.data(), entry.indices.size() * sizeof(i32));
+    u8 *destination = reinterpret_cast<u8 *>(vertices);
+    Parallel::forBlocks(entry.vertices.size() / stride, [&](u64 begin, u64 end, u32) {
+      std::memcpy(destination + begin * stride, entry.vertices.data() + begin * stride, (end - begin) * stride);
+      for (u64 i = begin; i < end; ++i)
+        transform(destination + i * stride);
+    });
+  }
+  static void clear() {
+    auto &cache = instance();
+    std::lock_guard<std::mutex> lock(cache.mutex_);
+    cache.entries_.clear();
+  }
+  static u64 sizeInBytes() {
+    auto &cache = instance();
+    std::lock_guard<std::mutex> lock(cache.mutex_);
+    u64 size = 0;
+    for (const auto &entry : cache.entries_)
+      size += entry.second->vertices.size() + entry.second->indices.size() * sizeof(i32);
+    return size;
   }
-  aos = std::move(vertex_data);
-  Model model;
-  model = std::move(aos);
 
-  if (!only_vertices)
-    model = index_data;
+private:
+  static TessellationCache &instance() {
+    static TessellationCache cache;
+    return cache;
+  }
+  std::mutex mutex_;
+  std::map<Key, std::shared_ptr<const Entry>> entries_;
+};
 
-  model.setPrimitiveType(GeometricPrimitiveType::TRIANGLES);
-  if (only_vertices)
-    model.setPrimitiveType(GeometricPrimitiveType::POINTS);
+}
+
+Shapes::Layout Shapes::icosphereLayout(u32 divisions, shape_options options) {
+  Layout layout;
+  layout.vertex_descriptor.pushField<point3>("position");
+  if (testMaskBit(options, shape_options::normal))
+    layout.vertex_descriptor.pushField<vec3>("normal");
+  if (testMaskBit(options, shape_options::uv))
+    layout.vertex_descriptor.pushField<point2>("uv");
+  if (divisions > max_icosphere_divisions) {
+    Log::warn("Shapes::icosphere: divisions clamped to {}.", max_icosphere_divisions);
+    divisions = max_icosphere_divisions;
+  }
+  const u64 n = 1ull << divisions;
+  layout.vertex_count = 10 * n * n + 2;
+  if (testMaskBit(options, shape_options::vertices))
+    layout.primitive_type = GeometricPrimitiveType::POINTS;
+  else
+    layout.index_count = 20 * n * n * 3;
+  return layout;
+}
+
+namespace {
+
+/// Tessellates the unit icosphere (the tessellation cache builder)
+void writeIcosphere(u32 divisions, shape_options options, void *vertices, i32 *indices) {
+  const bool only_vertices = testMaskBit(options, shape_options::vertices);
+  const bool generate_normals = testMaskBit(options, shape_options::normal);
+  const bool generate_uvs = testMaskBit(options, shape_options::uv);
+  const bool flip_normals = testMaskBit(options, shape_options::flip_normals);
+  const bool flip_faces = testMaskBit(options, shape_options::flip_faces);
+  const FieldOffsets fields({generate_normals ? sizeof(vec3) : 0, generate_uvs ? sizeof(point2) : 0});
+  const VertexSpan span{reinterpret_cast<u8 *>(vertices), fields.stride};
+  const auto &icosahedron = Icosahedron::get();
+  // base vertices
+  const f32 t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+  const vec3 base[12] = {{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+                         {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+                         {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+  // Each face is split into a regular grid of n x n triangles (the same
+  // vertices recursive midpoint subdivision produces). Vertex ids are
+  // [12 corners | 30 edges x (n - 1) | 20 faces x (n - 1)(n - 2) / 2], and
+  // shared vertices are written only by the face that owns them, so faces
+  // are tessellated in parallel.
+  const u32 n = 1u << divisions;
+  const u64 edge_vertices_offset = 12;
+  const u64 face_vertices_offset = edge_vertices_offset + 30ull * (n - 1);
+  const u64 face_vertex_count = static_cast<u64>(n - 1) * (n - 2) / 2;
+  auto edgeVertex = [&](u32 u, u32 v, u32 k) -> u64 {
+    // k-th vertex (1..n-1) walking from u to v
+    const u64 e = icosahedron.edge_ids[u][v];
+    return edge_vertices_offset + e * (n - 1) + (u < v ? k - 1 : n - k - 1);
+  };
+  auto writeVertex = [&](u64 vertex_index, const vec3 &p) {
+    const auto direction = normalize(p);
+    span.write(vertex_index, 0, point3(direction.x, direction.y, direction.z));
+    if (generate_normals)
+      span.write(vertex_index, fields.offsets[0], flip_normals ? -direction : direction);
+    if (generate_uvs)
+      span.write(vertex_index, fields.offsets[1], point2(std::atan2(direction.y, direction.x),
+                                                         std::acos(direction.z)));
+  };
+  auto tessellateFace = [&](u32 f) {
+    const u32 a = Icosahedron::faces[f][0];
+    const u32 b = Icosahedron::faces[f][1];
+    const u32 c = Icosahedron::faces[f][2];
+    auto vertexId = [&](u32 i, u32 j) -> u64 {
+      if (i == 0 && j == 0)
+        return a;
+      if (i == n)
+        return b;
+      if (j == n)
+        return c;
+      if (j == 0)
+        return edgeVertex(a, b, i);
+      if (i == 0)
+        return edgeVertex(a, c, j);
+      if (i + j == n)
+        return edgeVertex(b, c, j);
+      // interior vertices, row by row (row j holds n - 1 - j vertices)
+      const u64 row_offset = static_cast<u64>(j - 1) * (n - 1) - static_cast<u64>(j - 1) * j / 2;
+      return face_vertices_offset + f * face_vertex_count + row_offset + i - 1;
+    };
+    auto ownsVertex = [&](u32 i, u32 j) -> bool {
+      if ((i == 0 && j == 0) || i == n || j == n) {
+        const u32 corner = (i == n) ? b : (j == n) ? c : a;
+        return icosahedron.corner_owners[corner] == static_cast<i32>(f);
+      }
+      if (j == 0 || i == 0 || i + j == n) {
+        const u32 u = j == 0 ? a : i == 0 ? a : b;
+        const u32 v = j == 0 ? b : c;
+        return icosahedron.edge_owners[icosahedron.edge_ids[u][v]] == f;
+      }
+      return true;
+    };
+    // vertices
+    const vec3 ab = (base[b] - base[a]) / static_cast<f32>(n);
+    const vec3 ac = (base[c] - base[a]) / static_cast<f32>(n);
+    for (u32 j = 0; j <= n; ++j)
+      for (u32 i = 0; i + j <= n; ++i)
+        if (ownsVertex(i, j))
+          writeVertex(vertexId(i, j), base[a] + ab * static_cast<f32>(i) + ac * static_cast<f32>(j));
+    if (only_vertices)
+      return;
+    // triangles
+    i32 *face_indices = indices + static_cast<u64>(f) * n * n * 3;
+    auto addTriangle = [&](u64 v0, u64 v1, u64 v2) {
+      *face_indices++ = static_cast<i32>(v0);
+      *face_indices++ = static_cast<i32>(flip_faces ? v2 : v1);
+      *face_indices++ = static_cast<i32>(flip_faces ? v1 : v2);
+    };
+    for (u32 j = 0; j < n; ++j)
+      for (u32 i = 0; i + j < n; ++i) {
+        addTriangle(vertexId(i, j), vertexId(i + 1, j), vertexId(i, j + 1));
+        if (i + j + 1 < n)
+          addTriangle(vertexId(i + 1, j), vertexId(i + 1, j + 1), vertexId(i, j + 1));
+      }
+  };
+  Parallel::forEach(20, tessellateFace, 1);
+}
 
+}
+
+void Shapes::icosphere(const point3 &center, real_t radius, u32 divisions, shape_options options,
+                       void *vertices, i32 *indices) {
+  divisions = std::min(divisions, max_icosphere_divisions);
+  // only options that change the unit tessellation are part of the key
+  options = options & (shape_options::normal | shape_options::uv | shape_options::vertices |
+      shape_options::flip_normals | shape_options::flip_faces);
+  const FieldOffsets fields({testMaskBit(options, shape_options::normal) ? sizeof(vec3) : 0,
+                             testMaskBit(options, shape_options::uv) ? sizeof(point2) : 0});
+  auto entry = TessellationCache::get({shape_key_icosphere, divisions, 0, static_cast<u32>(options)},
+                                      [&](TessellationCache::Entry &unit) {
+                                        const u64 n = 1ull << divisions;
+                                        unit.vertices.resize((10 * n * n + 2) * fields.stride);
+                                        if (!testMaskBit(options, shape_options::vertices))
+                                          unit.indices.resize(60 * n * n);
+                                        writeIcosphere(divisions, options, unit.vertices.data(),
+                                                       unit.indices.data());
+                                      });
+  // center and radius only touch positions
+  TessellationCache::copy(*entry, fields.stride, vertices, indices, [&](u8 *vertex) {
+    point3 p;
+    std::memcpy(&p, vertex, sizeof(p));
+    p = point3(center.x + p.x * radius, center.y + p.y * radius, center.z + p.z * radius);
+    std::memcpy(vertex, &p, sizeof(p));
+  });
+}
+
+Model Shapes::icosphere(const point3 &center, real_t radius, u32 divisions, shape_options options) {
+  const auto layout = icosphereLayout(divisions, options);
+  Model model;
+  std::vector<i32> indices(layout.index_count);
+  model = allocate(layout);
+  icosphere(center, radius, divisions, options, vertexMemory(model), indices.data());
+  if (!indices.empty())
+    model = indices;
+  model.setPrimitiveType(layout.primitive_type);
   return model;
-#undef STORE_POSITION
-#undef ADD_FACE
+}
+
+void Shapes::clearTessellationCache() {
+  TessellationCache::clear();
+}
+
+u64 Shapes::tessellationCacheSizeInBytes() {
+  return TessellationCache::sizeInBytes();
 }
 
 Model Shapes::icosphere(u32 divisions, shape_options options) {
@@ -361,283 +585,325 @@ Model Shapes::plane(const Plane &plane,
                        options);
 }
 
-Model Shapes::plane(const Plane &plane,
-                    const point3 &center,
-                    const vec3 &direction,
-                    const vec2 &size,
-                    hermes::size2 divisions,
-                    shape_options options) {
+Shapes::Layout Shapes::planeLayout(hermes::size2 divisions, shape_options options) {
   if ((options & shape_options::tangent_space) == shape_options::tangent_space)
     options = options | shape_options::tangent | shape_options::bitangent;
-  const bool generate_normals = (options & shape_options::normal) == shape_options::normal;
-  bool generate_uvs = (options & shape_options::uv) == shape_options::uv;
-  const bool generate_tangents = (options & shape_options::tangent) == shape_options::tangent;
-  const bool generate_bitangents = (options & shape_options::bitangent) == shape_options::bitangent;
-  const bool wireframe = (options & shape_options::wireframe) == shape_options::wireframe;
-  if (std::fabs(dot(plane.normal, direction)) > 1e-8)
-    Log::warn("Direction vector must be perpendicular to plane normal vector.");
+  const bool generate_tangents = testMaskBit(options, shape_options::tangent);
+  const bool generate_bitangents = testMaskBit(options, shape_options::bitangent);
   // if the tangent space is needed, uv must be generated as well
-  if (!generate_uvs && (generate_tangents || generate_bitangents)) {
-    Log::warn("UV will be generated since tangent space is being generated.");
-    generate_uvs = true;
+  const bool generate_uvs = testMaskBit(options, shape_options::uv) || generate_tangents || generate_bitangents;
+  Layout layout;
+  layout.vertex_descriptor.pushField<point3>("position");
+  if (testMaskBit(options, shape_options::wireframe)) {
+    // grid lines only have positions
+    layout.primitive_type = GeometricPrimitiveType::LINES;
+    layout.vertex_count = (divisions.width + 1) * 2 + (divisions.height + 1) * 2;
+    layout.index_count = layout.vertex_count;
+  } else {
+    if (testMaskBit(options, shape_options::normal))
+      layout.vertex_descriptor.pushField<vec3>("normal");
+    if (generate_uvs)
+      layout.vertex_descriptor.pushField<point2>("uvs");
+    if (generate_tangents)
+      layout.vertex_descriptor.pushField<vec3>("tangents");
+    if (generate_bitangents)
+      layout.vertex_descriptor.pushField<vec3>("bitangents");
+    layout.vertex_count = static_cast<u64>(divisions.width + 1) * (divisions.height + 1);
+    layout.index_count = static_cast<u64>(divisions.width) * divisions.height * 6;
   }
-  Model model;
-  std::vector<i32> index_data;
-  AoS aos;
-  const u64 position_id = aos.pushField<point3>("position");
-  const u64 normal_id = generate_normals ? aos.pushField<vec3>("normal") : 0;
-  const u64 uv_id = generate_uvs ? aos.pushField<point2>("uvs") : 0;
-  const u64 tangent_id = generate_tangents ? aos.pushField<vec3>("tangents") : 0;
-  const u64 bitangent_id = generate_bitangents ? aos.pushField<vec3>("bitangents") : 0;
+  return layout;
+}
 
-  if (wireframe) {
-    aos.resize((divisions.width + 1) * 2 + (divisions.height + 1) * 2);
+namespace {
 
-    vec2 div_rec(1.f / divisions.width, 1.f / divisions.height);
-    vec2 step = size * div_rec;
-    auto dx = normalize(direction);
-    auto dy = normalize(cross(vec3(plane.normal), dx));
-    auto origin = center - dx * size.x * .5 - dy * size.y * .5;
+/// Tessellates a plane (the tessellation cache builder)
+void writePlane(const Plane &plane,
+                const point3 &center,
+                const vec3 &direction,
+                const vec2 &size,
+                hermes::size2 divisions,
+                shape_options options,
+                void *vertices, i32 *indices) {
+  if ((options & shape_options::tangent_space) == shape_options::tangent_space)
+    options = options | shape_options::tangent | shape_options::bitangent;
+  const bool generate_normals = testMaskBit(options, shape_options::normal);
+  const bool generate_tangents = testMaskBit(options, shape_options::tangent);
+  const bool generate_bitangents = testMaskBit(options, shape_options::bitangent);
+  const bool generate_uvs = testMaskBit(options, shape_options::uv) || generate_tangents || generate_bitangents;
+  const bool wireframe = testMaskBit(options, shape_options::wireframe);
+  const FieldOffsets fields({generate_normals ? sizeof(vec3) : 0,
+                             generate_uvs ? sizeof(point2) : 0,
+                             generate_tangents ? sizeof(vec3) : 0,
+                             generate_bitangents ? sizeof(vec3) : 0});
+  const VertexSpan span{reinterpret_cast<u8 *>(vertices), wireframe ? sizeof(point3) : fields.stride};
+
+  vec2 div_rec(1.f / divisions.width, 1.f / divisions.height);
+  vec2 step = size * div_rec;
+  auto dx = normalize(direction);
+  auto dy = normalize(cross(vec3(plane.normal), dx));
+  auto origin = center - dx * size.x * .5 - dy * size.y * .5;
+  if (wireframe) {
     u64 vertex_index = 0;
+    auto addVertex = [&](const point3 &p) {
+      span.write(vertex_index, 0, p);
+      *indices++ = static_cast<i32>(vertex_index++);
+    };
     for (u32 x = 0; x <= divisions.width; ++x) {
-      aos.valueAt<point3>(position_id, vertex_index) =
-          origin + dx * step.x * static_cast<float>(x);
-      index_data.emplace_back(vertex_index++);
-      aos.valueAt<point3>(position_id, vertex_index) =
-          origin + dx * step.x * static_cast<float>(x) + dy * step.y * static_cast<float>(divisions.height);
-      index_data.emplace_back(vertex_index++);
+      addVertex(origin + dx * step.x * static_cast<float>(x));
+      addVertex(origin + dx * step.x * static_cast<float>(x) + dy * step.y * static_cast<float>(divisions.height));
     }
     for (u32 y = 0; y <= divisions.height; ++y) {
-      aos.valueAt<point3>(position_id, vertex_index) =
-          origin + dy * step.y * static_cast<float>(y);
-      index_data.emplace_back(vertex_index++);
-      aos.valueAt<point3>(position_id, vertex_index) =
-          origin + dx * step.x * static_cast<float>(divisions.width) + dy * step.y * static_cast<float>(y);
-      index_data.emplace_back(vertex_index++);
+      addVertex(origin + dy * step.y * static_cast<float>(y));
+      addVertex(origin + dx * step.x * static_cast<float>(divisions.width) + dy * step.y * static_cast<float>(y));
     }
+    return;
+  }
+  const vec3 normal(plane.normal.x, plane.normal.y, plane.normal.z);
+  u64 vertex_index = 0;
+  for (u32 x = 0; x <= divisions.width; ++x)
+    for (u32 y = 0; y <= divisions.height; ++y) {
+      span.write(vertex_index, 0,
+                 origin + dx * step.x * static_cast<float>(x) + dy * step.y * static_cast<float>(y));
+      if (generate_normals)
+        span.write(vertex_index, fields.offsets[0], normal);
+      if (generate_uvs)
+        span.write(vertex_index, fields.offsets[1], point2(x * div_rec.x, y * div_rec.y));
+      // u grows along dx and v along dy
+      if (generate_tangents)
+        span.write(vertex_index, fields.offsets[2], dx);
+      if (generate_bitangents)
+        span.write(vertex_index, fields.offsets[3], dy);
+      vertex_index++;
+    }
+  const u64 w = divisions.height + 1;
+  for (u64 i = 0; i < divisions.width; ++i)
+    for (u64 j = 0; j < divisions.height; ++j) {
+      *indices++ = i * w + j;
+      *indices++ = (i + 1) * w + j;
+      *indices++ = i * w + j + 1;
+      *indices++ = i * w + j + 1;
+      *indices++ = (i + 1) * w + j;
+      *indices++ = (i + 1) * w + j + 1;
+    }
+}
 
-    model = std::move(aos);
-    model = index_data;
-    model.setPrimitiveType(GeometricPrimitiveType::LINES);
-  } else {
-    aos.resize((divisions.width + 1) * (divisions.height + 1));
+}
 
-    vec2 div_rec(1.f / divisions.width, 1.f / divisions.height);
-    vec2 step = size * div_rec;
-    auto dx = normalize(direction);
-    auto dy = normalize(cross(vec3(plane.normal), dx));
-    auto origin = center - dx * size.x * .5 - dy * size.y * .5;
-    u64 vertex_index = 0;
-    for (u32 x = 0; x <= divisions.width; ++x)
-      for (u32 y = 0; y <= divisions.height; ++y) {
-        auto p = origin + dx * step.x * static_cast<float>(x) + dy * step.y * static_cast<float>(y);
-        aos.valueAt<point3>(position_id, vertex_index) = p;
-        if (generate_normals)
-          aos.valueAt<normal3>(normal_id, vertex_index) = plane.normal;
-        if (generate_uvs)
-          aos.valueAt<point2>(uv_id, vertex_index) = {x * div_rec.x, y * div_rec.y};
-        vertex_index++;
-      }
-    u64 w = divisions.width + 1;
-    for (u64 i = 0; i < divisions.width; ++i)
-      for (u64 j = 0; j < divisions.height; ++j) {
-        index_data.emplace_back(i * w + j);
-        index_data.emplace_back((i + 1) * w + j);
-        index_data.emplace_back(i * w + j + 1);
-        index_data.emplace_back(i * w + j + 1);
-        index_data.emplace_back((i + 1) * w + j);
-        index_data.emplace_back((i + 1) * w + j + 1);
-      }
-    // compute tangent space
-    if (generate_tangents || generate_bitangents) {
-      auto face_count = index_data.size() / 3;
-      for (u64 i = 0; i < face_count; ++i) {
-        auto edge_a = aos.valueAt<point3>(position_id, index_data[i * 3 + 1])
-            - aos.valueAt<point3>(position_id, index_data[i * 3 + 0]);
-        auto edge_b = aos.valueAt<point3>(position_id, index_data[i * 3 + 2])
-            - aos.valueAt<point3>(position_id, index_data[i * 3 + 0]);
-        auto delta_uv_a = aos.valueAt<point2>(uv_id, index_data[i * 3 + 1])
-            - aos.valueAt<point2>(uv_id, index_data[i * 3 + 0]);
-        auto delta_uv_b = aos.valueAt<point2>(uv_id, index_data[i * 3 + 2])
-            - aos.valueAt<point2>(uv_id, index_data[i * 3 + 0]);
-        f32 f = 1.0f / (delta_uv_a.x * delta_uv_b.y - delta_uv_b.x * delta_uv_a.y);
-        if (generate_tangents) {
-          vec3 tangent(
-              f * (delta_uv_b.y * edge_a.x - delta_uv_a.y * edge_b.x),
-              f * (delta_uv_b.y * edge_a.y - delta_uv_a.y * edge_b.y),
-              f * (delta_uv_b.y * edge_a.z - delta_uv_a.y * edge_b.z)
-          );
-          tangent.normalize();
-          aos.valueAt<vec3>(tangent_id, index_data[i * 3 + 0]) = tangent;
-          aos.valueAt<vec3>(tangent_id, index_data[i * 3 + 1]) = tangent;
-          aos.valueAt<vec3>(tangent_id, index_data[i * 3 + 2]) = tangent;
-        }
-        if (generate_bitangents) {
-          vec3 bitangent(
-              f * (-delta_uv_b.x * edge_a.x - delta_uv_a.x * edge_b.x),
-              f * (-delta_uv_b.x * edge_a.y - delta_uv_a.x * edge_b.y),
-              f * (-delta_uv_b.x * edge_a.z - delta_uv_a.x * edge_b.z)
-          );
-          bitangent.normalize();
-          aos.valueAt<vec3>(bitangent_id, index_data[i * 3 + 0]) = bitangent;
-          aos.valueAt<vec3>(bitangent_id, index_data[i * 3 + 1]) = bitangent;
-          aos.valueAt<vec3>(bitangent_id, index_data[i * 3 + 2]) = bitangent;
-        }
-      }
-    }
-    model = std::move(aos);
-    model = index_data;
-  }
+void Shapes::plane(const Plane &plane,
+                   const point3 &center,
+                   const vec3 &direction,
+                   const vec2 &size,
+                   hermes::size2 divisions,
+                   shape_options options,
+                   void *vertices, i32 *indices) {
+  if ((options & shape_options::tangent_space) == shape_options::tangent_space)
+    options = options | shape_options::tangent | shape_options::bitangent;
+  options = options & (shape_options::normal | shape_options::uv | shape_options::tangent |
+      shape_options::bitangent | shape_options::wireframe);
+  const bool wireframe = testMaskBit(options, shape_options::wireframe);
+  const bool generate_normals = !wireframe && testMaskBit(options, shape_options::normal);
+  const bool generate_tangents = !wireframe && testMaskBit(options, shape_options::tangent);
+  const bool generate_bitangents = !wireframe && testMaskBit(options, shape_options::bitangent);
+  const bool generate_uvs = !wireframe && (testMaskBit(options, shape_options::uv) ||
+      generate_tangents || generate_bitangents);
+  const FieldOffsets fields({generate_normals ? sizeof(vec3) : 0,
+                             generate_uvs ? sizeof(point2) : 0,
+                             generate_tangents ? sizeof(vec3) : 0,
+                             generate_bitangents ? sizeof(vec3) : 0});
+  // the unit plane lies on z = 0, centered at the origin, with u along x
+  auto entry = TessellationCache::get({shape_key_plane, divisions.width, divisions.height,
+                                       static_cast<u32>(options)},
+                                      [&](TessellationCache::Entry &unit) {
+                                        const u64 vertex_count = wireframe ?
+                                                                 (divisions.width + 1) * 2 + (divisions.height + 1) * 2 :
+                                                                 static_cast<u64>(divisions.width + 1) * (divisions.height + 1);
+                                        unit.vertices.resize(vertex_count * fields.stride);
+                                        unit.indices.resize(wireframe ? vertex_count :
+                                                            static_cast<u64>(divisions.width) * divisions.height * 6);
+                                        writePlane(Plane(normal3(0, 0, 1), 0), point3(), vec3(1, 0, 0), vec2(1, 1),
+                                                   divisions, options, unit.vertices.data(), unit.indices.data());
+                                      });
+  const auto dx = normalize(direction);
+  const auto dy = normalize(cross(vec3(plane.normal), dx));
+  const vec3 normal(plane.normal.x, plane.normal.y, plane.normal.z);
+  TessellationCache::copy(*entry, fields.stride, vertices, indices, [&](u8 *vertex) {
+    point3 p;
+    std::memcpy(&p, vertex, sizeof(p));
+    p = center + dx * (p.x * size.x) + dy * (p.y * size.y);
+    std::memcpy(vertex, &p, sizeof(p));
+    if (generate_normals)
+      std::memcpy(vertex + fields.offsets[0], &normal, sizeof(normal));
+    if (generate_tangents)
+      std::memcpy(vertex + fields.offsets[2], &dx, sizeof(dx));
+    if (generate_bitangents)
+      std::memcpy(vertex + fields.offsets[3], &dy, sizeof(dy));
+  });
+}
+
+Model Shapes::plane(const Plane &plane,
+                    const point3 &center,
+                    const vec3 &direction,
+                    const vec2 &size,
+                    hermes::size2 divisions,
+                    shape_options options) {
+  if (std::fabs(dot(plane.normal, direction)) > 1e-8)
+    Log::warn("Direction vector must be perpendicular to plane normal vector.");
+  if (!testMaskBit(options, shape_options::uv) &&
+      (testMaskBit(options, shape_options::tangent) || testMaskBit(options, shape_options::bitangent)))
+    Log::warn("UV will be generated since tangent space is being generated.");
+  const auto layout = planeLayout(divisions, options);
+  Model model;
+  std::vector<i32> indices(layout.index_count);
+  model = allocate(layout);
+  Shapes::plane(plane, center, direction, size, divisions, options, vertexMemory(model), indices.data());
+  model = indices;
+  model.setPrimitiveType(layout.primitive_type);
   return model;
-#undef ADD_FACE
 }
 
-Model Shapes::box(const bbox3 &box, shape_options options) {
-  // check options
+namespace {
+
+// base vertices of boxes (bit 0: x, bit 1: y, bit 2: z) in face order
+//           7
+//  3                     6
+//               2
+//
+//           4
+//  0                     5
+//               1
+constexpr u32 box_corners[8][3] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+                                   {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}};
+constexpr u32 box_faces[6][4] = {
+    {0, 1, 2, 3}, // -Z face
+    {4, 7, 6, 5}, // +Z face
+    {0, 4, 5, 1}, // -Y face
+    {3, 2, 6, 7}, // +Y face
+    {0, 3, 7, 4}, // -X face
+    {2, 1, 5, 6}  // +X face
+};
+constexpr f32 box_normals[6][3] = {{0, 0, -1}, {0, 0, 1}, {0, -1, 0}, {0, 1, 0}, {-1, 0, 0}, {1, 0, 0}};
+constexpr f32 box_uvs[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+constexpr i32 box_edges[24] = {0, 1, 1, 2, 2, 3, 3, 0, 0, 4, 1, 5, 2, 6, 3, 7, 4, 5, 5, 6, 6, 7, 7, 4};
+
+/// Face attributes (normals, uvs, tangents) need one vertex per face corner
+bool boxHasFaceVertices(shape_options options) {
+  if (testMaskBit(options, shape_options::wireframe) || testMaskBit(options, shape_options::vertices))
+    return false;
+  return testMaskBit(options, shape_options::unique_positions) ||
+      testMaskBit(options, shape_options::normal) || testMaskBit(options, shape_options::uv) ||
+      testMaskBit(options, shape_options::tangent) || testMaskBit(options, shape_options::bitangent);
+}
+
+}
+
+Shapes::Layout Shapes::boxLayout(shape_options options) {
+  if (testMaskBit(options, shape_options::tangent_space))
+    options = options | shape_options::tangent | shape_options::bitangent;
+  Layout layout;
+  layout.vertex_descriptor.pushField<point3>("position");
+  if (testMaskBit(options, shape_options::normal))
+    layout.vertex_descriptor.pushField<vec3>("normal");
+  if (testMaskBit(options, shape_options::uv))
+    layout.vertex_descriptor.pushField<point2>("uvs");
+  if (testMaskBit(options, shape_options::uvw))
+    layout.vertex_descriptor.pushField<point3>("uvw");
+  if (testMaskBit(options, shape_options::tangent))
+    layout.vertex_descriptor.pushField<vec3>("tangent");
+  if (testMaskBit(options, shape_options::bitangent))
+    layout.vertex_descriptor.pushField<vec3>("bitangent");
+  layout.vertex_count = boxHasFaceVertices(options) ? 24 : 8;
+  if (testMaskBit(options, shape_options::vertices)) {
+    layout.primitive_type = GeometricPrimitiveType::POINTS;
+  } else if (testMaskBit(options, shape_options::wireframe)) {
+    layout.primitive_type = GeometricPrimitiveType::LINES;
+    layout.index_count = 24;
+  } else
+    layout.index_count = 36;
+  return layout;
+}
+
+void Shapes::box(const bbox3 &box, shape_options options, void *vertices, i32 *indices) {
   if (testMaskBit(options, shape_options::tangent_space))
     options = options | shape_options::tangent | shape_options::bitangent;
   const bool generate_wireframe = testMaskBit(options, shape_options::wireframe);
   const bool only_vertices = testMaskBit(options, shape_options::vertices);
   const bool generate_normals = testMaskBit(options, shape_options::normal);
+  const bool generate_uvs = testMaskBit(options, shape_options::uv);
+  const bool generate_uvw = testMaskBit(options, shape_options::uvw);
   const bool generate_tangents = testMaskBit(options, shape_options::tangent);
   const bool generate_bitangents = testMaskBit(options, shape_options::bitangent);
   const bool flip_normals = testMaskBit(options, shape_options::flip_normals);
   const bool flip_faces = testMaskBit(options, shape_options::flip_faces);
-  const bool unique_positions = testMaskBit(options, shape_options::unique_positions);
-  const bool generate_uvw = testMaskBit(options, shape_options::uvw);
-  const bool generate_uvs = testMaskBit(options, shape_options::uv);
-
-  // model data
-  AoS aos;
-
-  // data fields
-  const u64 position_id = aos.pushField<point3>("position");
-  const u64 normal_id = generate_normals ? aos.pushField<vec3>("normal") : 0;
-  const u64 uv_id = generate_uvs ? aos.pushField<point2>("uvs") : 0;
-  const u64 uvw_id = generate_uvw ? aos.pushField<point3>("uvw") : 0;
-  const u64 tangent_id = generate_tangents ? aos.pushField<vec3>("tangent") : 0;
-  const u64 bitangent_id = generate_bitangents ? aos.pushField<vec3>("bitangent") : 0;
-
-  // base vertices
-  point3 base_vertices[8] = {
-      {box.lower.x, box.lower.y, box.lower.z}, // 0
-      {box.upper.x, box.lower.y, box.lower.z}, // 1
-      {box.upper.x, box.upper.y, box.lower.z}, // 2
-      {box.lower.x, box.upper.y, box.lower.z}, // 3
-      {box.lower.x, box.lower.y, box.upper.z}, // 4
-      {box.upper.x, box.lower.y, box.upper.z}, // 5
-      {box.upper.x, box.upper.y, box.upper.z}, // 6
-      {box.lower.x, box.upper.y, box.upper.z}};// 7
-
-  // base uvs
-  point2 base_uvs[4] = {
-      {0, 0}, // 0
-      {1, 0}, // 1
-      {1, 1}, // 2
-      {0, 1}, // 3
-  };
-
-  point3 base_uvw[8] = {
-      {0, 0, 0}, // 0
-      {1, 0, 0}, // 1
-      {1, 1, 0}, // 2
-      {0, 1, 0}, // 3
-      {0, 0, 1}, // 4
-      {1, 0, 1}, // 5
-      {1, 1, 1}, // 6
-      {0, 1, 1}, // 7
+  const FieldOffsets fields({generate_normals ? sizeof(vec3) : 0,
+                             generate_uvs ? sizeof(point2) : 0,
+                             generate_uvw ? sizeof(point3) : 0,
+                             generate_tangents ? sizeof(vec3) : 0,
+                             generate_bitangents ? sizeof(vec3) : 0});
+  const VertexSpan span{reinterpret_cast<u8 *>(vertices), fields.stride};
+  auto corner = [&](u32 c) {
+    return point3(box_corners[c][0] ? box.upper.x : box.lower.x,
+                  box_corners[c][1] ? box.upper.y : box.lower.y,
+                  box_corners[c][2] ? box.upper.z : box.lower.z);
   };
-
-  vec3 base_normals[6] = {
-      {0, 0, -1}, // -Z
-      {0, 0, 1}, // +Z
-      {0, -1, 0}, // -Y
-      {0, 1, 0}, // Y
-      {-1, 0, 0}, // -X
-      {1, 0, 0}, // X
-  };
-
-  //           7
-  //  3                     6
-  //               2
-  //
-  //           4
-  //  0                     5
-  //               1
-
-  std::vector<i32> base_vertex_indices = {
-      0, 1, 2, 3, // -Z face
-      4, 7, 6, 5, // +Z face
-      0, 4, 5, 1, // -Y face
-      3, 2, 6, 7, // +Y face
-      0, 3, 7, 4, // -X face
-      2, 1, 5, 6  // +X face
+  auto cornerUVW = [&](u32 c) {
+    return point3(box_corners[c][0], box_corners[c][1], box_corners[c][2]);
   };
-
-
-  // data type
-  GeometricPrimitiveType primitive_type = GeometricPrimitiveType::TRIANGLES;
-  if (only_vertices)
-    primitive_type = GeometricPrimitiveType::POINTS;
-  else if (generate_wireframe)
-    primitive_type = GeometricPrimitiveType::LINES;
-
-  // compute number of vertices
-  size_t n_vertices = 8;
-  if (unique_positions && !only_vertices) {
-    n_vertices = 24;
+  if (!boxHasFaceVertices(options)) {
+    for (u32 c = 0; c < 8; ++c) {
+      span.write(c, 0, corner(c));
+      if (generate_uvw)
+        span.write(c, fields.offsets[2], cornerUVW(c));
+    }
     if (generate_wireframe)
-      n_vertices = 8 * 6;
+      std::memcpy(indices, box_edges, sizeof(box_edges));
+    else if (!only_vertices)
+      for (u32 f = 0; f < 6; ++f)
+        for (u32 jump = 0; jump < 2; ++jump) {
+          *indices++ = box_faces[f][0];
+          *indices++ = box_faces[f][flip_faces ? jump + 2 : jump + 1];
+          *indices++ = box_faces[f][flip_faces ? jump + 1 : jump + 2];
+        }
+    return;
   }
-  aos.resize(n_vertices);
-
-  size_t n_indices = 36;
-  if (generate_wireframe)
-    n_indices = 8; // a line per edge
-
-  // fill vertex data
-  std::vector<i32> indices;
-  if (generate_wireframe) {
-    indices = {0, 1, 1, 2, 2, 3, 3, 0, 0, 4, 1, 5, 2, 6, 3, 7, 4, 5, 5, 6, 6, 7, 7, 4};
-    if (unique_positions) {
-    } else {
-      for (int i = 0; i < n_vertices; ++i)
-        aos.valueAt<point3>(position_id, i) = base_vertices[i];
+  // one vertex per face corner
+  for (u32 f = 0; f < 6; ++f) {
+    vec3 normal(box_normals[f][0], box_normals[f][1], box_normals[f][2]);
+    if (flip_normals)
+      normal = -normal;
+    // uv corners follow the face vertex order
+    const auto tangent = normalize(corner(box_faces[f][1]) - corner(box_faces[f][0]));
+    const auto bitangent = normalize(corner(box_faces[f][3]) - corner(box_faces[f][0]));
+    for (u32 k = 0; k < 4; ++k) {
+      const u64 vertex_index = f * 4 + k;
+      span.write(vertex_index, 0, corner(box_faces[f][k]));
+      if (generate_normals)
+        span.write(vertex_index, fields.offsets[0], normal);
+      if (generate_uvs)
+        span.write(vertex_index, fields.offsets[1], point2(box_uvs[k][0], box_uvs[k][1]));
+      if (generate_uvw)
+        span.write(vertex_index, fields.offsets[2], cornerUVW(box_faces[f][k]));
+      if (generate_tangents)
+        span.write(vertex_index, fields.offsets[3], tangent);
+      if (generate_bitangents)
+        span.write(vertex_index, fields.offsets[4], bitangent);
     }
-  } else {
-    // tesselate cube
-    for (int f = 0; f < 6; ++f)
-      for (int jump = 0; jump < 2; ++jump) {
-        indices.emplace_back(base_vertex_indices[f * 4 + 0]);
-        indices.emplace_back(base_vertex_indices[f * 4 + jump + 1]);
-        indices.emplace_back(base_vertex_indices[f * 4 + jump + 2]);
-      }
-
-    if (unique_positions) {
-      // we must duplicate each vertex per index
-    } else {
-      HERMES_ASSERT(n_vertices == 8)
-      for (int i = 0; i < n_vertices; ++i) {
-        aos.valueAt<point3>(position_id, i) = base_vertices[i];
-        if (generate_uvw)
-          aos.valueAt<point3>(uvw_id, i) = base_uvw[i];
-        if (generate_uvs)
-          aos.valueAt<point2>(uv_id, i) = base_uvs[i % 4];
-      }
-      if (generate_normals) {
-        for (int f = 0; f < 6; ++f)
-          for (int i = 0; i < 4; ++i)
-            aos.valueAt<vec3>(normal_id, f * 4 + i) =
-                flip_normals ? -base_normals[f] : base_normals[f];
-      }
+    for (u32 jump = 0; jump < 2; ++jump) {
+      *indices++ = static_cast<i32>(f * 4);
+      *indices++ = static_cast<i32>(f * 4 + (flip_faces ? jump + 2 : jump + 1));
+      *indices++ = static_cast<i32>(f * 4 + (flip_faces ? jump + 1 : jump + 2));
     }
   }
-  // prepare model
+}
+
+Model Shapes::box(const bbox3 &box, shape_options options) {
+  const auto layout = boxLayout(options);
   Model model;
-  model.setPrimitiveType(primitive_type);
-  model = aos;
+  std::vector<i32> indices(layout.index_count);
+  model = allocate(layout);
+  Shapes::box(box, options, vertexMemory(model), indices.data());
   if (!indices.empty())
     model = indices;
+  model.setPrimitiveType(layout.primitive_type);
   return model;
 }
 
@@ -683,22 +949,40 @@ Model Shapes::box(const bbox2 &box, shape_options options) {
   return model;
 }
 
-Model Shapes::segment(const Segment3 &s, shape_options options) {
-  Model model;
-  model.pushAttribute<point3>("position");
+Shapes::Layout Shapes::segmentLayout(shape_options options) {
+  Layout layout;
+  layout.vertex_descriptor.pushField<point3>("position");
   if (testMaskBit(options, shape_options::uv))
-    model.pushAttribute<point2>("uv");
-  model.resize(2);
-  model.attributeValue<point3>(0, 0) = s.a;
-  model.attributeValue<point3>(0, 1) = s.b;
-  if (testMaskBit(options, shape_options::uv)) {
-    model.attributeValue<point2>(1, 0) = {0.f, 0.f};
-    model.attributeValue<point2>(1, 1) = {1.f, 1.f};
+    layout.vertex_descriptor.pushField<point2>("uv");
+  layout.vertex_count = 2;
+  layout.index_count = 2;
+  layout.primitive_type = GeometricPrimitiveType::LINES;
+  return layout;
+}
+
+void Shapes::segment(const Segment3 &s, shape_options options, void *vertices, i32 *indices) {
+  const bool generate_uvs = testMaskBit(options, shape_options::uv);
+  const FieldOffsets fields({generate_uvs ? sizeof(point2) : 0});
+  const VertexSpan span{reinterpret_cast<u8 *>(vertices), fields.stride};
+  span.write(0, 0, s.a);
+  span.write(1, 0, s.b);
+  if (generate_uvs) {
+    span.write(0, fields.offsets[0], point2(0.f, 0.f));
+    span.write(1, fields.offsets[0], point2(1.f, 1.f));
   }
-  std::vector<i32> indices = {0, 1};
+  indices[0] = 0;
+  indices[1] = 1;
+}
+
+Model Shapes::segment(const Segment3 &s, shape_options options) {
+  const auto layout = segmentLayout(options);
+  Model model;
+  std::vector<i32> indices(layout.index_count);
+  model = allocate(layout);
+  segment(s, options, vertexMemory(model), indices.data());
   model = indices;
-  model.setPrimitiveType(GeometricPrimitiveType::LINES);
+  model.setPrimitiveType(layout.primitive_type);
   return model;
 }
 
-}
\ No newline at end of file
+}
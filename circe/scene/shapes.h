@@ -40,6 +40,20 @@ namespace circe {
 
 class Shapes {
 public:
+  /// Exact memory requirements of a generated shape. Generators can write
+  /// straight into caller provided memory (a mapped DeviceMemory::View, for
+  /// example), without intermediate allocations:
+  ///   auto layout = Shapes::icosphereLayout(divisions, options);
+  ///   // reserve layout.vertexDataSizeInBytes() and layout.indexDataSizeInBytes()
+  ///   Shapes::icosphere(center, radius, divisions, options, vertices, indices);
+  struct Layout {
+    hermes::StructDescriptor vertex_descriptor; //!< interleaved vertex attributes
+    u64 vertex_count{0};
+    u64 index_count{0};
+    hermes::GeometricPrimitiveType primitive_type{hermes::GeometricPrimitiveType::TRIANGLES};
+    [[nodiscard]] u64 vertexDataSizeInBytes() const { return vertex_count * vertex_descriptor.sizeInBytes(); }
+    [[nodiscard]] u64 indexDataSizeInBytes() const { return index_count * sizeof(i32); }
+  };
   ///
   /// \param mesh
   /// \param options
@@ -133,6 +147,19 @@ public:
   /// \param options
   /// \return
   static Model icosphere(u32 divisions, shape_options options = shape_options::none);
+  /// \param divisions
+  /// \param options
+  /// \return vertex layout and counts of icosphere()
+  static Layout icosphereLayout(u32 divisions, shape_options options = shape_options::none);
+  /// Writes an icosphere into caller provided memory
+  /// \param center
+  /// \param radius
+  /// \param divisions
+  /// \param options
+  /// \param vertices **[out]** icosphereLayout().vertexDataSizeInBytes() bytes
+  /// \param indices **[out]** icosphereLayout().index_count indices
+  static void icosphere(const hermes::point3 &center, real_t radius, u32 divisions,
+                        shape_options options, void *vertices, i32 *indices);
   ///
   /// \param plane
   /// \param center
@@ -149,18 +176,65 @@ public:
                      const hermes::vec3 &direction,
                      const hermes::vec2 &size,
                      hermes::size2 divisions, shape_options options = shape_options::none);
+  /// \param divisions
+  /// \param options
+  /// \return vertex layout and counts of plane()
+  static Layout planeLayout(hermes::size2 divisions, shape_options options = shape_options::none);
+  /// Writes a plane into caller provided memory
+  /// \param vertices **[out]** planeLayout().vertexDataSizeInBytes() bytes
+  /// \param indices **[out]** planeLayout().index_count indices
+  static void plane(const hermes::Plane &plane,
+                    const hermes::point3 &center,
+                    const hermes::vec3 &direction,
+                    const hermes::vec2 &size,
+                    hermes::size2 divisions, shape_options options,
+                    void *vertices, i32 *indices);
   ///
   /// \param box
   /// \param options
   /// \return
   static Model box(const hermes::bbox3 &box, shape_options options = shape_options::none);
   static Model box(const hermes::bbox2 &box, shape_options options = shape_options::none);
+  /// Boxes get one vertex per face corner (24) when face attributes
+  /// (normals, uvs, tangent space) or unique positions are requested.
+  /// \param options
+  /// \return vertex layout and counts of box()
+  static Layout boxLayout(shape_options options = shape_options::none);
+  /// Writes a box into caller provided memory
+  /// \param box
+  /// \param options
+  /// \param vertices **[out]** boxLayout().vertexDataSizeInBytes() bytes
+  /// \param indices **[out]** boxLayout().index_count indices
+  static void box(const hermes::bbox3 &box, shape_options options, void *vertices, i32 *indices);
   ///
   /// \param s
   /// \param options
   /// \return
   static Model segment(const hermes::Segment3 &s,
                        shape_options options = shape_options::none);
+  /// \param options
+  /// \return vertex layout and counts of segment()
+  static Layout segmentLayout(shape_options options = shape_options::none);
+  /// Writes a segment into caller provided memory
+  /// \param s
+  /// \param options
+  /// \param vertices **[out]** segmentLayout().vertexDataSizeInBytes() bytes
+  /// \param indices **[out]** 2 indices
+  static void segment(const hermes::Segment3 &s, shape_options options, void *vertices, i32 *indices);
+
+  // ***********************************************************************
+  //                        TESSELLATION CACHE
+  // ***********************************************************************
+  // Icospheres and planes are tessellated once per (divisions, options) as
+  // unit shapes and kept in a process-wide cache. Every call copies the
+  // cached tessellation and applies its placement (center, radius,
+  // orientation, size), which is a single parallel pass over the vertices.
+  /// Releases all cached tessellations
+  static void clearTessellationCache();
+  /// \return memory used by cached tessellations
+  static u64 tessellationCacheSizeInBytes();
+
+  static constexpr u32 max_icosphere_divisions = 13;
 };
 
 }
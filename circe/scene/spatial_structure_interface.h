@@ -1,6 +1,7 @@
 #ifndef HERMES_SPATIAL_STRUCTURE_INTERFACE_H
 #define HERMES_SPATIAL_STRUCTURE_INTERFACE_H
 
+#include <circe/scene/frustum_culler.h>
 #include <hermes/geometry/ray.h>
 
 #include <functional>
@@ -82,6 +83,35 @@ public:
     HERMES_UNUSED_VARIABLE(r);
     return nullptr;
   }
+  /* iterateVisible
+   * @culler **[in]** view frustum
+   * @f **[in]** function called for each object inside or crossing the frustum
+   * @statistics **[out | optional]** object counts of the pass
+   *
+   * Culls objects by their worldBounds(). Objects without bounds are always
+   * visited. The default implementation tests every object.
+   */
+  virtual void iterateVisible(const FrustumCuller &culler,
+                              std::function<void(ObjectType *o)> f,
+                              FrustumCuller::Statistics *statistics = nullptr) {
+    FrustumCuller::Statistics counts;
+    iterate([&](ObjectType *o) {
+      auto bounds = o->worldBounds();
+      if (!hasBounds(bounds))
+        counts.unbounded++;
+      else {
+        counts.box_tests++;
+        if (!culler.isVisible(bounds)) {
+          counts.culled++;
+          return;
+        }
+      }
+      counts.visible++;
+      f(o);
+    });
+    if (statistics)
+      *statistics = counts;
+  }
 };
 
 } // hermes namespace
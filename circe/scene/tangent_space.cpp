@@ -0,0 +1,305 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file tangent_space.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-18
+///
+///\brief
+
+#include <circe/scene/tangent_space.h>
+#include <circe/common/parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace circe {
+
+namespace {
+
+inline hermes::vec3 load3(const u8 *p) {
+  f32 v[3];
+  std::memcpy(v, p, sizeof(v));
+  return {v[0], v[1], v[2]};
+}
+
+inline void store3(u8 *p, const hermes::vec3 &v) {
+  const f32 a[3] = {v.x, v.y, v.z};
+  std::memcpy(p, a, sizeof(a));
+}
+
+/// \return angle between a and b (0 for degenerate edges)
+inline f32 cornerAngle(const hermes::vec3 &a, const hermes::vec3 &b) {
+  const f32 la = a.length();
+  const f32 lb = b.length();
+  if (la <= 0.f || lb <= 0.f)
+    return 0.f;
+  return std::acos(std::clamp(hermes::dot(a, b) / (la * lb), -1.f, 1.f));
+}
+
+inline bool validTriangle(const i32 *t, u64 vertex_count) {
+  for (int k = 0; k < 3; ++k)
+    if (t[k] < 0 || static_cast<u64>(t[k]) >= vertex_count)
+      return false;
+  return true;
+}
+
+/// Sums the per block accumulators of vertex v
+inline void reduceVertex(const std::vector<f32> &accumulators, u32 blocks, u64 vertex_count,
+                         u32 components, u64 v, f32 *sum) {
+  for (u32 c = 0; c < components; ++c)
+    sum[c] = 0.f;
+  for (u32 b = 0; b < blocks; ++b) {
+    const f32 *acc = accumulators.data() + (b * vertex_count + v) * components;
+    for (u32 c = 0; c < components; ++c)
+      sum[c] += acc[c];
+  }
+}
+
+}
+
+void TangentSpace::computeNormals(const i32 *indices, u64 index_count,
+                                  const u8 *positions, u64 position_stride, u64 vertex_count,
+                                  u8 *normals, u64 normal_stride,
+                                  normal_weighting weighting) {
+  const u64 triangle_count = index_count / 3;
+  const u32 blocks = std::max(1u, Parallel::blockCount(triangle_count, min_block_size));
+  std::vector<f32> accumulators(blocks * vertex_count * 3, 0.f);
+  Parallel::forBlocks(triangle_count, [&](u64 begin, u64 end, u32 block) {
+    f32 *acc = accumulators.data() + block * vertex_count * 3;
+    for (u64 t = begin; t < end; ++t) {
+      const i32 *triangle = indices + t * 3;
+      if (!validTriangle(triangle, vertex_count))
+        continue;
+      hermes::vec3 p[3];
+      for (int k = 0; k < 3; ++k)
+        p[k] = load3(positions + triangle[k] * position_stride);
+      auto face_normal = hermes::cross(p[1] - p[0], p[2] - p[0]);
+      if (weighting == normal_weighting::angle) {
+        const f32 length = face_normal.length();
+        if (length <= 0.f)
+          continue;
+        face_normal = face_normal / length;
+      }
+      for (int k = 0; k < 3; ++k) {
+        const f32 weight = weighting == normal_weighting::angle ?
+                           cornerAngle(p[(k + 1) % 3] - p[k], p[(k + 2) % 3] - p[k]) : 1.f;
+        f32 *n = acc + triangle[k] * 3;
+        n[0] += face_normal.x * weight;
+        n[1] += face_normal.y * weight;
+        n[2] += face_normal.z * weight;
+      }
+    }
+  }, min_block_size);
+  Parallel::forEach(vertex_count, [&](u64 v) {
+    f32 sum[3];
+    reduceVertex(accumulators, blocks, vertex_count, 3, v, sum);
+    hermes::vec3 n(sum[0], sum[1], sum[2]);
+    const f32 length = n.length();
+    store3(normals + v * normal_stride, length > 0.f ? n / length : hermes::vec3());
+  }, min_block_size);
+}
+
+void TangentSpace::computeTangents(const i32 *indices, u64 index_count,
+                                   const u8 *positions, u64 position_stride,
+                                   const u8 *normals, u64 normal_stride,
+                                   const u8 *uvs, u64 uv_stride, u64 vertex_count,
+                                   u8 *tangents, u64 tangent_stride,
+                                   u8 *bitangents, u64 bitangent_stride) {
+  const u64 triangle_count = index_count / 3;
+  const u32 blocks = std::max(1u, Parallel::blockCount(triangle_count, min_block_size));
+  // tangent (3) + bitangent (3) per vertex
+  std::vector<f32> accumulators(blocks * vertex_count * 6, 0.f);
+  Parallel::forBlocks(triangle_count, [&](u64 begin, u64 end, u32 block) {
+    f32 *acc = accumulators.data() + block * vertex_count * 6;
+    for (u64 t = begin; t < end; ++t) {
+      const i32 *triangle = indices + t * 3;
+      if (!validTriangle(triangle, vertex_count))
+        continue;
+      hermes::vec3 p[3];
+      f32 uv[3][2];
+      for (int k = 0; k < 3; ++k) {
+        p[k] = load3(positions + triangle[k] * position_stride);
+        std::memcpy(uv[k], uvs + triangle[k] * uv_stride, sizeof(uv[k]));
+      }
+      const auto e1 = p[1] - p[0];
+      const auto e2 = p[2] - p[0];
+      const f32 du1 = uv[1][0] - uv[0][0], dv1 = uv[1][1] - uv[0][1];
+      const f32 du2 = uv[2][0] - uv[0][0], dv2 = uv[2][1] - uv[0][1];
+      const f32 det = du1 * dv2 - du2 * dv1;
+      if (std::abs(det) <= 1e-20f)
+        continue;
+      const f32 r = 1.f / det;
+      // derivatives of the position with respect to u and v
+      const auto s_dir = (e1 * dv2 - e2 * dv1) * r;
+      const auto t_dir = (e2 * du1 - e1 * du2) * r;
+      for (int k = 0; k < 3; ++k) {
+        const auto n = load3(normals + triangle[k] * normal_stride);
+        auto tangent = s_dir - n * hermes::dot(n, s_dir);
+        auto bitangent = t_dir - n * hermes::dot(n, t_dir);
+        const f32 tangent_length = tangent.length();
+        const f32 bitangent_length = bitangent.length();
+        if (tangent_length <= 0.f)
+          continue;
+        const f32 weight = cornerAngle(p[(k + 1) % 3] - p[k], p[(k + 2) % 3] - p[k]);
+        tangent = tangent * (weight / tangent_length);
+        if (bitangent_length > 0.f)
+          bitangent = bitangent * (weight / bitangent_length);
+        f32 *a = acc + triangle[k] * 6;
+        a[0] += tangent.x;
+        a[1] += tangent.y;
+        a[2] += tangent.z;
+        a[3] += bitangent.x;
+        a[4] += bitangent.y;
+        a[5] += bitangent.z;
+      }
+    }
+  }, min_block_size);
+  Parallel::forEach(vertex_count, [&](u64 v) {
+    f32 sum[6];
+    reduceVertex(accumulators, blocks, vertex_count, 6, v, sum);
+    const auto n = load3(normals + v * normal_stride);
+    hermes::vec3 tangent(sum[0], sum[1], sum[2]);
+    const hermes::vec3 bitangent_sum(sum[3], sum[4], sum[5]);
+    // Gram-Schmidt
+    tangent = tangent - n * hermes::dot(n, tangent);
+    f32 length = tangent.length();
+    if (length <= 1e-12f) {
+      // no uv gradient: any direction perpendicular to the normal
+      const hermes::vec3 axis = std::abs(n.x) < 0.9f ? hermes::vec3(1, 0, 0) : hermes::vec3(0, 1, 0);
+      tangent = axis - n * hermes::dot(n, axis);
+      length = tangent.length();
+    }
+    tangent = length > 0.f ? tangent / length : hermes::vec3();
+    store3(tangents + v * tangent_stride, tangent);
+    if (bitangents) {
+      const auto bitangent = hermes::cross(n, tangent);
+      const f32 sign = hermes::dot(bitangent, bitangent_sum) < 0.f ? -1.f : 1.f;
+      store3(bitangents + v * bitangent_stride, bitangent * sign);
+    }
+  }, min_block_size);
+}
+
+u64 TangentSpace::findAttribute(const Model &model, const std::vector<std::string> &names) {
+  const auto &fields = model.vertexDescriptor().fields();
+  for (const auto &name : names)
+    for (u64 i = 0; i < fields.size(); ++i)
+      if (fields[i].name == name)
+        return i;
+  return fields.size();
+}
+
+bool TangentSpace::generate(Model &model, shape_options options, normal_weighting weighting) {
+  if ((options & shape_options::tangent_space) == shape_options::tangent_space)
+    options = options | shape_options::tangent | shape_options::bitangent;
+  const bool generate_normals = testMaskBit(options, shape_options::normal);
+  const bool generate_tangents = testMaskBit(options, shape_options::tangent);
+  const bool generate_bitangents = testMaskBit(options, shape_options::bitangent);
+  if (!generate_normals && !generate_tangents && !generate_bitangents)
+    return true;
+  if (model.primitiveType() != hermes::GeometricPrimitiveType::TRIANGLES) {
+    hermes::Log::warn("TangentSpace: only triangle meshes are supported.");
+    return false;
+  }
+  // copy external (memory mapped) and separate data first: materialize()
+  // releases the mapping, so no pointer into it may be taken before
+  model.materialize();
+  const auto &fields = model.vertexDescriptor().fields();
+  auto isVec = [&](u64 id, u32 component_count) {
+    return id < fields.size() && fields[id].type == hermes::DataType::F32 &&
+        fields[id].component_count == component_count;
+  };
+  const u64 position_id = model.positionAttribute();
+  const u64 normal_id = findAttribute(model, {"normal", "normals"});
+  const u64 uv_id = findAttribute(model, {"uv", "uvs"});
+  const u64 tangent_id = findAttribute(model, {"tangents", "tangent"});
+  const u64 bitangent_id = findAttribute(model, {"bitangents", "bitangent"});
+  if (!isVec(position_id, 3) ||
+      (generate_normals && !isVec(normal_id, 3)) ||
+      (generate_tangents && !isVec(tangent_id, 3)) ||
+      (generate_bitangents && !isVec(bitangent_id, 3))) {
+    hermes::Log::warn("TangentSpace: missing vertex attributes.");
+    return false;
+  }
+  if ((generate_tangents || generate_bitangents) && !isVec(uv_id, 2)) {
+    hermes::Log::warn("TangentSpace: tangents require uv coordinates.");
+    return false;
+  }
+  const u64 vertex_count = model.vertexCount();
+  if (!vertex_count)
+    return true;
+  // only the full resolution level contributes
+  std::vector<i32> implicit_indices;
+  const i32 *indices = model.indexData();
+  u64 index_count = model.indexCount();
+  if (!model.levelsOfDetail().empty())
+    index_count = model.levelsOfDetail().front().index_count;
+  if (!index_count) {
+    implicit_indices.resize(vertex_count);
+    std::iota(implicit_indices.begin(), implicit_indices.end(), 0);
+    indices = implicit_indices.data();
+    index_count = vertex_count;
+  }
+  // mutable view of the interleaved vertex data
+  const u64 stride = model.vertexDescriptor().sizeInBytes();
+  u8 *data = reinterpret_cast<u8 *>(&model.attributeValue<hermes::point3>(position_id, 0))
+      - fields[position_id].offset;
+  const u8 *positions = data + fields[position_id].offset;
+  // tangents need normals even when they are not stored
+  std::vector<f32> normal_buffer;
+  const u8 *normals = nullptr;
+  u64 normal_stride = stride;
+  if (generate_normals) {
+    computeNormals(indices, index_count, positions, stride, vertex_count,
+                   data + fields[normal_id].offset, stride, weighting);
+    normals = data + fields[normal_id].offset;
+  } else if (generate_tangents || generate_bitangents) {
+    if (isVec(normal_id, 3))
+      normals = data + fields[normal_id].offset;
+    else {
+      normal_buffer.resize(vertex_count * 3);
+      computeNormals(indices, index_count, positions, stride, vertex_count,
+                     reinterpret_cast<u8 *>(normal_buffer.data()), sizeof(f32) * 3, weighting);
+      normals = reinterpret_cast<const u8 *>(normal_buffer.data());
+      normal_stride = sizeof(f32) * 3;
+    }
+  }
+  if (generate_tangents || generate_bitangents) {
+    std::vector<f32> tangent_buffer;
+    u8 *tangents = nullptr;
+    u64 tangent_stride = stride;
+    if (generate_tangents)
+      tangents = data + fields[tangent_id].offset;
+    else {
+      tangent_buffer.resize(vertex_count * 3);
+      tangents = reinterpret_cast<u8 *>(tangent_buffer.data());
+      tangent_stride = sizeof(f32) * 3;
+    }
+    computeTangents(indices, index_count, positions, stride, normals, normal_stride,
+                    data + fields[uv_id].offset, stride, vertex_count,
+                    tangents, tangent_stride,
+                    generate_bitangents ? data + fields[bitangent_id].offset : nullptr, stride);
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,107 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file tangent_space.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-18
+///
+///\brief Vertex normal and tangent frame generation
+
+#ifndef CIRCE_CIRCE_SCENE_TANGENT_SPACE_H
+#define CIRCE_CIRCE_SCENE_TANGENT_SPACE_H
+
+#include <circe/scene/model.h>
+
+namespace circe {
+
+/// Weight of each triangle in the vertex normals it touches
+enum class normal_weighting {
+  area = 0, //!< unnormalized face normals (larger triangles dominate)
+  angle = 1 //!< face normals weighted by the triangle angle at the vertex
+};
+
+/// Generates per-vertex normals and tangent frames from triangle lists.
+/// Both stages run in parallel over the index buffer: each thread
+/// accumulates the triangles of its block into a private buffer and
+/// buffers are reduced per vertex afterwards, so results do not depend on
+/// scheduling.
+/// Tangents follow the MikkTSpace conventions: per-corner tangents are
+/// projected onto the vertex normal plane, normalized and weighted by the
+/// corner angle; the final tangent is orthonormalized against the normal
+/// and the bitangent is sign * cross(normal, tangent), where sign is the
+/// handedness of the uv mapping. Vertices are not split where the
+/// handedness changes (mirrored uv islands should already be split by the
+/// uv seam).
+/// All strides are in bytes.
+class TangentSpace final {
+public:
+  /// \param indices triangle list
+  /// \param index_count
+  /// \param positions 3 x f32 per vertex
+  /// \param position_stride
+  /// \param vertex_count
+  /// \param normals **[out]** 3 x f32 per vertex (unit length, zero for unreferenced vertices)
+  /// \param normal_stride
+  /// \param weighting
+  static void computeNormals(const i32 *indices, u64 index_count,
+                             const u8 *positions, u64 position_stride, u64 vertex_count,
+                             u8 *normals, u64 normal_stride,
+                             normal_weighting weighting = normal_weighting::angle);
+  /// \param indices triangle list
+  /// \param index_count
+  /// \param positions 3 x f32 per vertex
+  /// \param position_stride
+  /// \param normals 3 x f32 per vertex
+  /// \param normal_stride
+  /// \param uvs 2 x f32 per vertex
+  /// \param uv_stride
+  /// \param vertex_count
+  /// \param tangents **[out]** 3 x f32 per vertex
+  /// \param tangent_stride
+  /// \param bitangents **[out | optional]** 3 x f32 per vertex
+  /// \param bitangent_stride
+  static void computeTangents(const i32 *indices, u64 index_count,
+                              const u8 *positions, u64 position_stride,
+                              const u8 *normals, u64 normal_stride,
+                              const u8 *uvs, u64 uv_stride, u64 vertex_count,
+                              u8 *tangents, u64 tangent_stride,
+                              u8 *bitangents = nullptr, u64 bitangent_stride = 0);
+  /// Fills the normal ("normal"), tangent ("tangents") and bitangent
+  /// ("bitangents") attributes of a triangle model, as requested by options.
+  /// Attributes must already exist. Tangents require uv coordinates
+  /// ("uv" or "uvs").
+  /// \param model **[in/out]**
+  /// \param options normal, tangent and/or bitangent (tangent_space)
+  /// \param weighting
+  /// \return false if the model is not a triangle mesh or misses attributes
+  static bool generate(Model &model, shape_options options,
+                       normal_weighting weighting = normal_weighting::angle);
+  /// \param model
+  /// \param names candidate attribute names
+  /// \return index of the first attribute found, number of attributes otherwise
+  static u64 findAttribute(const Model &model, const std::vector<std::string> &names);
+
+  static constexpr u64 min_block_size = 1 << 13;
+};
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_TANGENT_SPACE_H
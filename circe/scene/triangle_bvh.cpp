@@ -0,0 +1,860 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file triangle_bvh.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-25
+///
+///\brief
+
+#include <circe/scene/triangle_bvh.h>
+#include <circe/common/bounds.h>
+#include <circe/common/parallel.h>
+#include <circe/common/simd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+namespace circe {
+
+namespace {
+
+// *******************************************************************************************************************
+//                                                                                                              LANES
+// *******************************************************************************************************************
+// 8 f32 lanes and lane masks, one per packet ray
+#if defined(CIRCE_AVX)
+struct Lanes {
+  __m256 v;
+};
+struct Mask {
+  __m256 v;
+};
+inline Lanes load(const f32 *p) { return {_mm256_load_ps(p)}; }
+inline Lanes broadcast(f32 s) { return {_mm256_set1_ps(s)}; }
+inline void store(f32 *p, Lanes a) { _mm256_store_ps(p, a.v); }
+inline Lanes operator+(Lanes a, Lanes b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline Lanes min(Lanes a, Lanes b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline Lanes max(Lanes a, Lanes b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline Mask operator<(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline Mask operator<=(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+inline Mask operator!=(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_NEQ_OQ)}; }
+inline Mask operator&(Mask a, Mask b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline Lanes select(Mask m, Lanes a, Lanes b) { return {_mm256_blendv_ps(b.v, a.v, m.v)}; }
+inline u32 bits(Mask m) { return static_cast<u32>(_mm256_movemask_ps(m.v)); }
+#elif defined(CIRCE_SSE)
+struct Lanes {
+  __m128 v[2];
+};
+struct Mask {
+  __m128 v[2];
+};
+#define CIRCE_LANES_OP(EXPR) { { EXPR(0), EXPR(1) } }
+inline Lanes load(const f32 *p) { return {{_mm_load_ps(p), _mm_load_ps(p + 4)}}; }
+inline Lanes broadcast(f32 s) { return {{_mm_set1_ps(s), _mm_set1_ps(s)}}; }
+inline void store(f32 *p, Lanes a) {
+  _mm_store_ps(p, a.v[0]);
+  _mm_store_ps(p + 4, a.v[1]);
+}
+#define CIRCE_ADD(I) _mm_add_ps(a.v[I], b.v[I])
+inline Lanes operator+(Lanes a, Lanes b) { return CIRCE_LANES_OP(CIRCE_ADD); }
+#define CIRCE_SUB(I) _mm_sub_ps(a.v[I], b.v[I])
+inline Lanes operator-(Lanes a, Lanes b) { return CIRCE_LANES_OP(CIRCE_SUB); }
+#define CIRCE_MUL(I) _mm_mul_ps(a.v[I], b.v[I])
+inline Lanes operator*(Lanes a, Lanes b) { return CIRCE_LANES_OP(CIRCE_MUL); }
+#define CIRCE_DIV(I) _mm_div_ps(a.v[I], b.v[I])
+inline Lanes operator/(Lanes a, Lanes b) { return CIRCE_LANES_OP(CIRCE_DIV); }
+#define CIRCE_MIN(I) _mm_min_ps(a.v[I], b.v[I])
+inline Lanes min(Lanes a, Lanes b) { return CIRCE_LANES_OP(CIRCE_MIN); }
+#define CIRCE_MAX(I) _mm_max_ps(a.v[I], b.v[I])
+inline Lanes max(Lanes a, Lanes b) { return CIRCE_LANES_OP(CIRCE_MAX); }
+#define CIRCE_LT(I) _mm_cmplt_ps(a.v[I], b.v[I])
+inline Mask operator<(Lanes a, Lanes b) { return CIRCE_LANES_OP(CIRCE_LT); }
+#define CIRCE_LE(I) _mm_cmple_ps(a.v[I], b.v[I])
+inline Mask operator<=(Lanes a, Lanes b) { return CIRCE_LANES_OP(CIRCE_LE); }
+#define CIRCE_NEQ(I) _mm_cmpneq_ps(a.v[I], b.v[I])
+inline Mask operator!=(Lanes a, Lanes b) { return CIRCE_LANES_OP(CIRCE_NEQ); }
+#define CIRCE_AND(I) _mm_and_ps(a.v[I], b.v[I])
+inline Mask operator&(Mask a, Mask b) { return CIRCE_LANES_OP(CIRCE_AND); }
+#define CIRCE_SELECT(I) _mm_or_ps(_mm_and_ps(m.v[I], a.v[I]), _mm_andnot_ps(m.v[I], b.v[I]))
+inline Lanes select(Mask m, Lanes a, Lanes b) { return CIRCE_LANES_OP(CIRCE_SELECT); }
+inline u32 bits(Mask m) {
+  return static_cast<u32>(_mm_movemask_ps(m.v[0]) | (_mm_movemask_ps(m.v[1]) << 4));
+}
+#undef CIRCE_ADD
+#undef CIRCE_SUB
+#undef CIRCE_MUL
+#undef CIRCE_DIV
+#undef CIRCE_MIN
+#undef CIRCE_MAX
+#undef CIRCE_LT
+#undef CIRCE_LE
+#undef CIRCE_NEQ
+#undef CIRCE_AND
+#undef CIRCE_SELECT
+#undef CIRCE_LANES_OP
+#else
+struct Lanes {
+  f32 v[8];
+};
+struct Mask {
+  bool v[8];
+};
+template<typename R, typename F>
+inline R lanewise(F &&f) {
+  R r;
+  for (int i = 0; i < 8; ++i)
+    r.v[i] = f(i);
+  return r;
+}
+inline Lanes load(const f32 *p) { return lanewise<Lanes>([&](int i) { return p[i]; }); }
+inline Lanes broadcast(f32 s) { return lanewise<Lanes>([&](int) { return s; }); }
+inline void store(f32 *p, Lanes a) {
+  for (int i = 0; i < 8; ++i)
+    p[i] = a.v[i];
+}
+inline Lanes operator+(Lanes a, Lanes b) { return lanewise<Lanes>([&](int i) { return a.v[i] + b.v[i]; }); }
+inline Lanes operator-(Lanes a, Lanes b) { return lanewise<Lanes>([&](int i) { return a.v[i] - b.v[i]; }); }
+inline Lanes operator*(Lanes a, Lanes b) { return lanewise<Lanes>([&](int i) { return a.v[i] * b.v[i]; }); }
+inline Lanes operator/(Lanes a, Lanes b) { return lanewise<Lanes>([&](int i) { return a.v[i] / b.v[i]; }); }
+inline Lanes min(Lanes a, Lanes b) { return lanewise<Lanes>([&](int i) { return a.v[i] < b.v[i] ? a.v[i] : b.v[i]; }); }
+inline Lanes max(Lanes a, Lanes b) { return lanewise<Lanes>([&](int i) { return a.v[i] > b.v[i] ? a.v[i] : b.v[i]; }); }
+inline Mask operator<(Lanes a, Lanes b) { return lanewise<Mask>([&](int i) { return a.v[i] < b.v[i]; }); }
+inline Mask operator<=(Lanes a, Lanes b) { return lanewise<Mask>([&](int i) { return a.v[i] <= b.v[i]; }); }
+inline Mask operator!=(Lanes a, Lanes b) { return lanewise<Mask>([&](int i) { return a.v[i] != b.v[i]; }); }
+inline Mask operator&(Mask a, Mask b) { return lanewise<Mask>([&](int i) { return a.v[i] && b.v[i]; }); }
+inline Lanes select(Mask m, Lanes a, Lanes b) { return lanewise<Lanes>([&](int i) { return m.v[i] ? a.v[i] : b.v[i]; }); }
+inline u32 bits(Mask m) {
+  u32 r = 0;
+  for (int i = 0; i < 8; ++i)
+    r |= static_cast<u32>(m.v[i]) << i;
+  return r;
+}
+#endif
+
+// *******************************************************************************************************************
+//                                                                                                          TRAVERSAL
+// *******************************************************************************************************************
+/// Node stack sized by the tree depth (pending nodes never outnumber it)
+class NodeStack {
+public:
+  explicit NodeStack(u32 max_depth) {
+    if (max_depth >= 64) {
+      storage_.resize(max_depth + 1);
+      nodes_ = storage_.data();
+    }
+  }
+  void push(u32 node) { nodes_[size_++] = node; }
+  bool pop(u32 &node) {
+    if (!size_)
+      return false;
+    node = nodes_[--size_];
+    return true;
+  }
+
+private:
+  u32 buffer_[64]{};
+  std::vector<u32> storage_;
+  u32 *nodes_{buffer_};
+  u32 size_{0};
+};
+
+struct SingleRay {
+  explicit SingleRay(const hermes::Ray3 &ray) {
+    for (int d = 0; d < 3; ++d) {
+      o[d] = ray.o[d];
+      dir[d] = ray.d[d];
+      inv[d] = Bounds::safeInverse(dir[d]);
+      neg[d] = inv[d] < 0;
+    }
+  }
+  [[nodiscard]] bool hits(const hermes::bbox3 &bounds, f32 t_max) const {
+    return Bounds::hitsSlabs(bounds, o, inv, neg, t_max);
+  }
+  f32 o[3]{};
+  f32 dir[3]{};
+  f32 inv[3]{};
+  int neg[3]{};
+};
+
+/// Moller-Trumbore
+template<typename T>
+inline bool intersectTriangle(const T &triangle, const SingleRay &ray, f32 t_max, f32 &t, f32 &u, f32 &v) {
+  const f32 *d = ray.dir, *e1 = triangle.e1, *e2 = triangle.e2;
+  const f32 p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+  const f32 det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+  if (det == 0)
+    return false;
+  const f32 inv_det = 1.f / det;
+  const f32 s[3] = {ray.o[0] - triangle.v0[0], ray.o[1] - triangle.v0[1], ray.o[2] - triangle.v0[2]};
+  u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+  if (u < 0 || u > 1)
+    return false;
+  const f32 q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+  v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+  if (v < 0 || u + v > 1)
+    return false;
+  t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+  return t >= 0 && t < t_max;
+}
+
+/// Visits the leaves of a binary hierarchy hit by a ray, near child first.
+/// visit(first, count) returns the current search distance.
+template<typename F>
+void traverseBinary(const std::vector<BVHBuilder::Node> &nodes, u32 max_depth, const hermes::Ray3 &r, f32 t_max,
+                    F &&visit) {
+  if (nodes.empty())
+    return;
+  const SingleRay ray(r);
+  NodeStack stack(max_depth);
+  u32 node_index = 0;
+  do {
+    const auto &node = nodes[node_index];
+    if (!ray.hits(node.bounds, t_max))
+      continue;
+    if (node.isLeaf()) {
+      t_max = visit(node.offset, node.count);
+      continue;
+    }
+    if (ray.neg[node.axis]) {
+      stack.push(node_index + 1);
+      stack.push(node.offset);
+    } else {
+      stack.push(node.offset);
+      stack.push(node_index + 1);
+    }
+  } while (stack.pop(node_index));
+}
+
+// *******************************************************************************************************************
+//                                                                                                              REFIT
+// *******************************************************************************************************************
+f64 nodeCost(const BVHBuilder::Node &node, const BVHBuilder::Options &options) {
+  return Bounds::area(node.bounds) * (node.isLeaf() ? options.intersection_cost * node.count : options.traversal_cost);
+}
+
+template<typename T>
+hermes::bbox3 triangleBounds(const T &triangle) {
+  hermes::bbox3 b;
+  for (int d = 0; d < 3; ++d) {
+    const f32 v0 = triangle.v0[d], v1 = v0 + triangle.e1[d], v2 = v0 + triangle.e2[d];
+    b.lower[d] = std::min(v0, std::min(v1, v2));
+    b.upper[d] = std::max(v0, std::max(v1, v2));
+  }
+  return b;
+}
+
+template<typename T>
+void setTriangle(T &triangle, const hermes::point3 &a, const hermes::point3 &b, const hermes::point3 &c) {
+  for (int d = 0; d < 3; ++d) {
+    triangle.v0[d] = a[d];
+    triangle.e1[d] = b[d] - a[d];
+    triangle.e2[d] = c[d] - a[d];
+  }
+}
+
+// *******************************************************************************************************************
+//                                                                                                    WINDING NUMBERS
+// *******************************************************************************************************************
+constexpr f32 inv_four_pi = 0.0795774715459477f;
+
+inline f32 dot3(const f32 *a, const f32 *b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+inline f32 length3(const f32 *a) { return std::sqrt(dot3(a, a)); }
+
+/// Signed solid angle of a triangle seen from p (Van Oosterom and Strackee),
+/// positive when p is behind the triangle (counter-clockwise, outward normals)
+template<typename T>
+f32 solidAngle(const T &triangle, const f32 *p) {
+  f32 a[3], b[3], c[3];
+  for (int d = 0; d < 3; ++d) {
+    a[d] = triangle.v0[d] - p[d];
+    b[d] = a[d] + triangle.e1[d];
+    c[d] = a[d] + triangle.e2[d];
+  }
+  const f32 la = length3(a), lb = length3(b), lc = length3(c);
+  const f32 det = a[0] * (b[1] * c[2] - b[2] * c[1]) + a[1] * (b[2] * c[0] - b[0] * c[2])
+      + a[2] * (b[0] * c[1] - b[1] * c[0]);
+  const f32 den = la * lb * lc + dot3(a, b) * lc + dot3(b, c) * la + dot3(c, a) * lb;
+  return 2 * std::atan2(det, den);
+}
+
+} // namespace
+
+// *********************************************************************************************************************
+//                                                                                                         TriangleBVH
+// *********************************************************************************************************************
+void TriangleBVH::RayPacket::add(const hermes::Ray3 &ray, f32 max_t) {
+  if (count >= packet_size)
+    return;
+  for (int d = 0; d < 3; ++d) {
+    origin[d][count] = ray.o[d];
+    direction[d][count] = ray.d[d];
+  }
+  t_max[count++] = max_t;
+}
+
+BVHBuilder::Statistics TriangleBVH::build(const hermes::point3 *positions, const i32 *indices, u64 triangle_count,
+                                          const BVHBuilder::Options &options, bvh_layout layout) {
+  auto vertex = [&](u64 triangle, u32 corner) -> const hermes::point3 & {
+    return positions[indices ? indices[triangle * 3 + corner] : triangle * 3 + corner];
+  };
+  std::vector<hermes::bbox3> bounds(triangle_count);
+  Parallel::forEach(triangle_count, [&](u64 i) {
+    hermes::bbox3 b(vertex(i, 0));
+    for (u32 c = 1; c < 3; ++c)
+      for (int d = 0; d < 3; ++d) {
+        b.lower[d] = std::min(b.lower[d], vertex(i, c)[d]);
+        b.upper[d] = std::max(b.upper[d], vertex(i, c)[d]);
+      }
+    bounds[i] = b;
+  });
+  options_ = options;
+  statistics_ = BVHBuilder::build(bounds.data(), triangle_count, options, nodes_, primitives_);
+  build_cost_ = statistics_.sah_cost;
+  triangles_.resize(primitives_.size());
+  Parallel::forEach(primitives_.size(), [&](u64 i) {
+    setTriangle(triangles_[i], vertex(primitives_[i], 0), vertex(primitives_[i], 1), vertex(primitives_[i], 2));
+  });
+  layout_ = layout;
+  buildLayout();
+  partition();
+  updateWindingNodes();
+  return statistics_;
+}
+
+TriangleBVH::RefitStatistics TriangleBVH::refit(const hermes::point3 *positions, const i32 *indices) {
+  return refit(positions, indices, RefitOptions());
+}
+
+TriangleBVH::RefitStatistics TriangleBVH::refit(const hermes::point3 *positions, const i32 *indices,
+                                                const RefitOptions &options) {
+  RefitStatistics refit_statistics;
+  if (nodes_.empty())
+    return refit_statistics;
+  const auto start = std::chrono::steady_clock::now();
+  auto vertex = [&](u64 triangle, u32 corner) -> const hermes::point3 & {
+    return positions[indices ? indices[triangle * 3 + corner] : triangle * 3 + corner];
+  };
+  Parallel::forEach(primitives_.size(), [&](u64 i) {
+    setTriangle(triangles_[i], vertex(primitives_[i], 0), vertex(primitives_[i], 1), vertex(primitives_[i], 2));
+  });
+  // bottom-up over each subtree (children follow their parents), then the nodes above them
+  std::vector<f64> costs(subtree_roots_.size());
+  Parallel::forEach(subtree_roots_.size(), [&](u64 s) {
+    const u32 root = subtree_roots_[s];
+    f64 cost = 0;
+    for (u32 i = subtreeEnd(root); i-- > root;) {
+      auto &node = nodes_[i];
+      if (node.isLeaf()) {
+        node.bounds = triangleBounds(triangles_[node.offset]);
+        for (u32 e = node.offset + 1; e < node.offset + node.count; ++e)
+          node.bounds = Bounds::merge(node.bounds, triangleBounds(triangles_[e]));
+      } else
+        node.bounds = Bounds::merge(nodes_[i + 1].bounds, nodes_[node.offset].bounds);
+      cost += nodeCost(node, options_);
+    }
+    const f64 root_area = Bounds::area(nodes_[root].bounds);
+    costs[s] = root_area > 0 ? cost / root_area : 0;
+  }, 1);
+  for (auto i : top_nodes_)
+    nodes_[i].bounds = Bounds::merge(nodes_[i + 1].bounds, nodes_[nodes_[i].offset].bounds);
+  auto now = std::chrono::steady_clock::now();
+  refit_statistics.refit_ms = std::chrono::duration<f64, std::milli>(now - start).count();
+  // quality check
+  std::vector<u32> degraded;
+  if (options.rebuild_threshold > 0)
+    for (u32 s = 0; s < subtree_roots_.size(); ++s)
+      if (costs[s] > subtree_costs_[s] * options.rebuild_threshold)
+        degraded.emplace_back(s);
+  if (!degraded.empty()) {
+    for (auto s : degraded) {
+      const u32 root = subtree_roots_[s];
+      const u32 end = subtreeEnd(root);
+      for (u32 i = root; i < end; ++i)
+        refit_statistics.rebuilt_triangles += nodes_[i].count;
+    }
+    refit_statistics.rebuilt_subtrees = degraded.size();
+    rebuild(degraded);
+    const f64 build_ms = statistics_.build_ms;
+    statistics_ = BVHBuilder::statistics(nodes_, options_);
+    statistics_.build_ms = build_ms;
+    buildLayout();
+    refit_statistics.rebuild_ms =
+        std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - now).count();
+  } else {
+    if (layout_ == bvh_layout::wide4)
+      wide4_.refit(nodes_);
+    else if (layout_ == bvh_layout::wide8)
+      wide8_.refit(nodes_);
+    const f64 root_area = Bounds::area(nodes_[0].bounds);
+    f64 cost = 0;
+    for (u32 s = 0; s < subtree_roots_.size(); ++s)
+      cost += costs[s] * Bounds::area(nodes_[subtree_roots_[s]].bounds);
+    for (auto i : top_nodes_)
+      cost += nodeCost(nodes_[i], options_);
+    statistics_.sah_cost = root_area > 0 ? cost / root_area : 0;
+    refit_statistics.refit_ms =
+        std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+  updateWindingNodes();
+  refit_statistics.sah_cost = statistics_.sah_cost;
+  refit_statistics.degradation = build_cost_ > 0 ? static_cast<f32>(statistics_.sah_cost / build_cost_) : 1.f;
+  return refit_statistics;
+}
+
+void TriangleBVH::buildLayout() {
+  wide4_.build(layout_ == bvh_layout::wide4 ? nodes_ : std::vector<BVHBuilder::Node>());
+  wide8_.build(layout_ == bvh_layout::wide8 ? nodes_ : std::vector<BVHBuilder::Node>());
+}
+
+u32 TriangleBVH::subtreeEnd(u32 node) const {
+  while (!nodes_[node].isLeaf())
+    node = nodes_[node].offset;
+  return node + 1;
+}
+
+void TriangleBVH::partition() {
+  subtree_roots_.clear();
+  subtree_costs_.clear();
+  top_nodes_.clear();
+  if (nodes_.empty())
+    return;
+  // open the largest subtree until there are enough of them
+  subtree_roots_.emplace_back(0);
+  while (subtree_roots_.size() < refit_subtree_count) {
+    u64 largest = 0;
+    u32 largest_size = 0;
+    for (u64 s = 0; s < subtree_roots_.size(); ++s) {
+      const u32 root = subtree_roots_[s];
+      const u32 size = nodes_[root].isLeaf() ? 0 : subtreeEnd(root) - root;
+      if (size > largest_size) {
+        largest = s;
+        largest_size = size;
+      }
+    }
+    if (!largest_size)
+      break;
+    const u32 root = subtree_roots_[largest];
+    top_nodes_.emplace_back(root);
+    subtree_roots_[largest] = root + 1;
+    subtree_roots_.emplace_back(nodes_[root].offset);
+  }
+  std::sort(subtree_roots_.begin(), subtree_roots_.end());
+  std::sort(top_nodes_.rbegin(), top_nodes_.rend());
+  subtree_costs_.resize(subtree_roots_.size());
+  Parallel::forEach(subtree_roots_.size(), [&](u64 s) {
+    const u32 root = subtree_roots_[s];
+    f64 cost = 0;
+    for (u32 i = root; i < subtreeEnd(root); ++i)
+      cost += nodeCost(nodes_[i], options_);
+    const f64 root_area = Bounds::area(nodes_[root].bounds);
+    subtree_costs_[s] = root_area > 0 ? cost / root_area : 0;
+  }, 1);
+}
+
+void TriangleBVH::rebuild(const std::vector<u32> &subtrees) {
+  struct Replacement {
+    u32 root{0};
+    u32 first_element{0};
+    std::vector<BVHBuilder::Node> nodes;
+  };
+  std::vector<Replacement> replacements(subtrees.size());
+  std::vector<hermes::bbox3> bounds;
+  std::vector<u32> elements;
+  std::vector<Triangle> triangles;
+  std::vector<u32> primitives;
+  for (u64 r = 0; r < subtrees.size(); ++r) {
+    auto &replacement = replacements[r];
+    replacement.root = subtree_roots_[subtrees[r]];
+    // leaves of a subtree reference a contiguous range of triangles
+    u32 first = ~0u, last = 0;
+    for (u32 i = replacement.root; i < subtreeEnd(replacement.root); ++i)
+      if (nodes_[i].isLeaf()) {
+        first = std::min(first, nodes_[i].offset);
+        last = std::max(last, nodes_[i].offset + nodes_[i].count);
+      }
+    const u32 count = last - first;
+    bounds.resize(count);
+    Parallel::forEach(count, [&](u64 i) { bounds[i] = triangleBounds(triangles_[first + i]); });
+    BVHBuilder::build(bounds.data(), count, options_, replacement.nodes, elements);
+    triangles.assign(triangles_.begin() + first, triangles_.begin() + last);
+    primitives.assign(primitives_.begin() + first, primitives_.begin() + last);
+    for (u32 i = 0; i < count; ++i) {
+      triangles_[first + i] = triangles[elements[i]];
+      primitives_[first + i] = primitives[elements[i]];
+    }
+    replacement.first_element = first;
+    subtree_costs_[subtrees[r]] = BVHBuilder::sahCost(replacement.nodes, options_);
+  }
+  // splice the new subtrees; old nodes are visited in increasing index
+  // order, which keeps the partition indices (tracked) in step
+  std::vector<u32 *> tracked;
+  for (auto &root : subtree_roots_)
+    tracked.emplace_back(&root);
+  for (auto &node : top_nodes_)
+    tracked.emplace_back(&node);
+  std::sort(tracked.begin(), tracked.end(), [](const u32 *a, const u32 *b) { return *a < *b; });
+  std::vector<BVHBuilder::Node> old_nodes;
+  old_nodes.swap(nodes_);
+  nodes_.reserve(old_nodes.size());
+  struct Pending {
+    u32 node;
+    i64 parent; //!< node whose second child this is (-1 for first children)
+  };
+  std::vector<Pending> stack{{0, -1}};
+  u64 next_tracked = 0, next_replacement = 0;
+  while (!stack.empty()) {
+    const Pending pending = stack.back();
+    stack.pop_back();
+    const u32 index = static_cast<u32>(nodes_.size());
+    if (pending.parent >= 0)
+      nodes_[pending.parent].offset = index;
+    if (next_tracked < tracked.size() && *tracked[next_tracked] == pending.node)
+      *tracked[next_tracked++] = index;
+    if (next_replacement < replacements.size() && replacements[next_replacement].root == pending.node) {
+      const auto &replacement = replacements[next_replacement++];
+      for (auto node : replacement.nodes) {
+        node.offset += node.isLeaf() ? replacement.first_element : index;
+        nodes_.emplace_back(node);
+      }
+      continue;
+    }
+    const auto &node = old_nodes[pending.node];
+    nodes_.emplace_back(node);
+    if (!node.isLeaf()) {
+      stack.push_back({node.offset, index});
+      stack.push_back({pending.node + 1, -1});
+    }
+  }
+}
+
+void TriangleBVH::updateWindingNodes() {
+  winding_nodes_.resize(nodes_.size());
+  auto update = [&](u32 i) {
+    const auto &node = nodes_[i];
+    auto &winding_node = winding_nodes_[i];
+    winding_node = WindingNode();
+    f32 weighted_center[3] = {0, 0, 0};
+    f32 center[3] = {0, 0, 0};
+    if (node.isLeaf()) {
+      for (u32 e = node.offset; e < node.offset + node.count; ++e) {
+        const auto &triangle = triangles_[e];
+        const f32 normal[3] = {0.5f * (triangle.e1[1] * triangle.e2[2] - triangle.e1[2] * triangle.e2[1]),
+                               0.5f * (triangle.e1[2] * triangle.e2[0] - triangle.e1[0] * triangle.e2[2]),
+                               0.5f * (triangle.e1[0] * triangle.e2[1] - triangle.e1[1] * triangle.e2[0])};
+        const f32 area = length3(normal);
+        winding_node.area += area;
+        for (int d = 0; d < 3; ++d) {
+          const f32 centroid = triangle.v0[d] + (triangle.e1[d] + triangle.e2[d]) / 3;
+          winding_node.normal[d] += normal[d];
+          weighted_center[d] += area * centroid;
+          center[d] += centroid / node.count;
+        }
+      }
+    } else {
+      for (auto child : {i + 1, node.offset}) {
+        const auto &child_node = winding_nodes_[child];
+        winding_node.area += child_node.area;
+        for (int d = 0; d < 3; ++d) {
+          winding_node.normal[d] += child_node.normal[d];
+          weighted_center[d] += child_node.area * child_node.center[d];
+          center[d] += 0.5f * child_node.center[d];
+        }
+      }
+    }
+    // degenerate triangles have no area to weight by
+    for (int d = 0; d < 3; ++d)
+      winding_node.center[d] = winding_node.area > 0 ? weighted_center[d] / winding_node.area : center[d];
+    if (node.isLeaf()) {
+      for (u32 e = node.offset; e < node.offset + node.count; ++e) {
+        const auto &triangle = triangles_[e];
+        for (u32 corner = 0; corner < 3; ++corner) {
+          f32 offset[3];
+          for (int d = 0; d < 3; ++d)
+            offset[d] = triangle.v0[d] - winding_node.center[d]
+                + (corner == 1 ? triangle.e1[d] : corner == 2 ? triangle.e2[d] : 0.f);
+          winding_node.radius = std::max(winding_node.radius, length3(offset));
+        }
+      }
+    } else {
+      for (auto child : {i + 1, node.offset}) {
+        const auto &child_node = winding_nodes_[child];
+        f32 offset[3];
+        for (int d = 0; d < 3; ++d)
+          offset[d] = child_node.center[d] - winding_node.center[d];
+        winding_node.radius = std::max(winding_node.radius, length3(offset) + child_node.radius);
+      }
+    }
+  };
+  // children follow their parents: bottom-up over each subtree, then the nodes above them
+  Parallel::forEach(subtree_roots_.size(), [&](u64 s) {
+    const u32 root = subtree_roots_[s];
+    for (u32 i = subtreeEnd(root); i-- > root;)
+      update(i);
+  }, 1);
+  for (auto i : top_nodes_)
+    update(i);
+}
+
+u64 TriangleBVH::nodeMemorySizeInBytes() const {
+  switch (layout_) {
+  case bvh_layout::wide4: return wide4_.memorySizeInBytes();
+  case bvh_layout::wide8: return wide8_.memorySizeInBytes();
+  default: return nodes_.size() * sizeof(BVHBuilder::Node);
+  }
+}
+
+template<typename F>
+void TriangleBVH::traverse(const hermes::Ray3 &ray, f32 t_max, F &&visit) const {
+  switch (layout_) {
+  case bvh_layout::wide4: wide4_.traverse(ray, t_max, visit);
+    break;
+  case bvh_layout::wide8: wide8_.traverse(ray, t_max, visit);
+    break;
+  default: traverseBinary(nodes_, statistics_.max_depth, ray, t_max, visit);
+  }
+}
+
+TriangleBVH::Hit TriangleBVH::closestHit(const hermes::Ray3 &ray, f32 max_t) const {
+  Hit hit;
+  hit.t = max_t;
+  const SingleRay single_ray(ray);
+  traverse(ray, max_t, [&](u32 first, u32 count) {
+    f32 t, u, v;
+    for (u32 i = first; i < first + count; ++i)
+      if (intersectTriangle(triangles_[i], single_ray, hit.t, t, u, v)) {
+        hit.primitive = primitives_[i];
+        hit.t = t;
+        hit.u = u;
+        hit.v = v;
+      }
+    return hit.t;
+  });
+  if (!hit.valid())
+    hit.t = std::numeric_limits<f32>::infinity();
+  return hit;
+}
+
+u32 TriangleBVH::countHits(const hermes::Ray3 &ray, f32 *closest_t) const {
+  u32 count = 0;
+  f32 closest = std::numeric_limits<f32>::infinity();
+  const SingleRay single_ray(ray);
+  const f32 t_max = std::numeric_limits<f32>::infinity();
+  // every hit is counted, so the traversal is never shortened to the closest
+  traverse(ray, t_max, [&](u32 first, u32 element_count) {
+    f32 t, u, v;
+    for (u32 i = first; i < first + element_count; ++i)
+      if (intersectTriangle(triangles_[i], single_ray, t_max, t, u, v)) {
+        count++;
+        closest = std::min(closest, t);
+      }
+    return t_max;
+  });
+  if (closest_t)
+    *closest_t = closest;
+  return count;
+}
+
+f32 TriangleBVH::windingNumber(const hermes::point3 &p, f32 accuracy) const {
+  if (nodes_.empty())
+    return 0;
+  const f32 q[3] = {p.x, p.y, p.z};
+  const f32 accuracy2 = accuracy * accuracy;
+  f32 solid_angle = 0;
+  NodeStack stack(statistics_.max_depth);
+  u32 node_index = 0;
+  do {
+    const auto &winding_node = winding_nodes_[node_index];
+    const f32 offset[3] = {winding_node.center[0] - q[0],
+                           winding_node.center[1] - q[1],
+                           winding_node.center[2] - q[2]};
+    const f32 distance2 = dot3(offset, offset);
+    if (distance2 > accuracy2 * winding_node.radius * winding_node.radius) {
+      // far field: dipole at the node center
+      solid_angle += dot3(winding_node.normal, offset) / (distance2 * std::sqrt(distance2));
+      continue;
+    }
+    const auto &node = nodes_[node_index];
+    if (node.isLeaf()) {
+      for (u32 i = node.offset; i < node.offset + node.count; ++i)
+        solid_angle += solidAngle(triangles_[i], q);
+      continue;
+    }
+    stack.push(node.offset);
+    stack.push(node_index + 1);
+  } while (stack.pop(node_index));
+  return solid_angle * inv_four_pi;
+}
+
+void TriangleBVH::windingNumbers(const hermes::point3 *points, u64 count, f32 *winding_numbers,
+                                 f32 accuracy) const {
+  Parallel::forEach(count, [&](u64 i) { winding_numbers[i] = windingNumber(points[i], accuracy); }, 256);
+}
+
+bool TriangleBVH::parityInside(const hermes::point3 &p) const {
+  // generic directions, so grid aligned points and meshes rarely graze edges;
+  // the third ray breaks ties when an edge or vertex hit flips a parity
+  static const hermes::vec3 directions[3] = {hermes::vec3(0.5347f, 0.6012f, 0.5937f),
+                                             hermes::vec3(-0.7128f, 0.3071f, 0.6303f),
+                                             hermes::vec3(0.2296f, -0.8167f, 0.5294f)};
+  const bool first = countHits(hermes::Ray3(p, directions[0])) % 2;
+  const bool second = countHits(hermes::Ray3(p, directions[1])) % 2;
+  if (first == second)
+    return first;
+  return countHits(hermes::Ray3(p, directions[2])) % 2;
+}
+
+bool TriangleBVH::isInside(const hermes::point3 &p, const InsideOptions &options) const {
+  if (options.method == inside_test::parity)
+    return parityInside(p);
+  return windingNumber(p, options.accuracy) > 0.5f;
+}
+
+bool TriangleBVH::isInside(const hermes::point3 &p) const {
+  return isInside(p, InsideOptions());
+}
+
+void TriangleBVH::isInside(const hermes::point3 *points, u64 count, u8 *inside,
+                           const InsideOptions &options) const {
+  Parallel::forEach(count, [&](u64 i) { inside[i] = isInside(points[i], options); }, 256);
+}
+
+void TriangleBVH::isInside(const hermes::point3 *points, u64 count, u8 *inside) const {
+  isInside(points, count, inside, InsideOptions());
+}
+
+void TriangleBVH::closestHit(const RayPacket &packet, Hit *hits) const {
+  if (!packet.count)
+    return;
+  for (u32 lane = 0; lane < packet.count; ++lane)
+    hits[lane] = Hit();
+  if (nodes_.empty())
+    return;
+  alignas(32) f32 inv[3][packet_size];
+  alignas(32) f32 t_max[packet_size];
+  alignas(32) f32 hit_u[packet_size]{};
+  alignas(32) f32 hit_v[packet_size]{};
+  u32 primitive[packet_size];
+  // the near child is chosen by the majority of the packet directions
+  int negative_count[3] = {0, 0, 0};
+  for (u32 lane = 0; lane < packet_size; ++lane) {
+    const bool active = lane < packet.count;
+    // inactive lanes get an empty range
+    t_max[lane] = active ? packet.t_max[lane] : -1.f;
+    primitive[lane] = no_primitive;
+    for (int d = 0; d < 3; ++d) {
+      inv[d][lane] = Bounds::safeInverse(packet.direction[d][lane]);
+      negative_count[d] += active && inv[d][lane] < 0;
+    }
+  }
+  const Lanes o[3] = {load(packet.origin[0]), load(packet.origin[1]), load(packet.origin[2])};
+  const Lanes dir[3] = {load(packet.direction[0]), load(packet.direction[1]), load(packet.direction[2])};
+  const Lanes inv_dir[3] = {load(inv[0]), load(inv[1]), load(inv[2])};
+  const Lanes zero = broadcast(0.f), one = broadcast(1.f);
+  Lanes t_far = load(t_max);
+  Lanes u_lanes = zero, v_lanes = zero;
+
+  NodeStack stack(statistics_.max_depth);
+  u32 node_index = 0;
+  do {
+    const auto &node = nodes_[node_index];
+    // slab test of all rays
+    Lanes t_enter = zero, t_exit = t_far;
+    for (int d = 0; d < 3; ++d) {
+      const Lanes t0 = (broadcast(node.bounds.lower[d]) - o[d]) * inv_dir[d];
+      const Lanes t1 = (broadcast(node.bounds.upper[d]) - o[d]) * inv_dir[d];
+      t_enter = max(t_enter, min(t0, t1));
+      t_exit = min(t_exit, max(t0, t1));
+    }
+    if (!bits(t_enter <= t_exit))
+      continue;
+    if (!node.isLeaf()) {
+      if (2 * negative_count[node.axis] > static_cast<int>(packet.count)) {
+        stack.push(node_index + 1);
+        stack.push(node.offset);
+      } else {
+        stack.push(node.offset);
+        stack.push(node_index + 1);
+      }
+      continue;
+    }
+    for (u32 i = node.offset; i < node.offset + node.count; ++i) {
+      const auto &triangle = triangles_[i];
+      const Lanes e1[3] = {broadcast(triangle.e1[0]), broadcast(triangle.e1[1]), broadcast(triangle.e1[2])};
+      const Lanes e2[3] = {broadcast(triangle.e2[0]), broadcast(triangle.e2[1]), broadcast(triangle.e2[2])};
+      const Lanes p[3] = {dir[1] * e2[2] - dir[2] * e2[1],
+                          dir[2] * e2[0] - dir[0] * e2[2],
+                          dir[0] * e2[1] - dir[1] * e2[0]};
+      const Lanes det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+      const Lanes inv_det = one / det;
+      const Lanes s[3] = {o[0] - broadcast(triangle.v0[0]),
+                          o[1] - broadcast(triangle.v0[1]),
+                          o[2] - broadcast(triangle.v0[2])};
+      const Lanes u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+      const Lanes q[3] = {s[1] * e1[2] - s[2] * e1[1],
+                          s[2] * e1[0] - s[0] * e1[2],
+                          s[0] * e1[1] - s[1] * e1[0]};
+      const Lanes v = (dir[0] * q[0] + dir[1] * q[1] + dir[2] * q[2]) * inv_det;
+      const Lanes t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+      const Mask hit = (det != zero) & (zero <= u) & (zero <= v) & (u + v <= one) & (zero <= t) & (t < t_far);
+      const u32 hit_bits = bits(hit);
+      if (!hit_bits)
+        continue;
+      t_far = select(hit, t, t_far);
+      u_lanes = select(hit, u, u_lanes);
+      v_lanes = select(hit, v, v_lanes);
+      for (u32 lane = 0; lane < packet_size; ++lane)
+        if (hit_bits & (1u << lane))
+          primitive[lane] = primitives_[i];
+    }
+  } while (stack.pop(node_index));
+
+  store(t_max, t_far);
+  store(hit_u, u_lanes);
+  store(hit_v, v_lanes);
+  for (u32 lane = 0; lane < packet.count; ++lane) {
+    hits[lane].primitive = primitive[lane];
+    hits[lane].t = primitive[lane] != no_primitive ? t_max[lane] : std::numeric_limits<f32>::infinity();
+    hits[lane].u = hit_u[lane];
+    hits[lane].v = hit_v[lane];
+  }
+}
+
+void TriangleBVH::closestHits(const hermes::Ray3 *rays, u64 count, Hit *hits) const {
+  const u64 packet_count = (count + packet_size - 1) / packet_size;
+  Parallel::forBlocks(packet_count, [&](u64 begin, u64 end, u32) {
+    RayPacket packet;
+    for (u64 p = begin; p < end; ++p) {
+      packet.count = 0;
+      const u64 first = p * packet_size;
+      for (u64 r = first; r < std::min(first + packet_size, count); ++r)
+        packet.add(rays[r]);
+      closestHit(packet, hits + first);
+    }
+  }, 64);
+}
+
+}
@@ -0,0 +1,242 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file triangle_bvh.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-25
+///
+///\brief Triangle mesh BVH with single ray and packet queries
+
+#ifndef CIRCE_CIRCE_SCENE_TRIANGLE_BVH_H
+#define CIRCE_CIRCE_SCENE_TRIANGLE_BVH_H
+
+#include <circe/scene/wide_bvh.h>
+#include <hermes/geometry/ray.h>
+#include <limits>
+#include <vector>
+
+namespace circe {
+
+/// Node layout used by single ray queries. Wide layouts are kept next to the
+/// binary nodes (packets, refit and winding numbers run on those), so they
+/// trade extra memory for faster single ray traversal.
+enum class bvh_layout {
+  binary, //!< BVHBuilder nodes
+  wide4,  //!< WideBVH<4>
+  wide8   //!< WideBVH<8>
+};
+
+/// Point classification method of TriangleBVH::isInside
+enum class inside_test {
+  parity,        //!< odd number of ray crossings (closed meshes only)
+  winding_number //!< generalized winding number above 1/2 (tolerates holes and overlaps)
+};
+
+/// Bounding volume hierarchy over the triangles of a mesh (see BVHBuilder).
+/// Triangles are stored in leaf order as a vertex and two edges, ready for
+/// the Moller-Trumbore test. Single ray queries run over the binary nodes or
+/// over a wide collapsed copy of them (see bvh_layout and WideBVH).
+///
+/// Rays can be traced one at a time or in packets of packet_size rays. A
+/// packet visits a node if any of its rays hits the node bounds and tests
+/// every triangle against all rays at once (8 lanes with AVX, two 4 lane
+/// halves with SSE, a plain loop otherwise). Packets pay off for coherent
+/// rays (similar origins and directions, like a tile of probe rays); bulk
+/// queries split their packets across threads.
+///
+/// Deforming meshes (same triangles, moving vertices) are updated with
+/// refit(): node bounds are recomputed bottom-up, in parallel over
+/// refit_subtree_count subtrees chosen at build time. The SAH cost of each
+/// subtree is compared to its cost when it was built; subtrees that degraded
+/// past RefitOptions::rebuild_threshold are rebuilt in place.
+///
+/// Points are classified against the mesh by ray parity or by the
+/// generalized winding number (Barill et al., Fast Winding Numbers for Soups
+/// and Clouds). Winding numbers sum the solid angles of the triangles near
+/// the point and replace distant nodes by a dipole (area weighted normal at
+/// the area weighted centroid), so they give sensible answers for meshes
+/// with holes or self intersections. Bulk queries run in parallel.
+///
+/// Example:
+///   TriangleBVH bvh;
+///   bvh.build(positions.data(), indices.data(), indices.size() / 3);
+///   auto hit = bvh.closestHit(ray);
+///   if (hit.valid())
+///     auto p = ray(hit.t);
+class TriangleBVH final {
+public:
+  static constexpr u32 packet_size = 8;
+  static constexpr u32 no_primitive = ~0u;
+  /// Closest intersection of a ray
+  struct Hit {
+    u32 primitive{no_primitive}; //!< triangle index
+    f32 t{std::numeric_limits<f32>::infinity()};
+    f32 u{0}; //!< barycentric coordinate of the second vertex
+    f32 v{0}; //!< barycentric coordinate of the third vertex
+    [[nodiscard]] bool valid() const { return primitive != no_primitive; }
+  };
+  /// Up to packet_size rays in SoA layout
+  struct alignas(32) RayPacket {
+    f32 origin[3][packet_size]{};
+    f32 direction[3][packet_size]{};
+    f32 t_max[packet_size]{};
+    u32 count{0};
+    /// Appends a ray
+    /// \param ray
+    /// \param max_t hits are searched in [0, max_t)
+    void add(const hermes::Ray3 &ray, f32 max_t = std::numeric_limits<f32>::infinity());
+  };
+  struct RefitOptions {
+    f32 rebuild_threshold{1.5f}; //!< rebuild subtrees whose sah cost grew by this factor (0 never rebuilds)
+  };
+  struct RefitStatistics {
+    f64 sah_cost{0};        //!< after refit and rebuilds
+    f32 degradation{1};     //!< sah cost relative to the last full build
+    u32 rebuilt_subtrees{0};
+    u64 rebuilt_triangles{0};
+    f64 refit_ms{0};
+    f64 rebuild_ms{0};
+  };
+  struct InsideOptions {
+    inside_test method{inside_test::winding_number};
+    f32 accuracy{2}; //!< nodes farther than accuracy * node radius are approximated (winding numbers)
+  };
+
+  TriangleBVH() = default;
+  /// Builds the hierarchy
+  /// \param positions vertex positions
+  /// \param indices 3 indices per triangle (nullptr reads 3 consecutive positions per triangle)
+  /// \param triangle_count
+  /// \param options
+  /// \param layout nodes traversed by single ray queries (packets always use the binary nodes)
+  /// \return build statistics
+  BVHBuilder::Statistics build(const hermes::point3 *positions, const i32 *indices, u64 triangle_count,
+                               const BVHBuilder::Options &options = {},
+                               bvh_layout layout = bvh_layout::binary);
+  /// Updates the hierarchy to moved vertices (the triangles must be the same
+  /// as in build)
+  /// \param positions vertex positions
+  /// \param indices 3 indices per triangle (nullptr reads 3 consecutive positions per triangle)
+  /// \param options
+  /// \return
+  RefitStatistics refit(const hermes::point3 *positions, const i32 *indices, const RefitOptions &options);
+  /// Refit with default options
+  RefitStatistics refit(const hermes::point3 *positions, const i32 *indices);
+  /// \param ray
+  /// \param max_t hits are searched in [0, max_t)
+  /// \return closest hit (invalid if none)
+  [[nodiscard]] Hit closestHit(const hermes::Ray3 &ray, f32 max_t = std::numeric_limits<f32>::infinity()) const;
+  /// \param packet
+  /// \param hits **[out]** packet.count hits
+  void closestHit(const RayPacket &packet, Hit *hits) const;
+  /// Traces rays in packets of consecutive rays, in parallel
+  /// \param rays
+  /// \param count
+  /// \param hits **[out]** count hits
+  void closestHits(const hermes::Ray3 *rays, u64 count, Hit *hits) const;
+  /// Counts hits and finds the closest one in a single traversal
+  /// \param ray
+  /// \param closest_t **[out | optional]** parametric coordinate of the closest hit (infinity if none)
+  /// \return number of triangles crossed by the ray (t >= 0)
+  u32 countHits(const hermes::Ray3 &ray, f32 *closest_t = nullptr) const;
+  /// \param p
+  /// \param accuracy nodes farther than accuracy * node radius are approximated
+  /// \return generalized winding number of the mesh around p (1 inside, 0 outside)
+  [[nodiscard]] f32 windingNumber(const hermes::point3 &p, f32 accuracy = 2) const;
+  /// Computes winding numbers in parallel
+  /// \param points
+  /// \param count
+  /// \param winding_numbers **[out]** count values
+  /// \param accuracy nodes farther than accuracy * node radius are approximated
+  void windingNumbers(const hermes::point3 *points, u64 count, f32 *winding_numbers, f32 accuracy = 2) const;
+  /// \param p
+  /// \param options
+  /// \return true if p is inside the mesh
+  [[nodiscard]] bool isInside(const hermes::point3 &p, const InsideOptions &options) const;
+  /// isInside with default options
+  [[nodiscard]] bool isInside(const hermes::point3 &p) const;
+  /// Classifies points in parallel
+  /// \param points
+  /// \param count
+  /// \param inside **[out]** count values, 1 for points inside the mesh
+  /// \param options
+  void isInside(const hermes::point3 *points, u64 count, u8 *inside, const InsideOptions &options) const;
+  /// isInside with default options
+  void isInside(const hermes::point3 *points, u64 count, u8 *inside) const;
+
+  [[nodiscard]] const std::vector<BVHBuilder::Node> &nodes() const { return nodes_; }
+  [[nodiscard]] const BVHBuilder::Statistics &statistics() const { return statistics_; }
+  [[nodiscard]] u64 triangleCount() const { return primitives_.size(); }
+  [[nodiscard]] bvh_layout layout() const { return layout_; }
+  /// \return bytes of the nodes traversed by single ray queries (the binary
+  ///         nodes are kept in addition to wide ones)
+  [[nodiscard]] u64 nodeMemorySizeInBytes() const;
+
+  static constexpr u32 refit_subtree_count = 64;
+
+private:
+  struct Triangle {
+    f32 v0[3];
+    f32 e1[3];
+    f32 e2[3];
+  };
+  /// Dipole of the triangles under a node
+  struct WindingNode {
+    f32 center[3]{}; //!< area weighted centroid
+    f32 normal[3]{}; //!< sum of the area weighted normals
+    f32 area{0};
+    f32 radius{0};   //!< distance from center to the farthest vertex (upper bound)
+  };
+
+  template<typename F>
+  void traverse(const hermes::Ray3 &ray, f32 t_max, F &&visit) const;
+  void buildLayout();
+  /// Splits the tree into refit subtrees and records their costs
+  void partition();
+  /// \return index past the last node of the subtree rooted at node
+  [[nodiscard]] u32 subtreeEnd(u32 node) const;
+  /// Rebuilds subtrees (ascending roots) and splices them into the node array
+  void rebuild(const std::vector<u32> &subtrees);
+  /// Recomputes the node dipoles used by winding numbers
+  void updateWindingNodes();
+  /// \param p
+  /// \return true if odd crossings along most of 3 rays from p
+  [[nodiscard]] bool parityInside(const hermes::point3 &p) const;
+
+  std::vector<BVHBuilder::Node> nodes_;
+  WideBVH<4> wide4_;
+  WideBVH<8> wide8_;
+  bvh_layout layout_{bvh_layout::binary};
+  std::vector<Triangle> triangles_; //!< leaf order
+  std::vector<u32> primitives_;     //!< triangle index of each leaf triangle
+  std::vector<WindingNode> winding_nodes_; //!< one per binary node
+  BVHBuilder::Statistics statistics_;
+  BVHBuilder::Options options_;
+  // refit
+  std::vector<u32> subtree_roots_; //!< ascending
+  std::vector<f64> subtree_costs_; //!< sah cost of each subtree when it was built
+  std::vector<u32> top_nodes_;     //!< nodes above the subtrees, descending
+  f64 build_cost_{0};
+};
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_TRIANGLE_BVH_H
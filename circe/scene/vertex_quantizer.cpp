@@ -0,0 +1,341 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file vertex_quantizer.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-17
+///
+///\brief
+
+#include <circe/scene/vertex_quantizer.h>
+#include <circe/scene/attribute_semantics.h>
+#include <circe/common/parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace circe {
+
+namespace {
+
+inline f32 signNotZero(f32 v) {
+  return v >= 0.f ? 1.f : -1.f;
+}
+
+}
+
+QuantizedVertices VertexQuantizer::quantize(const Model &model) {
+  QuantizedVertices vertices;
+  const auto &descriptor = model.vertexDescriptor();
+  const auto &fields = descriptor.fields();
+  const u64 position_id = model.positionAttribute();
+  // setup output layout
+  for (u64 i = 0; i < fields.size(); ++i) {
+    const auto &field = fields[i];
+    QuantizedVertices::Attribute attribute;
+    attribute.name = field.name;
+    attribute.offset = vertices.stride;
+    if (field.type == hermes::DataType::F32 && field.component_count == 3 && i == position_id) {
+      attribute.encoding = vertex_encoding::snorm16;
+      attribute.component_count = 4;
+      attribute.type = hermes::DataType::I16;
+      attribute.normalized = true;
+      vertices.stride += 8;
+    } else if (field.type == hermes::DataType::F32 && field.component_count == 3 &&
+        AttributeSemantics::isDirection(field.name)) {
+      attribute.encoding = vertex_encoding::octahedral;
+      attribute.component_count = 2;
+      attribute.type = hermes::DataType::I16;
+      attribute.normalized = true;
+      vertices.stride += 4;
+    } else if (field.type == hermes::DataType::F32 && field.component_count == 2) {
+      attribute.encoding = vertex_encoding::half;
+      attribute.component_count = 2;
+      attribute.type = hermes::DataType::F16;
+      vertices.stride += 4;
+    } else {
+      attribute.component_count = field.component_count;
+      attribute.type = field.type;
+      vertices.stride += field.size;
+    }
+    vertices.attributes.emplace_back(attribute);
+  }
+  vertices.vertex_count = model.vertexCount();
+  vertices.data.resize(vertices.stride * vertices.vertex_count, 0);
+  if (!vertices.vertex_count)
+    return vertices;
+  // position dequantization
+  if (position_id < fields.size()) {
+    const auto bounds = model.boundingBox();
+    const auto center = bounds.centroid();
+    vertices.position_offset = {center.x, center.y, center.z};
+    for (int d = 0; d < 3; ++d)
+      vertices.position_scale[d] = std::max(bounds.size(d) * 0.5f, 1e-12f);
+  }
+  const hermes::vec3 inv_scale(1.f / vertices.position_scale.x,
+                               1.f / vertices.position_scale.y,
+                               1.f / vertices.position_scale.z);
+  // attributes are read in place from any vertex storage
+  std::vector<const u8 *> inputs(fields.size());
+  std::vector<u64> input_strides(fields.size());
+  for (u64 i = 0; i < fields.size(); ++i)
+    inputs[i] = model.attributeElements(i, input_strides[i]);
+  u8 *output = vertices.data.data();
+  const u64 output_stride = vertices.stride;
+  const auto &attributes = vertices.attributes;
+  const auto offset = vertices.position_offset;
+  Parallel::forBlocks(vertices.vertex_count, [&](u64 begin, u64 end, u32) {
+    for (u64 v = begin; v < end; ++v) {
+      u8 *dst = output + v * output_stride;
+      for (u64 i = 0; i < attributes.size(); ++i) {
+        const u8 *field_src = inputs[i] + v * input_strides[i];
+        u8 *field_dst = dst + attributes[i].offset;
+        f32 in[3];
+        switch (attributes[i].encoding) {
+        case vertex_encoding::snorm16: {
+          std::memcpy(in, field_src, sizeof(f32) * 3);
+          i16 out[4] = {0, 0, 0, 32767};
+          for (int d = 0; d < 3; ++d)
+            out[d] = encodeSnorm16((in[d] - offset[d]) * inv_scale[d]);
+          std::memcpy(field_dst, out, sizeof(out));
+          break;
+        }
+        case vertex_encoding::octahedral: {
+          std::memcpy(in, field_src, sizeof(f32) * 3);
+          i16 out[2];
+          encodeOctahedral(hermes::vec3(in[0], in[1], in[2]), out[0], out[1]);
+          std::memcpy(field_dst, out, sizeof(out));
+          break;
+        }
+        case vertex_encoding::half: {
+          std::memcpy(in, field_src, sizeof(f32) * 2);
+          u16 out[2] = {floatToHalf(in[0]), floatToHalf(in[1])};
+          std::memcpy(field_dst, out, sizeof(out));
+          break;
+        }
+        default:std::memcpy(field_dst, field_src, fields[i].size);
+        }
+      }
+    }
+  }, min_block_size);
+  return vertices;
+}
+
+hermes::AoS VertexQuantizer::dequantize(const QuantizedVertices &vertices) {
+  hermes::AoS aos;
+  // output field of each attribute (-1 if skipped)
+  std::vector<i64> field_ids;
+  for (const auto &attribute : vertices.attributes) {
+    i64 field_id = -1;
+    switch (attribute.encoding) {
+    case vertex_encoding::snorm16: field_id = aos.pushField<hermes::point3>(attribute.name);
+      break;
+    case vertex_encoding::octahedral: field_id = aos.pushField<hermes::vec3>(attribute.name);
+      break;
+    case vertex_encoding::half: field_id = aos.pushField<hermes::point2>(attribute.name);
+      break;
+    default:
+      if (attribute.type == hermes::DataType::F32 && attribute.component_count == 1)
+        field_id = aos.pushField<f32>(attribute.name);
+      else if (attribute.type == hermes::DataType::F32 && attribute.component_count == 2)
+        field_id = aos.pushField<hermes::vec2>(attribute.name);
+      else if (attribute.type == hermes::DataType::F32 && attribute.component_count == 3)
+        field_id = aos.pushField<hermes::vec3>(attribute.name);
+      else if (attribute.type == hermes::DataType::F32 && attribute.component_count == 4)
+        field_id = aos.pushField<hermes::vec4>(attribute.name);
+      else if (attribute.type == hermes::DataType::I32 && attribute.component_count == 1)
+        field_id = aos.pushField<i32>(attribute.name);
+      else if (attribute.type == hermes::DataType::U32 && attribute.component_count == 1)
+        field_id = aos.pushField<u32>(attribute.name);
+      else
+        hermes::Log::warn("Dequantization skips attribute {} (unsupported type).", attribute.name);
+    }
+    field_ids.emplace_back(field_id);
+  }
+  aos.resize(vertices.vertex_count);
+  if (!vertices.vertex_count || !aos.stride())
+    return aos;
+  const auto &fields = aos.structDescriptor().fields();
+  const u64 output_stride = aos.stride();
+  const u8 *input = vertices.data.data();
+  u8 *output = aos.data();
+  Parallel::forBlocks(vertices.vertex_count, [&](u64 begin, u64 end, u32) {
+    for (u64 v = begin; v < end; ++v) {
+      const u8 *src = input + v * vertices.stride;
+      u8 *dst = output + v * output_stride;
+      for (u64 i = 0; i < vertices.attributes.size(); ++i) {
+        if (field_ids[i] < 0)
+          continue;
+        const auto &attribute = vertices.attributes[i];
+        const u8 *field_src = src + attribute.offset;
+        u8 *field_dst = dst + fields[field_ids[i]].offset;
+        switch (attribute.encoding) {
+        case vertex_encoding::snorm16: {
+          i16 q[4];
+          std::memcpy(q, field_src, sizeof(q));
+          f32 out[3];
+          for (int d = 0; d < 3; ++d)
+            out[d] = vertices.position_offset[d] + vertices.position_scale[d] * decodeSnorm16(q[d]);
+          std::memcpy(field_dst, out, sizeof(out));
+          break;
+        }
+        case vertex_encoding::octahedral: {
+          i16 q[2];
+          std::memcpy(q, field_src, sizeof(q));
+          const auto n = decodeOctahedral(q[0], q[1]);
+          const f32 out[3] = {n.x, n.y, n.z};
+          std::memcpy(field_dst, out, sizeof(out));
+          break;
+        }
+        case vertex_encoding::half: {
+          u16 q[2];
+          std::memcpy(q, field_src, sizeof(q));
+          const f32 out[2] = {halfToFloat(q[0]), halfToFloat(q[1])};
+          std::memcpy(field_dst, out, sizeof(out));
+          break;
+        }
+        default:std::memcpy(field_dst, field_src, fields[field_ids[i]].size);
+        }
+      }
+    }
+  }, min_block_size);
+  return aos;
+}
+
+const char *VertexQuantizer::glslDecoder() {
+  return "uniform vec3 position_offset;\n"
+         "uniform vec3 position_scale;\n"
+         "vec3 dequantizePosition(vec4 q) { return position_offset + position_scale * q.xyz; }\n"
+         "vec3 decodeOctahedral(vec2 e) {\n"
+         "  vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+         "  if (v.z < 0.0)\n"
+         "    v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);\n"
+         "  return normalize(v);\n"
+         "}\n";
+}
+
+i16 VertexQuantizer::encodeSnorm16(f32 value) {
+  value = std::clamp(value, -1.f, 1.f);
+  return static_cast<i16>(std::lround(value * 32767.f));
+}
+
+f32 VertexQuantizer::decodeSnorm16(i16 value) {
+  return std::max(static_cast<f32>(value) / 32767.f, -1.f);
+}
+
+void VertexQuantizer::encodeOctahedral(const hermes::vec3 &v, i16 &x, i16 &y) {
+  const f32 l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+  if (l1 <= 0.f) {
+    x = y = 0;
+    return;
+  }
+  f32 px = v.x / l1;
+  f32 py = v.y / l1;
+  if (v.z < 0.f) {
+    // fold the lower hemisphere over the diagonals
+    const f32 ox = (1.f - std::abs(py)) * signNotZero(px);
+    const f32 oy = (1.f - std::abs(px)) * signNotZero(py);
+    px = ox;
+    py = oy;
+  }
+  x = encodeSnorm16(px);
+  y = encodeSnorm16(py);
+}
+
+hermes::vec3 VertexQuantizer::decodeOctahedral(i16 x, i16 y) {
+  f32 px = decodeSnorm16(x);
+  f32 py = decodeSnorm16(y);
+  const f32 pz = 1.f - std::abs(px) - std::abs(py);
+  if (pz < 0.f) {
+    const f32 ox = (1.f - std::abs(py)) * signNotZero(px);
+    const f32 oy = (1.f - std::abs(px)) * signNotZero(py);
+    px = ox;
+    py = oy;
+  }
+  const f32 l = std::sqrt(px * px + py * py + pz * pz);
+  return {px / l, py / l, pz / l};
+}
+
+u16 VertexQuantizer::floatToHalf(f32 value) {
+  u32 bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const u32 sign = (bits >> 16) & 0x8000u;
+  const u32 exponent = (bits >> 23) & 0xffu;
+  u32 mantissa = bits & 0x7fffffu;
+  // inf / nan
+  if (exponent == 0xff)
+    return static_cast<u16>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+  const i32 half_exponent = static_cast<i32>(exponent) - 127 + 15;
+  // overflow
+  if (half_exponent >= 0x1f)
+    return static_cast<u16>(sign | 0x7c00u);
+  // subnormal half (or zero)
+  if (half_exponent <= 0) {
+    if (half_exponent < -10)
+      return static_cast<u16>(sign);
+    mantissa |= 0x800000u;
+    const u32 shift = static_cast<u32>(14 - half_exponent);
+    u32 half_mantissa = mantissa >> shift;
+    const u32 remainder = mantissa & ((1u << shift) - 1);
+    const u32 halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half_mantissa & 1u)))
+      ++half_mantissa;
+    return static_cast<u16>(sign | half_mantissa);
+  }
+  u32 half = sign | (static_cast<u32>(half_exponent) << 10) | (mantissa >> 13);
+  const u32 remainder = mantissa & 0x1fffu;
+  // a carry into the exponent is still correct (it may round to inf)
+  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+    ++half;
+  return static_cast<u16>(half);
+}
+
+f32 VertexQuantizer::halfToFloat(u16 value) {
+  const u32 sign = static_cast<u32>(value & 0x8000u) << 16;
+  const u32 exponent = (value >> 10) & 0x1fu;
+  const u32 mantissa = value & 0x3ffu;
+  u32 bits;
+  if (exponent == 0) {
+    const f32 magnitude = std::ldexp(static_cast<f32>(mantissa), -24);
+    return sign ? -magnitude : magnitude;
+  }
+  if (exponent == 0x1f)
+    bits = sign | 0x7f800000u | (mantissa << 13);
+  else
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  f32 result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+hermes::point3 VertexQuantizer::position(const QuantizedVertices &vertices, u64 vertex_index) {
+  for (const auto &attribute : vertices.attributes)
+    if (attribute.encoding == vertex_encoding::snorm16) {
+      i16 q[4];
+      std::memcpy(q, vertices.data.data() + vertex_index * vertices.stride + attribute.offset, sizeof(q));
+      return {vertices.position_offset.x + vertices.position_scale.x * decodeSnorm16(q[0]),
+              vertices.position_offset.y + vertices.position_scale.y * decodeSnorm16(q[1]),
+              vertices.position_offset.z + vertices.position_scale.z * decodeSnorm16(q[2])};
+    }
+  return {};
+}
+
+}
@@ -0,0 +1,138 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file vertex_quantizer.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-17
+///
+///\brief Compressed vertex formats for GPU upload
+
+#ifndef CIRCE_CIRCE_SCENE_VERTEX_QUANTIZER_H
+#define CIRCE_CIRCE_SCENE_VERTEX_QUANTIZER_H
+
+#include <circe/scene/model.h>
+#include <vector>
+
+namespace circe {
+
+/// Encoding of a quantized vertex attribute
+enum class vertex_encoding {
+  raw = 0,        //!< copied as is
+  snorm16 = 1,    //!< positions: 4 x snorm16 relative to the model bounds (w is padding)
+  octahedral = 2, //!< unit vectors: 2 x snorm16 octahedral map
+  half = 3        //!< 2 x f16
+};
+
+/// Interleaved quantized vertex data (output of VertexQuantizer)
+struct QuantizedVertices {
+  struct Attribute {
+    std::string name;
+    u32 component_count{0};
+    hermes::DataType type{hermes::DataType::F32};
+    bool normalized{false};
+    u64 offset{0};
+    vertex_encoding encoding{vertex_encoding::raw};
+  };
+  std::vector<Attribute> attributes;
+  std::vector<u8> data;
+  u64 stride{0};
+  u64 vertex_count{0};
+  // position dequantization: p = position_offset + position_scale * snorm
+  hermes::vec3 position_offset;
+  hermes::vec3 position_scale{1.f, 1.f, 1.f};
+  [[nodiscard]] u64 memorySizeInBytes() const { return data.size(); }
+};
+
+/// Packs model vertex data into compact GPU formats:
+///   - positions are stored as snorm16 relative to the model bounds, the
+///     original position is recovered as offset + scale * snorm;
+///   - normals, tangents and bitangents (see AttributeSemantics) are mapped
+///     to 2 x snorm16 with the octahedral encoding (Cigolle et al. 2014);
+///   - uv coordinates are stored as half floats.
+/// All other attributes are copied as they are. A position + normal + uv
+/// vertex goes from 32 to 16 bytes, tangent space adds 8 bytes instead of 24.
+/// Snorm attributes are uploaded as normalized GL_SHORT attributes and uvs as
+/// GL_HALF_FLOAT, so shaders read floats, but positions and unit vectors keep
+/// their encodings: a quantized position arrives as a vec4 in [-1,1] and a
+/// normal/tangent/bitangent as a vec2. Shaders drawing quantized vertices
+/// must decode them with the functions in glslDecoder():
+///   #version 440 core
+///   <glslDecoder()>
+///   layout(location = 0) in vec4 position;
+///   layout(location = 1) in vec2 normal;
+///   ...
+///   vec3 p = dequantizePosition(position);
+///   vec3 n = decodeOctahedral(normal);
+class VertexQuantizer final {
+public:
+  /// GLSL source (no #version line) declaring the position dequantization
+  /// uniforms (vec3 position_offset, vec3 position_scale) and the decoding
+  /// functions dequantizePosition(vec4) and decodeOctahedral(vec2). It
+  /// mirrors position() and decodeOctahedral().
+  /// \return
+  static const char *glslDecoder();
+  /// Quantizes model vertex data
+  /// \param model
+  /// \return
+  static QuantizedVertices quantize(const Model &model);
+  /// Decodes quantized data back into float attributes (positions as
+  /// point3, unit vectors as vec3 and half pairs as point2). Raw attributes
+  /// keep their type, unless it has no hermes equivalent (these are skipped).
+  /// \param vertices
+  /// \return
+  static hermes::AoS dequantize(const QuantizedVertices &vertices);
+  // ***********************************************************************
+  //                            ENCODING
+  // ***********************************************************************
+  /// \param value in [-1,1]
+  /// \return
+  static i16 encodeSnorm16(f32 value);
+  /// Decodes the same way OpenGL normalizes GL_SHORT values
+  /// \param value
+  /// \return
+  static f32 decodeSnorm16(i16 value);
+  /// \param v unit vector
+  /// \param x **[out]**
+  /// \param y **[out]**
+  static void encodeOctahedral(const hermes::vec3 &v, i16 &x, i16 &y);
+  /// \param x
+  /// \param y
+  /// \return unit vector
+  static hermes::vec3 decodeOctahedral(i16 x, i16 y);
+  /// Converts to IEEE 754 half precision (round to nearest even)
+  /// \param value
+  /// \return
+  static u16 floatToHalf(f32 value);
+  /// \param value
+  /// \return
+  static f32 halfToFloat(u16 value);
+  /// Decodes a quantized position
+  /// \param vertices
+  /// \param vertex_index
+  /// \return
+  static hermes::point3 position(const QuantizedVertices &vertices, u64 vertex_index);
+
+  static constexpr u64 min_block_size = 1 << 12;
+};
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_VERTEX_QUANTIZER_H
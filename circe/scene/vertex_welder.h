@@ -0,0 +1,237 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file vertex_welder.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-11
+///
+///\brief Vertex deduplication (welding) engine
+
+#ifndef CIRCE_CIRCE_SCENE_VERTEX_WELDER_H
+#define CIRCE_CIRCE_SCENE_VERTEX_WELDER_H
+
+#include <circe/common/radix_sort.h>
+#include <cstring>
+#include <type_traits>
+
+namespace circe {
+
+/// Deduplication strategies used by VertexWelder
+enum class weld_method {
+  automatic,  //!< radix_sort for large inputs when multiple threads are available
+  hash_table, //!< sequential open addressing hash table
+  radix_sort  //!< parallel hashing + radix sort of (hash, index) pairs
+};
+
+/// Merges identical vertex keys into unique vertices.
+/// A key is any trivially copyable struct describing a vertex (component
+/// indices, raw attribute values, ...). Keys are compared bitwise, so float
+/// keys distinguish -0.f from 0.f.
+/// Both methods produce the same output: unique vertices are numbered in the
+/// order of their first occurrence.
+/// Example:
+///   std::vector<i32> indices;
+///   std::vector<u64> unique_keys;
+///   VertexWelder::weld(keys.data(), keys.size(), indices, unique_keys);
+///   // keys[unique_keys[indices[i]]] == keys[i]
+class VertexWelder final {
+public:
+  /// \tparam Key trivially copyable vertex key type
+  /// \param keys input keys (one per vertex reference)
+  /// \param count number of keys
+  /// \param indices receives the unique vertex index of each key
+  /// \param unique_keys receives, for each unique vertex, the position of its first key
+  /// \param method deduplication strategy
+  /// \return number of unique vertices
+  template<typename Key>
+  static u64 weld(const Key *keys, u64 count, std::vector<i32> &indices, std::vector<u64> &unique_keys,
+                  weld_method method = weld_method::automatic) {
+    static_assert(std::is_trivially_copyable<Key>::value, "VertexWelder keys must be trivially copyable");
+    indices.resize(count);
+    unique_keys.clear();
+    if (!count)
+      return 0;
+    if (method == weld_method::automatic)
+      method = count >= radix_sort_threshold && Parallel::threadCount() > 1 ?
+               weld_method::radix_sort : weld_method::hash_table;
+    if (method == weld_method::radix_sort)
+      weldSorted(keys, count, indices, unique_keys);
+    else
+      weldHashed(keys, count, indices, unique_keys);
+    return unique_keys.size();
+  }
+  /// 64-bit hash with full avalanche (every input bit affects every output bit)
+  /// \param data
+  /// \param size_in_bytes
+  /// \return
+  static u64 hash(const void *data, u64 size_in_bytes) {
+    const auto *bytes = reinterpret_cast<const u8 *>(data);
+    u64 h = 0x9e3779b97f4a7c15ull ^ (size_in_bytes * 0xff51afd7ed558ccdull);
+    for (; size_in_bytes >= 8; size_in_bytes -= 8, bytes += 8) {
+      u64 word;
+      std::memcpy(&word, bytes, 8);
+      h = rotateLeft(h ^ mix(word), 27) * 0x9fb21c651e98df25ull;
+    }
+    if (size_in_bytes) {
+      u64 word = 0;
+      std::memcpy(&word, bytes, size_in_bytes);
+      h = rotateLeft(h ^ mix(word), 27) * 0x9fb21c651e98df25ull;
+    }
+    return mix(h);
+  }
+
+  /// Inputs smaller than this are always welded with the hash table
+  static constexpr u64 radix_sort_threshold = 1u << 18;
+
+private:
+  /// splitmix64 finalizer
+  static u64 mix(u64 x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+  static u64 rotateLeft(u64 x, u32 r) {
+    return (x << r) | (x >> (64 - r));
+  }
+  template<typename Key>
+  static bool equal(const Key &a, const Key &b) {
+    return std::memcmp(&a, &b, sizeof(Key)) == 0;
+  }
+
+  /// Linear probing table. Each slot stores the upper hash bits (used to
+  /// reject most mismatches without touching the keys) and the unique id.
+  template<typename Key>
+  static void weldHashed(const Key *keys, u64 count, std::vector<i32> &indices, std::vector<u64> &unique_keys) {
+    struct Slot {
+      u32 tag;
+      u32 id;
+    };
+    constexpr u32 empty = ~0u;
+    u64 capacity = 64;
+    while (capacity < count / 2)
+      capacity <<= 1;
+    std::vector<Slot> table(capacity, Slot{0, empty});
+    u64 mask = capacity - 1;
+    for (u64 i = 0; i < count; ++i) {
+      // keep load factor below 1/2
+      if (2 * (unique_keys.size() + 1) > capacity) {
+        capacity <<= 1;
+        mask = capacity - 1;
+        table.assign(capacity, Slot{0, empty});
+        for (u64 id = 0; id < unique_keys.size(); ++id) {
+          const u64 h = hash(&keys[unique_keys[id]], sizeof(Key));
+          u64 slot = h & mask;
+          while (table[slot].id != empty)
+            slot = (slot + 1) & mask;
+          table[slot] = {static_cast<u32>(h >> 32), static_cast<u32>(id)};
+        }
+      }
+      const u64 h = hash(&keys[i], sizeof(Key));
+      const u32 tag = static_cast<u32>(h >> 32);
+      u64 slot = h & mask;
+      while (true) {
+        auto &entry = table[slot];
+        if (entry.id == empty) {
+          entry = {tag, static_cast<u32>(unique_keys.size())};
+          indices[i] = static_cast<i32>(unique_keys.size());
+          unique_keys.emplace_back(i);
+          break;
+        }
+        if (entry.tag == tag && equal(keys[unique_keys[entry.id]], keys[i])) {
+          indices[i] = static_cast<i32>(entry.id);
+          break;
+        }
+        slot = (slot + 1) & mask;
+      }
+    }
+  }
+
+  /// Sorts (hash, position) pairs so equal keys become adjacent. The sort is
+  /// stable, thus the first element of each group is its first occurrence.
+  template<typename Key>
+  static void weldSorted(const Key *keys, u64 count, std::vector<i32> &indices, std::vector<u64> &unique_keys) {
+    std::vector<u64> hashes(count);
+    std::vector<u32> order(count);
+    Parallel::forEach(count, [&](u64 i) {
+      hashes[i] = hash(&keys[i], sizeof(Key));
+      order[i] = static_cast<u32>(i);
+    });
+    RadixSort::sort(hashes, order);
+    // representative (first occurrence) of each key
+    std::vector<u32> representative(count);
+    Parallel::forBlocks(count, [&](u64 begin, u64 end, u32) {
+      // runs of equal hashes belong to the block holding their first element
+      while (begin < end && begin > 0 && hashes[begin] == hashes[begin - 1])
+        ++begin;
+      std::vector<u32> run_representatives;
+      for (u64 run_begin = begin; run_begin < end;) {
+        u64 run_end = run_begin + 1;
+        while (run_end < count && hashes[run_end] == hashes[run_begin])
+          ++run_end;
+        run_representatives.clear();
+        for (u64 j = run_begin; j < run_end; ++j) {
+          const u32 key_index = order[j];
+          u32 match = key_index;
+          // hash collisions are resolved by comparing against the distinct keys of the run
+          for (u32 candidate : run_representatives)
+            if (equal(keys[candidate], keys[key_index])) {
+              match = candidate;
+              break;
+            }
+          if (match == key_index)
+            run_representatives.emplace_back(key_index);
+          representative[key_index] = match;
+        }
+        run_begin = run_end;
+      }
+    });
+    // number unique keys in order of first occurrence
+    const u32 blocks = Parallel::blockCount(count);
+    std::vector<u64> block_offset(blocks + 1, 0);
+    Parallel::forBlocks(count, [&](u64 begin, u64 end, u32 block) {
+      u64 unique_count = 0;
+      for (u64 i = begin; i < end; ++i)
+        unique_count += representative[i] == i;
+      block_offset[block + 1] = unique_count;
+    });
+    for (u32 b = 0; b < blocks; ++b)
+      block_offset[b + 1] += block_offset[b];
+    unique_keys.resize(block_offset[blocks]);
+    Parallel::forBlocks(count, [&](u64 begin, u64 end, u32 block) {
+      u64 id = block_offset[block];
+      for (u64 i = begin; i < end; ++i)
+        if (representative[i] == i) {
+          indices[i] = static_cast<i32>(id);
+          unique_keys[id++] = i;
+        }
+    });
+    Parallel::forEach(count, [&](u64 i) {
+      if (representative[i] != i)
+        indices[i] = indices[representative[i]];
+    });
+  }
+};
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_VERTEX_WELDER_H
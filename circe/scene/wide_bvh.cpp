@@ -0,0 +1,162 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file wide_bvh.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-26
+///
+///\brief
+
+#include <circe/scene/wide_bvh.h>
+#include <circe/common/parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace circe {
+
+namespace {
+
+/// \return 2^exponent for exponent in [-126, 127]
+f32 powerOfTwo(int exponent) {
+  const u32 bits = static_cast<u32>(exponent + 127) << 23;
+  f32 r;
+  std::memcpy(&r, &bits, sizeof(f32));
+  return r;
+}
+
+}
+
+template<u32 Width>
+void WideBVH<Width>::build(const std::vector<BVHBuilder::Node> &binary_nodes) {
+  nodes_.clear();
+  sources_.clear();
+  max_depth_ = 0;
+  if (binary_nodes.empty())
+    return;
+  struct Task {
+    u32 node;
+    u32 binary_node;
+    u32 depth;
+  };
+  nodes_.reserve(binary_nodes.size() / (Width - 1) + 1);
+  nodes_.emplace_back();
+  sources_.resize(Width + 1);
+  std::vector<Task> tasks{{0, 0, 1}};
+  std::vector<u32> children;
+  while (!tasks.empty()) {
+    const Task task = tasks.back();
+    tasks.pop_back();
+    max_depth_ = std::max(max_depth_, task.depth);
+    const auto &binary = binary_nodes[task.binary_node];
+    // collapse: open the largest interior child until the node is full
+    children.clear();
+    if (binary.isLeaf())
+      children.emplace_back(task.binary_node);
+    else {
+      children.emplace_back(task.binary_node + 1);
+      children.emplace_back(binary.offset);
+    }
+    while (children.size() < Width) {
+      i32 largest = -1;
+      f64 largest_area = -1;
+      for (u32 i = 0; i < children.size(); ++i) {
+        const auto &child = binary_nodes[children[i]];
+        if (!child.isLeaf() && Bounds::area(child.bounds) > largest_area) {
+          largest = i;
+          largest_area = Bounds::area(child.bounds);
+        }
+      }
+      if (largest < 0)
+        break;
+      const u32 opened = children[largest];
+      children[largest] = opened + 1;
+      children.emplace_back(binary_nodes[opened].offset);
+    }
+    Node node;
+    node.child_count = static_cast<u8>(children.size());
+    const u64 sources = task.node * (Width + 1);
+    sources_[sources] = task.binary_node;
+    for (u32 i = 0; i < children.size(); ++i) {
+      sources_[sources + i + 1] = children[i];
+      const auto &child = binary_nodes[children[i]];
+      if (child.isLeaf()) {
+        node.child[i] = child.offset;
+        node.count[i] = child.count;
+      } else {
+        node.child[i] = static_cast<u32>(nodes_.size());
+        nodes_.emplace_back();
+        sources_.resize(nodes_.size() * (Width + 1));
+        tasks.push_back({node.child[i], children[i], task.depth + 1});
+      }
+    }
+    quantize(node, binary_nodes, &sources_[sources]);
+    nodes_[task.node] = node;
+  }
+}
+
+template<u32 Width>
+void WideBVH<Width>::refit(const std::vector<BVHBuilder::Node> &binary_nodes) {
+  Parallel::forEach(nodes_.size(), [&](u64 i) {
+    quantize(nodes_[i], binary_nodes, &sources_[i * (Width + 1)]);
+  });
+}
+
+template<u32 Width>
+void WideBVH<Width>::quantize(Node &node, const std::vector<BVHBuilder::Node> &binary_nodes, const u32 *sources) {
+  const auto &bounds = binary_nodes[sources[0]].bounds;
+  f32 scale[3], inv_scale[3];
+  for (int d = 0; d < 3; ++d) {
+    node.origin[d] = bounds.lower[d];
+    const f32 extent = bounds.upper[d] - bounds.lower[d];
+    // smallest power of two step that covers the extent in 254 steps:
+    // extent / 254 = m * 2^e with m in [0.5, 1)
+    int exponent = -126;
+    if (extent > 0) {
+      const f32 m = std::frexp(extent / 254.f, &exponent);
+      exponent -= m == 0.5f;
+    }
+    exponent = std::clamp(exponent, -126, 126);
+    node.exponent[d] = static_cast<i8>(exponent);
+    scale[d] = powerOfTwo(exponent);
+    inv_scale[d] = powerOfTwo(-exponent);
+  }
+  for (u32 i = 0; i < node.child_count; ++i) {
+    const auto &child = binary_nodes[sources[i + 1]].bounds;
+    for (int d = 0; d < 3; ++d) {
+      const f32 origin = node.origin[d];
+      f32 q_lower = std::clamp(std::floor((child.lower[d] - origin) * inv_scale[d]), 0.f, 255.f);
+      f32 q_upper = std::clamp(std::ceil((child.upper[d] - origin) * inv_scale[d]), 0.f, 255.f);
+      // the decoded box must contain the child
+      while (q_lower > 0 && origin + q_lower * scale[d] > child.lower[d])
+        q_lower--;
+      while (q_upper < 255 && origin + q_upper * scale[d] < child.upper[d])
+        q_upper++;
+      node.lower[d][i] = static_cast<u8>(q_lower);
+      node.upper[d][i] = static_cast<u8>(q_upper);
+    }
+  }
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
+
+}
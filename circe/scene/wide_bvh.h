@@ -0,0 +1,210 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file wide_bvh.h
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-26
+///
+///\brief 4 and 8 wide bounding volume hierarchies with quantized child bounds
+
+#ifndef CIRCE_CIRCE_SCENE_WIDE_BVH_H
+#define CIRCE_CIRCE_SCENE_WIDE_BVH_H
+
+#include <circe/scene/bvh_builder.h>
+#include <circe/common/bounds.h>
+#include <circe/common/simd.h>
+#include <hermes/geometry/ray.h>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+
+namespace circe {
+
+/// Wide (4 or 8 children per node) hierarchy collapsed from a binary
+/// BVHBuilder hierarchy. Each node stores the bounds of all its children
+/// quantized to 8 bits per plane, relative to the node bounds (the decoded
+/// boxes always contain the original ones), so a node fits one (Width 4) or
+/// two (Width 8) cache lines, against one 32 byte node per binary node.
+///
+/// Traversal tests a ray against all children of a node at once (4 SSE lanes
+/// per group of 4 children) and visits hit children near to far. Leaves
+/// keep the element ranges of the binary leaves.
+///
+/// Example:
+///   WideBVH<4> wide;
+///   wide.build(binary_nodes);
+///   wide.traverse(ray, t_max, [&](u32 first, u32 count) {
+///     // test elements [first, first + count), return the new t_max
+///     return t_max;
+///   });
+template<u32 Width>
+class WideBVH final {
+  static_assert(Width == 4 || Width == 8, "WideBVH: width must be 4 or 8");
+public:
+  struct alignas(64) Node {
+    f32 origin[3]{};     //!< lower corner of the node bounds
+    i8 exponent[3]{};    //!< child bounds are quantized in steps of 2^exponent
+    u8 child_count{0};
+    u8 lower[3][Width]{}; //!< quantized child bounds
+    u8 upper[3][Width]{};
+    u32 child[Width]{};   //!< node index (interior children) or first element (leaf children)
+    u16 count[Width]{};   //!< elements of leaf children (0 for interior children)
+    [[nodiscard]] bool isLeaf(u32 i) const { return count[i] > 0; }
+    /// \param i child slot
+    /// \return decoded (conservative) child bounds
+    [[nodiscard]] hermes::bbox3 childBounds(u32 i) const {
+      hermes::bbox3 b;
+      for (int d = 0; d < 3; ++d) {
+        const f32 scale = std::ldexp(1.f, exponent[d]);
+        b.lower[d] = origin[d] + lower[d][i] * scale;
+        b.upper[d] = origin[d] + upper[d][i] * scale;
+      }
+      return b;
+    }
+  };
+  static_assert(sizeof(Node) == 64 * (Width / 4), "WideBVH: node does not fit its cache lines");
+
+  WideBVH() = default;
+  /// Collapses a binary hierarchy
+  /// \param binary_nodes BVHBuilder nodes (depth-first order)
+  void build(const std::vector<BVHBuilder::Node> &binary_nodes);
+  /// Re-quantizes the child bounds after the binary nodes were refit (same
+  /// topology), in parallel
+  /// \param binary_nodes nodes used by the last build
+  void refit(const std::vector<BVHBuilder::Node> &binary_nodes);
+  /// Visits the leaves hit by a ray, near to far
+  /// \param ray
+  /// \param t_max hits are searched in [0, t_max)
+  /// \param visit called as visit(first_element, element_count), returns the new t_max
+  template<typename F>
+  void traverse(const hermes::Ray3 &ray, f32 t_max, F &&visit) const;
+
+  [[nodiscard]] const std::vector<Node> &nodes() const { return nodes_; }
+  [[nodiscard]] u32 maxDepth() const { return max_depth_; }
+  [[nodiscard]] u64 memorySizeInBytes() const { return nodes_.size() * sizeof(Node); }
+
+private:
+  struct Entry {
+    u32 index;
+    u32 count; //!< leaf element count (0 for nodes)
+  };
+
+  static void quantize(Node &node, const std::vector<BVHBuilder::Node> &binary_nodes, const u32 *sources);
+
+  std::vector<Node> nodes_;
+  std::vector<u32> sources_; //!< binary node and child binary nodes of each node (Width + 1 per node)
+  u32 max_depth_{0};
+};
+
+template<u32 Width>
+template<typename F>
+void WideBVH<Width>::traverse(const hermes::Ray3 &ray, f32 t_max, F &&visit) const {
+  if (nodes_.empty())
+    return;
+  f32 o[3], inv[3];
+  for (int d = 0; d < 3; ++d) {
+    o[d] = ray.o[d];
+    inv[d] = Bounds::safeInverse(ray.d[d]);
+  }
+  // pending entries never outnumber depth * (Width - 1) + 1
+  Entry buffer[128];
+  std::vector<Entry> storage;
+  Entry *stack = buffer;
+  if (max_depth_ * (Width - 1) + 1 > 128) {
+    storage.resize(max_depth_ * (Width - 1) + 1);
+    stack = storage.data();
+  }
+  u32 stack_size = 0;
+  stack[stack_size++] = {0, 0};
+  while (stack_size) {
+    const Entry entry = stack[--stack_size];
+    if (entry.count) {
+      t_max = visit(entry.index, entry.count);
+      continue;
+    }
+    const Node &node = nodes_[entry.index];
+    // child slab intervals: t = (origin + q * 2^e - o) * inv = q * a + b
+    alignas(16) f32 t_enter[Width], t_exit[Width];
+    f32 a[3], b[3];
+    for (int d = 0; d < 3; ++d) {
+      const u32 scale_bits = static_cast<u32>(node.exponent[d] + 127) << 23;
+      f32 scale;
+      std::memcpy(&scale, &scale_bits, sizeof(f32));
+      a[d] = scale * inv[d];
+      b[d] = (node.origin[d] - o[d]) * inv[d];
+    }
+#ifdef CIRCE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (u32 g = 0; g < Width / 4; ++g) {
+      __m128 enter = _mm_setzero_ps();
+      __m128 exit = _mm_set1_ps(t_max);
+      for (int d = 0; d < 3; ++d) {
+        i32 lower_bytes, upper_bytes;
+        std::memcpy(&lower_bytes, node.lower[d] + 4 * g, 4);
+        std::memcpy(&upper_bytes, node.upper[d] + 4 * g, 4);
+        const __m128 q_lower = _mm_cvtepi32_ps(_mm_unpacklo_epi16(
+            _mm_unpacklo_epi8(_mm_cvtsi32_si128(lower_bytes), zero), zero));
+        const __m128 q_upper = _mm_cvtepi32_ps(_mm_unpacklo_epi16(
+            _mm_unpacklo_epi8(_mm_cvtsi32_si128(upper_bytes), zero), zero));
+        const __m128 t0 = _mm_add_ps(_mm_mul_ps(q_lower, _mm_set1_ps(a[d])), _mm_set1_ps(b[d]));
+        const __m128 t1 = _mm_add_ps(_mm_mul_ps(q_upper, _mm_set1_ps(a[d])), _mm_set1_ps(b[d]));
+        enter = _mm_max_ps(enter, _mm_min_ps(t0, t1));
+        exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+      }
+      _mm_store_ps(t_enter + 4 * g, enter);
+      _mm_store_ps(t_exit + 4 * g, exit);
+    }
+#else
+    for (u32 i = 0; i < Width; ++i) {
+      t_enter[i] = 0;
+      t_exit[i] = t_max;
+      for (int d = 0; d < 3; ++d) {
+        const f32 t0 = node.lower[d][i] * a[d] + b[d];
+        const f32 t1 = node.upper[d][i] * a[d] + b[d];
+        t_enter[i] = std::max(t_enter[i], std::min(t0, t1));
+        t_exit[i] = std::min(t_exit[i], std::max(t0, t1));
+      }
+    }
+#endif
+    // push hit children far to near (the nearest is popped first)
+    u32 hit_count = 0;
+    u32 order[Width];
+    for (u32 i = 0; i < node.child_count; ++i) {
+      // tolerance for the rounding of q * a + b
+      if (t_enter[i] > t_exit[i] * (1.f + 1e-6f) + 1e-30f)
+        continue;
+      u32 j = hit_count++;
+      for (; j > 0 && t_enter[order[j - 1]] < t_enter[i]; --j)
+        order[j] = order[j - 1];
+      order[j] = i;
+    }
+    for (u32 j = 0; j < hit_count; ++j)
+      stack[stack_size++] = {node.child[order[j]], node.count[order[j]]};
+  }
+}
+
+extern template class WideBVH<4>;
+extern template class WideBVH<8>;
+
+}
+
+#endif //CIRCE_CIRCE_SCENE_WIDE_BVH_H
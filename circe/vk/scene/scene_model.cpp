@@ -28,11 +28,11 @@
 #include <circe/vk/scene/scene_model.h>
 #include <circe/vk/storage/buffer.h>
 #include <circe/vk/pipeline/command_buffer.h>
+#include <circe/scene/vertex_welder.h>
 #include <hermes/geometry/vector.h>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
-#include <unordered_map>
 
 struct Vertex {
   hermes::vec3 pos;
@@ -41,23 +41,14 @@ struct Vertex {
   hermes::vec3 normal;
   hermes::vec3 tangent;
   hermes::vec3 bi_tangent;
-
-  bool operator==(const Vertex &other) const {
-    return pos == other.pos && color == other.color &&
-        tex_coord == other.tex_coord;
-  }
 };
 
-namespace std {
-template<> struct hash<Vertex> {
-  size_t operator()(Vertex const &vertex) const {
-    return ((hash<hermes::vec3>()(vertex.pos) ^
-        (hash<hermes::vec3>()(vertex.color) << 1)) >>
-                                                  1) ^
-        (hash<hermes::vec2>()(vertex.tex_coord) << 1);
-  }
+/// Attributes that identify a unique vertex while loading obj files
+struct VertexKey {
+  float pos[3];
+  float color[3];
+  float tex_coord[2];
 };
-} // namespace std
 
 namespace circe::vk {
 
@@ -135,31 +126,33 @@ bool Model::loadFromOBJ(const std::string &obj_filename, VertexLayout layout) {
                         obj_filename.c_str()))
     throw std::runtime_error(warn + err);
 
-  std::unordered_map<Vertex, uint32_t> unique_vertices = {};
+  std::vector<VertexKey> keys;
   for (const auto &shape : shapes) {
     for (const auto &index : shape.mesh.indices) {
-
-      Vertex vertex = {};
-
-      vertex.pos = {attrib.vertices[3 * index.vertex_index + 0],
-                    -attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]};
-
-      vertex.tex_coord = {attrib.texcoords[2 * index.texcoord_index + 0],
-                          1.0f -
-                              attrib.texcoords[2 * index.texcoord_index + 1]};
-
-      vertex.color = {1.0f, 1.0f, 1.0f};
-
-      if (unique_vertices.count(vertex) == 0) {
-        unique_vertices[vertex] =
-            static_cast<uint32_t>(h_vertices.size() / (layout.stride() / sizeof(float)));
-        addVertex(h_vertices, layout, vertex, uv_scale, scale, center);
+      VertexKey key = {};
+      key.pos[0] = attrib.vertices[3 * index.vertex_index + 0];
+      key.pos[1] = -attrib.vertices[3 * index.vertex_index + 1];
+      key.pos[2] = attrib.vertices[3 * index.vertex_index + 2];
+      if (index.texcoord_index >= 0) {
+        key.tex_coord[0] = attrib.texcoords[2 * index.texcoord_index + 0];
+        key.tex_coord[1] = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
       }
-
-      h_indices.push_back(unique_vertices[vertex]);
+      key.color[0] = key.color[1] = key.color[2] = 1.0f;
+      keys.emplace_back(key);
     }
   }
+  std::vector<i32> vertex_indices;
+  std::vector<u64> unique_keys;
+  circe::VertexWelder::weld(keys.data(), keys.size(), vertex_indices, unique_keys);
+  for (u64 key_index : unique_keys) {
+    const auto &key = keys[key_index];
+    Vertex vertex = {};
+    vertex.pos = {key.pos[0], key.pos[1], key.pos[2]};
+    vertex.color = {key.color[0], key.color[1], key.color[2]};
+    vertex.tex_coord = {key.tex_coord[0], key.tex_coord[1]};
+    addVertex(h_vertices, layout, vertex, uv_scale, scale, center);
+  }
+  h_indices.assign(vertex_indices.begin(), vertex_indices.end());
   return loadFromData(h_vertices, h_indices);
 }
 
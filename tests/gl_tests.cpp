@@ -0,0 +1,136 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file gl_tests.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-28
+///
+///\brief Tests of the gl module that do not need a GL context
+
+#include <catch2/catch.hpp>
+
+#include <circe/common/parallel.h>
+#include <circe/gl/utils/asset_loader.h>
+#include <atomic>
+#include <thread>
+
+using namespace circe::gl;
+
+TEST_CASE("AssetLoader") {
+  SECTION("default handle") {
+    const AssetHandle<int> handle;
+    REQUIRE(handle.status() == asset_status::failed);
+    REQUIRE(!handle.ready());
+    REQUIRE(handle.get() == nullptr);
+    int placeholder = 7;
+    REQUIRE(&handle.getOr(placeholder) == &placeholder);
+  }
+  SECTION("decode and upload") {
+    AssetLoader loader(2);
+    std::atomic<u32> upload_count{0};
+    auto handle = loader.load<int, int>([](int &decoded) {
+      decoded = 21;
+      return true;
+    }, [&](int &&decoded) {
+      upload_count++;
+      return decoded * 2;
+    });
+    loader.waitDecoded();
+    // decoded, but nothing is uploaded until the GL thread pumps uploads
+    REQUIRE(handle.status() == asset_status::uploading);
+    REQUIRE(loader.pendingCount() == 1);
+    REQUIRE(upload_count == 0);
+    const AssetHandle<int> &const_handle = handle;
+    REQUIRE(const_handle.get() == nullptr);
+    int placeholder = -1;
+    REQUIRE(const_handle.getOr(placeholder) == -1);
+    REQUIRE(loader.pumpUploads() == 1);
+    REQUIRE(handle.ready());
+    REQUIRE(upload_count == 1);
+    REQUIRE(loader.pendingCount() == 0);
+    REQUIRE(const_handle.get() != nullptr);
+    REQUIRE(*const_handle.get() == 42);
+    REQUIRE(const_handle.getOr(placeholder) == 42);
+    // copies share the asset
+    auto copy = handle;
+    REQUIRE(copy.get() == handle.get());
+    REQUIRE(loader.pumpUploads() == 0);
+  }
+  SECTION("decode failure") {
+    AssetLoader loader(1);
+    std::atomic<u32> upload_count{0};
+    auto handle = loader.load<int, int>([](int &) { return false; }, [&](int &&decoded) {
+      upload_count++;
+      return decoded;
+    });
+    loader.waitDecoded();
+    REQUIRE(handle.status() == asset_status::failed);
+    REQUIRE(loader.pendingCount() == 0);
+    REQUIRE(loader.pumpUploads() == 0);
+    REQUIRE(upload_count == 0);
+    REQUIRE(handle.get() == nullptr);
+  }
+  SECTION("upload budget") {
+    AssetLoader loader(3);
+    std::vector<AssetHandle<int>> handles;
+    for (int i = 0; i < 4; ++i)
+      handles.emplace_back(loader.load<int, int>([i](int &decoded) {
+        decoded = i;
+        return true;
+      }, [](int &&decoded) { return decoded; }));
+    loader.waitDecoded();
+    REQUIRE(loader.pendingCount() == 4);
+    // at least one upload runs even without budget
+    REQUIRE(loader.pumpUploads(0) == 1);
+    REQUIRE(loader.pendingCount() == 3);
+    REQUIRE(loader.pumpUploads(1000) == 3);
+    REQUIRE(loader.pendingCount() == 0);
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(handles[i].ready());
+      REQUIRE(*handles[i].get() == i);
+    }
+  }
+  SECTION("parallel loops inside decodes") {
+    AssetLoader loader(2);
+    // a lone decode keeps parallel loops
+    std::atomic<bool> lone_serial{true};
+    loader.load<int, int>([&](int &) {
+      lone_serial = circe::Parallel::insideWorker();
+      return true;
+    }, [](int &&decoded) { return decoded; });
+    loader.waitDecoded();
+    REQUIRE(!lone_serial);
+    // overlapping decodes run their loops serially
+    std::atomic<u32> started{0};
+    std::atomic<u32> serial_count{0};
+    for (int i = 0; i < 2; ++i)
+      loader.load<int, int>([&](int &) {
+        started++;
+        while (started < 2)
+          std::this_thread::yield();
+        serial_count += circe::Parallel::insideWorker() ? 1 : 0;
+        return true;
+      }, [](int &&decoded) { return decoded; });
+    loader.waitDecoded();
+    REQUIRE(serial_count >= 1);
+    REQUIRE(loader.pumpUploads(1000) == 3);
+  }
+}
@@ -0,0 +1,492 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file io_tests.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-10
+///
+///\brief
+
+#include <catch2/catch.hpp>
+
+#include <circe/io/io.h>
+#include <circe/io/model_cache.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+using namespace circe;
+
+namespace {
+
+/// Writes a triangulated grid with positions, normals and uvs
+hermes::Path writeGridOBJ(const std::string &name, u32 n) {
+  hermes::Path path(std::string(P_tmpdir) + "/" + name);
+  std::ofstream file(path.fullName());
+  file << "o grid\n";
+  for (u32 y = 0; y <= n; ++y)
+    for (u32 x = 0; x <= n; ++x) {
+      file << "v " << x * 0.25f << " " << y * 0.125f << " " << (x + y) * 1e-3f << "\n";
+      file << "vt " << x / (f32) n << " " << y / (f32) n << "\n";
+    }
+  file << "vn 0 0 1\n";
+  for (u32 y = 0; y < n; ++y)
+    for (u32 x = 0; x < n; ++x) {
+      u32 a = y * (n + 1) + x + 1;
+      u32 b = a + 1;
+      u32 c = a + n + 1;
+      u32 d = c + 1;
+      file << "f " << a << "/" << a << "/1 " << b << "/" << b << "/1 " << d << "/" << d << "/1\n";
+      file << "f " << a << "/" << a << "/1 " << d << "/" << d << "/1 " << c << "/" << c << "/1\n";
+    }
+  return path;
+}
+
+/// Writes n vertices (position, normal, uchar color and intensity), preceded by
+/// an element that readers must skip
+hermes::Path writePointsPLY(const std::string &name, ply_format format, u32 n) {
+  hermes::Path path(std::string(P_tmpdir) + "/" + name);
+  std::ofstream file(path.fullName(), std::ios::binary);
+  const char *format_names[] = {"ascii", "binary_little_endian", "binary_big_endian"};
+  file << "ply\nformat " << format_names[static_cast<int>(format)] << " 1.0\n"
+       << "comment circe test\n"
+       << "element camera 2\nproperty ushort id\nproperty list uchar int values\n"
+       << "element vertex " << n << "\n"
+       << "property float x\nproperty float y\nproperty float z\n"
+       << "property float nx\nproperty float ny\nproperty float nz\n"
+       << "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+       << "property double intensity\nend_header\n";
+  u16 endian_test = 1;
+  const bool host_little = *reinterpret_cast<u8 *>(&endian_test) == 1;
+  const bool swap = (format == ply_format::binary_big_endian) == host_little;
+  auto write = [&](auto value) {
+    char bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    if (swap)
+      std::reverse(bytes, bytes + sizeof(value));
+    file.write(bytes, sizeof(value));
+  };
+  for (u16 id = 0; id < 2; ++id)
+    if (format == ply_format::ascii)
+      file << id << " 3 1 2 3\n";
+    else {
+      write(id);
+      write(u8(3));
+      for (i32 v = 1; v <= 3; ++v)
+        write(v);
+    }
+  for (u32 i = 0; i < n; ++i)
+    if (format == ply_format::ascii)
+      file << i * 0.5f << " " << -(f32) i << " " << i * 0.25f << " 0 0 1 "
+           << i % 256 << " 255 0 " << i * 2.0 << "\n";
+    else {
+      write(i * 0.5f);
+      write(-(f32) i);
+      write(i * 0.25f);
+      write(0.f);
+      write(0.f);
+      write(1.f);
+      write(u8(i % 256));
+      write(u8(255));
+      write(u8(0));
+      write(i * 2.0);
+    }
+  return path;
+}
+
+/// Writes a glb file with two meshes: an interleaved float quad (u32 indices)
+/// and a triangle with separate views, normalized i16 uvs and u16 indices.
+/// Node 0 (translated) has node 1 (scaled, mesh 0) as child, node 2 holds mesh 1.
+hermes::Path writeGLB(const std::string &name, u32 last_quad_index = 3) {
+  std::vector<u8> bin;
+  auto write = [&](const void *data, u64 size) {
+    bin.insert(bin.end(), reinterpret_cast<const u8 *>(data), reinterpret_cast<const u8 *>(data) + size);
+  };
+  const f32 quad[4][6] = {{0, 0, 0, 0, 0, 1}, {1, 0, 0, 0, 0, 1}, {1, 1, 0, 0, 0, 1}, {0, 1, 0, 0, 0, 1}};
+  const u32 quad_indices[6] = {0, 1, 2, 0, 2, last_quad_index};
+  const f32 triangle[3][3] = {{0, 0, 0}, {2, 0, 0}, {0, 2, 0}};
+  const i16 uvs[3][2] = {{0, 0}, {32767, 0}, {-32768, 16384}};
+  const u16 triangle_indices[4] = {0, 1, 2, 0};
+  write(quad, sizeof(quad));                          // 0: 96 bytes
+  write(quad_indices, sizeof(quad_indices));          // 96: 24 bytes
+  write(triangle, sizeof(triangle));                  // 120: 36 bytes
+  write(uvs, sizeof(uvs));                            // 156: 12 bytes
+  write(triangle_indices, sizeof(triangle_indices));  // 168: 8 bytes
+  const std::string json = R"({"asset":{"version":"2.0"},"scene":0,"scenes":[{"nodes":[0,2]}],
+    "nodes":[{"name":"root","translation":[1,2,3],"children":[1]},{"mesh":0,"scale":[2,2,2]},{"mesh":1}],
+    "meshes":[{"name":"quad","primitives":[{"attributes":{"POSITION":0,"NORMAL":1},"indices":2}]},
+              {"name":"triangle","primitives":[{"attributes":{"POSITION":3,"TEXCOORD_0":4},"indices":5}]}],
+    "buffers":[{"byteLength":176}],
+    "bufferViews":[{"buffer":0,"byteOffset":0,"byteLength":96,"byteStride":24},
+                   {"buffer":0,"byteOffset":96,"byteLength":24},
+                   {"buffer":0,"byteOffset":120,"byteLength":36},
+                   {"buffer":0,"byteOffset":156,"byteLength":12},
+                   {"buffer":0,"byteOffset":168,"byteLength":6}],
+    "accessors":[{"bufferView":0,"componentType":5126,"count":4,"type":"VEC3"},
+                 {"bufferView":0,"byteOffset":12,"componentType":5126,"count":4,"type":"VEC3"},
+                 {"bufferView":1,"componentType":5125,"count":6,"type":"SCALAR"},
+                 {"bufferView":2,"componentType":5126,"count":3,"type":"VEC3"},
+                 {"bufferView":3,"componentType":5122,"normalized":true,"count":3,"type":"VEC2"},
+                 {"bufferView":4,"componentType":5123,"count":3,"type":"SCALAR"}]})";
+  std::string json_chunk = json;
+  json_chunk.resize((json_chunk.size() + 3) & ~size_t(3), ' ');
+  hermes::Path path(std::string(P_tmpdir) + "/" + name);
+  std::ofstream file(path.fullName(), std::ios::binary);
+  auto write_u32 = [&](u32 value) { file.write(reinterpret_cast<const char *>(&value), sizeof(value)); };
+  write_u32(0x46546C67);
+  write_u32(2);
+  write_u32(static_cast<u32>(12 + 8 + json_chunk.size() + 8 + bin.size()));
+  write_u32(static_cast<u32>(json_chunk.size()));
+  write_u32(0x4E4F534A);
+  file.write(json_chunk.data(), json_chunk.size());
+  write_u32(static_cast<u32>(bin.size()));
+  write_u32(0x004E4942);
+  file.write(reinterpret_cast<const char *>(bin.data()), bin.size());
+  return path;
+}
+
+
+}
+
+TEST_CASE("ObjParser", "[io]") {
+  SECTION("statements") {
+    std::string text = "# comment\n"
+                       "v 1 2 3\n"
+                       "v -1.5e1 .5 2.\n"
+                       "v 0 0 1 0.5 0.25 1\n"
+                       "vt 0.5 0.25\n"
+                       "vn 0 0 1\n"
+                       "o first\n"
+                       "f 1/1/1 2/1/1 3/1/1\n"
+                       "g empty\n"
+                       "g second\n"
+                       "f -3//-1 -2//-1 -1//-1 1//1\n";
+    ObjData data;
+    REQUIRE(ObjParser::parse(text.data(), text.size(), data));
+    REQUIRE(data.positions.size() == 9);
+    REQUIRE(data.positions[3] == Approx(-15));
+    REQUIRE(data.positions[4] == Approx(0.5));
+    REQUIRE(data.colors.size() == 9);
+    REQUIRE(data.colors[0] == Approx(1));
+    REQUIRE(data.colors[7] == Approx(0.25));
+    REQUIRE(data.normals.size() == 3);
+    REQUIRE(data.uvs.size() == 2);
+    REQUIRE(data.shapes.size() == 2);
+    REQUIRE(data.shapes[0].name == "first");
+    REQUIRE(data.shapes[0].index_count == 3);
+    REQUIRE(data.shapes[1].name == "second");
+    // quad is split in 2 triangles
+    REQUIRE(data.shapes[1].index_count == 6);
+    REQUIRE(data.indices[3].vertex_index == 0);
+    REQUIRE(data.indices[3].normal_index == 0);
+    REQUIRE(data.indices[3].uv_index == -1);
+    REQUIRE(data.indices[5].vertex_index == 2);
+  }//
+  SECTION("all shapes") {
+    std::string text = "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n"
+                       "o a\n"
+                       "usemtl red\n"
+                       "f 1 2 3\n"
+                       "usemtl blue\n"
+                       "f 2 4 3\n"
+                       "o b\n"
+                       "f 1 2 4\n"
+                       "usemtl red\n"
+                       "f 1 4 3\n";
+    ObjData data;
+    REQUIRE(ObjParser::parse(text.data(), text.size(), data));
+    REQUIRE(data.shapes.size() == 2);
+    REQUIRE(data.materials.size() == 2);
+    REQUIRE(data.material_ranges.size() == 3);
+    auto model = io::fromOBJData(data, shape_options::none, io::all_shapes);
+    REQUIRE(model.data().size() == 4);
+    REQUIRE(model.indices().size() == 12);
+    const auto &sub_meshes = model.subMeshes();
+    REQUIRE(sub_meshes.size() == 4);
+    REQUIRE(sub_meshes[0].name == "a");
+    REQUIRE(sub_meshes[0].material_id == 0);
+    REQUIRE(sub_meshes[1].material_id == 1);
+    REQUIRE(sub_meshes[2].name == "b");
+    REQUIRE(sub_meshes[2].index_offset == 6);
+    REQUIRE(sub_meshes[2].material_id == 1);
+    REQUIRE(sub_meshes[3].material_id == 0);
+    REQUIRE(sub_meshes[3].index_count == 3);
+  }//
+  SECTION("malformed indices") {
+    const std::string header = "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n";
+    for (const char *face : {"f 1/999/1 2/1/1 3/1/1\n", "f 1/1/999 2/1/1 3/1/1\n", "f 1/1/-5 2/1/1 3/1/1\n",
+                             "f 1/1/1 2/1/1 9/1/1\n", "f 1/1/1 2/1/1 99999999999/1/1\n"}) {
+      const std::string text = header + face;
+      ObjData data;
+      REQUIRE(ObjParser::parse(text.data(), text.size(), data));
+      REQUIRE(io::fromOBJData(data, shape_options::none, io::all_shapes).vertexCount() == 0);
+    }
+    const std::string text = header + "f 1/1/1 2/1/1 3/1/1\n";
+    ObjData data;
+    REQUIRE(ObjParser::parse(text.data(), text.size(), data));
+    REQUIRE(io::fromOBJData(data, shape_options::none, io::all_shapes).vertexCount() == 3);
+  }//
+  SECTION("engines") {
+    auto path = writeGridOBJ("circe_obj_parser_test.obj", 64);
+    ObjData native, reference;
+    REQUIRE(io::readOBJ(path, native, obj_parsing_engine::native));
+    REQUIRE(io::readOBJ(path, reference, obj_parsing_engine::tinyobj));
+    REQUIRE(native.positions == reference.positions);
+    REQUIRE(native.uvs == reference.uvs);
+    REQUIRE(native.indices.size() == reference.indices.size());
+    for (u64 i = 0; i < native.indices.size(); ++i) {
+      REQUIRE(native.indices[i].vertex_index == reference.indices[i].vertex_index);
+      REQUIRE(native.indices[i].normal_index == reference.indices[i].normal_index);
+      REQUIRE(native.indices[i].uv_index == reference.indices[i].uv_index);
+    }
+    auto model = io::readOBJ(path);
+    REQUIRE(model.data().size() == 65 * 65);
+    REQUIRE(model.indices().size() == 64 * 64 * 6);
+    std::remove(path.fullName().c_str());
+  }//
+}
+
+TEST_CASE("ModelCache", "[io]") {
+  auto obj_path = writeGridOBJ("circe_model_cache_test.obj", 16);
+  SECTION("container") {
+    auto model = io::readOBJ(obj_path);
+    model.setLevelsOfDetail({{0, model.indexCount(), 0.f}, {0, 6, 0.5f}});
+    hermes::Path path(std::string(P_tmpdir) + "/circe_model_cache_test.cmodel");
+    REQUIRE(ModelCache::write(path, model));
+    auto cached = ModelCache::read(path);
+    REQUIRE(cached.hasExternalData());
+    REQUIRE(cached.primitiveType() == model.primitiveType());
+    REQUIRE(cached.vertexCount() == model.vertexCount());
+    REQUIRE(cached.indexCount() == model.indexCount());
+    REQUIRE(cached.vertexDescriptor().sizeInBytes() == model.vertexDescriptor().sizeInBytes());
+    REQUIRE(std::memcmp(cached.vertexData(), model.vertexData(), model.vertexDataSizeInBytes()) == 0);
+    REQUIRE(cached.levelsOfDetail().size() == 2);
+    REQUIRE(cached.levelsOfDetail()[1].index_count == 6);
+    REQUIRE(cached.levelsOfDetail()[1].error == 0.5f);
+    // const reads stay in the mapped file
+    const Model &const_cached = cached;
+    const Model &const_model = model;
+    const auto cached_positions = const_cached.attributeAccessor<hermes::point3>("position");
+    const auto positions = const_model.attributeAccessor<hermes::point3>("position");
+    for (u64 i = 0; i < model.vertexCount(); ++i)
+      REQUIRE(cached_positions[i] == positions[i]);
+    REQUIRE(std::equal(model.indices().begin(), model.indices().end(), cached.indexData()));
+    REQUIRE(cached.hasExternalData());
+    cached.materialize();
+    REQUIRE(cached.indices() == model.indices());
+    REQUIRE(!cached.hasExternalData());
+    // corrupt record offsets (header.descriptor_offset is at byte 48) are
+    // rejected, even when offset + record size wraps around
+    std::vector<char> bytes;
+    {
+      std::ifstream file(path.fullName(), std::ios::binary);
+      bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    hermes::Path corrupt_path(std::string(P_tmpdir) + "/circe_model_cache_corrupt_test.cmodel");
+    for (u64 descriptor_offset : {u64(bytes.size()), u64(bytes.size() - 4), ~u64(0) - 8}) {
+      std::memcpy(bytes.data() + 48, &descriptor_offset, sizeof(u64));
+      {
+        std::ofstream file(corrupt_path.fullName(), std::ios::binary);
+        file.write(bytes.data(), bytes.size());
+      }
+      REQUIRE(ModelCache::read(corrupt_path).vertexCount() == 0);
+    }
+    std::remove(corrupt_path.fullName().c_str());
+    std::remove(path.fullName().c_str());
+  }//
+  SECTION("sidecar") {
+    u32 loads = 0;
+    auto loader = [&](const hermes::Path &source, shape_options options) {
+      loads++;
+      return io::readOBJ(source, options);
+    };
+    // opt-in
+    REQUIRE(!ModelCache::sidecarEnabled());
+    ModelCache::load(obj_path, shape_options::none, loader);
+    ModelCache::load(obj_path, shape_options::none, loader);
+    REQUIRE(loads == 2);
+    loads = 0;
+    ModelCache::setSidecarEnabled(true);
+    const std::string directory = std::string(P_tmpdir) + "/circe_model_cache_dir";
+    ModelCache::setCacheDirectory(hermes::Path(directory));
+    const auto cache_path = ModelCache::sidecarPath(obj_path).fullName();
+    REQUIRE(cache_path.rfind(directory, 0) == 0);
+    std::remove(cache_path.c_str());
+    auto first = ModelCache::load(obj_path, shape_options::none, loader);
+    auto second = ModelCache::load(obj_path, shape_options::none, loader);
+    REQUIRE(loads == 1);
+    REQUIRE(second.hasExternalData());
+    REQUIRE(second.indexCount() == first.indexCount());
+    // touched source: the cache is replaced, the old mapping stays valid
+    std::filesystem::last_write_time(obj_path.fullName(),
+                                     std::filesystem::last_write_time(obj_path.fullName()) +
+                                         std::chrono::seconds(10));
+    auto touched = ModelCache::load(obj_path, shape_options::none, loader);
+    REQUIRE(loads == 1);
+    REQUIRE(touched.hasExternalData());
+    REQUIRE(std::memcmp(second.vertexData(), first.vertexData(), first.vertexDataSizeInBytes()) == 0);
+    ModelCache::load(obj_path, shape_options::none, loader);
+    REQUIRE(loads == 1);
+    // options are part of the key
+    ModelCache::load(obj_path, shape_options::normal, loader);
+    REQUIRE(loads == 2);
+    std::remove(cache_path.c_str());
+    std::filesystem::remove(directory);
+    ModelCache::setCacheDirectory(hermes::Path(""));
+    ModelCache::setSidecarEnabled(false);
+  }//
+  std::remove(obj_path.fullName().c_str());
+}
+
+TEST_CASE("PlyReader", "[io]") {
+  const u32 n = 100;
+  for (auto format : {ply_format::ascii, ply_format::binary_little_endian, ply_format::binary_big_endian}) {
+    auto path = writePointsPLY("circe_ply_test.ply", format, n);
+    PlyReader reader(path);
+    REQUIRE(reader.good());
+    REQUIRE(reader.format() == format);
+    REQUIRE(reader.elements().size() == 2);
+    REQUIRE(reader.vertexCount() == n);
+    REQUIRE(reader.vertexAttributes().size() == 4);
+    REQUIRE(reader.vertexAttributes()[2].name == "color");
+    REQUIRE(reader.vertexAttributes()[3].name == "intensity");
+    REQUIRE(reader.vertexComponentCount() == 10);
+    // small chunks force carrying partial data between reads
+    std::vector<f32> vertices(n * 10);
+    REQUIRE(reader.readVertices(vertices.data(), 7));
+    for (u32 i = 0; i < n; ++i) {
+      const f32 *v = &vertices[i * 10];
+      REQUIRE(v[0] == Approx(i * 0.5f));
+      REQUIRE(v[1] == Approx(-(f32) i));
+      REQUIRE(v[2] == Approx(i * 0.25f));
+      REQUIRE(v[5] == Approx(1));
+      REQUIRE(v[6] == Approx((i % 256) / 255.f));
+      REQUIRE(v[7] == Approx(1));
+      REQUIRE(v[9] == Approx(i * 2.f));
+    }
+    // streaming can be stopped by the callback
+    u64 chunks = 0;
+    REQUIRE(reader.readVertices([&](const f32 *, u64 first, u64 count) {
+      REQUIRE(first == chunks * 16);
+      REQUIRE(count == 16);
+      return ++chunks < 2;
+    }, 16));
+    REQUIRE(chunks == 2);
+    auto model = io::readPLY(path, 7);
+    REQUIRE(model.primitiveType() == hermes::GeometricPrimitiveType::POINTS);
+    REQUIRE(model.vertexCount() == n);
+    REQUIRE(model.indexCount() == 0);
+    REQUIRE(std::memcmp(model.vertexData(), vertices.data(), vertices.size() * sizeof(f32)) == 0);
+    std::remove(path.fullName().c_str());
+  }
+}
+
+TEST_CASE("GltfReader", "[io]") {
+  auto path = writeGLB("circe_gltf_test.glb");
+  GltfReader reader(path);
+  REQUIRE(reader.good());
+  REQUIRE(reader.meshes().size() == 2);
+  REQUIRE(reader.nodes().size() == 3);
+  REQUIRE(reader.defaultScene() == 0);
+  SECTION("zero-copy mesh") {
+    auto model = reader.readMesh(0);
+    REQUIRE(model.hasExternalData());
+    REQUIRE(model.vertexCount() == 4);
+    REQUIRE(model.indexCount() == 6);
+    REQUIRE(model.vertexDescriptor().fields().size() == 2);
+    REQUIRE(model.vertexDescriptor().fields()[1].name == "normal");
+    // vertex data points into the glb mapping
+    REQUIRE(reinterpret_cast<const f32 *>(model.vertexData())[6] == Approx(1));
+    REQUIRE(model.indexData()[5] == 3);
+    GltfReader::VertexStream stream;
+    REQUIRE(reader.vertexStream(0, 0, stream));
+    REQUIRE(stream.data == model.vertexData());
+    REQUIRE(stream.layout.stride == 24);
+    REQUIRE(stream.layout.attributes[1].offset == 12);
+    // out of range indices are not used in place
+    auto bad_path = writeGLB("circe_gltf_bad_index_test.glb", 4);
+    GltfReader bad_reader(bad_path);
+    REQUIRE(bad_reader.good());
+    REQUIRE(bad_reader.readMesh(0).vertexCount() == 0);
+    REQUIRE(bad_reader.readMesh(1).vertexCount() == 3);
+    std::remove(bad_path.fullName().c_str());
+  }
+  SECTION("converted mesh") {
+    auto model = reader.readMesh(1);
+    REQUIRE_FALSE(model.hasExternalData());
+    REQUIRE(model.vertexCount() == 3);
+    REQUIRE(model.indexCount() == 3);
+    REQUIRE(model.vertexDescriptor().fields()[1].name == "uvs");
+    const auto *v = reinterpret_cast<const f32 *>(model.vertexData());
+    // position (3) + uv (2)
+    REQUIRE(v[5 + 3] == Approx(1));
+    REQUIRE(v[10 + 3] == Approx(-1));
+    REQUIRE(v[10 + 4] == Approx(16384 / 32767.f));
+    REQUIRE(v[5] == Approx(2));
+    // normalized integers stay raw in vertex streams
+    GltfReader::VertexStream stream;
+    REQUIRE_FALSE(reader.vertexStream(1, 0, stream));
+  }
+  SECTION("hierarchy") {
+    auto instances = reader.instances();
+    REQUIRE(instances.size() == 2);
+    REQUIRE(instances[0].node == 1);
+    REQUIRE(instances[0].mesh == 0);
+    const auto &m = instances[0].transform.matrix();
+    REQUIRE(m[0][0] == Approx(2));
+    REQUIRE(m[0][3] == Approx(1));
+    REQUIRE(m[1][3] == Approx(2));
+    REQUIRE(m[2][3] == Approx(3));
+    REQUIRE(m[3][3] == Approx(1));
+    REQUIRE(reader.instanceTransforms(1).size() == 1);
+  }
+  std::remove(path.fullName().c_str());
+}
+
+TEST_CASE("readOBJ benchmark", "[.benchmark][io]") {
+  auto path = writeGridOBJ("circe_obj_benchmark.obj", 1024);
+  BENCHMARK("tinyobj") {
+    auto model = io::readOBJ(path, shape_options::none, 0, obj_parsing_engine::tinyobj);
+    return model.data().size();
+  };
+  BENCHMARK("native") {
+    auto model = io::readOBJ(path, shape_options::none, 0, obj_parsing_engine::native);
+    return model.data().size();
+  };
+  std::remove(path.fullName().c_str());
+}
+
+TEST_CASE("readPLY benchmark", "[.benchmark][io]") {
+  const u32 n = 1u << 20;
+  for (auto format : {ply_format::ascii, ply_format::binary_little_endian, ply_format::binary_big_endian}) {
+    auto path = writePointsPLY("circe_ply_benchmark.ply", format, n);
+    BENCHMARK(std::string("readPLY ") + (format == ply_format::ascii ? "ascii" :
+                                         format == ply_format::binary_little_endian ? "binary le" : "binary be")) {
+      auto model = io::readPLY(path);
+      return model.vertexCount();
+    };
+    std::remove(path.fullName().c_str());
+  }
+}
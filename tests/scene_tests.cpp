@@ -0,0 +1,1711 @@
+/// Copyright (c) 2022, FilipeCN.
+///
+/// The MIT License (MIT)
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+///\file scene_tests.cpp
+///\author FilipeCN (filipedecn@gmail.com)
+///\date 2022-01-11
+///
+///\brief
+
+#include <catch2/catch.hpp>
+
+#include <circe/scene/vertex_welder.h>
+#include <circe/scene/array.h>
+#include <circe/scene/attribute_semantics.h>
+#include <circe/scene/bvh.h>
+#include <circe/scene/bvh_builder.h>
+#include <circe/scene/edge_extractor.h>
+#include <circe/scene/frustum_culler.h>
+#include <circe/scene/mesh_optimizer.h>
+#include <circe/scene/mesh_simplifier.h>
+#include <circe/scene/model.h>
+#include <circe/scene/model_residency.h>
+#include <circe/scene/shapes.h>
+#include <circe/scene/tangent_space.h>
+#include <circe/scene/triangle_bvh.h>
+#include <circe/scene/vertex_quantizer.h>
+#include <circe/common/bounds.h>
+#include <circe/common/parallel.h>
+#include <circe/common/transform_kernels.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <set>
+
+using namespace circe;
+
+TEST_CASE("VertexWelder", "[scene]") {
+  struct Key {
+    i32 a, b, c;
+  };
+  std::mt19937 rng(7);
+  std::vector<Key> keys(100000);
+  for (auto &key : keys)
+    key = {static_cast<i32>(rng() % 3000), static_cast<i32>(rng() % 3), static_cast<i32>(rng() % 2)};
+  SECTION("methods") {
+    std::vector<i32> hashed_indices, sorted_indices;
+    std::vector<u64> hashed_unique, sorted_unique;
+    VertexWelder::weld(keys.data(), keys.size(), hashed_indices, hashed_unique, weld_method::hash_table);
+    VertexWelder::weld(keys.data(), keys.size(), sorted_indices, sorted_unique, weld_method::radix_sort);
+    REQUIRE(hashed_indices == sorted_indices);
+    REQUIRE(hashed_unique == sorted_unique);
+    for (u64 i = 0; i < keys.size(); ++i) {
+      const auto &unique = keys[hashed_unique[hashed_indices[i]]];
+      REQUIRE(unique.a == keys[i].a);
+      REQUIRE(unique.b == keys[i].b);
+      REQUIRE(unique.c == keys[i].c);
+    }
+    // first occurrence order
+    for (u64 i = 1; i < hashed_unique.size(); ++i)
+      REQUIRE(hashed_unique[i - 1] < hashed_unique[i]);
+  }
+  SECTION("radix sort") {
+    std::vector<u64> values(50000);
+    std::vector<u32> order(values.size());
+    for (u64 i = 0; i < values.size(); ++i) {
+      values[i] = (static_cast<u64>(rng()) << 32) | (rng() % 16);
+      order[i] = i;
+    }
+    auto expected = values;
+    std::stable_sort(expected.begin(), expected.end());
+    auto keys_copy = values;
+    RadixSort::sort(keys_copy, order);
+    REQUIRE(keys_copy == expected);
+    for (u64 i = 0; i < order.size(); ++i)
+      REQUIRE(values[order[i]] == keys_copy[i]);
+  }
+}
+
+TEST_CASE("Model bounds", "[scene]") {
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<f32> distribution(-5.f, 3.f);
+  Model model;
+  const u64 position_id = model.pushAttribute<hermes::point3>("position");
+  model.pushAttribute<hermes::vec3>("normal");
+  model.resize(100003);
+  f32 lower[3] = {1e9f, 1e9f, 1e9f}, upper[3] = {-1e9f, -1e9f, -1e9f};
+  std::vector<f32> tight;
+  {
+    auto positions = model.attributeAccessor<hermes::point3>(position_id);
+    for (u64 i = 0; i < model.vertexCount(); ++i) {
+      positions[i] = hermes::point3(distribution(rng), 2 * distribution(rng), 0.5f * distribution(rng));
+      for (int d = 0; d < 3; ++d) {
+        lower[d] = std::min(lower[d], positions[i][d]);
+        upper[d] = std::max(upper[d], positions[i][d]);
+        tight.emplace_back(positions[i][d]);
+      }
+    }
+  }
+  SECTION("reduction") {
+    auto box = model.boundingBox();
+    auto tight_box = Bounds::ofPoints(tight.data(), model.vertexCount());
+    for (int d = 0; d < 3; ++d) {
+      REQUIRE(box.lower[d] == lower[d]);
+      REQUIRE(box.upper[d] == upper[d]);
+      REQUIRE(tight_box.lower[d] == lower[d]);
+      REQUIRE(tight_box.upper[d] == upper[d]);
+    }
+    // positions at the end of 16 byte vertices: the buffer ends 12 bytes
+    // after the last point
+    std::vector<f32> padded(model.vertexCount() * 4);
+    for (u64 i = 0; i < model.vertexCount(); ++i)
+      std::memcpy(&padded[i * 4 + 1], &tight[i * 3], 3 * sizeof(f32));
+    auto padded_box = Bounds::ofPoints(padded.data() + 1, model.vertexCount(), 4 * sizeof(f32));
+    for (int d = 0; d < 3; ++d) {
+      REQUIRE(padded_box.lower[d] == lower[d]);
+      REQUIRE(padded_box.upper[d] == upper[d]);
+    }
+  }//
+  SECTION("cache") {
+    model.boundingBox();
+    model.attributeValue<hermes::point3>(position_id, 7) = hermes::point3(100, 0, 0);
+    REQUIRE(model.boundingBox().upper.x == 100);
+  }//
+  SECTION("fit to box") {
+    model.fitToBox(hermes::bbox3::unitBox());
+    auto box = model.boundingBox();
+    // y has the largest extent
+    REQUIRE(box.lower.y == Approx(0).margin(1e-5));
+    REQUIRE(box.upper.y == Approx(1).margin(1e-5));
+    REQUIRE(box.lower.x >= -1e-5);
+    REQUIRE(box.upper.x <= 1 + 1e-5);
+    REQUIRE((box.lower.x + box.upper.x) * 0.5f == Approx(0.5f));
+    REQUIRE((box.lower.z + box.upper.z) * 0.5f == Approx(0.5f));
+  }//
+  SECTION("separate storage") {
+    const auto interleaved = std::vector<u8>(model.vertexData(), model.vertexData() + model.vertexDataSizeInBytes());
+    model.setVertexStorage(vertex_storage::separate);
+    REQUIRE(model.vertexStorage() == vertex_storage::separate);
+    REQUIRE(model.vertexCount() == 100003);
+    const auto *positions = model.attributeArray<hermes::point3>(position_id);
+    for (u64 i = 0; i < model.vertexCount(); i += 101)
+      for (int d = 0; d < 3; ++d)
+        REQUIRE(positions[i][d] == tight[i * 3 + d]);
+    auto box = model.boundingBox();
+    for (int d = 0; d < 3; ++d) {
+      REQUIRE(box.lower[d] == lower[d]);
+      REQUIRE(box.upper[d] == upper[d]);
+    }
+    model.attributeArray<hermes::point3>(position_id)[3] = hermes::point3(0, -100, 0);
+    REQUIRE(model.boundingBox().lower.y == -100);
+    model.attributeArray<hermes::point3>(position_id)[3] = hermes::point3(tight[9], tight[10], tight[11]);
+    // const reads never change the storage
+    const Model &const_model = model;
+    REQUIRE(const_model.vertexData() == nullptr);
+    const auto const_positions = const_model.attributeAccessor<hermes::point3>(position_id);
+    REQUIRE(const_positions[5].y == tight[16]);
+    std::vector<u8> copied(interleaved.size());
+    const_model.copyVertexData(copied.data());
+    REQUIRE(copied == interleaved);
+    REQUIRE(model.vertexStorage() == vertex_storage::separate);
+    // materialize restores the original layout
+    model.materialize();
+    REQUIRE(std::memcmp(model.vertexData(), interleaved.data(), interleaved.size()) == 0);
+    REQUIRE(model.vertexStorage() == vertex_storage::interleaved);
+    REQUIRE(model.attributeData(position_id) == nullptr);
+  }//
+  SECTION("2d positions") {
+    // 2D "position" fields are never read as 3 floats
+    auto square = Shapes::box(hermes::bbox2(hermes::point2(0, 0), hermes::point2(1, 2)));
+    REQUIRE(square.vertexCount() > 0);
+    REQUIRE(square.positionAttribute() == square.vertexDescriptor().fields().size());
+    Model planar;
+    planar.pushAttribute<hermes::point2>("position");
+    const u64 normal_id = planar.pushAttribute<hermes::vec3>("normal");
+    planar.resize(3);
+    planar.attributeValue<hermes::vec3>(normal_id, 0) = hermes::vec3(0, 0, 1);
+    REQUIRE(planar.positionAttribute() == planar.vertexDescriptor().fields().size());
+    const auto box = planar.boundingBox();
+    REQUIRE(box.lower.x > box.upper.x);
+    planar.fitToBox(hermes::bbox3::unitBox());
+    REQUIRE(planar.attributeValue<hermes::vec3>(normal_id, 0).z == 1);
+    planar.setIndices({0, 1, 2, 0, 2, 1});
+    planar.setPrimitiveType(hermes::GeometricPrimitiveType::TRIANGLES);
+    MeshOptimizer::optimize(planar);
+    REQUIRE(planar.indexData()[1] == 1);
+  }
+}
+
+TEST_CASE("Parallel", "[scene]") {
+  Parallel::setThreadCount(4);
+  REQUIRE(Parallel::threadCount() == 4);
+  REQUIRE(!Parallel::insideWorker());
+  const u64 n = 1u << 16;
+  std::vector<u32> counts(Parallel::blockCount(n, 1024), 0);
+  REQUIRE(counts.size() == 4);
+  // assertions are checked on the calling thread, Catch is not thread safe
+  std::atomic<u32> nested_blocks{0}, serial_workers{0};
+  Parallel::forBlocks(n, [&](u64 begin, u64 end, u32 block) {
+    // nested loops run serially on the worker
+    if (Parallel::insideWorker() && Parallel::blockCount(n, 1) == 1)
+      serial_workers++;
+    Parallel::forBlocks(end - begin, [&](u64, u64, u32 nested) {
+      if (nested == 0)
+        nested_blocks++;
+    }, 1);
+    counts[block] = static_cast<u32>(end - begin);
+  }, 1024);
+  REQUIRE(serial_workers == 4);
+  REQUIRE(nested_blocks == 4);
+  u64 total = 0;
+  for (auto c : counts)
+    total += c;
+  REQUIRE(total == n);
+  REQUIRE(!Parallel::insideWorker());
+  {
+    Parallel::WorkerScope scope;
+    REQUIRE(Parallel::blockCount(n, 1) == 1);
+  }
+  REQUIRE(Parallel::blockCount(n, 1) == 4);
+  Parallel::setThreadCount(0);
+}
+
+TEST_CASE("TransformKernels", "[scene]") {
+  std::mt19937 rng(13);
+  std::uniform_real_distribution<f32> distribution(-2.f, 2.f);
+  const f32 m[3][4] = {{0.f, -2.f, 0.f, 1.f}, {1.f, 0.f, 0.5f, -3.f}, {0.f, 0.f, 3.f, 0.25f}};
+  auto reference = [&](const f32 *p, bool translate, f32 *r) {
+    for (int d = 0; d < 3; ++d)
+      r[d] = m[d][0] * p[0] + m[d][1] * p[1] + m[d][2] * p[2] + (translate ? m[d][3] : 0.f);
+  };
+  // odd count exercises the vector loops and the scalar tail
+  const u64 count = 50011;
+  Parallel::setThreadCount(4);
+  SECTION("packed") {
+    std::vector<f32> points(count * 3);
+    for (auto &v : points)
+      v = distribution(rng);
+    auto transformed = points;
+    TransformKernels::transformPoints(m, transformed.data(), count);
+    for (u64 i = 0; i < count; ++i) {
+      f32 r[3];
+      reference(&points[i * 3], true, r);
+      for (int d = 0; d < 3; ++d)
+        REQUIRE(transformed[i * 3 + d] == Approx(r[d]).margin(1e-5));
+    }
+    TransformKernels::transformVectors(m, points.data(), count, 3 * sizeof(f32), true);
+    for (u64 i = 0; i < count; ++i) {
+      const f32 *v = &points[i * 3];
+      REQUIRE(v[0] * v[0] + v[1] * v[1] + v[2] * v[2] == Approx(1).margin(1e-5));
+    }
+  }//
+  SECTION("strided") {
+    // 8 floats per element, the vector starts at the 4th float
+    std::vector<f32> data(count * 8);
+    for (auto &v : data)
+      v = distribution(rng);
+    auto transformed = data;
+    TransformKernels::transformVectors(m, transformed.data() + 3, count, 8 * sizeof(f32));
+    for (u64 i = 0; i < count; ++i) {
+      f32 r[3];
+      reference(&data[i * 8 + 3], false, r);
+      for (int d = 0; d < 3; ++d)
+        REQUIRE(transformed[i * 8 + 3 + d] == Approx(r[d]).margin(1e-5));
+      // other fields are untouched
+      REQUIRE(transformed[i * 8 + 2] == data[i * 8 + 2]);
+      REQUIRE(transformed[i * 8 + 6] == data[i * 8 + 6]);
+    }
+  }//
+  SECTION("normal matrix") {
+    // normals stay perpendicular to transformed tangents
+    f32 normal_matrix[3][4];
+    REQUIRE(TransformKernels::normalMatrix(m, normal_matrix));
+    f32 tangent[3] = {1, 1, 0}, normal[3] = {1, -1, 2};
+    TransformKernels::transformVectors(m, tangent, 1);
+    TransformKernels::transformVectors(normal_matrix, normal, 1, 3 * sizeof(f32), true);
+    REQUIRE(tangent[0] * normal[0] + tangent[1] * normal[1] + tangent[2] * normal[2] == Approx(0).margin(1e-5));
+    f32 zero[3] = {0, 0, 0};
+    TransformKernels::normalize(zero, 1);
+    REQUIRE(zero[0] == 0);
+  }
+  Parallel::setThreadCount(0);
+}
+
+TEST_CASE("MeshOptimizer", "[scene]") {
+  // shuffled triangles of a grid
+  const u32 n = 64;
+  Model model;
+  const u64 position_id = model.pushAttribute<hermes::point3>("position");
+  model.resize((n + 1) * (n + 1));
+  for (u32 y = 0; y <= n; ++y)
+    for (u32 x = 0; x <= n; ++x)
+      model.attributeValue<hermes::point3>(position_id, y * (n + 1) + x) = hermes::point3(x, y, 0);
+  std::vector<std::array<i32, 3>> triangles;
+  for (u32 y = 0; y < n; ++y)
+    for (u32 x = 0; x < n; ++x) {
+      const i32 a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+      triangles.push_back({a, b, d});
+      triangles.push_back({a, d, c});
+    }
+  // two sub-meshes (bottom and top rows), shuffled separately
+  const u64 half = triangles.size() / 2 * 3;
+  std::mt19937 rng(3);
+  std::shuffle(triangles.begin(), triangles.begin() + half / 3, rng);
+  std::shuffle(triangles.begin() + half / 3, triangles.end(), rng);
+  std::vector<i32> indices;
+  for (const auto &t : triangles)
+    indices.insert(indices.end(), t.begin(), t.end());
+  model.setIndices(std::move(indices));
+  model.setSubMeshes({{"a", 0, half, 0}, {"b", half, triangles.size() * 3 - half, 1}});
+  // triangles as sorted position keys, per sub-mesh
+  auto triangleKeys = [&](u64 begin, u64 end) {
+    std::vector<std::array<f32, 9>> keys;
+    const auto &model_indices = model.indices();
+    for (u64 i = begin; i < end; i += 3) {
+      std::array<hermes::point3, 3> t;
+      for (u32 k = 0; k < 3; ++k)
+        t[k] = model.attributeAccessor<hermes::point3>(position_id)[model_indices[i + k]];
+      // keep winding, rotate the smallest vertex first
+      u32 first = 0;
+      for (u32 k = 1; k < 3; ++k)
+        if (std::make_pair(t[k].x, t[k].y) < std::make_pair(t[first].x, t[first].y))
+          first = k;
+      std::array<f32, 9> key{};
+      for (u32 k = 0; k < 3; ++k)
+        for (u32 d = 0; d < 3; ++d)
+          key[k * 3 + d] = t[(first + k) % 3][d];
+      keys.emplace_back(key);
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+  };
+  auto keys_a = triangleKeys(0, half);
+  auto keys_b = triangleKeys(half, model.indexCount());
+  const u8 *vertex_data = model.vertexData();
+  const i32 *index_data = model.indexData();
+  auto report = MeshOptimizer::optimize(model);
+  // reordered in place
+  REQUIRE(model.vertexData() == vertex_data);
+  REQUIRE(model.indexData() == index_data);
+  REQUIRE(report.after.acmr < report.before.acmr);
+  REQUIRE(report.after.acmr < 1.f);
+  REQUIRE(report.after.atvr < report.before.atvr);
+  REQUIRE(model.vertexCount() == (n + 1) * (n + 1));
+  REQUIRE(triangleKeys(0, half) == keys_a);
+  REQUIRE(triangleKeys(half, model.indexCount()) == keys_b);
+  // vertices are numbered in first use order
+  i32 next = 0;
+  for (auto i : model.indices()) {
+    REQUIRE(i <= next);
+    next = std::max(next, i + 1);
+  }
+}
+
+TEST_CASE("MeshSimplifier", "[scene]") {
+  // height field grid
+  const u32 n = 64;
+  Model model;
+  const u64 position_id = model.pushAttribute<hermes::point3>("position");
+  model.resize((n + 1) * (n + 1));
+  for (u32 y = 0; y <= n; ++y)
+    for (u32 x = 0; x <= n; ++x)
+      model.attributeValue<hermes::point3>(position_id, y * (n + 1) + x) =
+          hermes::point3(x, y, 4 * std::sin(x * 0.1f) * std::cos(y * 0.1f));
+  std::vector<i32> indices;
+  for (u32 y = 0; y < n; ++y)
+    for (u32 x = 0; x < n; ++x) {
+      const i32 a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+      indices.insert(indices.end(), {a, b, d, a, d, c});
+    }
+  model.setIndices(std::move(indices));
+  SECTION("error bound") {
+    std::vector<i32> simplified;
+    f32 error = 0;
+    MeshSimplifier::simplify(model.indexData(), model.indexCount(),
+                             model.vertexData(), model.vertexDescriptor().sizeInBytes(), model.vertexCount(),
+                             0, 0.05f, simplified, &error);
+    REQUIRE(simplified.size() < model.indexCount());
+    REQUIRE(error <= 0.05f);
+  }//
+  SECTION("levels of detail") {
+    const auto full_bounds = model.boundingBox();
+    REQUIRE(MeshSimplifier::generateLevelsOfDetail(model, 4, 0.25f) == 4);
+    const auto &levels = model.levelsOfDetail();
+    REQUIRE(levels[0].index_offset == 0);
+    REQUIRE(levels[0].index_count == n * n * 6);
+    REQUIRE(model.elementCount() == n * n * 2);
+    for (u64 level = 1; level < levels.size(); ++level) {
+      REQUIRE(levels[level].index_offset == levels[level - 1].index_offset + levels[level - 1].index_count);
+      REQUIRE(levels[level].index_count <= levels[level - 1].index_count / 2);
+      REQUIRE(levels[level].error >= levels[level - 1].error);
+      // no degenerate triangles and the boundary is kept
+      f32 lower[2] = {1e9f, 1e9f}, upper[2] = {-1e9f, -1e9f};
+      const i32 *level_indices = model.indexData() + levels[level].index_offset;
+      for (u64 i = 0; i < levels[level].index_count; i += 3) {
+        REQUIRE(level_indices[i] != level_indices[i + 1]);
+        REQUIRE(level_indices[i + 1] != level_indices[i + 2]);
+        REQUIRE(level_indices[i] != level_indices[i + 2]);
+        for (u32 k = 0; k < 3; ++k) {
+          const auto &p = model.attributeAccessor<hermes::point3>(position_id)[level_indices[i + k]];
+          for (u32 d = 0; d < 2; ++d) {
+            lower[d] = std::min(lower[d], p[d]);
+            upper[d] = std::max(upper[d], p[d]);
+          }
+        }
+      }
+      for (u32 d = 0; d < 2; ++d) {
+        REQUIRE(lower[d] == full_bounds.lower[d]);
+        REQUIRE(upper[d] == full_bounds.upper[d]);
+      }
+    }
+  }//
+  SECTION("split vertices") {
+    // flat grid split into 4 x 4 patches with their own vertices (as split
+    // normals or uv charts do), patch borders are attribute seams
+    const u32 size = 32, patch_size = 8, patch_vertices = patch_size + 1;
+    std::vector<f32> positions;
+    std::vector<u32> vertex_patch;
+    std::vector<i32> split_indices;
+    for (u32 py = 0; py < size / patch_size; ++py)
+      for (u32 px = 0; px < size / patch_size; ++px) {
+        const i32 base = static_cast<i32>(vertex_patch.size());
+        for (u32 y = 0; y < patch_vertices; ++y)
+          for (u32 x = 0; x < patch_vertices; ++x) {
+            positions.insert(positions.end(), {static_cast<f32>(px * patch_size + x),
+                                               static_cast<f32>(py * patch_size + y), 0.f});
+            vertex_patch.emplace_back(py * size + px);
+          }
+        for (u32 y = 0; y < patch_size; ++y)
+          for (u32 x = 0; x < patch_size; ++x) {
+            const i32 a = base + static_cast<i32>(y * patch_vertices + x), b = a + 1;
+            const i32 c = a + static_cast<i32>(patch_vertices), d = c + 1;
+            split_indices.insert(split_indices.end(), {a, b, d, a, d, c});
+          }
+      }
+    std::vector<i32> simplified;
+    f32 error = 1;
+    MeshSimplifier::simplify(split_indices.data(), split_indices.size(),
+                             reinterpret_cast<const u8 *>(positions.data()), 3 * sizeof(f32),
+                             vertex_patch.size(), 0, 1e-3f, simplified, &error);
+    REQUIRE(error <= 1e-3f);
+    // seams are collapsed along, not locked
+    REQUIRE(simplified.size() * 10 < split_indices.size());
+    f64 area = 0;
+    for (u64 i = 0; i < simplified.size(); i += 3) {
+      // triangles keep the vertices of their own patch
+      REQUIRE(vertex_patch[simplified[i]] == vertex_patch[simplified[i + 1]]);
+      REQUIRE(vertex_patch[simplified[i]] == vertex_patch[simplified[i + 2]]);
+      const f32 *a = &positions[simplified[i] * 3], *b = &positions[simplified[i + 1] * 3],
+          *c = &positions[simplified[i + 2] * 3];
+      const f64 z = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+      REQUIRE(z > 0);
+      area += z * 0.5;
+    }
+    // no cracks or overlaps
+    REQUIRE(area == Approx(size * size));
+  }
+}
+
+TEST_CASE("AttributeSemantics", "[scene]") {
+  REQUIRE(AttributeSemantics::fromName("position") == attribute_semantic::position);
+  REQUIRE(AttributeSemantics::fromName("P") == attribute_semantic::position);
+  REQUIRE(AttributeSemantics::fromName("N") == attribute_semantic::normal);
+  REQUIRE(AttributeSemantics::fromName("vertexNormal") == attribute_semantic::normal);
+  REQUIRE(AttributeSemantics::fromName("tangents") == attribute_semantic::tangent);
+  REQUIRE(AttributeSemantics::fromName("bitangents") == attribute_semantic::bitangent);
+  REQUIRE(AttributeSemantics::fromName("binormal") == attribute_semantic::bitangent);
+  REQUIRE(AttributeSemantics::fromName("uvs_1") == attribute_semantic::texcoord);
+  REQUIRE(AttributeSemantics::fromName("Cd") == attribute_semantic::color);
+  REQUIRE(AttributeSemantics::fromName("density") == attribute_semantic::other);
+  REQUIRE(AttributeSemantics::isDirection("N"));
+  REQUIRE(!AttributeSemantics::isDirection("uv"));
+  SECTION("model transform") {
+    // short names are transformed by their role
+    Model model;
+    model.pushAttribute<hermes::point3>("P");
+    model.pushAttribute<hermes::vec3>("N");
+    model.pushAttribute<hermes::vec3>("T");
+    model.resize(1);
+    const f32 h = std::sqrt(0.5f);
+    model.attributeValue<hermes::point3>(0, 0) = hermes::point3(1, 1, 1);
+    model.attributeValue<hermes::vec3>(1, 0) = hermes::vec3(h, h, 0);
+    model.attributeValue<hermes::vec3>(2, 0) = hermes::vec3(h, h, 0);
+    // scale x by 2
+    hermes::Matrix4x4<real_t> m;
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4; ++j)
+        m[i][j] = i == j ? 1 : 0;
+    m[0][0] = 2;
+    model.transform(hermes::Transform(m));
+    const Model &transformed = model;
+    REQUIRE(transformed.attributeAccessor<hermes::point3>(0)[0].x == Approx(2));
+    // normals use the inverse transpose
+    const auto normal = transformed.attributeAccessor<hermes::vec3>(1)[0];
+    REQUIRE(normal.x == Approx(0.5f / std::sqrt(1.25f)));
+    REQUIRE(normal.y == Approx(1.f / std::sqrt(1.25f)));
+    // unknown names are left untouched
+    REQUIRE(transformed.attributeAccessor<hermes::vec3>(2)[0].x == Approx(h));
+  }
+}
+
+TEST_CASE("VertexQuantizer", "[scene]") {
+  SECTION("half") {
+    for (f32 v : {0.f, 1.f, -2.5f, 65504.f, 0.333251953125f, 6.103515625e-05f, 5.9604644775390625e-08f})
+      REQUIRE(VertexQuantizer::halfToFloat(VertexQuantizer::floatToHalf(v)) == v);
+    REQUIRE(VertexQuantizer::floatToHalf(1e6f) == 0x7c00);
+    REQUIRE(VertexQuantizer::floatToHalf(1.f + 1.f / 4096.f) == VertexQuantizer::floatToHalf(1.f));
+    REQUIRE(std::abs(VertexQuantizer::halfToFloat(VertexQuantizer::floatToHalf(0.1f)) - 0.1f) < 1e-4f);
+  }//
+  SECTION("model") {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<f32> distribution(-1.f, 1.f);
+    Model model;
+    const u64 position_id = model.pushAttribute<hermes::point3>("position");
+    const u64 normal_id = model.pushAttribute<hermes::vec3>("normal");
+    const u64 uv_id = model.pushAttribute<hermes::point2>("uvs");
+    model.resize(10000);
+    {
+      auto positions = model.attributeAccessor<hermes::point3>(position_id);
+      auto normals = model.attributeAccessor<hermes::vec3>(normal_id);
+      auto uvs = model.attributeAccessor<hermes::point2>(uv_id);
+      for (u64 i = 0; i < model.vertexCount(); ++i) {
+        positions[i] = hermes::point3(10 * distribution(rng), distribution(rng), 3 + 0.1f * distribution(rng));
+        hermes::vec3 n(distribution(rng), distribution(rng), distribution(rng));
+        normals[i] = n / n.length();
+        uvs[i] = hermes::point2(0.5f + 0.5f * distribution(rng), 0.5f + 0.5f * distribution(rng));
+      }
+    }
+    auto vertices = VertexQuantizer::quantize(model);
+    REQUIRE(vertices.vertex_count == model.vertexCount());
+    REQUIRE(vertices.stride == 16);
+    REQUIRE(vertices.memorySizeInBytes() * 2 == model.vertexDataSizeInBytes());
+    REQUIRE(vertices.attributes.size() == 3);
+    REQUIRE(vertices.attributes[0].encoding == vertex_encoding::snorm16);
+    REQUIRE(vertices.attributes[1].encoding == vertex_encoding::octahedral);
+    REQUIRE(vertices.attributes[2].encoding == vertex_encoding::half);
+    auto positions = model.attributeAccessor<hermes::point3>(position_id);
+    auto normals = model.attributeAccessor<hermes::vec3>(normal_id);
+    auto uvs = model.attributeAccessor<hermes::point2>(uv_id);
+    f32 position_error[3] = {0, 0, 0};
+    f32 normal_error = 0, uv_error = 0;
+    for (u64 i = 0; i < vertices.vertex_count; ++i) {
+      const auto p = VertexQuantizer::position(vertices, i);
+      for (int d = 0; d < 3; ++d)
+        position_error[d] = std::max(position_error[d], std::abs(p[d] - positions[i][d]));
+      const u8 *v = vertices.data.data() + i * vertices.stride;
+      i16 oct[2];
+      std::memcpy(oct, v + vertices.attributes[1].offset, sizeof(oct));
+      const auto n = VertexQuantizer::decodeOctahedral(oct[0], oct[1]);
+      normal_error = std::max(normal_error, (n - normals[i]).length());
+      u16 uv[2];
+      std::memcpy(uv, v + vertices.attributes[2].offset, sizeof(uv));
+      for (int d = 0; d < 2; ++d)
+        uv_error = std::max(uv_error, std::abs(VertexQuantizer::halfToFloat(uv[d]) - uvs[i][d]));
+    }
+    // one snorm16 step of each half extent
+    REQUIRE(position_error[0] <= 10.f / 32767.f);
+    REQUIRE(position_error[1] <= 1.f / 32767.f);
+    REQUIRE(position_error[2] <= 0.1f / 32767.f + 1e-6f);
+    REQUIRE(normal_error < 1e-4f);
+    REQUIRE(uv_error <= 1.f / 4096.f);
+    // decoding restores float attributes
+    auto decoded = VertexQuantizer::dequantize(vertices);
+    REQUIRE(decoded.size() == model.vertexCount());
+    REQUIRE(decoded.stride() == model.vertexDescriptor().sizeInBytes());
+    auto decoded_positions = decoded.field<hermes::point3>(0);
+    auto decoded_normals = decoded.field<hermes::vec3>(1);
+    for (u64 i = 0; i < vertices.vertex_count; i += 97) {
+      REQUIRE(decoded_positions[i].x == Approx(VertexQuantizer::position(vertices, i).x));
+      REQUIRE((decoded_normals[i] - normals[i]).length() < 1e-4f);
+    }
+    // shaders get the uniforms SceneModel sets along with the decoders
+    const std::string decoder = VertexQuantizer::glslDecoder();
+    for (const char *symbol : {"uniform vec3 position_offset;", "uniform vec3 position_scale;",
+                               "vec3 dequantizePosition(vec4", "vec3 decodeOctahedral(vec2"})
+      REQUIRE(decoder.find(symbol) != std::string::npos);
+  }
+}
+
+TEST_CASE("ModelResidency", "[scene]") {
+  auto model = Shapes::icosphere({1, 2, 3}, 2, 2, shape_options::normal | shape_options::uv);
+  model.setSubMeshes({{"sphere", 0, model.indexCount(), 3}});
+  const u64 position_id = model.positionAttribute();
+  auto vertexBytes = [](const Model &m) {
+    std::vector<u8> data(m.vertexDataSizeInBytes());
+    m.copyVertexData(data.data());
+    return data;
+  };
+  auto indexBytes = [](const Model &m) {
+    return std::vector<u8>(reinterpret_cast<const u8 *>(m.indexData()),
+                           reinterpret_cast<const u8 *>(m.indexData() + m.indexCount()));
+  };
+  // what a gpu upload stores
+  const auto layout = ModelResidency::layoutOf(model);
+  const auto vertex_data = vertexBytes(model);
+  const auto index_data = indexBytes(model);
+  REQUIRE(layout.vertex_count == model.vertexCount());
+  REQUIRE(layout.index_count == model.indexCount());
+  SECTION("keep") {
+    Model copy;
+    copy = model;
+    REQUIRE(ModelResidency::release(copy, cpu_residency::keep));
+    REQUIRE(vertexBytes(copy) == vertex_data);
+    REQUIRE(ModelResidency::holdsLayout(copy, layout));
+    // attribute updates are uploaded over the gpu buffers
+    copy.setVertexStorage(vertex_storage::separate);
+    REQUIRE(ModelResidency::holdsLayout(copy, layout));
+    copy.pushAttribute<f32>("weight");
+    REQUIRE(!ModelResidency::holdsLayout(copy, layout));
+  }//
+  SECTION("release") {
+    Model copy;
+    copy = model;
+    REQUIRE(ModelResidency::release(copy, cpu_residency::release));
+    REQUIRE(copy.vertexCount() == 0);
+    REQUIRE(copy.indexCount() == 0);
+    REQUIRE(copy.vertexDataSizeInBytes() == 0);
+    REQUIRE(!ModelResidency::holdsLayout(copy, layout));
+  }//
+  SECTION("positions only") {
+    for (auto storage : {vertex_storage::interleaved, vertex_storage::separate}) {
+      Model copy;
+      copy = model;
+      copy.setVertexStorage(storage);
+      REQUIRE(ModelResidency::release(copy, cpu_residency::positions_only));
+      REQUIRE(copy.vertexDescriptor().fields().size() == 1);
+      REQUIRE(copy.vertexCount() == model.vertexCount());
+      REQUIRE(copy.vertexDataSizeInBytes() == model.vertexCount() * sizeof(hermes::point3));
+      // positions cannot be uploaded over the full vertex buffers
+      REQUIRE(!ModelResidency::holdsLayout(copy, layout));
+      REQUIRE(indexBytes(copy) == index_data);
+      REQUIRE(copy.subMeshes().size() == 1);
+      REQUIRE(copy.subMeshes()[0].material_id == 3);
+      const auto positions = copy.attributeAccessor<hermes::point3>(copy.positionAttribute());
+      const auto original_positions = model.attributeAccessor<hermes::point3>(position_id);
+      for (u64 i = 0; i < model.vertexCount(); ++i)
+        REQUIRE(positions[i] == original_positions[i]);
+      REQUIRE(copy.boundingBox().lower == model.boundingBox().lower);
+      REQUIRE(copy.boundingBox().upper == model.boundingBox().upper);
+    }
+    // positions that are not 3 floats are kept with everything else
+    Model planar;
+    planar.pushAttribute<hermes::point2>("position");
+    planar.pushAttribute<hermes::vec3>("normal");
+    planar.resize(4);
+    REQUIRE(!ModelResidency::release(planar, cpu_residency::positions_only));
+    REQUIRE(planar.vertexDescriptor().fields().size() == 2);
+    REQUIRE(planar.vertexCount() == 4);
+  }//
+  SECTION("restore") {
+    Model copy;
+    copy = model;
+    REQUIRE(ModelResidency::release(copy, cpu_residency::release));
+    auto restored = ModelResidency::restore(layout, {vertex_data}, index_data);
+    REQUIRE(restored.vertexCount() == model.vertexCount());
+    REQUIRE(restored.vertexStorage() == vertex_storage::interleaved);
+    REQUIRE(vertexBytes(restored) == vertex_data);
+    REQUIRE(indexBytes(restored) == index_data);
+    REQUIRE(restored.primitiveType() == model.primitiveType());
+    REQUIRE(restored.subMeshes().size() == 1);
+    REQUIRE(restored.subMeshes()[0].name == "sphere");
+    // no gpu data
+    REQUIRE(ModelResidency::restore(layout, {}, {}).vertexCount() == 0);
+    REQUIRE(ModelResidency::restore(ModelResidency::Layout(), {vertex_data}, index_data).vertexCount() == 0);
+  }//
+  SECTION("restore separate storage") {
+    Model separate;
+    separate = model;
+    separate.setVertexStorage(vertex_storage::separate);
+    const auto separate_layout = ModelResidency::layoutOf(separate);
+    REQUIRE(separate_layout.storage == vertex_storage::separate);
+    const auto &fields = separate.vertexDescriptor().fields();
+    std::vector<std::vector<u8>> attribute_buffers;
+    for (u64 i = 0; i < fields.size(); ++i)
+      attribute_buffers.emplace_back(separate.attributeData(i),
+                                     separate.attributeData(i) + fields[i].size * separate.vertexCount());
+    auto restored = ModelResidency::restore(separate_layout, attribute_buffers, index_data);
+    REQUIRE(restored.vertexStorage() == vertex_storage::separate);
+    REQUIRE(vertexBytes(restored) == vertex_data);
+    REQUIRE(indexBytes(restored) == index_data);
+  }//
+  SECTION("restore quantized") {
+    auto quantized_layout = layout;
+    quantized_layout.quantized = true;
+    quantized_layout.quantized_vertices = VertexQuantizer::quantize(model);
+    const auto quantized_data = std::move(quantized_layout.quantized_vertices.data);
+    quantized_layout.quantized_vertices.data = {};
+    auto restored = ModelResidency::restore(quantized_layout, {quantized_data}, index_data);
+    REQUIRE(restored.vertexCount() == model.vertexCount());
+    REQUIRE(indexBytes(restored) == index_data);
+    const auto positions = restored.attributeAccessor<hermes::point3>(restored.positionAttribute());
+    const auto original_positions = model.attributeAccessor<hermes::point3>(position_id);
+    for (u64 i = 0; i < model.vertexCount(); ++i)
+      REQUIRE(hermes::distance(positions[i], original_positions[i]) < 1e-3f);
+  }
+}
+
+TEST_CASE("TangentSpace", "[scene]") {
+  SECTION("angle weighting") {
+    // cube corners shared by all faces (each face split into 2 triangles)
+    Model model;
+    const u64 position_id = model.pushAttribute<hermes::point3>("position");
+    const u64 normal_id = model.pushAttribute<hermes::vec3>("normal");
+    model.resize(8);
+    for (u64 i = 0; i < 8; ++i)
+      model.attributeValue<hermes::point3>(position_id, i) = {(i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f,
+                                                              (i & 4) ? 1.f : -1.f};
+    model.setIndices({0, 2, 3, 0, 3, 1, 4, 5, 7, 4, 7, 6, 0, 1, 5, 0, 5, 4,
+                      2, 6, 7, 2, 7, 3, 0, 4, 6, 0, 6, 2, 1, 3, 7, 1, 7, 5});
+    model.setPrimitiveType(hermes::GeometricPrimitiveType::TRIANGLES);
+    REQUIRE(TangentSpace::generate(model, shape_options::normal));
+    auto positions = model.attributeAccessor<hermes::point3>(position_id);
+    auto normals = model.attributeAccessor<hermes::vec3>(normal_id);
+    for (u64 i = 0; i < 8; ++i) {
+      hermes::vec3 expected(positions[i].x, positions[i].y, positions[i].z);
+      expected = expected / expected.length();
+      REQUIRE((normals[i] - expected).length() < 1e-5f);
+    }
+  }//
+  SECTION("external data") {
+    // a single triangle whose storage is scribbled over once the model
+    // releases it (as an unmapped file would be)
+    hermes::AoS vertices;
+    vertices.pushField<hermes::point3>("position");
+    vertices.pushField<hermes::vec3>("normal");
+    vertices.resize(3);
+    vertices.valueAt<hermes::point3>(0, 1) = {1, 0, 0};
+    vertices.valueAt<hermes::point3>(0, 2) = {0, 1, 0};
+    std::vector<i32> indices = {0, 1, 2};
+    bool released = false;
+    std::shared_ptr<const void> owner(indices.data(), [&](const void *) {
+      released = true;
+      std::fill(indices.begin(), indices.end(), 0);
+      std::memset(vertices.data(), 0, vertices.memorySizeInBytes());
+    });
+    Model model;
+    model.setExternalData(vertices.structDescriptor(), vertices.data(), 3, indices.data(), 3, owner);
+    model.setPrimitiveType(hermes::GeometricPrimitiveType::TRIANGLES);
+    owner.reset();
+    REQUIRE(!released);
+    REQUIRE(TangentSpace::generate(model, shape_options::normal));
+    REQUIRE(released);
+    REQUIRE(!model.hasExternalData());
+    REQUIRE(model.indexCount() == 3);
+    for (u64 i = 0; i < 3; ++i)
+      REQUIRE((model.attributeValue<hermes::vec3>(1, i) - hermes::vec3(0, 0, 1)).length() < 1e-5f);
+  }//
+  SECTION("grid") {
+    const u64 n = 256;
+    Model model;
+    const u64 position_id = model.pushAttribute<hermes::point3>("position");
+    const u64 normal_id = model.pushAttribute<hermes::vec3>("normal");
+    const u64 uv_id = model.pushAttribute<hermes::point2>("uv");
+    const u64 tangent_id = model.pushAttribute<hermes::vec3>("tangents");
+    const u64 bitangent_id = model.pushAttribute<hermes::vec3>("bitangents");
+    model.resize(n * n);
+    for (u64 y = 0; y < n; ++y)
+      for (u64 x = 0; x < n; ++x) {
+        // wavy surface z = sin(x)
+        const f32 px = x * 0.05f;
+        model.attributeValue<hermes::point3>(position_id, y * n + x) = {px, y * 0.05f, std::sin(px)};
+        model.attributeValue<hermes::point2>(uv_id, y * n + x) = {static_cast<f32>(x), static_cast<f32>(y)};
+      }
+    std::vector<i32> indices;
+    for (u64 y = 0; y + 1 < n; ++y)
+      for (u64 x = 0; x + 1 < n; ++x) {
+        const i32 v = y * n + x;
+        indices.insert(indices.end(), {v, v + 1, v + static_cast<i32>(n) + 1, v, v + static_cast<i32>(n) + 1,
+                                       v + static_cast<i32>(n)});
+      }
+    model.setIndices(std::move(indices));
+    model.setPrimitiveType(hermes::GeometricPrimitiveType::TRIANGLES);
+    Parallel::setThreadCount(1);
+    REQUIRE(TangentSpace::generate(model, shape_options::normal | shape_options::tangent_space));
+    std::vector<hermes::vec3> serial_normals(model.vertexCount());
+    for (u64 i = 0; i < model.vertexCount(); ++i)
+      serial_normals[i] = model.attributeAccessor<hermes::vec3>(normal_id)[i];
+    Parallel::setThreadCount(4);
+    REQUIRE(TangentSpace::generate(model, shape_options::normal | shape_options::tangent_space));
+    Parallel::setThreadCount(0);
+    auto positions = model.attributeAccessor<hermes::point3>(position_id);
+    auto normals = model.attributeAccessor<hermes::vec3>(normal_id);
+    auto tangents = model.attributeAccessor<hermes::vec3>(tangent_id);
+    auto bitangents = model.attributeAccessor<hermes::vec3>(bitangent_id);
+    for (u64 y = 1; y + 1 < n; ++y)
+      for (u64 x = 1; x + 1 < n; ++x) {
+        const u64 i = y * n + x;
+        REQUIRE((normals[i] - serial_normals[i]).length() < 1e-6f);
+        // analytic frame: tangent along d/dx, bitangent along +y
+        hermes::vec3 tangent(1, 0, std::cos(positions[i].x));
+        tangent = tangent / tangent.length();
+        hermes::vec3 normal(-tangent.z, 0, tangent.x);
+        REQUIRE((normals[i] - normal).length() < 1e-2f);
+        REQUIRE((tangents[i] - tangent).length() < 1e-2f);
+        REQUIRE((bitangents[i] - hermes::vec3(0, 1, 0)).length() < 1e-2f);
+        REQUIRE(std::abs(hermes::dot(normals[i], tangents[i])) < 1e-5f);
+      }
+  }
+}
+
+TEST_CASE("EdgeExtractor", "[scene]") {
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<i32> distribution(0, 5000);
+  // more blocks than cores exercise the block offsets
+  Parallel::setThreadCount(4);
+  for (u32 element_size : {3u, 4u}) {
+    std::vector<i32> indices(60000 * element_size);
+    for (auto &index : indices)
+      index = distribution(rng);
+    std::set<std::pair<i32, i32>> reference;
+    for (u64 i = 0; i < indices.size(); i += element_size)
+      for (u32 k = 0; k < element_size; ++k) {
+        const i32 a = indices[i + k];
+        const i32 b = indices[i + (k + 1) % element_size];
+        reference.insert({std::min(a, b), std::max(a, b)});
+      }
+    std::vector<u32> face_edges;
+    auto edges = EdgeExtractor::extract(indices.data(), indices.size() / element_size, element_size, &face_edges);
+    REQUIRE(edges.size() == reference.size() * 2);
+    u64 e = 0;
+    for (const auto &edge : reference) {
+      REQUIRE(edges[e * 2 + 0] == edge.first);
+      REQUIRE(edges[e * 2 + 1] == edge.second);
+      e++;
+    }
+    REQUIRE(face_edges.size() == indices.size());
+    for (u64 i = 0; i < indices.size(); i += element_size)
+      for (u32 k = 0; k < element_size; ++k) {
+        const i32 a = indices[i + k];
+        const i32 b = indices[i + (k + 1) % element_size];
+        const u32 edge_id = face_edges[i + k];
+        REQUIRE(edges[edge_id * 2 + 0] == std::min(a, b));
+        REQUIRE(edges[edge_id * 2 + 1] == std::max(a, b));
+      }
+  }
+  Parallel::setThreadCount(0);
+}
+
+TEST_CASE("Shapes", "[scene]") {
+  SECTION("icosphere") {
+    for (u32 divisions = 0; divisions < 5; ++divisions) {
+      const u64 n = 1u << divisions;
+      auto layout = Shapes::icosphereLayout(divisions, shape_options::normal | shape_options::uv);
+      REQUIRE(layout.vertex_count == 10 * n * n + 2);
+      REQUIRE(layout.index_count == 60 * n * n);
+      auto model = Shapes::icosphere({1, 2, 3}, 2, divisions, shape_options::normal | shape_options::uv);
+      REQUIRE(model.vertexCount() == layout.vertex_count);
+      REQUIRE(model.indexCount() == layout.index_count);
+      // caller provided memory gets the same data
+      std::vector<u8> vertices(layout.vertexDataSizeInBytes());
+      std::vector<i32> indices(layout.index_count);
+      Shapes::icosphere({1, 2, 3}, 2, divisions, shape_options::normal | shape_options::uv,
+                        vertices.data(), indices.data());
+      REQUIRE(std::memcmp(vertices.data(), model.vertexData(), vertices.size()) == 0);
+      REQUIRE(std::memcmp(indices.data(), model.indexData(), indices.size() * sizeof(i32)) == 0);
+      // closed sphere: every vertex is used, each edge has 2 triangles (V - E + F = 2)
+      auto positions = model.attributeAccessor<hermes::point3>(0);
+      for (u64 i = 0; i < model.vertexCount(); ++i)
+        REQUIRE(std::abs((positions[i] - hermes::point3(1, 2, 3)).length() - 2) < 1e-5f);
+      std::vector<u32> face_edges;
+      auto edges = EdgeExtractor::extract(indices.data(), indices.size() / 3, 3, &face_edges);
+      REQUIRE(edges.size() / 2 == 30 * n * n);
+      std::vector<u32> edge_faces(edges.size() / 2, 0);
+      for (auto e : face_edges)
+        edge_faces[e]++;
+      for (auto count : edge_faces)
+        REQUIRE(count == 2);
+      // counter-clockwise seen from outside
+      for (u64 t = 0; t < indices.size(); t += 3) {
+        auto normal = hermes::cross(positions[indices[t + 1]] - positions[indices[t]],
+                                    positions[indices[t + 2]] - positions[indices[t]]);
+        REQUIRE(hermes::dot(normal, positions[indices[t]] - hermes::point3(1, 2, 3)) > 0);
+      }
+    }
+  }//
+  SECTION("plane") {
+    auto layout = Shapes::planeLayout({3, 5}, shape_options::normal | shape_options::tangent_space);
+    REQUIRE(layout.vertex_count == 24);
+    REQUIRE(layout.index_count == 90);
+    REQUIRE(layout.vertex_descriptor.fields().size() == 5);
+    auto model = Shapes::plane(hermes::Plane(hermes::normal3(0, 0, 1), 0), {}, {1, 0, 0}, {3, 5}, {3, 5},
+                               shape_options::normal | shape_options::tangent_space);
+    REQUIRE(model.vertexCount() == 24);
+    for (auto index : model.indices())
+      REQUIRE(index < 24);
+    auto tangents = model.attributeAccessor<hermes::vec3>(3);
+    auto bitangents = model.attributeAccessor<hermes::vec3>(4);
+    REQUIRE(tangents[7].x == Approx(1));
+    REQUIRE(bitangents[7].y == Approx(1));
+  }//
+  SECTION("tessellation cache") {
+    Shapes::clearTessellationCache();
+    REQUIRE(Shapes::tessellationCacheSizeInBytes() == 0);
+    const auto options = shape_options::normal | shape_options::uv;
+    // serial and parallel cold builds match
+    Parallel::setThreadCount(1);
+    auto serial = Shapes::icosphere({}, 1, 4, options);
+    Shapes::clearTessellationCache();
+    Parallel::setThreadCount(4);
+    auto sphere = Shapes::icosphere({}, 1, 4, options);
+    Parallel::setThreadCount(0);
+    const u64 cache_size = Shapes::tessellationCacheSizeInBytes();
+    REQUIRE(cache_size > 0);
+    REQUIRE(std::memcmp(serial.vertexData(), sphere.vertexData(),
+                        sphere.vertexCount() * sphere.vertexDescriptor().sizeInBytes()) == 0);
+    // placement is applied on top of the cached unit sphere
+    auto moved = Shapes::icosphere({1, 2, 3}, 2, 4, options);
+    REQUIRE(Shapes::tessellationCacheSizeInBytes() == cache_size);
+    auto unit_positions = sphere.attributeAccessor<hermes::point3>(0);
+    auto positions = moved.attributeAccessor<hermes::point3>(0);
+    auto unit_normals = sphere.attributeAccessor<hermes::vec3>(1);
+    auto normals = moved.attributeAccessor<hermes::vec3>(1);
+    for (u64 i = 0; i < moved.vertexCount(); ++i) {
+      REQUIRE(positions[i].x == Approx(1 + 2 * unit_positions[i].x));
+      REQUIRE(positions[i].z == Approx(3 + 2 * unit_positions[i].z));
+      REQUIRE(normals[i].y == Approx(unit_normals[i].y));
+    }
+    REQUIRE(std::memcmp(sphere.indexData(), moved.indexData(), moved.indexCount() * sizeof(i32)) == 0);
+    // planes are oriented from the cached unit plane
+    auto plane = Shapes::plane(hermes::Plane(hermes::normal3(0, 1, 0), 0), {0, 1, 0}, {0, 0, 1}, {2, 4}, {2, 2},
+                               options | shape_options::tangent_space);
+    REQUIRE(Shapes::tessellationCacheSizeInBytes() > cache_size);
+    auto plane_positions = plane.attributeAccessor<hermes::point3>(0);
+    auto plane_normals = plane.attributeAccessor<hermes::vec3>(1);
+    auto plane_tangents = plane.attributeAccessor<hermes::vec3>(3);
+    for (u64 i = 0; i < plane.vertexCount(); ++i) {
+      REQUIRE(plane_positions[i].y == Approx(1));
+      REQUIRE(std::abs(plane_positions[i].z) <= 1 + 1e-5f);
+      REQUIRE(std::abs(plane_positions[i].x) <= 2 + 1e-5f);
+      REQUIRE(plane_normals[i].y == Approx(1));
+      REQUIRE(plane_tangents[i].z == Approx(1));
+    }
+    Shapes::clearTessellationCache();
+    REQUIRE(Shapes::tessellationCacheSizeInBytes() == 0);
+  }//
+  SECTION("box") {
+    REQUIRE(Shapes::boxLayout().vertex_count == 8);
+    REQUIRE(Shapes::boxLayout().index_count == 36);
+    REQUIRE(Shapes::boxLayout(shape_options::normal).vertex_count == 24);
+    REQUIRE(Shapes::boxLayout(shape_options::wireframe).index_count == 24);
+    REQUIRE(Shapes::boxLayout(shape_options::vertices).index_count == 0);
+    auto model = Shapes::box(hermes::bbox3::unitBox(), shape_options::normal | shape_options::uv);
+    REQUIRE(model.vertexCount() == 24);
+    auto positions = model.attributeAccessor<hermes::point3>(0);
+    auto normals = model.attributeAccessor<hermes::vec3>(1);
+    // face vertices lie on the face plane
+    for (u64 i = 0; i < 24; ++i) {
+      const f32 d = hermes::dot(hermes::vec3(positions[i].x - 0.5f, positions[i].y - 0.5f, positions[i].z - 0.5f),
+                                normals[i]);
+      REQUIRE(d == Approx(0.5f));
+    }
+  }
+}
+
+TEST_CASE("BVHBuilder", "[scene]") {
+  // small random triangles
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<f32> position(-10.f, 10.f), size(0.f, 0.2f);
+  const u64 n = 50000;
+  std::vector<hermes::bbox3> bounds(n);
+  for (auto &b : bounds) {
+    hermes::point3 p(position(rng), position(rng), position(rng));
+    b = hermes::bbox3(p, hermes::point3(p.x + size(rng), p.y + size(rng), p.z + size(rng)));
+  }
+  auto contains = [](const hermes::bbox3 &a, const hermes::bbox3 &b) {
+    return a.lower.x <= b.lower.x && a.lower.y <= b.lower.y && a.lower.z <= b.lower.z &&
+        a.upper.x >= b.upper.x && a.upper.y >= b.upper.y && a.upper.z >= b.upper.z;
+  };
+  auto check = [&](const std::vector<BVHBuilder::Node> &nodes, const std::vector<u32> &elements, u32 max_leaf_size) {
+    REQUIRE(elements.size() == n);
+    std::vector<u32> sorted = elements;
+    std::sort(sorted.begin(), sorted.end());
+    for (u64 i = 0; i < n; ++i)
+      REQUIRE(sorted[i] == i);
+    u64 referenced = 0;
+    for (u64 i = 0; i < nodes.size(); ++i) {
+      const auto &node = nodes[i];
+      if (node.isLeaf()) {
+        REQUIRE(node.count <= max_leaf_size);
+        referenced += node.count;
+        for (u32 e = 0; e < node.count; ++e)
+          REQUIRE(contains(node.bounds, bounds[elements[node.offset + e]]));
+      } else {
+        REQUIRE(node.offset > i + 1);
+        REQUIRE(node.offset < nodes.size());
+        REQUIRE(contains(node.bounds, nodes[i + 1].bounds));
+        REQUIRE(contains(node.bounds, nodes[node.offset].bounds));
+      }
+    }
+    REQUIRE(referenced == n);
+  };
+  SECTION("serial") {
+    std::vector<BVHBuilder::Node> nodes;
+    std::vector<u32> elements;
+    BVHBuilder::Options options;
+    options.parallel_size = n + 1;
+    auto statistics = BVHBuilder::build(bounds.data(), n, options, nodes, elements);
+    check(nodes, elements, options.max_leaf_size);
+    REQUIRE(statistics.node_count == nodes.size());
+    REQUIRE(statistics.node_count == 2 * statistics.leaf_count - 1);
+    REQUIRE(statistics.average_leaf_size <= options.max_leaf_size);
+    REQUIRE(statistics.max_depth < 64);
+    // single element leaves cost more to traverse
+    std::vector<BVHBuilder::Node> fine_nodes;
+    options.max_leaf_size = 1;
+    auto fine_statistics = BVHBuilder::build(bounds.data(), n, options, fine_nodes, elements);
+    check(fine_nodes, elements, 1);
+    REQUIRE(fine_statistics.leaf_count == n);
+    REQUIRE(fine_statistics.sah_cost > statistics.sah_cost);
+  }//
+  SECTION("parallel") {
+    Parallel::setThreadCount(4);
+    std::vector<BVHBuilder::Node> nodes;
+    std::vector<u32> elements;
+    BVHBuilder::Options options;
+    options.parallel_size = 1024;
+    auto statistics = BVHBuilder::build(bounds.data(), n, options, nodes, elements);
+    Parallel::setThreadCount(0);
+    check(nodes, elements, options.max_leaf_size);
+    REQUIRE(statistics.sah_cost == Approx(BVHBuilder::sahCost(nodes, options)));
+  }//
+  SECTION("degenerate") {
+    // all centroids coincide
+    std::vector<hermes::bbox3> same(100, hermes::bbox3(hermes::point3(0, 0, 0), hermes::point3(1, 1, 1)));
+    std::vector<BVHBuilder::Node> nodes;
+    std::vector<u32> elements;
+    auto statistics = BVHBuilder::build(same.data(), same.size(), {}, nodes, elements);
+    REQUIRE(elements.size() == 100);
+    REQUIRE(statistics.average_leaf_size <= 4);
+    REQUIRE(BVHBuilder::build(same.data(), 0, {}, nodes, elements).node_count == 0);
+    REQUIRE(nodes.empty());
+  }
+}
+
+TEST_CASE("BVHBuilder benchmark", "[.benchmark][scene]") {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<f32> position(-100.f, 100.f), size(0.f, 0.1f);
+  std::vector<hermes::bbox3> bounds(1u << 21);
+  for (auto &b : bounds) {
+    hermes::point3 p(position(rng), position(rng), position(rng));
+    b = hermes::bbox3(p, hermes::point3(p.x + size(rng), p.y + size(rng), p.z + size(rng)));
+  }
+  std::vector<BVHBuilder::Node> nodes;
+  std::vector<u32> elements;
+  BENCHMARK("binned sah") {
+    return BVHBuilder::build(bounds.data(), bounds.size(), {}, nodes, elements).node_count;
+  };
+}
+
+namespace {
+
+struct SphereObject {
+  [[nodiscard]] hermes::bbox3 worldBounds() const {
+    if (radius < 0)
+      return {};
+    return {hermes::point3(center.x - radius, center.y - radius, center.z - radius),
+            hermes::point3(center.x + radius, center.y + radius, center.z + radius)};
+  }
+  bool intersect(const hermes::Ray3 &r, float *t) {
+    // unbounded objects are planes z = center.z
+    if (radius < 0) {
+      if (r.d.z == 0)
+        return false;
+      *t = (center.z - r.o.z) / r.d.z;
+      return *t >= 0;
+    }
+    const hermes::vec3 oc = r.o - center;
+    const f32 a = hermes::dot(r.d, r.d);
+    const f32 b = hermes::dot(oc, r.d);
+    const f32 c = hermes::dot(oc, oc) - radius * radius;
+    const f32 discriminant = b * b - a * c;
+    if (discriminant < 0)
+      return false;
+    const f32 t0 = (-b - std::sqrt(discriminant)) / a;
+    const f32 t1 = (-b + std::sqrt(discriminant)) / a;
+    *t = t0 >= 0 ? t0 : t1;
+    return *t >= 0;
+  }
+  hermes::point3 center;
+  f32 radius{1};
+};
+
+}
+
+TEST_CASE("BVH", "[scene]") {
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<f32> position(-50.f, 50.f), radius(0.1f, 1.f), direction(-1.f, 1.f);
+  std::vector<SphereObject> spheres(5000);
+  for (auto &sphere : spheres) {
+    sphere.center = hermes::point3(position(rng), position(rng), position(rng));
+    sphere.radius = radius(rng);
+  }
+  // an object without bounds
+  spheres[17].center = hermes::point3(0, 0, -60);
+  spheres[17].radius = -1;
+  circe::Array<SphereObject> array;
+  circe::BVH<SphereObject> bvh;
+  for (auto &sphere : spheres) {
+    array.add(&sphere);
+    bvh.add(&sphere);
+  }
+  auto compare = [&]() {
+    std::mt19937 ray_rng(11);
+    u64 hits = 0;
+    for (int i = 0; i < 2000; ++i) {
+      hermes::Ray3 ray(hermes::point3(position(ray_rng), position(ray_rng), position(ray_rng)),
+                       hermes::vec3(direction(ray_rng), direction(ray_rng), direction(ray_rng)));
+      // axis aligned rays
+      if (i % 4 == 0)
+        ray.d = hermes::vec3(0, 0, i % 8 ? 1.f : -1.f);
+      float array_t = 0, bvh_t = 0;
+      auto *expected = array.intersect(ray, &array_t);
+      auto *found = bvh.intersect(ray, &bvh_t);
+      REQUIRE(found == expected);
+      if (expected) {
+        REQUIRE(bvh_t == Approx(array_t));
+        hits++;
+      }
+    }
+    REQUIRE(hits > 0);
+  };
+  SECTION("before init") {
+    compare();
+  }//
+  SECTION("after init") {
+    bvh.init();
+    REQUIRE(bvh.statistics().leaf_count > 0);
+    compare();
+    // added after init are still found
+    SphereObject late;
+    late.center = hermes::point3(0, 0, 1000);
+    late.radius = 1;
+    bvh.add(&late);
+    float t = 0;
+    REQUIRE(bvh.intersect(hermes::Ray3(hermes::point3(0, 0, 900), hermes::vec3(0, 0, 1)), &t) == &late);
+    REQUIRE(t == Approx(99));
+    u64 count = 0;
+    bvh.iterate([&](const SphereObject *) { count++; });
+    REQUIRE(count == spheres.size() + 1);
+  }
+}
+
+TEST_CASE("BVH benchmark", "[.benchmark][scene]") {
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<f32> position(-500.f, 500.f), direction(-1.f, 1.f);
+  std::vector<SphereObject> spheres(100000);
+  circe::Array<SphereObject> array;
+  circe::BVH<SphereObject> bvh;
+  for (auto &sphere : spheres) {
+    sphere.center = hermes::point3(position(rng), position(rng), position(rng));
+    array.add(&sphere);
+    bvh.add(&sphere);
+  }
+  bvh.init();
+  std::vector<hermes::Ray3> rays(1000);
+  for (auto &ray : rays)
+    ray = hermes::Ray3(hermes::point3(position(rng), position(rng), position(rng)),
+                       hermes::vec3(direction(rng), direction(rng), direction(rng)));
+  BENCHMARK("array") {
+    u64 hits = 0;
+    for (const auto &ray : rays)
+      hits += array.intersect(ray) != nullptr;
+    return hits;
+  };
+  BENCHMARK("bvh") {
+    u64 hits = 0;
+    for (const auto &ray : rays)
+      hits += bvh.intersect(ray) != nullptr;
+    return hits;
+  };
+}
+
+TEST_CASE("FrustumCuller", "[scene]") {
+  // OpenGL style perspective: eye at the origin looking down -z, 90 degrees,
+  // near 1, far 100
+  const f32 near = 1, far = 100;
+  hermes::Matrix4x4<real_t> clip;
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+      clip[i][j] = 0;
+  clip[0][0] = 1;
+  clip[1][1] = 1;
+  clip[2][2] = (far + near) / (near - far);
+  clip[2][3] = 2 * far * near / (near - far);
+  clip[3][2] = -1;
+  FrustumCuller culler(clip);
+  auto box = [](f32 x, f32 y, f32 z, f32 r) {
+    return hermes::bbox3(hermes::point3(x - r, y - r, z - r), hermes::point3(x + r, y + r, z + r));
+  };
+  SECTION("classify") {
+    REQUIRE(culler.classify(box(0, 0, -10, 1)) == frustum_test::inside);
+    REQUIRE(culler.classify(box(0, 0, 10, 1)) == frustum_test::outside);
+    REQUIRE(culler.classify(box(0, 0, -200, 1)) == frustum_test::outside);
+    REQUIRE(culler.classify(box(30, 0, -10, 1)) == frustum_test::outside);
+    REQUIRE(culler.classify(box(10, 0, -10, 1)) == frustum_test::intersecting);
+    REQUIRE(culler.classify(box(0, 0, -1, 0.5f)) == frustum_test::intersecting);
+    u8 plane_mask = FrustumCuller::all_planes;
+    REQUIRE(culler.classify(box(9.5f, 0, -10, 0.5f), plane_mask) == frustum_test::intersecting);
+    // only the right plane is crossed
+    REQUIRE(plane_mask == 2);
+    REQUIRE(FrustumCuller().classify(box(1e6f, 0, 0, 1)) == frustum_test::inside);
+  }
+  SECTION("structures") {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<f32> position(-150.f, 150.f), radius(0.1f, 2.f);
+    std::vector<SphereObject> spheres(20000);
+    for (auto &sphere : spheres) {
+      sphere.center = hermes::point3(position(rng), position(rng), position(rng));
+      sphere.radius = radius(rng);
+    }
+    spheres[3].radius = -1;
+    circe::Array<SphereObject> array;
+    circe::BVH<SphereObject> bvh;
+    for (auto &sphere : spheres) {
+      array.add(&sphere);
+      bvh.add(&sphere);
+    }
+    bvh.init();
+    // added after init
+    SphereObject late;
+    late.center = hermes::point3(0, 0, -20);
+    array.add(&late);
+    bvh.add(&late);
+
+    std::set<const SphereObject *> array_visible, bvh_visible;
+    FrustumCuller::Statistics array_statistics, bvh_statistics;
+    array.iterateVisible(culler, [&](SphereObject *o) { array_visible.insert(o); }, &array_statistics);
+    bvh.iterateVisible(culler, [&](SphereObject *o) { bvh_visible.insert(o); }, &bvh_statistics);
+    REQUIRE(array_visible == bvh_visible);
+    REQUIRE(array_visible.count(&spheres[3]));
+    REQUIRE(array_visible.count(&late));
+    for (const auto &sphere : spheres)
+      if (sphere.radius > 0 && sphere.center.z > sphere.radius)
+        REQUIRE(!array_visible.count(&sphere));
+    REQUIRE(array_statistics.visible == array_visible.size());
+    REQUIRE(array_statistics.visible + array_statistics.culled == spheres.size() + 1);
+    REQUIRE(array_statistics.unbounded == 1);
+    REQUIRE(bvh_statistics.visible == array_statistics.visible);
+    REQUIRE(bvh_statistics.culled == array_statistics.culled);
+    REQUIRE(bvh_statistics.unbounded == 1);
+    // whole subtrees are rejected
+    REQUIRE(bvh_statistics.box_tests < array_statistics.box_tests / 4);
+  }
+}
+
+namespace {
+
+/// Copies the positions and indices of a model into flat triangle arrays
+void trianglesOf(const Model &model, std::vector<hermes::point3> &positions, std::vector<i32> &indices) {
+  const auto vertices = model.attributeAccessor<hermes::point3>("position");
+  positions.resize(model.vertexCount());
+  for (u64 i = 0; i < model.vertexCount(); ++i)
+    positions[i] = vertices[i];
+  indices.assign(model.indexData(), model.indexData() + model.indexCount());
+}
+
+TriangleBVH::Hit bruteForceHit(const std::vector<hermes::point3> &positions, const std::vector<i32> &indices,
+                               const hermes::Ray3 &ray, u32 &count) {
+  TriangleBVH::Hit hit;
+  count = 0;
+  for (u64 i = 0; i < indices.size() / 3; ++i) {
+    const auto &a = positions[indices[i * 3]];
+    const hermes::vec3 e1 = positions[indices[i * 3 + 1]] - a;
+    const hermes::vec3 e2 = positions[indices[i * 3 + 2]] - a;
+    const hermes::vec3 p = hermes::cross(ray.d, e2);
+    const f32 det = hermes::dot(e1, p);
+    if (det == 0)
+      continue;
+    const hermes::vec3 s = ray.o - a;
+    const f32 u = hermes::dot(s, p) / det;
+    const hermes::vec3 q = hermes::cross(s, e1);
+    const f32 v = hermes::dot(ray.d, q) / det;
+    const f32 t = hermes::dot(e2, q) / det;
+    if (u < 0 || v < 0 || u + v > 1 || t < 0)
+      continue;
+    count++;
+    if (t < hit.t) {
+      hit.primitive = i;
+      hit.t = t;
+      hit.u = u;
+      hit.v = v;
+    }
+  }
+  return hit;
+}
+
+}
+
+TEST_CASE("TriangleBVH", "[scene]") {
+  // random triangles plus a shared-vertex grid
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<f32> position(-10.f, 10.f), offset(-1.f, 1.f), direction(-1.f, 1.f);
+  std::vector<hermes::point3> positions;
+  std::vector<i32> indices;
+  for (int i = 0; i < 3000; ++i) {
+    hermes::point3 p(position(rng), position(rng), position(rng));
+    for (int c = 0; c < 3; ++c) {
+      indices.emplace_back(positions.size());
+      positions.emplace_back(p.x + offset(rng), p.y + offset(rng), p.z + offset(rng));
+    }
+  }
+  const i32 grid_start = positions.size();
+  for (int y = 0; y <= 20; ++y)
+    for (int x = 0; x <= 20; ++x)
+      positions.emplace_back(x - 10.f, y - 10.f, -12.f);
+  for (int y = 0; y < 20; ++y)
+    for (int x = 0; x < 20; ++x) {
+      const i32 a = grid_start + y * 21 + x;
+      for (i32 v : {a, a + 1, a + 22, a, a + 22, a + 21})
+        indices.emplace_back(v);
+    }
+  const u64 triangle_count = indices.size() / 3;
+  TriangleBVH bvh;
+  auto statistics = bvh.build(positions.data(), indices.data(), triangle_count);
+  REQUIRE(bvh.triangleCount() == triangle_count);
+  REQUIRE(statistics.leaf_count > 0);
+
+  auto brute_force = [&](const hermes::Ray3 &ray, u32 &count) {
+    return bruteForceHit(positions, indices, ray, count);
+  };
+  std::vector<hermes::Ray3> rays;
+  // coherent bundle towards the grid
+  for (int y = 0; y < 16; ++y)
+    for (int x = 0; x < 16; ++x)
+      rays.emplace_back(hermes::point3(0.013f, 0.007f, 20), hermes::vec3(x / 16.f - .5f, y / 16.f - .5f, -1.f));
+  // incoherent rays, some axis aligned
+  for (int i = 0; i < 200; ++i) {
+    rays.emplace_back(hermes::point3(position(rng), position(rng), position(rng)),
+                      hermes::vec3(direction(rng), direction(rng), direction(rng)));
+    if (i % 5 == 0)
+      rays.back().d = hermes::vec3(0, 0, -1);
+  }
+  SECTION("single ray") {
+    TriangleBVH wide4_bvh, wide8_bvh;
+    wide4_bvh.build(positions.data(), indices.data(), triangle_count, {}, bvh_layout::wide4);
+    wide8_bvh.build(positions.data(), indices.data(), triangle_count, {}, bvh_layout::wide8);
+    REQUIRE(bvh.layout() == bvh_layout::binary);
+    REQUIRE(wide4_bvh.nodeMemorySizeInBytes() < bvh.nodeMemorySizeInBytes());
+    u64 hits = 0;
+    for (const auto &ray : rays) {
+      u32 expected_count = 0;
+      auto expected = brute_force(ray, expected_count);
+      auto hit = bvh.closestHit(ray);
+      REQUIRE(hit.primitive == expected.primitive);
+      REQUIRE(wide4_bvh.closestHit(ray).primitive == expected.primitive);
+      REQUIRE(wide8_bvh.closestHit(ray).primitive == expected.primitive);
+      REQUIRE(bvh.countHits(ray) == expected_count);
+      REQUIRE(wide4_bvh.countHits(ray) == expected_count);
+      REQUIRE(wide8_bvh.countHits(ray) == expected_count);
+      // single pass count and closest hit
+      f32 closest_t = 0;
+      REQUIRE(bvh.countHits(ray, &closest_t) == expected_count);
+      REQUIRE(closest_t == hit.t);
+      if (!hit.valid())
+        continue;
+      hits++;
+      REQUIRE(hit.t == Approx(expected.t));
+      REQUIRE(hit.u == Approx(expected.u).margin(1e-5));
+      REQUIRE(hit.v == Approx(expected.v).margin(1e-5));
+      // barycentrics reconstruct the hit point
+      const auto &a = positions[indices[hit.primitive * 3]];
+      const auto &b = positions[indices[hit.primitive * 3 + 1]];
+      const auto &c = positions[indices[hit.primitive * 3 + 2]];
+      const auto p = ray(hit.t);
+      for (int d = 0; d < 3; ++d)
+        REQUIRE(p[d] == Approx((1 - hit.u - hit.v) * a[d] + hit.u * b[d] + hit.v * c[d]).margin(1e-3));
+    }
+    REQUIRE(hits > 256);
+    // limited range
+    auto hit = bvh.closestHit(rays[0], 1.f);
+    REQUIRE(!hit.valid());
+  }//
+  SECTION("packets") {
+    std::vector<TriangleBVH::Hit> hits(rays.size());
+    bvh.closestHits(rays.data(), rays.size(), hits.data());
+    for (u64 i = 0; i < rays.size(); ++i) {
+      auto expected = bvh.closestHit(rays[i]);
+      REQUIRE(hits[i].primitive == expected.primitive);
+      if (expected.valid()) {
+        REQUIRE(hits[i].t == Approx(expected.t));
+        REQUIRE(hits[i].u == Approx(expected.u).margin(1e-5));
+      }
+    }
+    // partial packet with limited range
+    TriangleBVH::RayPacket packet;
+    packet.add(rays[0], 1.f);
+    packet.add(rays[1]);
+    packet.add(rays[2]);
+    TriangleBVH::Hit packet_hits[3];
+    bvh.closestHit(packet, packet_hits);
+    REQUIRE(!packet_hits[0].valid());
+    REQUIRE(packet_hits[1].primitive == bvh.closestHit(rays[1]).primitive);
+    REQUIRE(packet_hits[2].primitive == bvh.closestHit(rays[2]).primitive);
+  }
+}
+
+TEST_CASE("WideBVH", "[scene]") {
+  std::mt19937 rng(9);
+  std::uniform_real_distribution<f32> position(-1000.f, 1000.f), size(0.f, 0.5f);
+  std::vector<hermes::bbox3> bounds(20000);
+  for (auto &b : bounds) {
+    hermes::point3 p(position(rng), position(rng) * 1e-3f, position(rng));
+    b = hermes::bbox3(p, hermes::point3(p.x + size(rng), p.y, p.z + size(rng)));
+  }
+  std::vector<BVHBuilder::Node> nodes;
+  std::vector<u32> elements;
+  BVHBuilder::build(bounds.data(), bounds.size(), {}, nodes, elements);
+  auto check = [&](const auto &wide, u32 width) {
+    REQUIRE(!wide.nodes().empty());
+    REQUIRE(wide.nodes().size() < nodes.size() / (width - 1) + 1);
+    REQUIRE(wide.maxDepth() > 0);
+    // every element is reached once, through bounds that contain it
+    std::vector<u32> reached(bounds.size(), 0);
+    for (const auto &node : wide.nodes()) {
+      REQUIRE(node.child_count >= 2);
+      REQUIRE(node.child_count <= width);
+      for (u32 i = 0; i < node.child_count; ++i) {
+        const auto child_bounds = node.childBounds(i);
+        if (!node.isLeaf(i))
+          continue;
+        for (u32 e = node.child[i]; e < node.child[i] + node.count[i]; ++e) {
+          reached[elements[e]]++;
+          const auto &b = bounds[elements[e]];
+          for (int d = 0; d < 3; ++d) {
+            REQUIRE(child_bounds.lower[d] <= b.lower[d]);
+            REQUIRE(child_bounds.upper[d] >= b.upper[d]);
+          }
+        }
+      }
+    }
+    for (auto r : reached)
+      REQUIRE(r == 1);
+    // a ray down the y axis through an element reaches it
+    for (u32 i = 0; i < bounds.size(); i += 97) {
+      const auto c = bounds[i].centroid();
+      hermes::Ray3 ray(hermes::point3(c.x, 10.f, c.z), hermes::vec3(0, -1, 0));
+      bool found = false;
+      wide.traverse(ray, std::numeric_limits<f32>::infinity(), [&](u32 first, u32 count) {
+        for (u32 e = first; e < first + count; ++e)
+          found |= elements[e] == i;
+        return std::numeric_limits<f32>::infinity();
+      });
+      REQUIRE(found);
+    }
+  };
+  WideBVH<4> wide4;
+  wide4.build(nodes);
+  check(wide4, 4);
+  WideBVH<8> wide8;
+  wide8.build(nodes);
+  check(wide8, 8);
+  REQUIRE(sizeof(WideBVH<4>::Node) == 64);
+  REQUIRE(sizeof(WideBVH<8>::Node) == 128);
+  wide4.build({});
+  REQUIRE(wide4.nodes().empty());
+}
+
+TEST_CASE("TriangleBVH refit", "[scene]") {
+  // a 100x100 grid of quads
+  std::vector<hermes::point3> positions;
+  std::vector<i32> indices;
+  const int n = 100;
+  for (int y = 0; y <= n; ++y)
+    for (int x = 0; x <= n; ++x)
+      positions.emplace_back(x * .1f, y * .1f, 0.f);
+  for (int y = 0; y < n; ++y)
+    for (int x = 0; x < n; ++x) {
+      const i32 a = y * (n + 1) + x;
+      for (i32 v : {a, a + 1, a + n + 2, a, a + n + 2, a + n + 1})
+        indices.emplace_back(v);
+    }
+  const u64 triangle_count = indices.size() / 3;
+  TriangleBVH bvh;
+  bvh.build(positions.data(), indices.data(), triangle_count);
+  std::mt19937 rng(13);
+  std::uniform_real_distribution<f32> coordinate(0.f, 10.f);
+  auto check = [&]() {
+    // bounds contain their children and triangles
+    const auto &nodes = bvh.nodes();
+    auto contains = [](const hermes::bbox3 &a, const hermes::bbox3 &b) {
+      for (int d = 0; d < 3; ++d)
+        if (a.lower[d] > b.lower[d] || a.upper[d] < b.upper[d])
+          return false;
+      return true;
+    };
+    for (u64 i = 0; i < nodes.size(); ++i)
+      if (!nodes[i].isLeaf()) {
+        REQUIRE(contains(nodes[i].bounds, nodes[i + 1].bounds));
+        REQUIRE(contains(nodes[i].bounds, nodes[nodes[i].offset].bounds));
+      }
+    // queries match brute force
+    for (int i = 0; i < 100; ++i) {
+      hermes::Ray3 ray(hermes::point3(coordinate(rng), coordinate(rng), 5.f), hermes::vec3(0.01f, -0.02f, -1.f));
+      u32 expected_count = 0;
+      auto expected = bruteForceHit(positions, indices, ray, expected_count);
+      auto hit = bvh.closestHit(ray);
+      REQUIRE(hit.primitive == expected.primitive);
+      if (hit.valid())
+        REQUIRE(hit.t == Approx(expected.t));
+      REQUIRE(bvh.countHits(ray) == expected_count);
+    }
+  };
+  SECTION("smooth deformation") {
+    for (int frame = 1; frame <= 3; ++frame) {
+      for (auto &p : positions)
+        p.z = 0.5f * std::sin(p.x + frame * 0.5f) * std::cos(p.y);
+      TriangleBVH::RefitOptions options;
+      options.rebuild_threshold = 0;
+      auto statistics = bvh.refit(positions.data(), indices.data(), options);
+      REQUIRE(statistics.rebuilt_subtrees == 0);
+      REQUIRE(statistics.sah_cost == Approx(BVHBuilder::sahCost(bvh.nodes(), {})));
+      check();
+    }
+  }//
+  SECTION("degraded subtrees are rebuilt") {
+    // shuffle a region of the grid
+    std::vector<hermes::point3> shuffled = positions;
+    for (auto &p : shuffled)
+      if (p.x < 5.f && p.y < 5.f)
+        p = hermes::point3(coordinate(rng) * 0.5f, coordinate(rng) * 0.5f, coordinate(rng) * 0.1f);
+    positions = shuffled;
+    TriangleBVH::RefitOptions options;
+    options.rebuild_threshold = 0;
+    auto refit_only = bvh.refit(positions.data(), indices.data(), options);
+    REQUIRE(refit_only.degradation > 1.5f);
+    check();
+    options.rebuild_threshold = 1.5f;
+    auto rebuilt = bvh.refit(positions.data(), indices.data(), options);
+    REQUIRE(rebuilt.rebuilt_subtrees > 0);
+    REQUIRE(rebuilt.rebuilt_subtrees < TriangleBVH::refit_subtree_count);
+    REQUIRE(rebuilt.rebuilt_triangles < triangle_count);
+    REQUIRE(rebuilt.sah_cost < refit_only.sah_cost);
+    REQUIRE(bvh.statistics().sah_cost == Approx(BVHBuilder::sahCost(bvh.nodes(), {})));
+    check();
+    // the rebuilt subtrees are the new reference
+    auto again = bvh.refit(positions.data(), indices.data(), options);
+    REQUIRE(again.rebuilt_subtrees == 0);
+    check();
+  }
+}
+
+TEST_CASE("TriangleBVH benchmark", "[.benchmark][scene]") {
+  auto model = Shapes::icosphere(hermes::point3(), 1.f, 7);
+  std::vector<hermes::point3> positions;
+  std::vector<i32> indices;
+  trianglesOf(model, positions, indices);
+  TriangleBVH bvh;
+  bvh.build(positions.data(), indices.data(), indices.size() / 3);
+  // coherent primary rays
+  std::vector<hermes::Ray3> rays;
+  const int resolution = 256;
+  for (int y = 0; y < resolution; ++y)
+    for (int x = 0; x < resolution; ++x)
+      rays.emplace_back(hermes::point3(0, 0, 3),
+                        hermes::vec3(x * 0.8f / resolution - 0.4f, y * 0.8f / resolution - 0.4f, -1.f));
+  // group rays in 4x2 tiles
+  std::vector<hermes::Ray3> tiled;
+  for (int y = 0; y < resolution; y += 2)
+    for (int x = 0; x < resolution; x += 4)
+      for (int j = 0; j < 2; ++j)
+        for (int i = 0; i < 4; ++i)
+          tiled.emplace_back(rays[(y + j) * resolution + x + i]);
+  std::vector<TriangleBVH::Hit> hits(rays.size());
+  for (auto layout : {bvh_layout::binary, bvh_layout::wide4, bvh_layout::wide8}) {
+    TriangleBVH layout_bvh;
+    layout_bvh.build(positions.data(), indices.data(), indices.size() / 3, {}, layout);
+    BENCHMARK("single rays (layout " + std::to_string(static_cast<int>(layout)) + ")") {
+      for (u64 i = 0; i < rays.size(); ++i)
+        hits[i] = layout_bvh.closestHit(rays[i]);
+      return hits.back().t;
+    };
+  }
+  BENCHMARK("packets") {
+    bvh.closestHits(tiled.data(), tiled.size(), hits.data());
+    return hits.back().t;
+  };
+}
+
+TEST_CASE("TriangleBVH refit benchmark", "[.benchmark][scene]") {
+  auto model = Shapes::icosphere(hermes::point3(), 1.f, 8);
+  std::vector<hermes::point3> positions;
+  std::vector<i32> indices;
+  trianglesOf(model, positions, indices);
+  TriangleBVH bvh;
+  bvh.build(positions.data(), indices.data(), indices.size() / 3);
+  const auto rest = positions;
+  int frame = 0;
+  BENCHMARK("build") {
+    TriangleBVH rebuilt;
+    return rebuilt.build(positions.data(), indices.data(), indices.size() / 3).node_count;
+  };
+  BENCHMARK("refit") {
+    frame++;
+    for (u64 i = 0; i < positions.size(); ++i) {
+      const f32 s = 1 + 0.2f * std::sin(4 * rest[i].y + frame * 0.1f);
+      positions[i] = hermes::point3(rest[i].x * s, rest[i].y, rest[i].z * s);
+    }
+    return bvh.refit(positions.data(), indices.data()).sah_cost;
+  };
+}
+
+TEST_CASE("TriangleBVH inside", "[scene]") {
+  auto model = Shapes::icosphere(hermes::point3(), 1.f, 4);
+  std::vector<hermes::point3> positions;
+  std::vector<i32> indices;
+  trianglesOf(model, positions, indices);
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<f32> position(-1.5f, 1.5f);
+  std::vector<hermes::point3> points;
+  std::vector<u8> expected;
+  while (points.size() < 4000) {
+    hermes::point3 p(position(rng), position(rng), position(rng));
+    const f32 distance = hermes::vec3(p.x, p.y, p.z).length();
+    // skip the gap between the sphere and its tessellation
+    if (distance > 0.98f && distance < 1.02f)
+      continue;
+    points.emplace_back(p);
+    expected.emplace_back(distance < 1);
+  }
+  TriangleBVH bvh;
+  bvh.build(positions.data(), indices.data(), indices.size() / 3);
+  SECTION("closed mesh") {
+    std::vector<u8> winding_inside(points.size()), parity_inside(points.size());
+    TriangleBVH::InsideOptions options;
+    bvh.isInside(points.data(), points.size(), winding_inside.data());
+    options.method = inside_test::parity;
+    bvh.isInside(points.data(), points.size(), parity_inside.data(), options);
+    REQUIRE(winding_inside == expected);
+    REQUIRE(parity_inside == expected);
+    std::vector<f32> winding_numbers(points.size());
+    bvh.windingNumbers(points.data(), points.size(), winding_numbers.data());
+    for (u64 i = 0; i < points.size(); ++i) {
+      REQUIRE(winding_numbers[i] == Approx(expected[i]).margin(0.05));
+      // the far field approximation stays close to the exact sum
+      REQUIRE(winding_numbers[i] == Approx(bvh.windingNumber(points[i], 1e6f)).margin(0.05));
+    }
+    REQUIRE(bvh.isInside(hermes::point3(0, 0, 0)));
+    REQUIRE(!bvh.isInside(hermes::point3(0, 0, 2)));
+  }
+  SECTION("open mesh") {
+    // cut a hole around the north pole
+    std::vector<i32> open_indices;
+    for (u64 i = 0; i < indices.size(); i += 3)
+      if (positions[indices[i]].z < 0.9f || positions[indices[i + 1]].z < 0.9f || positions[indices[i + 2]].z < 0.9f)
+        open_indices.insert(open_indices.end(), indices.begin() + i, indices.begin() + i + 3);
+    REQUIRE(open_indices.size() < indices.size());
+    TriangleBVH open_bvh;
+    open_bvh.build(positions.data(), open_indices.data(), open_indices.size() / 3);
+    std::vector<u8> inside(points.size());
+    open_bvh.isInside(points.data(), points.size(), inside.data());
+    for (u64 i = 0; i < points.size(); ++i)
+      if (points[i].z < 0.5f)
+        REQUIRE(inside[i] == expected[i]);
+  }
+  SECTION("refit") {
+    for (auto &p : positions)
+      p = hermes::point3(p.x * 2, p.y, p.z);
+    bvh.refit(positions.data(), indices.data());
+    REQUIRE(bvh.isInside(hermes::point3(1.5f, 0, 0)));
+    REQUIRE(!bvh.isInside(hermes::point3(0, 1.5f, 0)));
+  }
+}
+
+TEST_CASE("TriangleBVH inside benchmark", "[.benchmark][scene]") {
+  auto model = Shapes::icosphere(hermes::point3(), 1.f, 6);
+  std::vector<hermes::point3> positions;
+  std::vector<i32> indices;
+  trianglesOf(model, positions, indices);
+  TriangleBVH bvh;
+  bvh.build(positions.data(), indices.data(), indices.size() / 3);
+  // grid samples, as used to seed simulations
+  const int n = 32;
+  std::vector<hermes::point3> points;
+  for (int z = 0; z < n; ++z)
+    for (int y = 0; y < n; ++y)
+      for (int x = 0; x < n; ++x)
+        points.emplace_back(3.f * x / n - 1.5f, 3.f * y / n - 1.5f, 3.f * z / n - 1.5f);
+  std::vector<u8> inside(points.size());
+  TriangleBVH::InsideOptions options;
+  BENCHMARK("winding number") {
+    bvh.isInside(points.data(), points.size(), inside.data(), options);
+    return inside.back();
+  };
+  BENCHMARK("parity") {
+    TriangleBVH::InsideOptions parity;
+    parity.method = inside_test::parity;
+    bvh.isInside(points.data(), points.size(), inside.data(), parity);
+    return inside.back();
+  };
+}